@@ -0,0 +1,81 @@
+#include "storage/buffer_pool.hpp"
+#include "storage/disk_manager.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Hit-path latency of fetch_page/unpin_page as the pool grows. Every page is
+// resident, so nothing here touches the disk. The hot-set column probes the
+// same 64 pages at every size and isolates replacer bookkeeping; the uniform
+// column spreads probes over the whole pool and also pays cache misses.
+
+static uint64_t xorshift(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static double run_probes(BufferPoolManager& bpm, FileId file_id, const std::vector<uint32_t>& probes, size_t ops) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ops; i++) {
+        uint32_t page_id = probes[i & (probes.size() - 1)];
+        bpm.fetch_page(file_id, page_id);
+        bpm.unpin_page(file_id, page_id, false);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(ops);
+}
+
+static void bench_hit_path(size_t pool_size, size_t ops) {
+    const std::string path = "bench_buffer_pool.db";
+    std::remove(path.c_str());
+    DiskManager dm(path);
+    BufferPoolManager bpm(pool_size);
+    FileId file_id = bpm.attach_file(dm);
+
+    // Pages past EOF read back as zeroes, so warming the pool never writes.
+    for (size_t i = 0; i < pool_size; i++) {
+        uint32_t page_id = static_cast<uint32_t>(i);
+        if (bpm.fetch_page(file_id, page_id) == nullptr) {
+            std::cerr << "warmup fetch failed at page " << page_id << "\n";
+            return;
+        }
+        bpm.unpin_page(file_id, page_id, false);
+    }
+
+    std::vector<uint32_t> hot_probes(1 << 16);
+    std::vector<uint32_t> uniform_probes(1 << 16);
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < hot_probes.size(); i++) {
+        hot_probes[i] = static_cast<uint32_t>(xorshift(state) % 64);
+        uniform_probes[i] = static_cast<uint32_t>(xorshift(state) % pool_size);
+    }
+
+    double hot_ns = run_probes(bpm, file_id, hot_probes, ops);
+    double uniform_ns = run_probes(bpm, file_id, uniform_probes, ops);
+    std::cout << "  frames=" << pool_size << "\thot-set ns/op=" << hot_ns
+              << "\tuniform ns/op=" << uniform_ns << "\n";
+    std::remove(path.c_str());
+}
+
+int main(int argc, char** argv) {
+    size_t max_frames = 1u << 20;
+    if (argc > 1) {
+        max_frames = std::strtoull(argv[1], nullptr, 10);
+    }
+    const size_t ops = 2000000;
+
+    std::cout << "\n=== BufferPoolManager hit-path latency (fetch + unpin) ===\n";
+    for (size_t frames = 128; frames <= max_frames; frames *= 8) {
+        bench_hit_path(frames, ops);
+    }
+    if (max_frames >= (1u << 20)) {
+        bench_hit_path(1u << 20, ops);
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include "storage/buffer_pool.hpp"
+#include "storage/disk_manager.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Throughput of concurrent fetch_page / frame latch / unpin_page on a fully
+// resident working set, for a growing number of threads. Each operation takes
+// the frame latch shared and reads one byte, the way a B+tree lookup would
+// touch a page. Every eighth operation takes it exclusive and marks the page
+// dirty, standing in for an insert.
+
+static uint64_t xorshift(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static void worker(BufferPoolManager& bpm, FileId file_id, size_t pages, size_t ops,
+                   uint64_t seed, std::atomic<bool>& start, std::atomic<uint64_t>& checksum) {
+    uint64_t state = seed;
+    uint64_t sum = 0;
+    while (!start.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+    for (size_t i = 0; i < ops; i++) {
+        uint64_t r = xorshift(state);
+        uint32_t page_id = static_cast<uint32_t>(r % pages);
+        bool write = (r >> 32) % 8 == 0;
+        Page* page = bpm.fetch_page(file_id, page_id);
+        if (page == nullptr) {
+            continue;
+        }
+        if (write) {
+            std::unique_lock<FrameLatch> latch(bpm.frame_latch(page));
+            page->data[PAGE_SIZE - 1]++;
+        } else {
+            std::shared_lock<FrameLatch> latch(bpm.frame_latch(page));
+            sum += page->data[PAGE_SIZE - 1];
+        }
+        bpm.unpin_page(file_id, page_id, write);
+    }
+    checksum += sum;
+}
+
+static void bench_threads(size_t pool_size, size_t threads, size_t ops_per_thread) {
+    const std::string path = "bench_buffer_pool_mt.db";
+    std::remove(path.c_str());
+    DiskManager dm(path);
+    {
+        BufferPoolManager bpm(pool_size);
+        FileId file_id = bpm.attach_file(dm);
+
+        // Leave headroom so no operation has to evict.
+        size_t pages = pool_size / 2;
+        for (size_t i = 0; i < pages; i++) {
+            uint32_t page_id = static_cast<uint32_t>(i);
+            if (bpm.fetch_page(file_id, page_id) == nullptr) {
+                std::cerr << "warmup fetch failed at page " << page_id << "\n";
+                return;
+            }
+            bpm.unpin_page(file_id, page_id, false);
+        }
+
+        std::atomic<bool> start{false};
+        std::atomic<uint64_t> checksum{0};
+        std::vector<std::thread> pool;
+        for (size_t t = 0; t < threads; t++) {
+            pool.emplace_back(worker, std::ref(bpm), file_id, pages, ops_per_thread,
+                              0x9E3779B97F4A7C15ULL + t * 0x632BE59BD9B4E019ULL,
+                              std::ref(start), std::ref(checksum));
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        start.store(true, std::memory_order_release);
+        for (auto& th : pool) {
+            th.join();
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(end - begin).count();
+        double total_ops = static_cast<double>(threads * ops_per_thread);
+        std::cout << "  threads=" << threads << "\tshards=" << bpm.get_shard_count()
+                  << "\tMops/s=" << total_ops / seconds / 1e6
+                  << "\tns/op/thread=" << seconds * 1e9 / static_cast<double>(ops_per_thread) << "\n";
+    }
+    std::remove(path.c_str());
+}
+
+int main(int argc, char** argv) {
+    size_t max_threads = 32;
+    if (argc > 1) {
+        max_threads = std::strtoull(argv[1], nullptr, 10);
+    }
+    const size_t pool_size = 8192;
+    const size_t ops_per_thread = 500000;
+
+    std::cout << "\n=== BufferPoolManager concurrent throughput (fetch + latch + unpin) ===\n";
+    std::cout << "  hardware threads: " << std::thread::hardware_concurrency() << "\n";
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        bench_threads(pool_size, threads, ops_per_thread);
+    }
+    return 0;
+}
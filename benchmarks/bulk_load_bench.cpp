@@ -0,0 +1,96 @@
+#include "storage/interface/storage_engine.hpp"
+#include "storage/table_handle.hpp"
+#include "storage/btree.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Loads the same sorted rows into an empty table twice: once with one
+// insert_record per row, and once through bulk_load. Then appends as many
+// rows again past the largest key the same two ways. Prints load time and
+// throughput, how many pages the load wrote, and where the leaves ended up.
+
+static std::vector<uint8_t> make_key(uint32_t i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "key%010u", i);
+    return std::vector<uint8_t>(buf, buf + 13);
+}
+
+struct Rows {
+    uint32_t next;
+    uint32_t end;
+    std::vector<uint8_t> value;
+};
+
+static bool next_row(std::vector<uint8_t>& key, std::vector<uint8_t>& value, void* ctx) {
+    Rows* rows = static_cast<Rows*>(ctx);
+    if (rows->next >= rows->end) {
+        return false;
+    }
+    key = make_key(rows->next++);
+    value = rows->value;
+    return true;
+}
+
+static void bench_load(const std::string& table_name, uint32_t first, uint32_t rows, bool bulk) {
+    StorageEngine se(64 * 1024 * 1024);
+    TableHandle* th = se.open_table(table_name);
+    if (th == nullptr) {
+        std::cout << "  open_table failed\n";
+        return;
+    }
+    Rows source{first, first + rows, std::vector<uint8_t>(64, 'v')};
+    bool ok = true;
+    auto start = std::chrono::steady_clock::now();
+    if (bulk) {
+        ok = se.bulk_load(th, next_row, &source);
+    } else {
+        std::vector<uint8_t> key;
+        std::vector<uint8_t> value;
+        while (ok && next_row(key, value, &source)) {
+            ok = se.insert_record(th, key, value);
+        }
+    }
+    se.flush_all();
+    auto end = std::chrono::steady_clock::now();
+    double load_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    BufferPoolStats stats = th->bpm->get_stats();
+    LeafLayout layout = btree_leaf_layout(*th);
+    std::cout << "  " << (bulk ? "bulk_load" : "insert_record")
+              << (ok ? "" : " FAILED")
+              << "\tms=" << load_ms
+              << "\tKrows/s=" << static_cast<double>(rows) / load_ms
+              << "\tpages written=" << stats.foreground_writes + stats.background_writes
+              << "\tleaves=" << layout.leaves
+              << "\tsequential hops=" << layout.sequential_share() * 100.0 << "%\n";
+    se.close_table(th);
+}
+
+int main(int argc, char** argv) {
+    uint32_t rows = 1000000;
+    if (argc > 1) {
+        rows = static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10));
+    }
+
+    for (bool append : {false, true}) {
+        std::cout << "\n=== " << (append ? "Appending " : "Loading ") << rows << " sorted rows"
+                  << (append ? " past the largest key" : " into an empty table") << " ===\n";
+        for (bool bulk : {false, true}) {
+            std::string table_name = bulk ? "bench_bulk_load" : "bench_insert_load";
+            if (!append) {
+                std::remove(("data/" + table_name + ".db").c_str());
+                StorageEngine se;
+                se.create_table(table_name);
+            }
+            bench_load(table_name, append ? rows : 0, rows, bulk);
+        }
+    }
+
+    std::remove("data/bench_bulk_load.db");
+    std::remove("data/bench_insert_load.db");
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include "storage/interface/storage_engine.hpp"
+#include "storage/table_handle.hpp"
+#include "storage/btree.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// A table loaded in random order and then mostly purged: its leaves are
+// sparse and scattered, and the file keeps its full size. Compares a cold
+// full scan and the file size before and after compact_table, and how long
+// inserts running alongside the compaction waited for it. Scans run after
+// asking the OS to drop the file from its cache, through a pool a quarter of
+// the table's size before compaction.
+
+static std::vector<uint8_t> make_key(uint32_t i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "key%010u", i);
+    return std::vector<uint8_t>(buf, buf + 13);
+}
+
+static void count_rows(const std::vector<uint8_t>& key, const std::vector<uint8_t>& value, void* ctx) {
+    (void)key;
+    (void)value;
+    (*static_cast<size_t*>(ctx))++;
+}
+
+static void drop_os_cache(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    fsync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+#endif
+}
+
+static size_t file_bytes(const std::string& path) {
+    size_t bytes = 0;
+    if (FILE* file = std::fopen(path.c_str(), "rb")) {
+        std::fseek(file, 0, SEEK_END);
+        bytes = static_cast<size_t>(std::ftell(file));
+        std::fclose(file);
+    }
+    return bytes;
+}
+
+static void bench_scan(const std::string& table_name, size_t pool_bytes, const char* label) {
+    std::string path = "data/" + table_name + ".db";
+    StorageEngine se(pool_bytes);
+    drop_os_cache(path);
+    TableHandle* th = se.open_table(table_name);
+    if (th == nullptr) {
+        std::cout << "  open_table failed\n";
+        return;
+    }
+    LeafLayout layout = btree_leaf_layout(*th);
+    se.close_table(th);
+    drop_os_cache(path);
+    th = se.open_table(table_name);
+    size_t scanned = 0;
+    uint64_t syscalls = th->dm->get_syscall_count();
+    auto start = std::chrono::steady_clock::now();
+    se.scan_table(th, count_rows, &scanned);
+    auto end = std::chrono::steady_clock::now();
+    double scan_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    std::cout << "  " << label
+              << "\tleaves=" << layout.leaves
+              << "\tsequential hops=" << layout.sequential_share() * 100.0 << "%"
+              << "\tfile MB=" << static_cast<double>(file_bytes(path)) / (1024.0 * 1024.0)
+              << "\tcold scan ms=" << scan_ms
+              << "\tI/O calls=" << th->dm->get_syscall_count() - syscalls
+              << "\trows=" << scanned << "\n";
+    se.close_table(th);
+}
+
+int main(int argc, char** argv) {
+    uint32_t rows = 300000;
+    if (argc > 1) {
+        rows = static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10));
+    }
+    const std::string table_name = "bench_compaction";
+    std::string path = "data/" + table_name + ".db";
+    std::remove(path.c_str());
+
+    std::vector<uint8_t> value(64, 'v');
+    {
+        StorageEngine se(64 * 1024 * 1024);
+        se.create_table(table_name);
+        TableHandle* th = se.open_table(table_name);
+        if (th == nullptr) {
+            return 1;
+        }
+        for (uint32_t i = 0; i < rows; i++) {
+            se.insert_record(th, make_key(static_cast<uint32_t>(i * 2654435761ULL % rows)), value);
+        }
+        for (uint32_t i = 0; i < rows; i++) {
+            if (i % 10 != 0) {
+                se.delete_record(th, make_key(i));
+            }
+        }
+        se.close_table(th);
+    }
+    size_t pool_bytes = file_bytes(path) / 4;
+
+    std::cout << "\n=== " << rows << " rows loaded in random order, 90% deleted ===\n";
+    bench_scan(table_name, pool_bytes, "before");
+
+    {
+        StorageEngine se(64 * 1024 * 1024);
+        TableHandle* th = se.open_table(table_name);
+        if (th == nullptr) {
+            return 1;
+        }
+        std::atomic<bool> done{false};
+        std::vector<double> waits;
+        std::thread writer([&] {
+            // Keys between the surviving ones, so they land in every part of the tree.
+            for (uint32_t i = 0; i < rows / 100 && !done; i++) {
+                auto start = std::chrono::steady_clock::now();
+                se.insert_record(th, make_key(static_cast<uint32_t>(i * 2654435761ULL % (rows / 100)) * 100 + 5), value);
+                waits.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            }
+        });
+        auto start = std::chrono::steady_clock::now();
+        bool ok = se.compact_table(th);
+        double compact_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        done = true;
+        writer.join();
+        std::sort(waits.begin(), waits.end());
+        std::cout << "\n=== compact_table " << (ok ? "" : "FAILED ") << "took " << compact_ms << " ms ===\n"
+                  << "  concurrent inserts=" << waits.size();
+        if (!waits.empty()) {
+            std::cout << "\tp50 ms=" << waits[waits.size() / 2]
+                      << "\tp99 ms=" << waits[waits.size() * 99 / 100]
+                      << "\tmax ms=" << waits.back();
+        }
+        std::cout << "\n";
+        se.close_table(th);
+    }
+
+    std::cout << "\n=== Full scan ===\n";
+    bench_scan(table_name, pool_bytes, "after");
+
+    std::remove(path.c_str());
+    return 0;
+}
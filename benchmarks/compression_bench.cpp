@@ -0,0 +1,167 @@
+#include "storage/interface/storage_engine.hpp"
+#include "storage/table_handle.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// The same rows of repetitive JSON-like values loaded into a plain and a
+// leaf-compressed table, then read with random point lookups and a full
+// scan through a pool a quarter the size of the plain table. Each read is
+// run cold, after asking the OS to drop the file from its cache, and again
+// warm. Reports file sizes, the compression ratio and the CPU time per page.
+
+static uint64_t xorshift(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static std::vector<uint8_t> make_key(uint32_t i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "key%010u", i);
+    return std::vector<uint8_t>(buf, buf + 13);
+}
+
+static std::vector<uint8_t> make_value(uint32_t i) {
+    static const char* const statuses[] = {"active", "pending", "archived"};
+    char buf[160];
+    int length = std::snprintf(buf, sizeof(buf),
+                               "{\"id\":%u,\"status\":\"%s\",\"owner\":\"user%04u\",\"region\":\"eu-west\","
+                               "\"tags\":[\"alpha\",\"beta\"],\"score\":%u}",
+                               i, statuses[i % 3], i % 1000, i % 97);
+    return std::vector<uint8_t>(buf, buf + length);
+}
+
+static void count_rows(const std::vector<uint8_t>& key, const std::vector<uint8_t>& value, void* ctx) {
+    (void)key;
+    (void)value;
+    (*static_cast<size_t*>(ctx))++;
+}
+
+static void drop_os_cache(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    fsync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+#endif
+}
+
+static size_t file_bytes(const std::string& path) {
+    size_t bytes = 0;
+    if (FILE* file = std::fopen(path.c_str(), "rb")) {
+        std::fseek(file, 0, SEEK_END);
+        bytes = static_cast<size_t>(std::ftell(file));
+        std::fclose(file);
+    }
+    return bytes;
+}
+
+static void load_table(const char* label, const std::string& table_name, bool compress, uint32_t rows) {
+    StorageEngine se(64 * 1024 * 1024);
+    se.create_table(table_name, PAGE_SIZE, compress);
+    TableHandle* th = se.open_table(table_name);
+    if (th == nullptr) {
+        std::cout << "  " << label << "\topen_table failed\n";
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < rows; i++) {
+        uint32_t k = static_cast<uint32_t>(i * 2654435761ULL % rows);
+        se.insert_record(th, make_key(k), make_value(k));
+    }
+    se.sync_table(th);
+    auto end = std::chrono::steady_clock::now();
+    CompressionStats stats = th->dm->get_compression_stats();
+    se.close_table(th);
+
+    std::cout << "  " << label << "\tload"
+              << "\tinsert ns/op=" << std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(rows)
+              << "\tfile KB=" << file_bytes("data/" + table_name + ".db") / 1024;
+    if (compress) {
+        std::cout << "\tratio=" << stats.ratio()
+                  << "\tcompress ns/page=" << stats.compress_ns_per_page()
+                  << "\tincompressible=" << stats.pages_incompressible;
+    }
+    std::cout << "\n";
+}
+
+static void bench_reads(const char* label, const std::string& table_name, size_t pool_bytes, uint32_t rows,
+                        size_t lookups) {
+    StorageEngine se(pool_bytes);
+    drop_os_cache("data/" + table_name + ".db");
+    TableHandle* th = se.open_table(table_name);
+    if (th == nullptr) {
+        std::cout << "  " << label << "\topen_table failed\n";
+        return;
+    }
+
+    for (const char* phase : {"cold", "warm"}) {
+        uint64_t state = 0x9E3779B97F4A7C15ULL;
+        size_t found = 0;
+        std::vector<uint8_t> out;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < lookups; i++) {
+            found += se.get_record(th, make_key(static_cast<uint32_t>(xorshift(state) % rows)), out) ? 1 : 0;
+        }
+        auto end = std::chrono::steady_clock::now();
+        double lookup_ns = std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(lookups);
+
+        size_t scanned = 0;
+        start = std::chrono::steady_clock::now();
+        se.scan_table(th, count_rows, &scanned);
+        end = std::chrono::steady_clock::now();
+        double scan_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+        std::cout << "  " << label << "\t" << phase
+                  << "\tlookup ns/op=" << lookup_ns
+                  << "\tscan ms=" << scan_ms
+                  << "\tMrows/s=" << static_cast<double>(scanned) / scan_ms / 1e3
+                  << (found != lookups || scanned != rows ? "\tMISSING ROWS" : "") << "\n";
+    }
+    CompressionStats stats = th->dm->get_compression_stats();
+    if (stats.pages_decompressed > 0) {
+        std::cout << "  " << label << "\tdecompress ns/page=" << stats.decompress_ns_per_page() << "\n";
+    }
+    se.close_table(th);
+}
+
+int main(int argc, char** argv) {
+    uint32_t rows = 150000;
+    if (argc > 1) {
+        rows = static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10));
+    }
+    const size_t lookups = 200000;
+    const std::string plain = "bench_plain";
+    const std::string compressed = "bench_compressed";
+    std::remove(("data/" + plain + ".db").c_str());
+    std::remove(("data/" + compressed + ".db").c_str());
+
+    std::cout << "\n=== " << rows << " rows of JSON-like values, " << PAGE_SIZE << "-byte pages ===\n";
+    load_table("plain     ", plain, false, rows);
+    load_table("compressed", compressed, true, rows);
+
+    size_t pool_bytes = file_bytes("data/" + plain + ".db") / 4;
+    std::cout << "\n=== " << lookups << " random lookups then a full scan, pool of " << pool_bytes / 1024 << " KB ===\n";
+    bench_reads("plain     ", plain, pool_bytes, rows, lookups);
+    bench_reads("compressed", compressed, pool_bytes, rows, lookups);
+
+    StorageEngine se;
+    se.drop_table(plain);
+    se.drop_table(compressed);
+    return 0;
+}
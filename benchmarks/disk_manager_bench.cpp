@@ -0,0 +1,77 @@
+#include "storage/disk_manager.hpp"
+#include "storage/page.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// Raw DiskManager throughput and system calls per page for appending a new
+// file, overwriting random pages and reading random pages, at several
+// extent sizes. With one-page extents every append grows the file; larger
+// extents leave growth to one call per extent.
+
+static uint64_t xorshift(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static void report(const char* phase, size_t pages, double seconds, uint64_t calls) {
+    double mb = static_cast<double>(pages) * PAGE_SIZE / (1024.0 * 1024.0);
+    std::cout << "    " << phase << "\tMB/s=" << mb / seconds
+              << "\tsyscalls/page=" << static_cast<double>(calls) / static_cast<double>(pages) << "\n";
+}
+
+static void bench_extent(size_t extent_pages, size_t pages) {
+    const std::string path = "bench_disk_manager.db";
+    std::remove(path.c_str());
+    {
+        DiskManager dm(path, extent_pages);
+        Page page;
+        std::memset(page.data, 0x5A, PAGE_SIZE);
+        std::cout << "  extent=" << extent_pages << " pages\n";
+
+        uint64_t calls = dm.get_syscall_count();
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < pages; i++) {
+            dm.write_page(static_cast<uint32_t>(i), page.data);
+        }
+        auto end = std::chrono::steady_clock::now();
+        report("append", pages, std::chrono::duration<double>(end - start).count(), dm.get_syscall_count() - calls);
+
+        uint64_t state = 0x9E3779B97F4A7C15ULL;
+        calls = dm.get_syscall_count();
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < pages; i++) {
+            dm.write_page(static_cast<uint32_t>(xorshift(state) % pages), page.data);
+        }
+        end = std::chrono::steady_clock::now();
+        report("overwrite", pages, std::chrono::duration<double>(end - start).count(), dm.get_syscall_count() - calls);
+
+        calls = dm.get_syscall_count();
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < pages; i++) {
+            dm.read_page(static_cast<uint32_t>(xorshift(state) % pages), page.data);
+        }
+        end = std::chrono::steady_clock::now();
+        report("read", pages, std::chrono::duration<double>(end - start).count(), dm.get_syscall_count() - calls);
+    }
+    std::remove(path.c_str());
+}
+
+int main(int argc, char** argv) {
+    size_t pages = 32768;
+    if (argc > 1) {
+        pages = std::strtoull(argv[1], nullptr, 10);
+    }
+
+    std::cout << "\n=== DiskManager page I/O, " << pages << " pages of " << PAGE_SIZE << " bytes ===\n";
+    for (size_t extent_pages : {static_cast<size_t>(1), DISK_EXTENT_PAGES, static_cast<size_t>(1024)}) {
+        bench_extent(extent_pages, pages);
+    }
+    return 0;
+}
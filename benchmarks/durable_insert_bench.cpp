@@ -0,0 +1,96 @@
+#include "storage/interface/storage_engine.hpp"
+#include "storage/table_handle.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Insert throughput through StorageEngine::insert_record into one table
+// against the number of client threads, per durability mode. In
+// PER_OPERATION mode every insert waits for its fdatasync, so throughput
+// depends on how many commits group commit folds into each sync. PER_BATCH
+// syncs once per 100 inserts per client; NONE never syncs.
+
+static std::vector<uint8_t> make_key(uint32_t i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "key%010u", i);
+    return std::vector<uint8_t>(buf, buf + 13);
+}
+
+static const char* mode_name(DurabilityMode mode) {
+    switch (mode) {
+        case DurabilityMode::NONE: return "none         ";
+        case DurabilityMode::PER_BATCH: return "per-batch    ";
+        default: return "per-operation";
+    }
+}
+
+static void bench_inserts(DurabilityMode mode, size_t clients, uint32_t inserts_per_client) {
+    const std::string table_name = "bench_durable_insert";
+    std::remove(("data/" + table_name + ".db").c_str());
+    StorageEngine se;
+    se.create_table(table_name);
+    TableHandle* th = se.open_table(table_name);
+    if (th == nullptr) {
+        std::cerr << "open_table failed\n";
+        return;
+    }
+    se.set_durability(th, mode);
+
+    std::atomic<size_t> failed{0};
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t c = 0; c < clients; c++) {
+        threads.emplace_back([&, c] {
+            std::vector<uint8_t> value(64, 'v');
+            for (uint32_t i = 0; i < inserts_per_client; i++) {
+                // Interleave the clients' keys so they share leaves.
+                uint32_t id = static_cast<uint32_t>(i * clients + c);
+                if (!se.insert_record(th, make_key(static_cast<uint32_t>(id * 2654435761ULL % 1000000007ULL)), value)) {
+                    failed++;
+                }
+                if (mode == DurabilityMode::PER_BATCH && (i + 1) % 100 == 0) {
+                    se.sync_table(th);
+                }
+            }
+            if (mode == DurabilityMode::PER_BATCH) {
+                se.sync_table(th);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    size_t inserts = clients * inserts_per_client;
+    uint64_t syncs = th->group_commit.get_sync_count();
+    std::cout << "  " << mode_name(mode) << "\tclients=" << clients
+              << "\tinserts/s=" << static_cast<double>(inserts) / seconds
+              << "\tsyncs=" << syncs
+              << "\tinserts/sync=" << (syncs > 0 ? static_cast<double>(inserts) / static_cast<double>(syncs) : 0.0)
+              << (failed > 0 ? "\tFAILED" : "") << "\n";
+    se.close_table(th);
+    se.drop_table(table_name);
+}
+
+int main(int argc, char** argv) {
+    uint32_t inserts_per_client = 500;
+    if (argc > 1) {
+        inserts_per_client = static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10));
+    }
+
+    std::cout << "\n=== Durable inserts, " << inserts_per_client << " per client ===\n";
+    for (DurabilityMode mode : {DurabilityMode::NONE, DurabilityMode::PER_BATCH, DurabilityMode::PER_OPERATION}) {
+        for (size_t clients : {1, 2, 4, 8, 16}) {
+            bench_inserts(mode, clients, inserts_per_client);
+        }
+    }
+    return 0;
+}
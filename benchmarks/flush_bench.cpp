@@ -0,0 +1,102 @@
+#include "storage/buffer_pool.hpp"
+#include "storage/disk_manager.hpp"
+#include "storage/page.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// flush_all of a pool full of dirty pages, the shutdown and close_table
+// case. Either every page of a range is dirty (long adjacent runs) or a
+// random half is (short runs). The baseline writes the same pages one
+// write_page call each in hash-table order, as flush_all used to; the
+// others go through flush_all with one or more writer threads.
+
+static uint64_t xorshift(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static std::vector<uint32_t> dirty_set(size_t pages, bool dense) {
+    std::vector<uint32_t> page_ids;
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (uint32_t page_id = 0; page_id < 2 * pages && page_ids.size() < pages; page_id++) {
+        if (dense || xorshift(state) % 2 == 0) {
+            page_ids.push_back(page_id);
+        }
+    }
+    return page_ids;
+}
+
+static void report(const char* label, size_t pages, double seconds, uint64_t calls) {
+    std::cout << "  " << label << "\tkpages/s=" << static_cast<double>(pages) / seconds / 1e3
+              << "\tMB/s=" << static_cast<double>(pages) * PAGE_SIZE / seconds / (1024.0 * 1024.0)
+              << "\twrite calls=" << calls << "\n";
+}
+
+static void bench_baseline(DiskManager& dm, const std::vector<uint32_t>& page_ids) {
+    std::unordered_set<uint64_t> hashed(page_ids.begin(), page_ids.end());
+    Page page;
+    page.data[0] = 1;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t page_id : hashed) {
+        dm.write_page(static_cast<uint32_t>(page_id), page.data);
+    }
+    auto end = std::chrono::steady_clock::now();
+    report("per-page (hash order)", page_ids.size(), std::chrono::duration<double>(end - start).count(), page_ids.size());
+}
+
+static void bench_flush(DiskManager& dm, const std::vector<uint32_t>& page_ids, IoBackend backend, size_t threads) {
+    // Twice the pages: shards fill unevenly, and nothing may be evicted.
+    BufferPoolManager bpm(2 * page_ids.size(), ReplacerPolicy::LRU, backend);
+    bpm.set_flush_threads(threads);
+    FileId file_id = bpm.attach_file(dm);
+    for (uint32_t page_id : page_ids) {
+        Page* page = bpm.new_page(file_id, page_id);
+        page->data[0] = 2;
+        bpm.unpin_page(file_id, page_id, true);
+    }
+    bpm.reset_stats();
+    bpm.flush_all();
+    BufferPoolStats stats = bpm.get_stats();
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "flush_all %s x%zu  ",
+                  bpm.get_io_backend() == IoBackend::IO_URING ? "io_uring" : "sync    ", threads);
+    report(label, stats.flush_writes, static_cast<double>(stats.flush_micros) / 1e6, stats.flush_write_calls);
+    bpm.detach_file(file_id);
+}
+
+int main(int argc, char** argv) {
+    size_t pages = 32768;
+    if (argc > 1) {
+        pages = std::strtoull(argv[1], nullptr, 10);
+    }
+    const std::string path = "bench_flush.db";
+
+    for (bool dense : {true, false}) {
+        std::remove(path.c_str());
+        DiskManager dm(path);
+        std::vector<uint32_t> page_ids = dirty_set(pages, dense);
+        // Allocate the file up front so growth is not timed.
+        Page page;
+        dm.write_page(page_ids.back(), page.data);
+
+        std::cout << "\n=== flush of " << page_ids.size() << " dirty pages, "
+                  << (dense ? "all adjacent" : "random half of a range") << " ===\n";
+        bench_baseline(dm, page_ids);
+        for (IoBackend backend : {IoBackend::SYNC, IoBackend::IO_URING}) {
+            for (size_t threads : {1, 2, 4}) {
+                bench_flush(dm, page_ids, backend, threads);
+            }
+        }
+    }
+    std::remove(path.c_str());
+    return 0;
+}
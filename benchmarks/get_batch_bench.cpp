@@ -0,0 +1,147 @@
+#include "storage/interface/storage_engine.hpp"
+#include "storage/table_handle.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Latency of fetching a batch of random keys with a loop of get_record
+// against one get_batch call, at 50 and 500 keys per batch. Hot runs go
+// through a pool holding the whole table; cold ones through a pool a
+// sixteenth of its size, after asking the OS to drop the file from its
+// cache, so most leaves come from disk.
+
+static std::vector<uint8_t> make_key(uint32_t i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "key%010u", i);
+    return std::vector<uint8_t>(buf, buf + 13);
+}
+
+struct Rows {
+    uint32_t next;
+    uint32_t end;
+    std::vector<uint8_t> value;
+};
+
+static bool next_row(std::vector<uint8_t>& key, std::vector<uint8_t>& value, void* ctx) {
+    Rows* rows = static_cast<Rows*>(ctx);
+    if (rows->next >= rows->end) {
+        return false;
+    }
+    key = make_key(rows->next++);
+    value = rows->value;
+    return true;
+}
+
+static void drop_os_cache(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    fsync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+#endif
+}
+
+static size_t file_bytes(const std::string& path) {
+    size_t bytes = 0;
+    if (FILE* file = std::fopen(path.c_str(), "rb")) {
+        std::fseek(file, 0, SEEK_END);
+        bytes = static_cast<size_t>(std::ftell(file));
+        std::fclose(file);
+    }
+    return bytes;
+}
+
+static void bench_batches(const std::string& table_name, uint32_t rows, size_t batch_size, size_t batches,
+                          bool cold, bool batched) {
+    std::string path = "data/" + table_name + ".db";
+    size_t table_bytes = file_bytes(path);
+    if (cold) {
+        drop_os_cache(path);
+    }
+    StorageEngine se(cold ? table_bytes / 16 : table_bytes * 2);
+    TableHandle* th = se.open_table(table_name);
+    if (th == nullptr) {
+        std::cout << "  open_table failed\n";
+        return;
+    }
+    if (!cold) {
+        std::vector<uint8_t> value;
+        for (uint32_t i = 0; i < rows; i += 8) {
+            se.get_record(th, make_key(i), value);
+        }
+    }
+
+    std::vector<double> latencies;
+    std::vector<std::vector<uint8_t>> keys(batch_size);
+    std::vector<uint8_t> value;
+    StorageEngine::BatchResult result;
+    size_t found = 0;
+    uint64_t seed = batched ? 7 : 7;  // both variants probe the same keys
+    for (size_t b = 0; b < batches; b++) {
+        for (auto& key : keys) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            key = make_key(static_cast<uint32_t>((seed >> 33) % rows));
+        }
+        auto start = std::chrono::steady_clock::now();
+        if (batched) {
+            found += se.get_batch(th, keys, result);
+        } else {
+            for (const auto& key : keys) {
+                found += se.get_record(th, key, value) ? 1 : 0;
+            }
+        }
+        latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << "  " << (batched ? "get_batch " : "get_record") << "\tkeys=" << batch_size
+              << "\tp50 us=" << latencies[latencies.size() / 2]
+              << "\tp99 us=" << latencies[latencies.size() * 99 / 100]
+              << (found != batch_size * batches ? "\tMISSING KEYS" : "") << "\n";
+    se.close_table(th);
+}
+
+int main(int argc, char** argv) {
+    uint32_t rows = 1000000;
+    if (argc > 1) {
+        rows = static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10));
+    }
+    const std::string table_name = "bench_get_batch";
+    std::remove(("data/" + table_name + ".db").c_str());
+    {
+        StorageEngine se(64 * 1024 * 1024);
+        se.create_table(table_name);
+        TableHandle* th = se.open_table(table_name);
+        if (th == nullptr) {
+            return 1;
+        }
+        Rows source{0, rows, std::vector<uint8_t>(64, 'v')};
+        se.bulk_load(th, next_row, &source);
+        se.close_table(th);
+    }
+
+    for (bool cold : {false, true}) {
+        std::cout << "\n=== " << (cold ? "Cold" : "Hot") << " lookups in " << rows << " rows ===\n";
+        for (size_t batch_size : {50, 500}) {
+            for (bool batched : {false, true}) {
+                bench_batches(table_name, rows, batch_size, cold ? 200 : 2000, cold, batched);
+            }
+        }
+    }
+
+    std::remove(("data/" + table_name + ".db").c_str());
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include "storage/interface/storage_engine.hpp"
+#include "storage/table_handle.hpp"
+#include "storage/btree.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Inserts the same rows, in random key order, into a table already holding
+// as many rows, with one insert_record per row and with insert_batch at
+// batch sizes from 1 to 100k. Bigger batches share each descent and leaf
+// latch between more rows. Prints throughput and the leaves the table ends
+// up with.
+
+static std::vector<uint8_t> make_key(uint32_t i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "key%010u", i);
+    return std::vector<uint8_t>(buf, buf + 13);
+}
+
+struct Rows {
+    uint32_t next;
+    uint32_t end;
+    std::vector<uint8_t> value;
+};
+
+static bool next_row(std::vector<uint8_t>& key, std::vector<uint8_t>& value, void* ctx) {
+    Rows* rows = static_cast<Rows*>(ctx);
+    if (rows->next >= rows->end) {
+        return false;
+    }
+    key = make_key(rows->next++ * 2);
+    value = rows->value;
+    return true;
+}
+
+// batch_size 0 means one insert_record per row.
+static void bench_insert(uint32_t rows, size_t batch_size) {
+    const std::string table_name = "bench_insert_batch";
+    std::remove(("data/" + table_name + ".db").c_str());
+    StorageEngine se(256 * 1024 * 1024);
+    se.create_table(table_name);
+    TableHandle* th = se.open_table(table_name);
+    if (th == nullptr) {
+        std::cout << "  open_table failed\n";
+        return;
+    }
+    std::vector<uint8_t> value(64, 'v');
+    Rows existing{0, rows, value};
+    se.bulk_load(th, next_row, &existing, 70);
+
+    size_t inserted = 0;
+    std::vector<StorageEngine::Row> batch;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < rows; i++) {
+        std::vector<uint8_t> key = make_key(static_cast<uint32_t>(i * 2654435761ULL % rows) * 2 + 1);
+        if (batch_size == 0) {
+            inserted += se.insert_record(th, key, value) ? 1 : 0;
+            continue;
+        }
+        batch.emplace_back(std::move(key), value);
+        if (batch.size() == batch_size || i + 1 == rows) {
+            inserted += se.insert_batch(th, batch);
+            batch.clear();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    LeafLayout layout = btree_leaf_layout(*th);
+    if (batch_size == 0) {
+        std::cout << "  insert_record";
+    } else {
+        std::cout << "  batch=" << batch_size;
+    }
+    std::cout << "\tms=" << ms
+              << "\tKrows/s=" << static_cast<double>(rows) / ms
+              << "\tleaves=" << layout.leaves
+              << (inserted != rows ? "\tMISSING ROWS" : "") << "\n";
+    se.close_table(th);
+    se.drop_table(table_name);
+}
+
+int main(int argc, char** argv) {
+    uint32_t rows = 200000;
+    if (argc > 1) {
+        rows = static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10));
+    }
+
+    std::cout << "\n=== Inserting " << rows << " random rows into a table of " << rows << " ===\n";
+    bench_insert(rows, 0);
+    for (size_t batch_size : {1, 10, 100, 1000, 10000, 100000}) {
+        bench_insert(rows, batch_size);
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "storage/disk_manager.hpp"
+#include "storage/io_queue.hpp"
+#include "storage/page.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Random cold page reads through IoQueue at growing queue depths, against
+// the blocking backend. Each run first asks the OS to drop the file from its
+// cache, so reads reach the device; the queue is kept full, refilling as
+// completions arrive.
+
+static uint64_t xorshift(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static void drop_os_cache(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    fsync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+#endif
+}
+
+static void bench_reads(DiskManager& dm, const std::string& path, IoBackend backend, size_t depth,
+                        size_t pages, size_t reads) {
+    drop_os_cache(path);
+    IoQueue io(depth, backend);
+    std::vector<uint8_t> buffer(io.depth() * PAGE_SIZE);
+    std::vector<IoRequest> requests(io.depth());
+    std::vector<IoRequest*> free_requests;
+    for (size_t i = 0; i < requests.size(); i++) {
+        requests[i].disk_manager = &dm;
+        requests[i].buffer = buffer.data() + i * PAGE_SIZE;
+        free_requests.push_back(&requests[i]);
+    }
+
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    size_t issued = 0;
+    size_t done = 0;
+    size_t failed = 0;
+    std::vector<IoRequest*> completed;
+    auto start = std::chrono::steady_clock::now();
+    while (done < reads) {
+        while (issued < reads && !free_requests.empty()) {
+            IoRequest* request = free_requests.back();
+            free_requests.pop_back();
+            request->first_page_id = static_cast<uint32_t>(xorshift(state) % pages);
+            io.submit(*request);
+            issued++;
+        }
+        completed.clear();
+        io.poll(completed, 1);
+        for (IoRequest* request : completed) {
+            failed += request->ok ? 0 : 1;
+            free_requests.push_back(request);
+        }
+        done += completed.size();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    uint64_t calls = backend == IoBackend::SYNC ? reads : io.get_syscall_count();
+    std::cout << "  " << (io.backend() == IoBackend::IO_URING ? "io_uring" : "sync    ")
+              << "\tdepth=" << io.depth()
+              << "\tkIOPS=" << static_cast<double>(reads) / seconds / 1e3
+              << "\tMB/s=" << static_cast<double>(reads) * PAGE_SIZE / seconds / (1024.0 * 1024.0)
+              << "\tsyscalls/read=" << static_cast<double>(calls) / static_cast<double>(reads)
+              << (failed > 0 ? "\tFAILED" : "") << "\n";
+}
+
+int main(int argc, char** argv) {
+    size_t pages = 65536;
+    if (argc > 1) {
+        pages = std::strtoull(argv[1], nullptr, 10);
+    }
+    const size_t reads = 50000;
+    const std::string path = "bench_io_queue.db";
+    std::remove(path.c_str());
+    {
+        DiskManager dm(path, 1024);
+        std::vector<uint8_t> chunk(1024 * PAGE_SIZE, 0x5A);
+        for (size_t page = 0; page < pages; page += 1024) {
+            dm.write_pages(static_cast<uint32_t>(page), 1024, chunk.data());
+        }
+
+        std::cout << "\n=== Random cold page reads, " << pages << " pages of " << PAGE_SIZE << " bytes ===\n";
+        bench_reads(dm, path, IoBackend::SYNC, 1, pages, reads);
+        for (size_t depth = 1; depth <= 64; depth *= 2) {
+            bench_reads(dm, path, IoBackend::IO_URING, depth, pages, reads);
+        }
+    }
+    std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "storage/interface/storage_engine.hpp"
+#include "storage/table_handle.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Increments counters and appends to lists at random keys, once as the
+// get_record, change, update_record round trip a client would do, and once
+// as a single merge with the built-in MERGE_ADD and MERGE_APPEND operators,
+// which change the value in its leaf in one descent.
+
+static std::vector<uint8_t> make_key(uint32_t i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "key%010u", i);
+    return std::vector<uint8_t>(buf, buf + 13);
+}
+
+enum class Workload { COUNTER, APPEND };
+
+static void bench_merge(Workload workload, bool use_merge, uint32_t keys, uint32_t ops) {
+    const std::string table_name = "bench_merge";
+    std::remove(("data/" + table_name + ".db").c_str());
+    StorageEngine se(256 * 1024 * 1024);
+    se.create_table(table_name);
+    TableHandle* th = se.open_table(table_name);
+    if (th == nullptr) {
+        std::cout << "  open_table failed\n";
+        return;
+    }
+    std::vector<uint8_t> initial(sizeof(int64_t), 0);
+    for (uint32_t i = 0; i < keys; i++) {
+        se.insert_record(th, make_key(i), initial);
+    }
+
+    // Appends of 4 bytes to lists that start at 8, so the average list
+    // ends at 8 + 4 * ops / keys bytes.
+    std::vector<uint8_t> operand(workload == Workload::COUNTER ? sizeof(int64_t) : 4, 0);
+    if (workload == Workload::COUNTER) {
+        int64_t one = 1;
+        std::memcpy(operand.data(), &one, sizeof(one));
+    }
+    std::mt19937 rng(42);
+    std::vector<uint8_t> value;
+    uint32_t failed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t op = 0; op < ops; op++) {
+        std::vector<uint8_t> key = make_key(rng() % keys);
+        if (use_merge) {
+            uint32_t merge_operator = workload == Workload::COUNTER ? StorageEngine::MERGE_ADD : StorageEngine::MERGE_APPEND;
+            failed += se.merge(th, key, operand, merge_operator) ? 0 : 1;
+            continue;
+        }
+        if (!se.get_record(th, key, value)) {
+            failed++;
+            continue;
+        }
+        if (workload == Workload::COUNTER) {
+            int64_t count;
+            std::memcpy(&count, value.data(), sizeof(count));
+            count++;
+            std::memcpy(value.data(), &count, sizeof(count));
+        } else {
+            value.insert(value.end(), operand.begin(), operand.end());
+        }
+        failed += se.update_record(th, key, value) ? 0 : 1;
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    std::cout << "  " << (workload == Workload::COUNTER ? "counter" : "append")
+              << (use_merge ? "\tmerge" : "\tget+update")
+              << "\tms=" << ms
+              << "\tKops/s=" << static_cast<double>(ops) / ms
+              << (failed != 0 ? "\tFAILED OPS" : "") << "\n";
+    se.close_table(th);
+    se.drop_table(table_name);
+}
+
+int main(int argc, char** argv) {
+    uint32_t keys = 100000;
+    uint32_t ops = 1000000;
+    if (argc > 1) {
+        keys = static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10));
+    }
+    if (argc > 2) {
+        ops = static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10));
+    }
+
+    std::cout << "\n=== " << ops << " read-modify-writes over " << keys << " keys ===\n";
+    for (Workload workload : {Workload::COUNTER, Workload::APPEND}) {
+        bench_merge(workload, false, keys, ops);
+        bench_merge(workload, true, keys, ops);
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include "storage/interface/storage_engine.hpp"
+#include "storage/table_handle.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Random point lookups and a full scan of one table read three ways: through
+// a buffer pool the table fits in, through a pool an eighth of its size (a
+// table larger than the memory set aside for it), and from the file mapping
+// with the small pool. Each is run cold, after asking the OS to drop the
+// file from its cache, and again warm.
+
+static uint64_t xorshift(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static std::vector<uint8_t> make_key(uint32_t i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "key%08u", i);
+    return std::vector<uint8_t>(buf, buf + 11);
+}
+
+static void count_rows(const std::vector<uint8_t>& key, const std::vector<uint8_t>& value, void* ctx) {
+    (void)key;
+    (void)value;
+    (*static_cast<size_t*>(ctx))++;
+}
+
+static void drop_os_cache(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    fsync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+#endif
+}
+
+static void bench_reads(const char* label, const std::string& table_name, size_t pool_bytes,
+                        TableAccessMode mode, uint32_t rows, size_t lookups) {
+    StorageEngine se(pool_bytes);
+    drop_os_cache("data/" + table_name + ".db");
+    TableHandle* th = se.open_table(table_name, mode);
+    if (th == nullptr) {
+        std::cout << "  " << label << "\tunavailable\n";
+        return;
+    }
+
+    for (const char* phase : {"cold", "warm"}) {
+        uint64_t state = 0x9E3779B97F4A7C15ULL;
+        size_t found = 0;
+        std::vector<uint8_t> out;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < lookups; i++) {
+            found += se.get_record(th, make_key(static_cast<uint32_t>(xorshift(state) % rows)), out) ? 1 : 0;
+        }
+        auto end = std::chrono::steady_clock::now();
+        double lookup_ns = std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(lookups);
+
+        size_t scanned = 0;
+        start = std::chrono::steady_clock::now();
+        se.scan_table(th, count_rows, &scanned);
+        end = std::chrono::steady_clock::now();
+        double scan_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+        std::cout << "  " << label << "\t" << phase
+                  << "\tlookup ns/op=" << lookup_ns
+                  << "\tscan ms=" << scan_ms
+                  << "\tMrows/s=" << static_cast<double>(scanned) / scan_ms / 1e3
+                  << (found != lookups || scanned != rows ? "\tMISSING ROWS" : "") << "\n";
+    }
+    se.close_table(th);
+}
+
+int main(int argc, char** argv) {
+    uint32_t rows = 150000;
+    if (argc > 1) {
+        rows = static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10));
+    }
+    const size_t lookups = 200000;
+    const std::string table_name = "bench_mmap";
+    const std::string path = "data/" + table_name + ".db";
+    std::remove(path.c_str());
+
+    {
+        StorageEngine se(64 * 1024 * 1024);
+        se.create_table(table_name);
+        TableHandle* th = se.open_table(table_name);
+        if (th == nullptr) {
+            std::cerr << "open_table failed\n";
+            return 1;
+        }
+        std::vector<uint8_t> value(64, 'v');
+        for (uint32_t i = 0; i < rows; i++) {
+            se.insert_record(th, make_key(static_cast<uint32_t>(i * 2654435761ULL % rows)), value);
+        }
+        se.close_table(th);
+    }
+
+    size_t table_bytes = 0;
+    if (FILE* file = std::fopen(path.c_str(), "rb")) {
+        std::fseek(file, 0, SEEK_END);
+        table_bytes = static_cast<size_t>(std::ftell(file));
+        std::fclose(file);
+    }
+    size_t small_pool = table_bytes / 8;
+    std::cout << "\n=== Reads of " << rows << " rows, table " << table_bytes / (1024 * 1024) << " MB, "
+              << lookups << " random lookups then a full scan ===\n";
+    bench_reads("pool (fits)  ", table_name, 2 * table_bytes, TableAccessMode::BUFFERED, rows, lookups);
+    bench_reads("pool (1/8)   ", table_name, small_pool, TableAccessMode::BUFFERED, rows, lookups);
+    bench_reads("mmap         ", table_name, small_pool, TableAccessMode::MMAP, rows, lookups);
+
+    std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include "storage/interface/storage_engine.hpp"
+#include "storage/table_handle.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// The same rows loaded into tables of each page size, then read with random
+// point lookups and a full scan through a pool of a fixed byte budget, a
+// quarter of the 2 KB table. Each is run cold, after asking the OS to drop
+// the file from its cache, and again warm. Larger pages mean a shallower
+// tree and longer sequential reads, but more bytes read per lookup.
+
+static uint64_t xorshift(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static std::vector<uint8_t> make_key(uint32_t i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "key%010u", i);
+    return std::vector<uint8_t>(buf, buf + 13);
+}
+
+static void count_rows(const std::vector<uint8_t>& key, const std::vector<uint8_t>& value, void* ctx) {
+    (void)key;
+    (void)value;
+    (*static_cast<size_t*>(ctx))++;
+}
+
+static void drop_os_cache(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    fsync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+#endif
+}
+
+static size_t file_bytes(const std::string& path) {
+    size_t bytes = 0;
+    if (FILE* file = std::fopen(path.c_str(), "rb")) {
+        std::fseek(file, 0, SEEK_END);
+        bytes = static_cast<size_t>(std::ftell(file));
+        std::fclose(file);
+    }
+    return bytes;
+}
+
+static void load_table(const std::string& table_name, uint32_t page_size, uint32_t rows) {
+    StorageEngine se(64 * 1024 * 1024);
+    se.create_table(table_name, page_size);
+    TableHandle* th = se.open_table(table_name);
+    if (th == nullptr) {
+        return;
+    }
+    std::vector<uint8_t> value(64, 'v');
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < rows; i++) {
+        se.insert_record(th, make_key(static_cast<uint32_t>(i * 2654435761ULL % rows)), value);
+    }
+    auto end = std::chrono::steady_clock::now();
+    se.close_table(th);
+    std::cout << "  " << page_size << "\tload\tinsert ns/op="
+              << std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(rows)
+              << "\tfile MB=" << static_cast<double>(file_bytes("data/" + table_name + ".db")) / (1024.0 * 1024.0)
+              << "\n";
+}
+
+static void bench_reads(const std::string& table_name, uint32_t page_size, size_t pool_bytes, uint32_t rows,
+                        size_t lookups) {
+    StorageEngine se(pool_bytes);
+    drop_os_cache("data/" + table_name + ".db");
+    TableHandle* th = se.open_table(table_name);
+    if (th == nullptr) {
+        std::cout << "  " << page_size << "\topen_table failed\n";
+        return;
+    }
+
+    for (const char* phase : {"cold", "warm"}) {
+        uint64_t state = 0x9E3779B97F4A7C15ULL;
+        size_t found = 0;
+        std::vector<uint8_t> out;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < lookups; i++) {
+            found += se.get_record(th, make_key(static_cast<uint32_t>(xorshift(state) % rows)), out) ? 1 : 0;
+        }
+        auto end = std::chrono::steady_clock::now();
+        double lookup_ns = std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(lookups);
+
+        size_t scanned = 0;
+        start = std::chrono::steady_clock::now();
+        se.scan_table(th, count_rows, &scanned);
+        end = std::chrono::steady_clock::now();
+        double scan_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+        std::cout << "  " << page_size << "\t" << phase
+                  << "\tlookup ns/op=" << lookup_ns
+                  << "\tscan ms=" << scan_ms
+                  << "\tMrows/s=" << static_cast<double>(scanned) / scan_ms / 1e3
+                  << (found != lookups || scanned != rows ? "\tMISSING ROWS" : "") << "\n";
+    }
+    se.close_table(th);
+}
+
+int main(int argc, char** argv) {
+    uint32_t rows = 150000;
+    if (argc > 1) {
+        rows = static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10));
+    }
+    const size_t lookups = 200000;
+    const uint32_t page_sizes[] = {2048, 4096, 8192, 16384, 32768};
+
+    std::cout << "\n=== " << rows << " rows per table, loaded in random order ===\n";
+    for (uint32_t page_size : page_sizes) {
+        std::string table_name = "bench_page_size_" + std::to_string(page_size);
+        std::remove(("data/" + table_name + ".db").c_str());
+        load_table(table_name, page_size, rows);
+    }
+
+    size_t pool_bytes = file_bytes("data/bench_page_size_2048.db") / 4;
+    std::cout << "\n=== " << lookups << " random lookups then a full scan, pool of "
+              << pool_bytes / 1024 << " KB ===\n";
+    for (uint32_t page_size : page_sizes) {
+        bench_reads("bench_page_size_" + std::to_string(page_size), page_size, pool_bytes, rows, lookups);
+    }
+
+    for (uint32_t page_size : page_sizes) {
+        std::remove(("data/bench_page_size_" + std::to_string(page_size) + ".db").c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "storage/buffer_pool.hpp"
+#include "storage/disk_manager.hpp"
+#include "storage/replacer.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Replays a synthetic B+tree access trace against each replacement policy:
+// skewed point lookups (root -> internal -> leaf) interleaved with full leaf
+// scans, and reports the hit ratio seen by the lookups. The pool holds the
+// root, all internal pages and the hot leaves, but not the whole table.
+
+namespace {
+
+constexpr uint32_t ROOT_PAGE = 0;
+constexpr uint32_t INTERNAL_PAGES = 64;
+constexpr uint32_t LEAF_PAGES = 16384;
+constexpr uint32_t FIRST_LEAF = 1 + INTERNAL_PAGES;
+constexpr uint32_t HOT_LEAVES = LEAF_PAGES / 32;
+constexpr size_t POOL_FRAMES = 1024;
+constexpr size_t ROUNDS = 40;
+constexpr size_t LOOKUPS_PER_ROUND = 2000;
+
+uint64_t xorshift(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+constexpr FileId FILE_ID = 0;
+
+void touch(BufferPoolManager& bpm, uint32_t page_id, AccessType access_type) {
+    if (bpm.fetch_page(FILE_ID, page_id, access_type) != nullptr) {
+        bpm.unpin_page(FILE_ID, page_id, false);
+    }
+}
+
+void point_lookup(BufferPoolManager& bpm, uint64_t& state) {
+    // 90% of lookups land on a small hot set of leaves.
+    uint32_t leaf = (xorshift(state) % 10 != 0)
+        ? static_cast<uint32_t>(xorshift(state) % HOT_LEAVES) * 32
+        : static_cast<uint32_t>(xorshift(state) % LEAF_PAGES);
+    touch(bpm, ROOT_PAGE, AccessType::DEFAULT);
+    touch(bpm, 1 + leaf / (LEAF_PAGES / INTERNAL_PAGES), AccessType::DEFAULT);
+    touch(bpm, FIRST_LEAF + leaf, AccessType::DEFAULT);
+}
+
+void full_scan(BufferPoolManager& bpm, AccessType leaf_access) {
+    touch(bpm, ROOT_PAGE, AccessType::DEFAULT);
+    touch(bpm, 1, AccessType::DEFAULT);
+    for (uint32_t leaf = 0; leaf < LEAF_PAGES; leaf++) {
+        touch(bpm, FIRST_LEAF + leaf, leaf_access);
+    }
+}
+
+void run_policy(const char* name, ReplacerPolicy policy, AccessType scan_access) {
+    const std::string path = "bench_replacer.db";
+    std::remove(path.c_str());
+    DiskManager dm(path);
+    BufferPoolManager bpm(POOL_FRAMES, policy);
+    bpm.attach_file(dm);
+
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    uint64_t lookup_hits = 0;
+    uint64_t lookup_misses = 0;
+
+    for (size_t round = 0; round < ROUNDS; round++) {
+        BufferPoolStats before = bpm.get_stats();
+        for (size_t i = 0; i < LOOKUPS_PER_ROUND; i++) {
+            point_lookup(bpm, state);
+        }
+        BufferPoolStats after = bpm.get_stats();
+        if (round > 0) {  // the first round only warms the pool
+            lookup_hits += after.hits - before.hits;
+            lookup_misses += after.misses - before.misses;
+        }
+        full_scan(bpm, scan_access);
+    }
+
+    double ratio = static_cast<double>(lookup_hits) / static_cast<double>(lookup_hits + lookup_misses);
+    std::cout << "  " << name << "\tlookup hit ratio=" << ratio * 100.0 << "%"
+              << "\tevictions=" << bpm.get_stats().evictions << "\n";
+    std::remove(path.c_str());
+}
+
+}
+
+int main() {
+    std::cout << "\n=== Replacer hit ratio: point lookups mixed with full scans ===\n";
+    std::cout << "  pool=" << POOL_FRAMES << " frames, table=" << LEAF_PAGES << " leaves, "
+              << HOT_LEAVES << " hot leaves\n";
+    run_policy("LRU (no scan hint)", ReplacerPolicy::LRU, AccessType::DEFAULT);
+    run_policy("LRU", ReplacerPolicy::LRU, AccessType::SCAN);
+    run_policy("LRU-K (no scan hint)", ReplacerPolicy::LRU_K, AccessType::DEFAULT);
+    run_policy("LRU-K", ReplacerPolicy::LRU_K, AccessType::SCAN);
+    run_policy("2Q (no scan hint)", ReplacerPolicy::TWO_QUEUE, AccessType::DEFAULT);
+    run_policy("2Q", ReplacerPolicy::TWO_QUEUE, AccessType::SCAN);
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include "storage/interface/storage_engine.hpp"
+#include "storage/table_handle.hpp"
+#include "storage/btree.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Builds a table of URL keys, which share long prefixes and differ well
+// before their end, once by inserting in random order and once by bulk
+// loading, and reports the shape of the tree above the leaves: how many
+// children each internal page holds, how many bytes each separator takes,
+// and how tall the tree is. Random lookups show what the shape costs.
+
+static std::vector<uint8_t> make_key(uint32_t i) {
+    static const char* const hosts[] = {"news.example.com", "shop.example.com", "docs.example.org",
+                                        "blog.example.net", "forum.example.io", "media.example.co.uk",
+                                        "wiki.example.org", "static.example.dev"};
+    static const char* const sections[] = {"articles", "products", "reference", "posts",
+                                           "threads", "videos", "pages", "downloads"};
+    char buf[128];
+    int len = std::snprintf(buf, sizeof(buf), "https://%s/%s/%04u/%08u/index.html?utm_source=feed",
+                            hosts[i % 8], sections[(i / 8) % 8], (i / 64) % 1000, i);
+    return std::vector<uint8_t>(buf, buf + len);
+}
+
+struct TreeShape {
+    uint32_t height = 0;
+    uint64_t leaves = 0;
+    uint64_t internal_pages = 0;
+    uint64_t children = 0;        // of all internal pages
+    uint64_t root_children = 0;
+    uint64_t entry_bytes = 0;     // internal page bytes below free_start
+};
+
+static TreeShape tree_shape(TableHandle& th) {
+    TreeShape shape;
+    std::vector<uint32_t> level = {th.root_page};
+    while (!level.empty() && level.front() != 0) {
+        std::vector<uint32_t> next;
+        for (uint32_t page_id : level) {
+            ReadPageGuard guard = read_page_guard(th, page_id);
+            if (!guard) {
+                continue;
+            }
+            PageHeader* ph = get_header(guard.page());
+            if (ph->page_level == PageLevel::LEAF) {
+                shape.leaves++;
+                continue;
+            }
+            uint32_t leftmost = *reinterpret_cast<uint32_t*>(ph->reserved);
+            if (leftmost != 0 && leftmost != INVALID_PAGE_ID) {
+                next.push_back(leftmost);
+            }
+            for (uint16_t i = 0; i < ph->cell_count; i++) {
+                next.push_back(reinterpret_cast<InternalEntry*>(guard.page().data + *slot_ptr(guard.page(), i))->child_page);
+            }
+            shape.internal_pages++;
+            shape.entry_bytes += ph->free_start - sizeof(PageHeader);
+            if (shape.height == 0) {
+                shape.root_children = next.size();
+            }
+        }
+        shape.children += shape.leaves == 0 ? next.size() : 0;
+        shape.height++;
+        level = std::move(next);
+    }
+    return shape;
+}
+
+struct SortedSource {
+    const std::vector<std::vector<uint8_t>>* keys;
+    size_t next = 0;
+};
+
+static bool sorted_source(std::vector<uint8_t>& key, std::vector<uint8_t>& value, void* ctx) {
+    auto* source = static_cast<SortedSource*>(ctx);
+    if (source->next == source->keys->size()) {
+        return false;
+    }
+    key = (*source->keys)[source->next++];
+    value.assign(100, 'v');
+    return true;
+}
+
+static void bench_urls(bool bulk, uint32_t rows, uint32_t lookups) {
+    const std::string table_name = "bench_url_keys";
+    std::remove(("data/" + table_name + ".db").c_str());
+    StorageEngine se(256 * 1024 * 1024);
+    se.create_table(table_name);
+    TableHandle* th = se.open_table(table_name);
+    if (th == nullptr) {
+        std::cout << "  open_table failed\n";
+        return;
+    }
+
+    std::vector<std::vector<uint8_t>> keys;
+    keys.reserve(rows);
+    for (uint32_t i = 0; i < rows; i++) {
+        keys.push_back(make_key(i));
+    }
+    std::mt19937 rng(42);
+    auto load_start = std::chrono::steady_clock::now();
+    if (bulk) {
+        std::sort(keys.begin(), keys.end());
+        SortedSource source{&keys};
+        load_start = std::chrono::steady_clock::now();
+        se.bulk_load(th, sorted_source, &source);
+    } else {
+        std::shuffle(keys.begin(), keys.end(), rng);
+        std::vector<uint8_t> value(100, 'v');
+        load_start = std::chrono::steady_clock::now();
+        for (const std::vector<uint8_t>& key : keys) {
+            se.insert_record(th, key, value);
+        }
+    }
+    double load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count();
+
+    TreeShape shape = tree_shape(*th);
+    uint64_t separators = shape.children - shape.internal_pages;
+
+    std::vector<uint8_t> value;
+    uint32_t missed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t op = 0; op < lookups; op++) {
+        missed += se.get_record(th, make_key(rng() % rows), value) ? 0 : 1;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "  " << (bulk ? "bulk load" : "random insert")
+              << "\tload_ms=" << load_ms
+              << "\theight=" << shape.height
+              << "\tleaves=" << shape.leaves
+              << "\tinternal=" << shape.internal_pages
+              << "\tfanout=" << static_cast<double>(shape.children) / static_cast<double>(shape.internal_pages)
+              << "\troot_fanout=" << shape.root_children
+              << "\tbytes/separator=" << static_cast<double>(shape.entry_bytes) / static_cast<double>(separators)
+              << "\tlookup_Kops/s=" << static_cast<double>(lookups) / ms
+              << (missed != 0 ? "\tMISSED LOOKUPS" : "") << "\n";
+    se.close_table(th);
+    se.drop_table(table_name);
+}
+
+int main(int argc, char** argv) {
+    uint32_t rows = 500000;
+    uint32_t lookups = 1000000;
+    if (argc > 1) {
+        rows = static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10));
+    }
+    if (argc > 2) {
+        lookups = static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10));
+    }
+
+    std::cout << "\n=== " << rows << " URL keys of about " << make_key(0).size() << " bytes, "
+              << lookups << " random lookups ===\n";
+    bench_urls(false, rows, lookups);
+    bench_urls(true, rows, lookups);
+    return 0;
+}
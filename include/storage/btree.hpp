@@ -2,9 +2,11 @@
 #include <cstdint>
 #include "storage/table_handle.hpp"
 #include "storage/page.hpp"
+#include "storage/page_guard.hpp"
 #include <vector>
 #include <cstring>
 #include <string_view>
+#include <utility>
 
 class Key {
 private:
@@ -14,6 +16,21 @@ private:
 
 public:
     Key() = default;
+
+    Key(const Key& other) { *this = other; }
+
+    Key& operator=(const Key& other) {
+        if (this == &other) return *this;
+        if (other.data_ == other.owned_data_.data() && !other.owned_data_.empty()) {
+            owned_data_ = other.owned_data_;
+            data_ = owned_data_.data();
+        } else {
+            owned_data_.clear();
+            data_ = other.data_;
+        }
+        size_ = other.size_;
+        return *this;
+    }
     
     Key(const uint8_t* d, uint16_t s) : data_(d), size_(s) {}
     
@@ -46,6 +63,21 @@ private:
 
 public:
     Value() = default;
+
+    Value(const Value& other) { *this = other; }
+
+    Value& operator=(const Value& other) {
+        if (this == &other) return *this;
+        if (other.data_ == other.owned_data_.data() && !other.owned_data_.empty()) {
+            owned_data_ = other.owned_data_;
+            data_ = owned_data_.data();
+        } else {
+            owned_data_.clear();
+            data_ = other.data_;
+        }
+        size_ = other.size_;
+        return *this;
+    }
     
     Value(const uint8_t* d, uint16_t s) : data_(d), size_(s) {}
     
@@ -68,20 +100,107 @@ public:
     [[nodiscard]] bool empty() const { return size_ == 0; }
 };
 
+// new_page is 0 if the split failed. Otherwise sibling holds it latched,
+// so that nothing reaches it before the caller has linked it in.
 struct SplitLeafResult {
     uint32_t new_page;
     Key seperator_key;
-    Page left_page;
-    Page right_page;
+    WritePageGuard sibling;
 };
 
 using SplitInternalResult = SplitLeafResult;
 
 // B+Tree operations
 bool btree_search(TableHandle& th, const Key& key, Value& value);
+// Called for each key found, with its index in keys. value points into the
+// latched leaf and is only valid during the call.
+using BTreeGetBatchCallback = void (*)(size_t index, const Value& value, void* ctx);
+// Looks up keys, which must be sorted, sharing the work between them: when
+// the first lookup misses the pool, the leaves the rest need are prefetched
+// before any is read; each leaf is latched once for all its keys, and
+// leaves under the same parent are reached from it without descending
+// again. Returns the number of keys found.
+size_t btree_get_batch(TableHandle& th, const std::vector<Key>& keys, BTreeGetBatchCallback callback, void* ctx);
 bool btree_insert(TableHandle& th, const Key& key, const Value& value);
 bool btree_delete(TableHandle& th, const Key& key);
+// Replaces the value of an existing key without leaving its leaf: in place
+// when the new value is no longer, else moved within the page, which is
+// compacted first if need be. The leaf is split only if the live records no
+// longer fit in it. False if the key is not in the tree.
+bool btree_update(TableHandle& th, const Key& key, const Value& value);
+// Inserts the row, or updates the key's value as btree_update does if it is
+// already there, in one descent.
+bool btree_upsert(TableHandle& th, const Key& key, const Value& value);
+// Computes into merged the key's new value from its current one, nullptr if
+// the key is absent, and operand. existing points into the latched leaf and
+// is only valid during the call. Returning false leaves the key as it was.
+using BTreeMergeOperator = bool (*)(const Value* existing, const Value& operand, std::vector<uint8_t>& merged, void* ctx);
+// Read-modify-write under one leaf latch: merge runs on the key's value
+// where it lies, and its result is upserted without descending again.
+bool btree_merge(TableHandle& th, const Key& key, const Value& operand, BTreeMergeOperator merge, void* ctx);
+// Inserts rows, which must be sorted by key, in one walk of the tree: each
+// row descends only from the lowest internal page on the previous row's
+// path that still covers it, every row below a leaf's upper fence goes in
+// under one latch, and a full leaf is split once before carrying on. Rows
+// whose key is already in the tree, or repeats an earlier row's, are
+// skipped. Returns the number inserted. The caller must hold off other
+// writers.
+size_t btree_insert_batch(TableHandle& th, const std::vector<std::pair<Key, Value>>& rows);
+// Frees every page of the tree. Leaves th.root_page 0 without recording it:
+// the caller is dropping the table.
+void btree_destroy(TableHandle& th);
+
+// Where the leaves lie in the file, in key order: how often a scan moving to
+// the next leaf reads the very next page, or at least stays in the extent.
+struct LeafLayout {
+    uint64_t leaves = 0;
+    uint64_t sequential_hops = 0;  // next leaf is the next page
+    uint64_t extent_hops = 0;      // next leaf is in the same ALLOCATION_EXTENT_PAGES extent
+    double sequential_share() const {
+        return leaves < 2 ? 1.0 : static_cast<double>(sequential_hops) / static_cast<double>(leaves - 1);
+    }
+    double extent_share() const {
+        return leaves < 2 ? 1.0 : static_cast<double>(extent_hops) / static_cast<double>(leaves - 1);
+    }
+};
+LeafLayout btree_leaf_layout(TableHandle& th);
+
+// Where an online compaction of the tree has got to, between steps.
+struct CompactionState {
+    enum class Phase {
+        LEAVES,        // packing leaves in key order, with their parents
+        UPPER_LEVELS,  // moving the internal levels above them down the file
+        TAIL,          // moving pages in use near the end of the file down
+        TRUNCATE,      // cutting free pages off the end of the file
+        DONE,
+    };
+    Phase phase = Phase::LEAVES;
+    Key next_key;             // first key of the next leaf window; empty for the first
+    uint32_t next_page = 1;   // lowest page the next rewritten page may go to
+};
+
+// Runs one bounded step of compaction: rewrites up to
+// COMPACTION_STEP_LEAVES leaves into dense pages laid out in key order from
+// the start of the file, and in later steps moves the internal levels and
+// stray pages down and truncates the file. The caller must hold off other
+// writers for the step, and calls again until state.phase is DONE. False if
+// a page could not be read or allocated; the tree is intact either way.
+bool btree_compact_step(TableHandle& th, CompactionState& state);
+
+// Fills in key and value with the next row and returns true, or returns
+// false when there are no more. They must stay valid until the next call.
+using BTreeBulkLoadSource = bool (*)(Key& key, Value& value, void* ctx);
+// Appends the rows from source at the right edge of the tree, filling each
+// page to fill_percent without splitting any. Keys must be strictly
+// increasing and greater than any already in the tree; the load stops at
+// the first that is not, or that needs a new leaf but shares too long a
+// prefix with the row before, returning false with the rows before it
+// loaded.
+// The caller must hold off other writers.
+bool btree_bulk_load(TableHandle& th, BTreeBulkLoadSource source, void* ctx, uint32_t fill_percent);
 
+// key and value point into the pinned leaf and are only valid during the
+// call. The leaf stays latched, so the callback must not modify the table.
 using BTreeRangeScanCallback = void (*)(const Key& key, const Value& value, void* ctx);
 void btree_range_scan(TableHandle& th, const Key& start_key, const Key& end_key,
                      BTreeRangeScanCallback callback, void* ctx);
@@ -97,13 +216,84 @@ struct InternalEntry {
 
 uint16_t write_raw_record(Page& page, const uint8_t* raw, uint16_t size);
 
-uint32_t find_leaf_page(TableHandle& th, const Key& key, Page& out_page);
-uint32_t find_leftmost_leaf_page(TableHandle& th, Page& out_page);
-bool btree_insert_leaf_no_split(TableHandle& th, uint32_t page_id, Page& page, const Key& key, const Value& value);
+// A read guard on page_id: from the table's mapping in MMAP mode, through
+// the pool otherwise or when the page lies past the mapped length.
+ReadPageGuard read_page_guard(TableHandle& th, uint32_t page_id, AccessType access_type = AccessType::DEFAULT);
+
+// Descend from the root, latching each child before releasing its parent.
+// The guard is empty if the tree is empty or a page could not be fetched.
+ReadPageGuard find_leaf_page(TableHandle& th, const Key& key);
+WritePageGuard find_leaf_page_for_write(TableHandle& th, const Key& key);
+// For a split or merge, which changes the pages above the leaf too: latches
+// every page from the root down to key's leaf exclusively, each parent
+// before its child as readers latch them, and keeps them all. path[0] is
+// the root and path.back() the leaf. False, with path empty, if the tree
+// is empty or a page could not be fetched. Writers must be serialized by
+// the caller; readers may run alongside.
+bool find_path_for_write(TableHandle& th, const Key& key, std::vector<WritePageGuard>& path);
+ReadPageGuard find_leftmost_leaf_page(TableHandle& th);
+bool btree_insert_leaf_no_split(Page& page, const Key& key, const Value& value);
+// Fails with page untouched when the separator between the halves would be
+// longer than max_separator_size.
 SplitLeafResult split_leaf_page(TableHandle& th, Page& page);
 
+// Makes room for a record of record_size without splitting page, compacting
+// it if that is what it takes (counted in th.btree_stats.splits_avoided).
+// False if it has no room even then.
+bool make_room_without_split(TableHandle& th, Page& page, uint16_t record_size);
+
+// The shortest separator between two neighbouring leaves: the fewest
+// leading bytes of right, the right leaf's first key, that still sort
+// after left, the left leaf's last key.
+Key shortest_separator(const uint8_t* left, uint16_t left_size, const uint8_t* right, uint16_t right_size);
+
 uint32_t internal_find_child(Page& page, const Key& key);
+// Also copies into fence the first separator greater than key, the upper
+// bound of the child's keys; bounded is false, and fence left as it was,
+// when the child is the last.
+uint32_t internal_find_child(Page& page, const Key& key, std::vector<uint8_t>& fence, bool& bounded);
+// Entry index's whole key, the page's prefix put back in front.
+Key internal_entry_key(Page& page, uint16_t index);
+// Index of the entry whose key is key, or -1.
+int internal_entry_index(Page& page, const Key& key);
+// key must start with the page's prefix, which is left off the entry.
+uint16_t write_internal_entry(Page& page, const Key& key, uint32_t child);
+// Re-encodes the page under a shorter prefix when key does not share its
+// prefix, and compacts it when that makes room. Like compact_internal_page
+// and split_internal_page, it may rewrite the whole page, so a page of the
+// tree must be held through a WritePageGuard; a private copy needs none.
 bool insert_internal_no_split(Page& page, const Key& key, uint32_t child);
-SplitInternalResult split_internal_page(TableHandle& th, Page& page);
-void create_new_root(TableHandle& th, uint32_t left, const Key& key, uint32_t right);
-void insert_into_parent(TableHandle& th, uint32_t left, const Key& key, uint32_t right);
\ No newline at end of file
+// page_compact for internal pages, which also stores the entries under
+// the longest prefix they share, and key too when given.
+void compact_internal_page(Page& page, const Key* key = nullptr);
+// Bytes page would use, header and slot directory included, with key
+// added and every entry under the prefix they would then share.
+uint32_t internal_page_bytes_with(Page& page, const Key& key);
+// A child a split moved under a new internal page. Its parent_page_id is
+// only updated once the split has let go of its path: the child may be a
+// leaf that a scan holds while it waits for one the split holds.
+struct MovedChild {
+    uint32_t page_id;
+    uint32_t parent_page_id;
+};
+// The longest separator an internal page of page_size bytes may hold. Every
+// path that writes internal entries keeps to it.
+uint16_t max_separator_size(uint32_t page_size);
+// Moves the entries past a split point to a new page, appending the
+// children that went with them to moved. The point leaves room for key,
+// which the caller adds to its half. Fails with page untouched.
+SplitInternalResult split_internal_page(TableHandle& th, Page& page, const Key& key, std::vector<MovedChild>& moved);
+// Grows a new root above left, the old root, which has split off right.
+// The caller holds both latched. False, with nothing changed, if no page
+// could be had.
+bool create_new_root(TableHandle& th, WritePageGuard& left, const Key& key, WritePageGuard& right);
+// Links right, split off path[level], into the page above it, splitting
+// that in turn when it is full, or into a new root above path[0]. The
+// caller holds every page of path and right latched until this returns,
+// then lets go of them and calls set_moved_parents. False if right could
+// not be linked, with every page above path[level] as it was, so that the
+// caller can take its own split back.
+bool insert_into_parent(TableHandle& th, std::vector<WritePageGuard>& path, size_t level, const Key& key,
+                        WritePageGuard& right, std::vector<MovedChild>& moved);
+// Points each moved child at its new parent, latching one at a time.
+void set_moved_parents(TableHandle& th, const std::vector<MovedChild>& moved);
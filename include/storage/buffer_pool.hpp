@@ -3,45 +3,303 @@
 #include "storage/page.hpp"
 #include "storage/disk_manager.hpp"
 #include "storage/constants.hpp"
+#include "storage/replacer.hpp"
+#include "storage/latch.hpp"
+#include "storage/io_queue.hpp"
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
-#include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <utility>
 #include <cstdint>
 
+// Identifies a data file attached to a BufferPoolManager. Pages are cached
+// under (file id, page id), so one pool can serve every open table.
+using FileId = uint32_t;
+inline constexpr FileId INVALID_FILE_ID = static_cast<FileId>(-1);
+
+struct BufferPoolStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t foreground_writes = 0;       // pages written on a caller's path (eviction, flush)
+    uint64_t background_writes = 0;       // pages written by the page cleaner
+    uint64_t background_write_calls = 0;  // coalesced writes the page cleaner issued
+    uint64_t flushes = 0;                 // flush_file/flush_all calls that wrote pages
+    uint64_t flush_writes = 0;            // pages those flushes wrote (also in foreground_writes)
+    uint64_t flush_write_calls = 0;       // coalesced writes those flushes issued
+    uint64_t flush_micros = 0;            // time spent writing in those flushes
+    uint64_t prefetched = 0;              // pages read in by read-ahead
+    uint64_t prefetch_used = 0;           // prefetched pages fetched before eviction
+    uint64_t prefetch_unused = 0;         // prefetched pages evicted without being fetched
+};
+
+struct PageCleanerOptions {
+    uint32_t wake_interval_ms = PAGE_CLEANER_INTERVAL_MS;
+    uint32_t max_dirty_percent = PAGE_CLEANER_MAX_DIRTY_PERCENT;
+};
+
+// Thread-safe page cache. Frames are split into shards, each with its own
+// latch, page table, free list and replacer; a page always maps to the same
+// shard, so threads touching different pages rarely contend. Pin counts are
+// atomic, and every frame carries a reader/writer latch that callers take
+// through frame_latch() while they read or modify a pinned page.
+//
+// An optional page cleaner thread writes dirty pages back before they reach
+// the eviction end of a replacer, so a miss rarely has to write its victim.
+// Each pass cleans the next PAGE_CLEANER_LOOKAHEAD_PERCENT victims of every
+// shard, plus enough further victims to bring the dirty share back under
+// max_dirty_percent. Pages are written in page order, with runs of adjacent
+// pages merged into one write.
+//
+// Read-ahead: prefetch_pages() hands page ids to a background thread that
+// reads them into unpinned frames, after asking the OS to start the reads.
+// A prefetched page counts as used the first time it is fetched; one that
+// is evicted first counts as unused, which callers can watch to size their
+// read-ahead window.
+//
+// Cleaner passes, flush_file/flush_all and the read-ahead thread submit
+// their I/O in batches through an IoQueue, on io_uring when the platform
+// has it and with blocking calls otherwise. Misses and eviction writes stay
+// synchronous, but run with the shard latch dropped: a missed page is
+// mapped as loading before it is read, and other fetches of it wait on
+// that frame alone. Flushes merge longer runs than the cleaner and can
+// split them across several writer threads (set_flush_threads).
+//
+// Every page in a pool has the same size, fixed at construction; only files
+// of that page size can be attached. Frames are page_size bytes apart.
+//
+// set_frame_limit() shrinks a pool below the frames it was built with, or
+// grows it back, so pools of different page sizes can share one memory
+// budget. A shrinking shard gives up its highest frames and returns their
+// memory to the OS.
 class BufferPoolManager {
 public:
-    explicit BufferPoolManager(DiskManager& disk_manager, size_t pool_size = BUFFER_POOL_SIZE);
+    explicit BufferPoolManager(size_t pool_size = BUFFER_POOL_SIZE, ReplacerPolicy policy = ReplacerPolicy::LRU,
+                               IoBackend io_backend = IoBackend::IO_URING, uint32_t page_size = PAGE_SIZE);
     ~BufferPoolManager();
 
     BufferPoolManager(const BufferPoolManager&) = delete;
     BufferPoolManager& operator=(const BufferPoolManager&) = delete;
 
-    Page* fetch_page(uint32_t page_id);
-    bool unpin_page(uint32_t page_id, bool dirty);
-    Page* new_page(uint32_t page_id, PageType page_type = PageType::DATA, PageLevel page_level = PageLevel::LEAF);
-    bool delete_page(uint32_t page_id);
-    bool flush_page(uint32_t page_id);
+    // Frames needed to cache budget_bytes worth of pages (at least one).
+    static size_t frames_for_budget(size_t budget_bytes, uint32_t page_size = PAGE_SIZE);
+
+    uint32_t get_page_size() const { return page_size_; }
+
+    // Returns INVALID_FILE_ID if the file's page size is not the pool's.
+    FileId attach_file(DiskManager& disk_manager);
+    // Writes back and drops the file's cached pages; other files are untouched.
+    // Waits out victims of the file that another fetch is writing. Returns
+    // false, with the file still attached, if a page cannot be written back
+    // or is still pinned; pages already written are dropped.
+    bool detach_file(FileId file_id);
+
+    Page* fetch_page(FileId file_id, uint32_t page_id, AccessType access_type = AccessType::DEFAULT);
+    bool unpin_page(FileId file_id, uint32_t page_id, bool dirty);
+    // Same, for a page pointer returned by fetch_page/new_page; skips the
+    // page table lookup.
+    bool unpin_page(const Page* page, bool dirty);
+    Page* new_page(FileId file_id, uint32_t page_id, PageType page_type = PageType::DATA, PageLevel page_level = PageLevel::LEAF);
+    bool delete_page(FileId file_id, uint32_t page_id);
+    // Waits out a write-back in progress, which may still be writing an
+    // older copy of the page; the caller must not hold a frame latch.
+    bool flush_page(FileId file_id, uint32_t page_id);
+    void flush_file(FileId file_id);
     void flush_all();
+    // Threads that share the runs of a flush_file/flush_all, the calling
+    // thread included; each brings its own IoQueue. 1 (the default) keeps
+    // flushes on the calling thread.
+    void set_flush_threads(size_t threads) { flush_threads_ = threads == 0 ? 1 : threads; }
+    size_t get_flush_threads() const { return flush_threads_.load(); }
+
+    // Latch of the frame holding page, which must be pinned by the caller.
+    FrameLatch& frame_latch(const Page* page);
+
+    void start_page_cleaner(const PageCleanerOptions& options = PageCleanerOptions());
+    void stop_page_cleaner();
+    void set_page_cleaner_options(const PageCleanerOptions& options);
+    bool is_page_cleaner_running() const { return cleaner_running_.load(); }
+    // Runs one cleaner pass on the calling thread; returns pages written.
+    size_t clean_pages();
+
+    // Queues pages for the read-ahead thread, which is started on first use.
+    // Pages that are already cached are skipped. Does nothing while
+    // read-ahead is disabled.
+    void prefetch_pages(FileId file_id, std::vector<uint32_t> page_ids);
+    void set_read_ahead(bool enabled) { read_ahead_enabled_ = enabled; }
+    bool is_read_ahead_enabled() const { return read_ahead_enabled_.load(); }
+
+    // Caps the frames the pool uses, between one per shard and the frames it
+    // was built with. Cached pages past the new limit are written back and
+    // dropped; pinned ones go once they are unpinned and the shard next
+    // needs a frame.
+    void set_frame_limit(size_t frames);
+
     size_t get_pinned_count() const;
     size_t get_free_frame_count() const;
+    // Frames the pool may use: its size, unless set_frame_limit lowered it.
+    size_t get_pool_size() const { return frame_limit_.load(); }
+    size_t get_shard_count() const { return shard_count_; }
+    size_t get_dirty_count() const { return dirty_count_.load(); }
+    // Backend of the batched write-back and read-ahead I/O.
+    IoBackend get_io_backend() const { return io_backend_; }
+    BufferPoolStats get_stats() const;
+    void reset_stats();
 
 private:
     struct Frame {
+        FileId file_id = INVALID_FILE_ID;   // guarded by the owning shard's latch
+        uint32_t page_id = INVALID_PAGE_ID;
+        std::atomic<uint32_t> pin_count{0};
+        std::atomic<bool> dirty{false};
+        // Bumped each time the page goes from clean to dirty, so an eviction
+        // that wrote a copy can tell whether the page changed meanwhile.
+        std::atomic<uint32_t> dirtied{0};
+        bool prefetched = false;            // read ahead and not fetched yet; guarded by the shard latch
+        bool loading = false;               // being read in by a miss; guarded by the shard latch
+        bool writing = false;               // a victim copy claim_frame is writing; guarded by the shard latch
+        FrameLatch latch;
+    };
+
+    struct Shard {
+        mutable std::mutex latch;
+        size_t first_frame = 0;
+        size_t frame_count = 0;
+        std::unordered_map<uint64_t, size_t> page_table;  // page key -> frame id
+        // Frames past first_frame + frame_limit are not handed out; those
+        // past first_frame + active_frames have been given up.
+        size_t frame_limit = 0;
+        size_t active_frames = 0;
+        std::vector<size_t> free_frames;
+        std::unique_ptr<Replacer> replacer;  // indexed by frame id - first_frame
+        // Signalled when a frame of the shard finishes loading.
+        std::condition_variable load_cv;
+        // Signalled when claim_frame finishes writing a victim of the shard.
+        std::condition_variable write_cv;
+        size_t pinned_count = 0;
+        BufferPoolStats stats;
+        // Pages the read-ahead thread is reading; a miss or new_page on one
+        // cancels it so the thread does not install a stale copy.
+        std::unordered_set<uint64_t> read_ahead_in_flight;
+    };
+
+    struct WriteBackTarget {
+        FileId file_id;
         uint32_t page_id;
-        uint32_t pin_count;
-        bool dirty;
-        Page page;
-        Frame() : page_id(INVALID_PAGE_ID), pin_count(0), dirty(false) {}
+        size_t frame_id;
+        Shard* shard;
     };
 
-    size_t find_or_evict_frame();
-    bool evict_frame(size_t frame_id);
-    void mark_frame_used(size_t frame_id);
-    void remove_from_lru(size_t frame_id);
+    static uint64_t page_key(FileId file_id, uint32_t page_id) {
+        return (static_cast<uint64_t>(file_id) << 32) | page_id;
+    }
+
+    Page& page_at(size_t frame_id) const {
+        return *reinterpret_cast<Page*>(page_memory_.get() + frame_id * page_size_);
+    }
+    size_t frame_of(const Page* page) const {
+        return static_cast<size_t>(reinterpret_cast<const uint8_t*>(page) - page_memory_.get()) / page_size_;
+    }
+
+    Shard& shard_for(uint64_t key);
+    DiskManager* file_for(FileId file_id) const;
+    size_t find_or_evict_frame(Shard& shard);
+    // Gives up the shard's frames past its limit: free ones at once, cached
+    // ones by evicting them. Caller holds the shard latch.
+    void trim_shard(Shard& shard);
+    // Frees a frame for a new page, evicting if needed. A dirty victim is
+    // written back with lock dropped, so the caller must look its page up
+    // again afterwards. SIZE_MAX on failure.
+    size_t claim_frame(Shard& shard, std::unique_lock<std::mutex>& lock);
+    // Waits out another thread's read of a frame the caller has pinned.
+    // False, with the pin dropped, if the read failed.
+    bool wait_for_load(Shard& shard, std::unique_lock<std::mutex>& lock, size_t frame_id, uint64_t key);
+    // Drops a pin on a frame whose read failed; the last one frees it.
+    void unpin_failed_load(Shard& shard, size_t frame_id);
+    bool evict_frame(Shard& shard, size_t frame_id);
+    bool unpin_frame(Shard& shard, size_t frame_id, bool dirty);
+    bool flush_frame(Shard& shard, std::unique_lock<std::mutex>& lock, size_t frame_id);
+    bool write_frame(size_t frame_id);
+    void pin_frame(Shard& shard, size_t frame_id, AccessType access_type);
+    // Pins without counting as an access, for write-back.
+    void hold_frame(Shard& shard, size_t frame_id);
+    void unhold_frame(Shard& shard, size_t frame_id);
+    void release_frame(Shard& shard, size_t frame_id);
+    void mark_dirty(Frame& frame);
+    bool clear_dirty(Frame& frame);
+    void wake_page_cleaner();
+    void page_cleaner_loop();
+    // Writes held frames back in page order, merging runs of adjacent
+    // pages, and unholds them. Caller holds write_back_latch_.
+    size_t write_back(std::vector<WriteBackTarget>& targets, bool background);
+    // Writes runs [first_run, last_run) of targets through io, staging them
+    // in buffer. Returns the pages written; calls counts the writes issued.
+    size_t write_runs(IoQueue& io, std::vector<uint8_t>& buffer, std::vector<WriteBackTarget>& targets,
+                      const std::vector<std::pair<size_t, size_t>>& runs, size_t first_run, size_t last_run,
+                      std::vector<uint8_t>& was_dirty, size_t& calls);
+    void read_ahead_loop();
+    void read_ahead_batch(IoQueue& io, std::vector<std::pair<FileId, uint32_t>>& batch, std::vector<uint8_t>& buffer);
+
+    mutable std::shared_mutex files_latch_;
+    std::vector<DiskManager*> files_;  // indexed by FileId; nullptr once detached
+    std::vector<FileId> free_file_ids_;
+
+    std::atomic<size_t> dirty_count_{0};
+    std::atomic<uint64_t> foreground_writes_{0};
+    std::atomic<uint64_t> background_writes_{0};
+    std::atomic<uint64_t> background_write_calls_{0};
+    std::atomic<uint64_t> flushes_{0};
+    std::atomic<uint64_t> flush_writes_{0};
+    std::atomic<uint64_t> flush_write_calls_{0};
+    std::atomic<uint64_t> flush_micros_{0};
+    std::atomic<size_t> flush_threads_{1};
+
+    // Held by a cleaner pass, flush_file/flush_all and detach_file, so a
+    // file never goes away under pages being written back. Also guards the
+    // write-back queue and buffer.
+    std::mutex write_back_latch_;
+    IoBackend io_backend_;
+    std::unique_ptr<IoQueue> write_back_io_;
+    std::vector<uint8_t> write_back_buffer_;
+    std::mutex cleaner_mutex_;  // guards cleaner_options_ and cleaner_stop_
+    std::condition_variable cleaner_cv_;
+    PageCleanerOptions cleaner_options_;
+    bool cleaner_stop_ = false;
+    std::atomic<bool> cleaner_running_{false};
+    std::atomic<bool> cleaner_wakeup_{false};
+    std::thread cleaner_thread_;
+
+    std::mutex read_ahead_mutex_;  // guards the queue, read_ahead_stop_ and the thread
+    std::condition_variable read_ahead_cv_;
+    std::deque<std::pair<FileId, uint32_t>> read_ahead_queue_;
+    // Page keys of the queue's live entries. A miss cancels its page by
+    // erasing it here; the thread skips queue entries missing from the set.
+    std::unordered_set<uint64_t> read_ahead_queued_;
+    // read_ahead_queued_.size(), so a miss can skip the mutex when nothing
+    // is queued.
+    std::atomic<size_t> read_ahead_queued_count_{0};
+    bool read_ahead_stop_ = false;
+    std::thread read_ahead_thread_;
+    // Held while a batch of prefetched pages is read in and by detach_file,
+    // so no page of a detached file is cached after it.
+    std::mutex read_ahead_load_latch_;
+    std::atomic<bool> read_ahead_enabled_{true};
 
-    DiskManager& disk_manager_;
-    std::vector<Frame> frames_;
-    std::unordered_map<uint32_t, size_t> page_table_;
-    std::list<size_t> lru_list_;
-    size_t pool_size_;
+    std::unique_ptr<Frame[]> frames_;
+    // The data of frames_[i] starts at i * page_size_; see page_at().
+    std::unique_ptr<uint8_t[]> page_memory_;
+    std::unique_ptr<Shard[]> shards_;
+    size_t shard_count_;
+    size_t frames_per_shard_;  // the last shard also takes the remainder
+    unsigned shard_bits_;
+    size_t pool_size_;  // frames built with
+    std::atomic<size_t> frame_limit_;
+    uint32_t page_size_;
 };
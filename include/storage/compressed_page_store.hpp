@@ -0,0 +1,139 @@
+#pragma once
+#include "storage/constants.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+// Where one page of a compressed table is stored: a slot of whole
+// COMPRESSED_SLOT_BYTES units.
+#pragma pack(push, 1)
+struct PageSlot {
+    uint32_t offset_units = 0;  // 0: the page was never written
+    uint16_t stored_bytes = 0;
+    uint8_t flags = 0;          // PAGE_SLOT_*
+    uint8_t units = 0;          // length of the slot, which may exceed stored_bytes
+
+    uint64_t offset() const { return static_cast<uint64_t>(offset_units) * COMPRESSED_SLOT_BYTES; }
+};
+#pragma pack(pop)
+
+static_assert(sizeof(PageSlot) == 8, "PageSlot is stored in the map file as is");
+
+inline constexpr uint8_t PAGE_SLOT_RAW = 0;  // stored as is
+inline constexpr uint8_t PAGE_SLOT_LZ = 1;   // lz_compress'd, without the free space between slots and records
+
+// CPU and space spent on compressing a table's leaf pages.
+struct CompressionStats {
+    uint64_t pages_compressed = 0;      // leaf page writes stored compressed
+    uint64_t pages_incompressible = 0;  // leaf page writes stored as is: they would not save a slot unit
+    uint64_t bytes_in = 0;              // page bytes of the compressed writes
+    uint64_t bytes_out = 0;             // what they were stored as
+    uint64_t compress_nanos = 0;        // every attempt, incompressible ones included
+    uint64_t pages_decompressed = 0;
+    uint64_t decompress_nanos = 0;
+
+    double ratio() const {
+        return bytes_out == 0 ? 1.0 : static_cast<double>(bytes_in) / static_cast<double>(bytes_out);
+    }
+    double compress_ns_per_page() const {
+        uint64_t pages = pages_compressed + pages_incompressible;
+        return pages == 0 ? 0.0 : static_cast<double>(compress_nanos) / static_cast<double>(pages);
+    }
+    double decompress_ns_per_page() const {
+        return pages_decompressed == 0 ? 0.0
+                                       : static_cast<double>(decompress_nanos) / static_cast<double>(pages_decompressed);
+    }
+};
+
+// The slot map of a compressed table. Page 0 keeps its fixed place at the
+// start of the file, so the meta page can be read before anything is known
+// about the table; every other page lives in a slot after it, sized to the
+// page's compressed length. The map is kept in memory and persisted to a
+// sidecar file when the table is synced.
+//
+// A page that still fits its slot is rewritten in place. One that does not
+// moves to a new slot, and the old one is reused only once a map that no
+// longer points at it is durable: a synced map never names space that has
+// been overwritten since.
+//
+// Writing a page is reserve(), the write itself, then publish(). A page
+// must not be read while it is being written; the buffer pool never does.
+class CompressedPageStore {
+public:
+    // Loads the map at map_path, or starts an empty one if there is none,
+    // for a file of page_size pages. Throws std::runtime_error if the map
+    // cannot be opened or was written for another page size.
+    CompressedPageStore(const std::string& map_path, uint32_t page_size);
+    ~CompressedPageStore();
+
+    CompressedPageStore(const CompressedPageStore&) = delete;
+    CompressedPageStore& operator=(const CompressedPageStore&) = delete;
+
+    PageSlot lookup(uint32_t page_id) const;
+    // Picks the slot the next version of page_id, stored_bytes long, is
+    // written to: its current slot if that fits, a free or new one if not.
+    PageSlot reserve(uint32_t page_id, uint16_t stored_bytes, uint8_t flags);
+    // Points the map at slot once the page has been written there.
+    void publish(uint32_t page_id, const PageSlot& slot);
+
+    // Makes the map durable. sync_data, which must make the table's
+    // writes durable, runs after the map is copied and before the copy is
+    // written, so every slot a durable map names holds durable data.
+    // Slots pages moved out of before the call are free afterwards.
+    template <typename SyncData>
+    void persist(SyncData sync_data) {
+        std::lock_guard<std::mutex> lock(persist_latch_);
+        std::vector<uint32_t> blocks;
+        std::vector<PageSlot> entries;
+        std::vector<PageSlot> moved_from;
+        snapshot(blocks, entries, moved_from);
+        sync_data();
+        write_map(blocks, entries, true);
+        release(moved_from);
+    }
+    // Writes the map without syncing it; when the table is closed.
+    void save();
+
+    // End of the last slot in bytes; the file must be at least this long.
+    uint64_t end_offset() const;
+
+    // stored_bytes is 0 for a page that did not compress.
+    void count_compression(uint32_t page_bytes, size_t stored_bytes, uint64_t nanos);
+    void count_decompression(uint64_t nanos);
+    CompressionStats get_stats() const;
+
+private:
+    // Copies the map blocks changed since the last snapshot and takes the
+    // slots pages moved out of since then.
+    void snapshot(std::vector<uint32_t>& blocks, std::vector<PageSlot>& entries, std::vector<PageSlot>& moved_from);
+    void write_map(const std::vector<uint32_t>& blocks, const std::vector<PageSlot>& entries, bool sync);
+    void release(const std::vector<PageSlot>& slots);
+    // Both called with latch_ held exclusively.
+    uint32_t allocate(uint32_t units);
+    void free_units(uint32_t offset_units, uint32_t units);
+
+    uint32_t page_size_;
+    uint32_t max_units_;  // units of an uncompressed page
+    int map_fd_ = -1;
+    std::mutex persist_latch_;  // one persist or save at a time
+
+    mutable std::shared_mutex latch_;  // guards everything below
+    std::vector<PageSlot> slots_;      // indexed by page id
+    std::vector<uint32_t> dirty_blocks_;  // map blocks changed since the last snapshot
+    std::vector<uint8_t> block_dirty_;    // per block: listed in dirty_blocks_
+    std::vector<std::vector<uint32_t>> free_slots_;  // [units] -> offsets of free slots of that length
+    std::vector<PageSlot> moved_from_;    // slots pages moved out of since the last snapshot
+    uint32_t end_units_;                  // first unit past the last slot
+
+    std::atomic<uint64_t> pages_compressed_{0};
+    std::atomic<uint64_t> pages_incompressible_{0};
+    std::atomic<uint64_t> bytes_in_{0};
+    std::atomic<uint64_t> bytes_out_{0};
+    std::atomic<uint64_t> compress_nanos_{0};
+    std::atomic<uint64_t> pages_decompressed_{0};
+    std::atomic<uint64_t> decompress_nanos_{0};
+};
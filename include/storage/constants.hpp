@@ -1,10 +1,36 @@
 #pragma once
 #include <cstdint>
+#include <cstddef>
 
-inline constexpr uint32_t PAGE_SIZE = 2048;
+inline constexpr uint32_t PAGE_SIZE = 2048;        // Default page size; also that of files from before sizes were recorded
+inline constexpr uint32_t MAX_PAGE_SIZE = 32768;   // Largest page size a table can be created with
 inline constexpr uint32_t INVALID_PAGE_ID = static_cast<uint32_t>(-1);
 inline constexpr uint32_t BUFFER_POOL_SIZE = 128;  // Default buffer pool size (can be overridden)
+inline constexpr size_t BUFFER_POOL_BYTES = 16 * 1024 * 1024;  // Default StorageEngine-wide pool budget
+inline constexpr size_t BUFFER_POOL_SHARDS = 16;        // Upper bound; must be a power of two
+inline constexpr size_t MIN_FRAMES_PER_SHARD = 64;      // Smaller pools use fewer shards
+inline constexpr uint32_t PAGE_CLEANER_INTERVAL_MS = 10;         // Page cleaner wake-up period
+inline constexpr uint32_t PAGE_CLEANER_MAX_DIRTY_PERCENT = 30;   // Above this share of dirty frames the cleaner catches up
+inline constexpr uint32_t PAGE_CLEANER_LOOKAHEAD_PERCENT = 10;   // Share of each shard's next victims kept clean
+inline constexpr size_t PAGE_CLEANER_MAX_WRITE_PAGES = 32;       // Longest run of adjacent pages per write
+inline constexpr size_t FLUSH_MAX_WRITE_PAGES = 256;             // Longest run per write in flush_file/flush_all
+inline constexpr size_t READ_AHEAD_MIN_PAGES = 4;              // Initial leaf read-ahead window of a scan
+inline constexpr size_t READ_AHEAD_MAX_PAGES = 64;             // Largest leaf read-ahead window
+inline constexpr size_t DISK_EXTENT_PAGES = 64;                // Pages a data file grows by at a time
+inline constexpr uint32_t ALLOCATION_EXTENT_PAGES = 64;        // Pages a B+tree allocates near each other (one bitmap word)
+inline constexpr size_t IO_QUEUE_DEPTH = 32;                   // Requests a pool keeps in flight per batch of async I/O
+inline constexpr uint64_t MMAP_RESERVE_BYTES = 1ULL << 36;     // Address space a memory-mapped table reserves (64 GiB)
+inline constexpr uint32_t COMPRESSED_SLOT_BYTES = 256;        // Allocation unit of a compressed table's page slots
+inline constexpr uint32_t PAGE_MAP_BLOCK_ENTRIES = 512;        // Slot map entries written back together (4 KB)
 inline constexpr uint32_t MAX_FILE_PATH_LENGTH = 255;
 
 inline constexpr uint8_t RECORD_DELETED = 1 << 0;
-inline constexpr uint16_t MERGE_THRESHOLD_PERCENT = 50;
\ No newline at end of file
+inline constexpr uint8_t PAGE_FLAG_COMPRESSED_LEAVES = 1 << 0;  // meta page: the table stores leaf pages compressed
+inline constexpr uint8_t PAGE_FLAG_TABLESPACE = 1 << 1;         // meta page: the file is a tablespace of many tables
+inline constexpr uint16_t MERGE_THRESHOLD_PERCENT = 50;
+inline constexpr uint32_t COMPACTION_FILL_PERCENT = 90;  // How full compaction packs leaves, leaving room for inserts
+inline constexpr size_t COMPACTION_STEP_LEAVES = 64;     // Leaves one compaction step rewrites under the write latch
+inline constexpr uint32_t BULK_LOAD_FILL_PERCENT = 90;   // Default page fill of StorageEngine::bulk_load
+inline constexpr uint32_t LRU_K_HISTORY = 2;          // K for ReplacerPolicy::LRU_K
+inline constexpr uint32_t TWO_QUEUE_A1_PERCENT = 25;  // share of frames kept in the 2Q probation queue
+
@@ -1,10 +1,27 @@
 #pragma once
+#include "storage/constants.hpp"
+#include "storage/compressed_page_store.hpp"
+#include <memory>
 #include <string>
 #include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <atomic>
 
+// Page-granular file I/O. Reads and writes are positional (pread/pwrite), so
+// they need no shared file offset and run without a lock. The file grows in
+// extents of extent_pages pages, preallocated with fallocate where the OS
+// supports it; the allocated size is cached, so a write inside it is a
+// single system call. Pages are page_size bytes, the size of the table the
+// file holds.
+//
+// With compression enabled, leaf pages are stored LZ-compressed in slots of
+// their compressed length (see CompressedPageStore) and every other page as
+// it is; callers still read and write whole uncompressed pages. Compressed
+// pages are read and written one at a time.
 class DiskManager {
 public:
-    DiskManager(const std::string& file_path);
+    DiskManager(const std::string& file_path, size_t extent_pages = DISK_EXTENT_PAGES, uint32_t page_size = PAGE_SIZE);
     ~DiskManager();
 
     DiskManager(DiskManager&& other) noexcept;
@@ -13,10 +30,61 @@ public:
     DiskManager(const DiskManager&) = delete;
     DiskManager& operator=(const DiskManager&) = delete;
 
-    void read_page(int page_id, uint8_t* page_data);
-    void write_page(int page_id, const void* page_data); // void as pointer can be anything for now
+    void read_page(uint32_t page_id, uint8_t* page_data);
+    void write_page(uint32_t page_id, const void* page_data); // void as pointer can be anything for now
+    // Writes page_count adjacent pages starting at first_page_id in one call.
+    void write_pages(uint32_t first_page_id, size_t page_count, const void* page_data);
+    // Tells the OS that page_count pages from first_page_id will be read
+    // soon, so it can start reading them in the background. Only a hint.
+    void prefetch_pages(uint32_t first_page_id, size_t page_count);
+    // Makes every completed write durable (fdatasync; fsync where that is
+    // missing), then the slot map of a compressed file. Throws if the OS
+    // reports a failure.
     void flush();
 
-private: 
+    // Cuts the file back to page_count pages; nothing past them may still be
+    // waiting to be written. Not for compressed files, whose pages are not
+    // stored at their page ids. Throws if the OS reports a failure.
+    void truncate(uint32_t page_count);
+
+    void set_extent_pages(size_t extent_pages) { this->extent_pages = extent_pages == 0 ? 1 : extent_pages; }
+    size_t get_extent_pages() const { return extent_pages; }
+    // Set before any page is read or written, e.g. once the meta page has
+    // been read with the default size.
+    void set_page_size(uint32_t page_size) { this->page_size = page_size; }
+    uint32_t get_page_size() const { return page_size; }
+    // Switches to compressed storage, loading the slot map; like the page
+    // size, set before any page other than the meta page is touched.
+    void enable_compression();
+    bool is_compressed() const { return page_store != nullptr; }
+    // Zero for a file without compression.
+    CompressionStats get_compression_stats() const;
+    // Sidecar file holding a compressed table's slot map.
+    static std::string page_map_path(const std::string& file_path) { return file_path + ".map"; }
+    // Allocated file size in bytes, a whole number of extents once the file
+    // has been written to.
+    uint64_t get_file_size() const { return file_size.load(); }
+    // System calls issued for reads, writes, hints and growth so far.
+    uint64_t get_syscall_count() const { return syscall_count.load(); }
+
+private:
+    friend class IoQueue;  // submits reads and writes on file_descriptor
+
+    void grow_to(uint64_t required_size);
+    // Reads up to length bytes at offset; returns the bytes read, short at
+    // the end of the file.
+    size_t read_bytes(uint64_t offset, uint8_t* buffer, size_t length);
+    void write_bytes(uint64_t offset, const uint8_t* data, uint64_t length);
+    void sync_data();
+    void read_compressed_page(uint32_t page_id, uint8_t* page_data);
+    void write_compressed_page(uint32_t page_id, const uint8_t* page_data);
+
+    std::string file_path;
     int file_descriptor{-1};
-};
\ No newline at end of file
+    std::mutex io_latch; // serializes growing the file (and every I/O on Windows, which lacks pread/pwrite)
+    std::atomic<uint64_t> file_size{0};
+    size_t extent_pages{DISK_EXTENT_PAGES};
+    uint32_t page_size{PAGE_SIZE};
+    std::atomic<uint64_t> syscall_count{0};
+    std::unique_ptr<CompressedPageStore> page_store;  // set for compressed tables
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include "storage/page.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Read-only shared mapping of a table file. MMAP_RESERVE_BYTES of address
+// space are reserved up front and the file is mapped at their start, so
+// extending the mapping after the file grows never moves a page a reader is
+// looking at. Pages past the mapped length read as nullptr; callers fetch
+// those through the buffer pool. When the file is cut, the mapping shrinks
+// with it.
+//
+// The mapping shows what is in the file, not what is in the pool: dirty
+// pages must be written back before readers can see them.
+class FileMapping {
+public:
+    FileMapping() = default;
+    ~FileMapping();
+
+    FileMapping(const FileMapping&) = delete;
+    FileMapping& operator=(const FileMapping&) = delete;
+
+    // Maps file_path, a file of page_size pages; false where mmap is
+    // unavailable (Windows) or fails.
+    bool map(const std::string& file_path, uint32_t page_size = PAGE_SIZE);
+    void unmap();
+    bool is_mapped() const { return base_ != nullptr; }
+
+    // Follows the file's length since the last call: maps what it has grown
+    // by and unmaps what it has been cut by.
+    bool remap();
+
+    // The page, or nullptr when it lies past the mapped length. Readers must
+    // not write through it; the mapping is read-only.
+    Page* page(uint32_t page_id) const;
+    size_t page_count() const { return static_cast<size_t>(mapped_bytes_.load() / page_size_); }
+
+    // Asks the OS to start reading the given pages in; only a hint.
+    void will_need(const std::vector<uint32_t>& page_ids) const;
+
+private:
+    std::string file_path_;
+    uint8_t* base_ = nullptr;
+    size_t reserved_bytes_ = 0;
+    uint32_t page_size_ = PAGE_SIZE;
+    std::atomic<uint64_t> mapped_bytes_{0};
+    std::mutex remap_latch_;  // serializes remap()
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include "storage/page.hpp"
+#include <cstdint>
+
+// Which pages of a file are in use, kept in two levels:
+//
+//  - Bitmap pages, one bit per page. The file is divided into groups of
+//    bitmap_group_pages() pages, each described by one bitmap page: page 1
+//    for the first group, and the first page of the group for every later
+//    one, so any page's bit is found without a lookup.
+//  - The meta page, after its header: a FreeSpaceHeader, then one bit per
+//    group, set while every page of the group below the high-water mark is
+//    in use, so allocation skips such groups without reading their bitmaps.
+//
+// Allocation is next-fit over the pages below the high-water mark: it
+// resumes after the last page allocated, scans a 64-bit word of the bitmap
+// at a time, and wraps around once. Only when no page below the mark is free
+// does the mark move up, starting a group where it crosses into one. Both
+// levels are ordinary pool pages, written back with the rest of the table
+// rather than on every change.
+#pragma pack(push, 1)
+struct FreeSpaceHeader {
+    uint32_t group_count;  // groups with a bitmap page; 0 in files that predate the map
+    uint32_t next_fit;     // page the next allocation starts looking at
+    uint32_t high_water;   // pages at and above it have never been allocated
+    uint8_t reserved[4];   // keeps the group bits that follow 8-byte aligned
+};
+#pragma pack(pop)
+
+// Pages described by one bitmap page.
+inline uint32_t bitmap_group_pages(uint32_t page_size) {
+    return (page_size - static_cast<uint32_t>(sizeof(PageHeader))) * 8;
+}
+
+inline uint32_t bitmap_page_of_group(uint32_t group, uint32_t page_size) {
+    return group == 0 ? 1 : group * bitmap_group_pages(page_size);
+}
+
+// Sets up the meta page and first bitmap page of a new file, where pages
+// 0 to reserved_pages - 1 are already in use.
+void init_free_space_map(Page& meta, Page& bitmap, uint32_t reserved_pages);
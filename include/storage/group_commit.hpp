@@ -0,0 +1,40 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+// Lets concurrent committers share one sync. Each finished write takes a
+// ticket from add(); commit() returns once a sync that started after the
+// ticket was taken has completed. The first waiter to find no sync running
+// becomes the leader and runs it for everyone whose ticket it covers;
+// the rest wait for it, and whoever is left over when it finishes starts
+// the next one.
+class GroupCommit {
+public:
+    GroupCommit() = default;
+    GroupCommit(const GroupCommit&) = delete;
+    GroupCommit& operator=(const GroupCommit&) = delete;
+
+    // Records a finished write; the ticket orders it against syncs.
+    uint64_t add();
+    // Ticket of the latest write, 0 before the first.
+    uint64_t last_ticket() const;
+    // Waits until ticket is durable, running sync as the leader when no
+    // sync is in progress. Returns false if the sync this caller ran threw;
+    // a waiter whose leader failed runs a sync of its own.
+    bool commit(uint64_t ticket, const std::function<void()>& sync);
+
+    // Syncs run and commit() calls served so far.
+    uint64_t get_sync_count() const;
+    uint64_t get_commit_count() const;
+
+private:
+    mutable std::mutex latch_;
+    std::condition_variable synced_;
+    uint64_t issued_ = 0;    // tickets handed out
+    uint64_t durable_ = 0;   // every ticket up to this one is durable
+    bool syncing_ = false;
+    uint64_t sync_count_ = 0;
+    uint64_t commit_count_ = 0;
+};
@@ -5,35 +5,160 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <shared_mutex>
+#include <utility>
 #include "storage/relational/catalog.hpp"
 #include "storage/relational/row_codec.hpp"
+#include "storage/constants.hpp"
 struct TableHandle;
+struct BTreeStats;
+class BufferPoolManager;
+class DiskManager;
+class Tablespace;
+enum class TableAccessMode;
+enum class DurabilityMode;
 
 
 class StorageEngine {
 public:
-    StorageEngine();
+    // Open tables of the same page size share one buffer pool; a pool is
+    // created the first time a table of its page size is opened. The pools
+    // split buffer_pool_bytes between them equally.
+    explicit StorageEngine(size_t buffer_pool_bytes = BUFFER_POOL_BYTES);
     ~StorageEngine();
 
     StorageEngine(const StorageEngine&) = delete;
     StorageEngine& operator=(const StorageEngine&) = delete;
 
+    // Keeps every table created, opened or dropped from now on in the
+    // single file data/<name>.tbs, created with page_size and
+    // compress_leaves if missing. Tables are then pages in that file, so
+    // creating and dropping them is cheap however many there are; the
+    // tablespace's page size and compression apply to all of them, and
+    // create_table with any other settings fails. Returns false if the
+    // tablespace cannot be opened, or one is already in use.
+    bool use_tablespace(const std::string& name, uint32_t page_size = PAGE_SIZE, bool compress_leaves = false);
+
     bool create_table(const std::string& table_name);
+    // page_size is fixed for the table's lifetime: a power of two from
+    // PAGE_SIZE to MAX_PAGE_SIZE. Returns false for any other size.
+    // compress_leaves stores leaf pages compressed on disk (they stay
+    // uncompressed in the pool); the ratio and CPU cost show in the table
+    // handle's dm->get_compression_stats().
+    bool create_table(const std::string& table_name, uint32_t page_size, bool compress_leaves = false);
     bool create_table(const std::string& table_name, const Relational::TableSchema& schema);
     bool drop_table(const std::string& table_name);
     TableHandle* open_table(const std::string& table_name);
-    void close_table(TableHandle* handle);
+    // Opens the table, or switches an open one, to mode. MMAP suits tables
+    // that are read far more than written: every write through this engine
+    // is written back to the file at once so the mapping stays current.
+    // Returns nullptr if the mode cannot be set (the table stays open), as
+    // for compressed tables.
+    TableHandle* open_table(const std::string& table_name, TableAccessMode mode);
+    // False if the table's pages could not all be written back; the table
+    // then stays open, and handle valid, so the close can be retried.
+    bool close_table(TableHandle* handle);
 
     bool insert_record(TableHandle* handle, const std::vector<uint8_t>& key, const std::vector<uint8_t>& value);
     bool get_record(TableHandle* handle, const std::vector<uint8_t>& key, std::vector<uint8_t>& out_value);
+
+    // Where get_batch puts what it finds: the values back to back in arena,
+    // and for each key, in the order given, where its value lies. Reusing
+    // one across calls keeps its capacity, so a warmed-up caller allocates
+    // nothing per value.
+    struct BatchValue {
+        size_t offset = 0;
+        size_t size = 0;
+        bool found = false;
+    };
+    struct BatchResult {
+        std::vector<uint8_t> arena;
+        std::vector<BatchValue> values;
+    };
+    // Looks up many keys at once: they are sorted, the leaves they need are
+    // prefetched if they are not cached, each leaf is read once for all its
+    // keys, and leaves that share a parent are reached from it without a
+    // new descent. Replaces result's contents; returns the number of keys
+    // found.
+    size_t get_batch(TableHandle* handle, const std::vector<std::vector<uint8_t>>& keys, BatchResult& result);
     bool delete_record(TableHandle* handle, const std::vector<uint8_t>& key);
     bool update_record(TableHandle* handle, const std::vector<uint8_t>& key, const std::vector<uint8_t>& new_value);
+    // Inserts the row, or replaces the key's value if it is already there,
+    // in one descent.
+    bool upsert(TableHandle* handle, const std::vector<uint8_t>& key, const std::vector<uint8_t>& value);
+
+    // Computes into merged a key's new value from its current one and an
+    // operand. existing is nullptr if the key is absent, else it points into
+    // the table's leaf and is only valid during the call. Returning false
+    // leaves the key as it was. The table's writers wait meanwhile, so the
+    // operator must not write to it.
+    using MergeOperator = bool (*)(const uint8_t* existing, size_t existing_size, const uint8_t* operand,
+                                   size_t operand_size, std::vector<uint8_t>& merged, void* ctx);
+    // Registered by every engine. MERGE_ADD adds an int64_t operand to an
+    // int64_t value (both in native byte order), an absent key counting as
+    // 0; MERGE_APPEND appends the operand's bytes to the value.
+    static constexpr uint32_t MERGE_ADD = 0;
+    static constexpr uint32_t MERGE_APPEND = 1;
+    // Returns the id merge takes. Safe to call while other threads merge.
+    uint32_t register_merge_operator(MergeOperator merge_operator, void* ctx);
+    // Read-modify-write in one descent: the operator runs on the value in
+    // its leaf and the result is written back before the leaf is released,
+    // replacing a get_record and update_record pair. False if the operator
+    // refuses, the id is unknown, or the result does not fit.
+    bool merge(TableHandle* handle, const std::vector<uint8_t>& key, const std::vector<uint8_t>& operand,
+               uint32_t merge_operator);
+
+    using Row = std::pair<std::vector<uint8_t>, std::vector<uint8_t>>;
+    // Inserts rows in any order as one write: they are sorted by key and
+    // the tree is descended once per leaf they land in, not once per row,
+    // with a full leaf split once before the rest go in. Rows insert_record
+    // would refuse, such as keys already in the table or repeated in the
+    // batch, are skipped. Returns the number inserted; in PER_OPERATION mode
+    // they are durable together when it returns.
+    size_t insert_batch(TableHandle* handle, const std::vector<Row>& rows);
+
+    // Fills in key and value with the next row to load and returns true, or
+    // returns false when there are no more.
+    using BulkLoadSource = bool (*)(std::vector<uint8_t>& key, std::vector<uint8_t>& value, void* ctx);
+    // Loads pre-sorted rows much faster than inserting them one by one:
+    // leaves are written left to right, each filled to fill_percent (1 to
+    // 100), with the internal levels built above them and nothing split.
+    // Works on an empty table or appends past its largest key. Keys must be
+    // strictly increasing; at the first that is not, that is not past the
+    // table's existing keys, or that would start a leaf with a separator
+    // too long for an internal page, the load stops and returns false,
+    // keeping the rows before it. Other writers wait for the whole load.
+    bool bulk_load(TableHandle* handle, BulkLoadSource source, void* ctx,
+                   uint32_t fill_percent = BULK_LOAD_FILL_PERCENT);
 
     using ScanCallback = void (*)(const std::vector<uint8_t>& key, const std::vector<uint8_t>& value, void* ctx);
+    // Writers to the table wait for the scan, so callback must not write to
+    // it.
     void scan_table(TableHandle* handle, ScanCallback callback, void* ctx);
     void range_scan(TableHandle* handle, const std::vector<uint8_t>& start_key, const std::vector<uint8_t>& end_key, ScanCallback callback, void* ctx);
 
+    // Durability of the table's writes; NONE until set. Writes to one
+    // table are serialized, and in PER_OPERATION mode each returns once it
+    // is on disk, with concurrent writers sharing one fdatasync.
+    void set_durability(TableHandle* handle, DurabilityMode mode);
+    // Makes every write to the table so far durable, in any mode; the
+    // commit point of a batch in PER_BATCH mode.
+    bool sync_table(TableHandle* handle);
+
+    // Rewrites the table's leaves in key order into dense, consecutive
+    // pages from the start of the file, moves its internal pages down after
+    // them and gives the free pages left at the end back to the file system
+    // (kept in compressed tables and shared tablespaces). Runs as a series
+    // of short writes, so other writers and readers carry on meanwhile.
+    bool compact_table(TableHandle* handle);
+    // Splits the table's writes have made since it was opened, and splits
+    // they avoided by compacting a full page in place.
+    BTreeStats get_btree_stats(TableHandle* handle);
+
     void flush_all();
+    // The pool of PAGE_SIZE tables.
+    BufferPoolManager& buffer_pool() { return buffer_pool(PAGE_SIZE); }
+    BufferPoolManager& buffer_pool(uint32_t page_size);
 
     bool insert(const std::string& table_name, const Relational::Tuple& row);
     std::vector<Relational::Tuple> scan(const std::string& table_name);
@@ -41,7 +166,24 @@ public:
     const Relational::TableSchema* get_schema(const std::string& table_name) const;
 
 private:
+    size_t buffer_pool_bytes_;
+    // Files whose pages could not be written back when the engine closed
+    // them. Still attached, so they must outlive the pools, which try once
+    // more as they go.
+    std::vector<std::shared_ptr<DiskManager>> unflushed_files_;
+    // Keyed by page size. Declared first: outlives open_tables_.
+    std::unordered_map<uint32_t, std::unique_ptr<BufferPoolManager>> buffer_pools_;
+    // Set by use_tablespace; closed after the tables opened from it.
+    std::unique_ptr<Tablespace> tablespace_;
     std::unordered_map<std::string, std::unique_ptr<TableHandle>> open_tables_;
     Relational::Catalog catalog_;
+    struct RegisteredMergeOperator {
+        MergeOperator merge;
+        void* ctx;
+    };
+    // Indexed by id; the built-in operators first. Growing the vector moves
+    // it, so merge looks an operator up under the shared latch.
+    std::vector<RegisteredMergeOperator> merge_operators_;
+    std::shared_mutex merge_operators_latch_;
     TableHandle* get_or_open_table(const std::string& table_name);
 };
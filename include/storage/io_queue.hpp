@@ -0,0 +1,85 @@
+#pragma once
+#include "storage/constants.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+class DiskManager;
+
+enum class IoBackend {
+    SYNC,      // DiskManager's blocking calls, one request at a time
+    IO_URING,  // Linux io_uring; requests run concurrently in the kernel
+};
+
+// A read or write of page_count adjacent pages. The buffer must stay valid
+// until the request completes; ok is set then.
+struct IoRequest {
+    DiskManager* disk_manager = nullptr;
+    bool write = false;
+    uint32_t first_page_id = 0;
+    size_t page_count = 1;
+    uint8_t* buffer = nullptr;
+    bool ok = false;
+};
+
+// Batched asynchronous page I/O. submit() queues a request and poll() hands
+// everything queued to the kernel in one system call, then collects
+// completions. Without io_uring (other platforms, old kernels, or when it is
+// disabled) the queue falls back to the blocking DiskManager calls and
+// requests complete in submit(). A failed or short io_uring request is
+// retried with the blocking calls before it is reported.
+//
+// Not thread-safe: each thread submitting I/O owns its queue.
+class IoQueue {
+public:
+    explicit IoQueue(size_t depth = IO_QUEUE_DEPTH, IoBackend backend = IoBackend::IO_URING);
+    ~IoQueue();
+
+    IoQueue(const IoQueue&) = delete;
+    IoQueue& operator=(const IoQueue&) = delete;
+
+    // The backend in use, which is SYNC when io_uring was asked for but is
+    // not available.
+    IoBackend backend() const { return backend_; }
+    size_t depth() const { return depth_; }
+    size_t in_flight() const { return in_flight_; }
+
+    // Queues request; returns false when depth() requests are in flight.
+    bool submit(IoRequest& request);
+    // Submits queued requests and waits until at least min_complete of the
+    // requests in flight have completed (fewer if fewer are in flight).
+    // Completed requests are appended to completed.
+    size_t poll(std::vector<IoRequest*>& completed, size_t min_complete = 1);
+    // Waits for every request in flight.
+    void wait();
+
+    // io_uring_enter calls made so far; 0 for the SYNC backend.
+    uint64_t get_syscall_count() const { return syscall_count_; }
+
+private:
+    bool setup_ring();
+    void complete_sync(IoRequest& request);
+
+    IoBackend backend_;
+    size_t depth_;
+    size_t in_flight_ = 0;
+    size_t unsubmitted_ = 0;
+    uint64_t syscall_count_ = 0;
+    std::vector<IoRequest*> sync_completed_;
+
+    // io_uring state, unused by the SYNC backend.
+    int ring_fd_ = -1;
+    void* sq_ring_ = nullptr;
+    size_t sq_ring_size_ = 0;
+    void* cq_ring_ = nullptr;
+    size_t cq_ring_size_ = 0;
+    void* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_mask_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned* cq_mask_ = nullptr;
+    void* cqes_ = nullptr;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// Reader/writer latch for buffer pool frames, packed into one atomic word:
+// the low bits count readers, the top bits mark a writer holding or waiting
+// for the latch. An uncontended acquire is a single atomic operation, which
+// matters because every page visit takes one. A waiting writer blocks new
+// readers, so a stream of lookups cannot starve it. Waiters yield rather
+// than sleep; frame latches are only held for the duration of a page access.
+// Meets the SharedMutex requirements used by std::shared_lock and
+// std::unique_lock.
+class FrameLatch {
+public:
+    FrameLatch() = default;
+    FrameLatch(const FrameLatch&) = delete;
+    FrameLatch& operator=(const FrameLatch&) = delete;
+
+    bool try_lock_shared() {
+        uint32_t state = state_.load(std::memory_order_relaxed);
+        return (state & (WRITER | WRITER_WAITING)) == 0 &&
+               state_.compare_exchange_strong(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    void lock_shared() {
+        while (!try_lock_shared()) {
+            std::this_thread::yield();
+        }
+    }
+
+    void unlock_shared() {
+        state_.fetch_sub(1, std::memory_order_release);
+    }
+
+    bool try_lock() {
+        uint32_t state = state_.load(std::memory_order_relaxed);
+        return (state & ~WRITER_WAITING) == 0 &&
+               state_.compare_exchange_strong(state, WRITER, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    void lock() {
+        while (!try_lock()) {
+            state_.fetch_or(WRITER_WAITING, std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+    }
+
+    void unlock() {
+        state_.store(0, std::memory_order_release);
+    }
+
+private:
+    static constexpr uint32_t WRITER = 1u << 31;
+    static constexpr uint32_t WRITER_WAITING = 1u << 30;
+
+    std::atomic<uint32_t> state_{0};
+};
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// A small LZ77 block codec in the style of LZ4, used to store leaf pages
+// compressed. The output is a sequence of (literals, match) pairs: a token
+// byte holds both lengths in its nibbles (15 means more length bytes
+// follow, each adding up to 255), then the literals, a two-byte little-endian
+// match offset and the extra match length. The last sequence has literals
+// only. Matches are at least LZ_MIN_MATCH bytes and reach back at most
+// 65535 bytes, so inputs are limited to LZ_MAX_INPUT.
+inline constexpr size_t LZ_MIN_MATCH = 4;
+inline constexpr size_t LZ_MAX_INPUT = 65535;
+
+// Compresses size bytes of src into dst. Returns the compressed size, or 0
+// if it would exceed capacity (the caller then stores the data as is).
+size_t lz_compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity);
+// Decompresses size bytes of src into dst. Returns the decompressed size,
+// or 0 if src is malformed or decompresses to more than capacity bytes.
+size_t lz_decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity);
@@ -24,13 +24,21 @@ struct PageHeader {
 
     uint32_t root_page;
     uint8_t reserved[4];
-    uint16_t flags;
+    uint8_t flags;
+    uint8_t page_shift;  // the page is 1 << page_shift bytes; 0 in files that predate it (PAGE_SIZE)
     uint16_t cell_count; 
     uint16_t free_start;
     uint16_t free_end;
 
     uint32_t parent_page_id;
-    uint32_t lsn;
+    // Bytes below free_start still held by deleted or moved records, which
+    // compacting the page reclaims. Taken from an lsn that was never set,
+    // so pages written before it read 0 and only compact once it counts.
+    uint16_t fragmented_bytes;
+    // Internal pages only: the length of the prefix every separator on the
+    // page shares, stored once right after the header and left off each
+    // entry. Pages written before it read 0 and hold whole keys.
+    uint16_t prefix_size;
 
     uint32_t prev_page_id;
     uint32_t next_page_id;
@@ -38,15 +46,23 @@ struct PageHeader {
 #pragma pack(pop)
 
 
+// Room for the largest page size. A table's pages are only as large as its
+// page size (recorded in every page header), and the pool and the file
+// mapping lay pages out at that stride, so only the first page_size(page)
+// bytes of a Page may be touched.
 struct Page {
-    uint8_t data[PAGE_SIZE];
+    uint8_t data[MAX_PAGE_SIZE];
 };
 
 
 static_assert(sizeof(PageHeader) == 40, "PageHeader size must be 40 bytes");
 
 inline PageHeader* get_header(Page& page);
-void init_page(Page& page, uint32_t page_id, PageType page_type, PageLevel page_level);
+// Page sizes a table can use: powers of two from PAGE_SIZE to MAX_PAGE_SIZE.
+bool is_valid_page_size(uint32_t page_size);
+void init_page(Page& page, uint32_t page_id, PageType page_type, PageLevel page_level, uint32_t page_size);
+// Copies page_size(src) bytes; the common sizes get fixed-length copies.
+void copy_page(Page& dst, const Page& src);
 uint16_t* slot_ptr(Page& page, uint16_t index);
 void insert_slot(Page& page, uint16_t index, uint16_t record_offset);
 void remove_slot(Page& page, uint16_t index);
@@ -54,3 +70,8 @@ void remove_slot(Page& page, uint16_t index);
 inline PageHeader* get_header(Page& page) {
     return reinterpret_cast<PageHeader*>(page.data);
 }
+
+inline uint32_t page_size(const Page& page) {
+    uint8_t shift = reinterpret_cast<const PageHeader*>(page.data)->page_shift;
+    return shift == 0 ? PAGE_SIZE : 1u << shift;
+}
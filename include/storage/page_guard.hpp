@@ -0,0 +1,73 @@
+#pragma once
+
+#include "storage/buffer_pool.hpp"
+#include "storage/page.hpp"
+#include <cstdint>
+
+// Pins a page and holds its frame latch shared for the guard's lifetime, so
+// callers can read the cached frame in place instead of copying it out.
+// A guard whose fetch failed is empty and tests false. Moving a guard hands
+// over both the pin and the latch.
+class ReadPageGuard {
+public:
+    ReadPageGuard() = default;
+    ReadPageGuard(BufferPoolManager& bpm, FileId file_id, uint32_t page_id, AccessType access_type = AccessType::DEFAULT);
+    ~ReadPageGuard();
+
+    ReadPageGuard(ReadPageGuard&& other) noexcept;
+    ReadPageGuard& operator=(ReadPageGuard&& other) noexcept;
+
+    ReadPageGuard(const ReadPageGuard&) = delete;
+    ReadPageGuard& operator=(const ReadPageGuard&) = delete;
+
+    // Wraps a page read straight from a table's file mapping. There is no
+    // pin or latch to hold; the guard only carries the page.
+    static ReadPageGuard mapped(Page& page, uint32_t page_id);
+
+    explicit operator bool() const { return page_ != nullptr; }
+    // The page helpers take Page&; readers must not write through it.
+    Page& page() const { return *page_; }
+    uint32_t page_id() const { return page_id_; }
+
+    // Drops the latch and the pin early.
+    void release();
+
+private:
+    BufferPoolManager* bpm_ = nullptr;
+    FileId file_id_ = INVALID_FILE_ID;
+    uint32_t page_id_ = INVALID_PAGE_ID;
+    Page* page_ = nullptr;
+};
+
+// Pins a page and holds its frame latch exclusively. The page is unpinned
+// dirty on release if mark_dirty() was called.
+class WritePageGuard {
+public:
+    WritePageGuard() = default;
+    WritePageGuard(BufferPoolManager& bpm, FileId file_id, uint32_t page_id, AccessType access_type = AccessType::DEFAULT);
+    ~WritePageGuard();
+
+    WritePageGuard(WritePageGuard&& other) noexcept;
+    WritePageGuard& operator=(WritePageGuard&& other) noexcept;
+
+    WritePageGuard(const WritePageGuard&) = delete;
+    WritePageGuard& operator=(const WritePageGuard&) = delete;
+
+    // Allocates page_id in the pool through new_page(); the result is dirty.
+    static WritePageGuard create(BufferPoolManager& bpm, FileId file_id, uint32_t page_id,
+                                 PageType page_type = PageType::DATA, PageLevel page_level = PageLevel::LEAF);
+
+    explicit operator bool() const { return page_ != nullptr; }
+    Page& page() const { return *page_; }
+    uint32_t page_id() const { return page_id_; }
+    void mark_dirty() { dirty_ = true; }
+
+    void release();
+
+private:
+    BufferPoolManager* bpm_ = nullptr;
+    FileId file_id_ = INVALID_FILE_ID;
+    uint32_t page_id_ = INVALID_PAGE_ID;
+    Page* page_ = nullptr;
+    bool dirty_ = false;
+};
@@ -26,5 +26,16 @@ const uint8_t* slot_value(Page& page, uint16_t slot_index, uint16_t& value_len);
 int compare_keys(const uint8_t* first, uint16_t first_size, const uint8_t* second, uint16_t second_size);
 BSearchResult search_record(Page& page, const uint8_t* key, uint16_t key_len);
 bool can_insert(Page& page, uint16_t record_size);
+// Like can_insert, counting the fragmented bytes compacting the page would
+// reclaim as free.
+bool can_insert_after_compact(Page& page, uint16_t record_size);
 bool page_insert(Page& page, const uint8_t* key, uint16_t key_size, const uint8_t* value, uint16_t value_size);
-bool page_delete(Page& page, const uint8_t* key, uint16_t key_len);
\ No newline at end of file
+bool page_delete(Page& page, const uint8_t* key, uint16_t key_len);
+// Replaces the value of the record in slot_index: in place when the new one
+// is no longer, else by rewriting the record into the free space and
+// leaving the old bytes behind. False, with the page untouched, if it does
+// not fit there.
+bool page_update(Page& page, uint16_t slot_index, const uint8_t* value, uint16_t value_size);
+// Rewrites the live records back to back after the header, reclaiming the
+// bytes deleted and moved records left behind. Slots keep their order.
+void page_compact(Page& page);
\ No newline at end of file
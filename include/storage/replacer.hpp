@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+// How a page is being touched. SCAN marks pages that a sequential pass will
+// not come back to, so the replacer can evict them ahead of the working set.
+enum class AccessType : uint8_t {
+    DEFAULT = 0,
+    SCAN = 1
+};
+
+enum class ReplacerPolicy : uint8_t {
+    LRU = 0,
+    LRU_K = 1,
+    TWO_QUEUE = 2
+};
+
+// Chooses eviction victims among buffer pool frames. The pool reports every
+// pin through record_access() and flips a frame to evictable once its pin
+// count drops to zero; only evictable frames are ever returned by evict().
+class Replacer {
+public:
+    virtual ~Replacer() = default;
+
+    virtual void record_access(size_t frame_id, AccessType access_type) = 0;
+    virtual void set_evictable(size_t frame_id, bool evictable) = 0;
+    virtual bool evict(size_t& frame_id) = 0;
+    // Forget a frame whose page was dropped from the pool.
+    virtual void remove(size_t frame_id) = 0;
+    virtual size_t size() const = 0;
+    // Appends up to max_frames evictable frames, next victim first, without
+    // evicting them. The page cleaner writes these back ahead of time.
+    virtual void eviction_candidates(size_t max_frames, std::vector<size_t>& out) const = 0;
+};
+
+std::unique_ptr<Replacer> make_replacer(ReplacerPolicy policy, size_t num_frames);
+
+// Intrusive doubly linked list over frame ids. Links live in a side array
+// indexed by frame id, so push, unlink and pop are O(1) with no allocation.
+class FrameList {
+public:
+    static constexpr size_t NO_FRAME = SIZE_MAX;
+
+    explicit FrameList(size_t num_frames);
+
+    void push_front(size_t frame_id);
+    void push_back(size_t frame_id);
+    void unlink(size_t frame_id);
+    bool contains(size_t frame_id) const { return linked_[frame_id]; }
+    size_t back() const { return tail_; }
+    size_t prev(size_t frame_id) const { return prev_[frame_id]; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+private:
+    std::vector<size_t> prev_;
+    std::vector<size_t> next_;
+    std::vector<bool> linked_;
+    size_t head_;
+    size_t tail_;
+    size_t size_;
+};
+
+// Classic LRU on unpin order. Frames brought in by a scan are queued at the
+// cold end so they go before anything a lookup has touched.
+class LRUReplacer : public Replacer {
+public:
+    explicit LRUReplacer(size_t num_frames);
+
+    void record_access(size_t frame_id, AccessType access_type) override;
+    void set_evictable(size_t frame_id, bool evictable) override;
+    bool evict(size_t& frame_id) override;
+    void remove(size_t frame_id) override;
+    size_t size() const override { return lru_.size(); }
+    void eviction_candidates(size_t max_frames, std::vector<size_t>& out) const override;
+
+private:
+    FrameList lru_;
+    std::vector<bool> scanned_;
+    std::vector<bool> touched_;  // accessed since the frame was last loaded
+};
+
+// LRU-K: evicts the frame whose K-th most recent access is oldest. Frames
+// with fewer than K accesses have infinite backward distance and go first,
+// least recently used first. Scan accesses are not added to the history, so a
+// page seen only by scans is evicted before any page with real history.
+class LRUKReplacer : public Replacer {
+public:
+    LRUKReplacer(size_t num_frames, size_t k);
+
+    void record_access(size_t frame_id, AccessType access_type) override;
+    void set_evictable(size_t frame_id, bool evictable) override;
+    bool evict(size_t& frame_id) override;
+    void remove(size_t frame_id) override;
+    size_t size() const override { return scan_only_.size() + cold_.size() + hot_.size(); }
+    void eviction_candidates(size_t max_frames, std::vector<size_t>& out) const override;
+
+private:
+    using Entry = std::pair<uint64_t, size_t>;  // (timestamp, frame id)
+
+    uint64_t history_at(size_t frame_id, size_t back) const;
+    void clear_history(size_t frame_id);
+
+    size_t k_;
+    uint64_t clock_;
+    std::vector<uint64_t> history_;  // ring of k_ timestamps per frame
+    std::vector<size_t> history_count_;
+    std::vector<bool> evictable_;
+    FrameList scan_only_;
+    std::set<Entry> cold_;  // fewer than k_ accesses, keyed by the most recent one
+    std::set<Entry> hot_;   // k_ accesses, keyed by the k-th most recent one
+};
+
+// 2Q over frames: a page enters the FIFO probation queue (A1) on its first
+// access and is promoted to the protected LRU queue (Am) when it is touched
+// again. A1 is drained first while it holds more than its share of the pool,
+// so a long scan only churns A1. Scan accesses never promote a page.
+class TwoQueueReplacer : public Replacer {
+public:
+    TwoQueueReplacer(size_t num_frames, size_t a1_share_percent);
+
+    void record_access(size_t frame_id, AccessType access_type) override;
+    void set_evictable(size_t frame_id, bool evictable) override;
+    bool evict(size_t& frame_id) override;
+    void remove(size_t frame_id) override;
+    size_t size() const override { return a1_.size() + am_.size(); }
+    void eviction_candidates(size_t max_frames, std::vector<size_t>& out) const override;
+
+private:
+    enum class Queue : uint8_t { NONE, A1, AM };
+
+    bool evict_from_a1() const;
+
+    FrameList a1_;
+    FrameList am_;
+    std::vector<Queue> queue_;
+    std::vector<bool> scanned_;
+    size_t a1_target_;
+    size_t a1_resident_;  // pinned and unpinned frames currently owned by A1
+};
@@ -2,31 +2,108 @@
 #include <string>
 #include <memory>
 #include <cstdint>
+#include <atomic>
 #include "storage/disk_manager.hpp"
+#include "storage/file_mapping.hpp"
+#include "storage/group_commit.hpp"
+#include <mutex>
+#include <shared_mutex>
 
 class BufferPoolManager;
+class Tablespace;
+struct Page;
+using FileId = uint32_t;
+
+enum class TableAccessMode {
+    BUFFERED,  // every page goes through the buffer pool
+    MMAP,      // lookups and scans read the file's mapping; writes go through the pool
+};
+
+enum class DurabilityMode {
+    NONE,           // writes reach the file when the pool writes them back; no sync
+    PER_BATCH,      // writes are durable once sync_table() returns
+    PER_OPERATION,  // each write is durable when it returns; concurrent writers share a sync
+};
+
+// What writes have done to the table's B+tree since it was opened.
+struct BTreeStats {
+    uint64_t leaf_splits = 0;
+    uint64_t internal_splits = 0;
+    uint64_t splits_avoided = 0;  // full pages compacted in place instead of split
+};
 
 struct TableHandle {
     std::string table_name;
     std::string file_path;
 
-    DiskManager dm;  // Used only by BufferPoolManager; do not call directly.
-    std::unique_ptr<BufferPoolManager> bpm;
+    // Attached to bpm as file_id; do not call directly. Shared by every
+    // table of a tablespace.
+    std::shared_ptr<DiskManager> dm;
+    BufferPoolManager* bpm = nullptr;  // Engine-wide pool, not owned.
+    FileId file_id = static_cast<FileId>(-1);
+
+    // B+tree lookups read it while a writer may be growing or moving the root.
+    std::atomic<uint32_t> root_page{0};
+    // Set for a table that lives in a tablespace, which then records its
+    // root page instead of the file's meta page.
+    Tablespace* tablespace = nullptr;
+
+    // In MMAP mode, btree_search and btree_range_scan read pages from
+    // mapping instead of pinning them. The mapping only sees what has been
+    // written back, so each write must be followed by sync_mapping(), and
+    // writes must not run concurrently with mapped reads.
+    TableAccessMode access_mode = TableAccessMode::BUFFERED;
+    std::unique_ptr<FileMapping> mapping;
 
-    uint32_t root_page;
+    // StorageEngine serializes writes to the table on write_latch, which
+    // its lookups and scans take shared, and commits them through
+    // group_commit.
+    DurabilityMode durability = DurabilityMode::NONE;
+    std::shared_mutex write_latch;
+    GroupCommit group_commit;
+    // Updated by writers under write_latch.
+    BTreeStats btree_stats;
 
     TableHandle() = default;
 
     explicit TableHandle(const std::string& name)
         : table_name(name),
           file_path("data/" + name + ".db"),
-          dm(file_path),
           bpm(nullptr),
           root_page(0)
     {}
 };
 
-bool open_table(const std::string &name, TableHandle &th);
-bool create_table(const std::string &name);
-uint32_t allocate_page(TableHandle &th);
+bool open_table(const std::string &name, TableHandle &th, BufferPoolManager &bpm);
+// False if the table's pages could not all be written back; the file then
+// stays attached to the pool, and th must be kept until it is closed.
+bool close_table(TableHandle &th);
+bool set_access_mode(TableHandle &th, TableAccessMode mode);
+void sync_mapping(TableHandle &th);
+bool sync_table(TableHandle &th, uint64_t ticket);
+bool create_table(const std::string &name, uint32_t page_size = PAGE_SIZE, bool compress_leaves = false);
+uint32_t table_page_size(const std::string &name);
+// Reads page 0 of the file at path, whatever its page size.
+bool read_meta_page(const std::string &path, Page &meta);
+// With near_page, prefers a page in the same extent of
+// ALLOCATION_EXTENT_PAGES, then a fresh extent, so pages allocated near
+// one another stay close on disk.
+uint32_t allocate_page(TableHandle &th, uint32_t near_page = 0);
+// Allocates page_id itself if it is free, or the page at the high-water
+// mark if page_id is at or past it; INVALID_PAGE_ID if page_id is in use.
+uint32_t allocate_page_at(TableHandle &th, uint32_t page_id);
+// Allocates the free page closest to the high-water mark, raising the mark
+// if none is free.
+uint32_t allocate_page_near_end(TableHandle &th);
+// Allocates the lowest free page below page_id; INVALID_PAGE_ID if there is
+// none.
+uint32_t allocate_page_below(TableHandle &th, uint32_t page_id);
+// The highest page in use, bitmap pages aside.
+uint32_t last_page_in_use(TableHandle &th);
+// Lowers the high-water mark past the free pages at the end of the file and
+// cuts them off the file. Returns the pages given up.
+uint32_t truncate_free_pages(TableHandle &th);
+// Makes root_page the table's root, persisting it in the meta page or the
+// tablespace directory.
+void set_root_page(TableHandle &th, uint32_t root_page);
 void free_page(TableHandle &th, uint32_t page_id);
@@ -0,0 +1,64 @@
+#pragma once
+#include "storage/table_handle.hpp"
+#include "storage/constants.hpp"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class BufferPoolManager;
+
+// Many tables in one file, data/<name>.tbs. Each table is a B+tree whose
+// pages come from the file's one free-space map, and a directory of table
+// names and root pages starts at page 2, chained through next_page_id.
+// Creating or dropping a table only changes the directory and the
+// free-space map: no file is created or removed. A new table has no pages
+// until its first insert. Every table shares the file's page size and
+// compression.
+class Tablespace {
+public:
+    // Creates data/<name>.tbs; false if it exists or cannot be written.
+    static bool create(const std::string& name, uint32_t page_size = PAGE_SIZE, bool compress_leaves = false);
+    static std::string path_for(const std::string& name) { return "data/" + name + ".tbs"; }
+
+    Tablespace() = default;
+    ~Tablespace();
+
+    Tablespace(const Tablespace&) = delete;
+    Tablespace& operator=(const Tablespace&) = delete;
+
+    // Attaches the file to bpm, whose page size must match the file's.
+    bool open(const std::string& name, BufferPoolManager& bpm);
+    // Writes back and detaches the file. Every table opened from it must
+    // have been closed first. False, with the file still open, if a page
+    // cannot be written back.
+    bool close();
+    bool is_open() const { return space_.bpm != nullptr; }
+
+    bool create_table(const std::string& table_name);
+    // Frees the table's pages and its directory entry. The table must not
+    // be open.
+    bool drop_table(const std::string& table_name);
+    // Fills in th for the table; close it with close_table() as usual.
+    bool open_table(const std::string& table_name, TableHandle& th);
+    bool has_table(const std::string& table_name);
+    std::vector<std::string> table_names();
+    // Records the table's new root; called through set_root_page(TableHandle&).
+    void set_root_page(const std::string& table_name, uint32_t root_page);
+
+    uint32_t get_page_size() const { return space_.dm ? space_.dm->get_page_size() : 0; }
+    bool is_compressed() const { return space_.dm && space_.dm->is_compressed(); }
+    const std::string& get_file_path() const { return space_.file_path; }
+    const std::shared_ptr<DiskManager>& get_disk_manager() const { return space_.dm; }
+
+private:
+    // Called with latch_ held. Finds the table's directory entry, returning
+    // the directory page holding it, or INVALID_PAGE_ID.
+    uint32_t find_entry(const std::string& table_name, uint32_t& root_page);
+    // Makes room for a record of record_bytes in a directory page by
+    // dropping the space of deleted entries, if that is enough.
+    static bool compact_directory_page(Page& page, uint16_t record_bytes);
+
+    TableHandle space_;  // the file; its root_page is the first directory page
+    std::mutex latch_;   // guards the directory
+};
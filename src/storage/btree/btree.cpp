@@ -8,39 +8,139 @@
 #include <cstring>
 #include <cassert>
 #include <vector>
+#include <deque>
+#include <algorithm>
 #include <climits>
+#include <unordered_set>
+
+// Adaptive read-ahead for a scan walking the leaf chain. Leaves split off
+// wherever the allocator puts them, so the next leaves are read from the
+// current leaf's parent instead of being assumed adjacent on disk. The window
+// doubles every time it is refilled and halves when the pool reports that
+// prefetched pages were evicted before anyone fetched them. On a mapped
+// table the leaves are requested from the OS with madvise instead, and the
+// window just grows.
+class LeafReadAhead {
+public:
+    explicit LeafReadAhead(TableHandle& th) : th_(th) {}
+
+    // Called with each leaf the scan reaches.
+    void advance(Page& leaf) {
+        if (!th_.mapping && !th_.bpm->is_read_ahead_enabled()) {
+            return;
+        }
+        PageHeader* ph = get_header(leaf);
+        auto reached = std::find(pending_.begin(), pending_.end(), ph->page_id);
+        if (reached != pending_.end()) {
+            pending_.erase(pending_.begin(), reached + 1);
+        }
+        if (pending_.size() > window_ / 2) {
+            return;
+        }
+        refill(ph->parent_page_id, pending_.empty() ? ph->page_id : pending_.back());
+    }
 
-extern uint32_t find_leaf_page(TableHandle& th, const Key& key, Page& out_page);
-extern uint32_t find_leftmost_leaf_page(TableHandle& th, Page& out_page);
-extern bool btree_insert_leaf_no_split(TableHandle& th, uint32_t page_id, Page& page, const Key& key, const Value& value);
-extern SplitLeafResult split_leaf_page(TableHandle& th, Page& page);
-extern void insert_into_parent(TableHandle& th, uint32_t left, const Key& key, uint32_t right);
-extern uint16_t write_raw_record(Page& page, const uint8_t* raw, uint16_t size);
+private:
+    void refill(uint32_t parent_page_id, uint32_t last_page_id) {
+        if (parent_page_id == 0 || parent_page_id == INVALID_PAGE_ID || parent_page_id == exhausted_parent_) {
+            return;
+        }
+        std::vector<uint32_t> page_ids;
+        if (Page* mapped = th_.mapping ? th_.mapping->page(parent_page_id) : nullptr) {
+            collect_children(*mapped, last_page_id, page_ids);
+        } else {
+            // The scan holds its leaf latch, and a writer splitting or
+            // merging leaves holds the parent while it waits for a leaf, so
+            // waiting on the parent here could deadlock. Skip the refill
+            // when the parent is busy; the next leaf retries.
+            Page* parent = th_.bpm->fetch_page(th_.file_id, parent_page_id);
+            if (parent == nullptr) {
+                return;
+            }
+            FrameLatch& latch = th_.bpm->frame_latch(parent);
+            if (!latch.try_lock_shared()) {
+                th_.bpm->unpin_page(parent, false);
+                return;
+            }
+            collect_children(*parent, last_page_id, page_ids);
+            latch.unlock_shared();
+            th_.bpm->unpin_page(parent, false);
+        }
+        if (page_ids.empty()) {
+            // Nothing left under this parent; the scan's next leaf starts
+            // the following one.
+            exhausted_parent_ = parent_page_id;
+            return;
+        }
+
+        if (th_.mapping) {
+            if (refilled_) {
+                window_ = std::min<size_t>(READ_AHEAD_MAX_PAGES, window_ * 2);
+            }
+            refilled_ = true;
+            pending_.insert(pending_.end(), page_ids.begin(), page_ids.end());
+            th_.mapping->will_need(page_ids);
+            return;
+        }
+
+        uint64_t unused = th_.bpm->get_stats().prefetch_unused;
+        if (refilled_) {
+            window_ = unused > unused_seen_
+                ? std::max<size_t>(READ_AHEAD_MIN_PAGES, window_ / 2)
+                : std::min<size_t>(READ_AHEAD_MAX_PAGES, window_ * 2);
+        }
+        unused_seen_ = unused;
+        refilled_ = true;
+
+        pending_.insert(pending_.end(), page_ids.begin(), page_ids.end());
+        th_.bpm->prefetch_pages(th_.file_id, std::move(page_ids));
+    }
+
+    // Children of parent that follow last_page_id, in key order: the
+    // leftmost, then one per entry.
+    void collect_children(Page& parent, uint32_t last_page_id, std::vector<uint32_t>& page_ids) const {
+        PageHeader* ph = get_header(parent);
+        if (ph->page_level != PageLevel::INTERNAL) {
+            return;
+        }
+        bool found = *reinterpret_cast<uint32_t*>(ph->reserved) == last_page_id;
+        for (uint16_t i = 0; i < ph->cell_count && pending_.size() + page_ids.size() < window_; i++) {
+            auto* entry = reinterpret_cast<InternalEntry*>(parent.data + *slot_ptr(parent, i));
+            if (found) {
+                page_ids.push_back(entry->child_page);
+            } else if (entry->child_page == last_page_id) {
+                found = true;
+            }
+        }
+    }
+
+    TableHandle& th_;
+    size_t window_ = READ_AHEAD_MIN_PAGES;
+    std::deque<uint32_t> pending_;  // requested leaves the scan has not reached, in chain order
+    uint64_t unused_seen_ = 0;
+    bool refilled_ = false;
+    uint32_t exhausted_parent_ = INVALID_PAGE_ID;
+};
 
 void btree_range_scan(TableHandle& th, const Key& start_key, const Key& end_key,
                      BTreeRangeScanCallback callback, void* ctx) {
     if (th.root_page == 0 || callback == nullptr) {
         return;
     }
-    Page page;
-    uint32_t page_id;
-    uint16_t start_index;
-    if (start_key.empty()) {
-        page_id = find_leftmost_leaf_page(th, page);
-        if (page_id == UINT32_MAX) {
-            return;
-        }
-        start_index = 0;
-    } else {
-        page_id = find_leaf_page(th, start_key, page);
-        if (page_id == UINT32_MAX) {
-            return;
-        }
-        BSearchResult sr = search_record(page, start_key.data(), start_key.size());
-        start_index = sr.index;
+    ReadPageGuard leaf = start_key.empty() ? find_leftmost_leaf_page(th) : find_leaf_page(th, start_key);
+    if (!leaf) {
+        return;
     }
-    PageHeader* ph = get_header(page);
+    uint16_t start_index = 0;
+    if (!start_key.empty()) {
+        start_index = search_record(leaf.page(), start_key.data(), start_key.size()).index;
+    }
+    LeafReadAhead read_ahead(th);
+
     while (true) {
+        Page& page = leaf.page();
+        read_ahead.advance(page);
+        PageHeader* ph = get_header(page);
         for (uint16_t i = start_index; i < ph->cell_count; i++) {
             uint16_t key_len = 0;
             const uint8_t* key_data = slot_key(page, i, key_len);
@@ -52,25 +152,18 @@ void btree_range_scan(TableHandle& th, const Key& start_key, const Key& end_key,
             if (!end_key.empty() && compare_keys(key_data, key_len, end_key.data(), end_key.size()) > 0) {
                 return;
             }
-            Key k(key_data, key_len);
-            Value v;
-            v.assign(value_data, value_len);
-            callback(k, v, ctx);
-        }
-        page_id = ph->next_page_id;
-        if (page_id == 0) {
-            return;
+            callback(Key(key_data, key_len), Value(value_data, value_len), ctx);
         }
-        if (!th.bpm) {
+        uint32_t next_page_id = ph->next_page_id;
+        if (next_page_id == 0) {
             return;
         }
-        Page* next = th.bpm->fetch_page(page_id);
-        if (!next) {
+        // Leaves past the first are touched once by this scan; let the
+        // replacer drop them before the internal pages lookups depend on.
+        leaf = read_page_guard(th, next_page_id, AccessType::SCAN);
+        if (!leaf) {
             return;
         }
-        std::memcpy(page.data, next->data, PAGE_SIZE);
-        th.bpm->unpin_page(page_id, false);
-        ph = get_header(page);
         start_index = 0;
     }
 }
@@ -80,19 +173,18 @@ bool btree_search(TableHandle& th, const Key& key, Value& value) {
         return false;
     }
 
-    Page leaf_page;
-    uint32_t leaf_page_id = find_leaf_page(th, key, leaf_page);
-    if (leaf_page_id == UINT32_MAX) {
+    ReadPageGuard leaf = find_leaf_page(th, key);
+    if (!leaf) {
         return false;
     }
     
-    BSearchResult result = search_record(leaf_page, key.data(), key.size());
+    BSearchResult result = search_record(leaf.page(), key.data(), key.size());
     if (!result.found) {
         return false;
     }
     
     uint16_t value_len;
-    const uint8_t* value_data = slot_value(leaf_page, result.index, value_len);
+    const uint8_t* value_data = slot_value(leaf.page(), result.index, value_len);
     if (value_data == nullptr || value_len == 0) {
         return false;
     }
@@ -101,6 +193,280 @@ bool btree_search(TableHandle& th, const Key& key, Value& value) {
     return true;
 }
 
+namespace {
+// Whether key lies below fence, an empty fence bounding nothing.
+bool below_fence(const Key& key, const Key& fence) {
+    return fence.empty() || compare_keys(key.data(), key.size(), fence.data(), fence.size()) < 0;
+}
+
+// An upper bound copied out of an internal page. The buffer is reused from
+// one lookup to the next, so a batch does not allocate per key.
+struct BatchFence {
+    std::vector<uint8_t> key;
+    bool bounded = false;
+
+    // The child of page k leads to, taking its fence from page, or from
+    // otherwise, page's own, when the child is the last.
+    uint32_t find_child(Page& page, const Key& k, const BatchFence& otherwise) {
+        uint32_t child = internal_find_child(page, k, key, bounded);
+        if (!bounded) {
+            key.assign(otherwise.key.begin(), otherwise.key.end());
+            bounded = otherwise.bounded;
+        }
+        return child;
+    }
+    bool above(const Key& k) const {
+        return !bounded || compare_keys(k.data(), k.size(), key.data(), static_cast<uint16_t>(key.size())) < 0;
+    }
+};
+
+// A page on the way down to a key, the page above it, and the separators
+// bounding each from above.
+struct BatchDescent {
+    ReadPageGuard parent;
+    BatchFence parent_fence;
+    ReadPageGuard page;
+    BatchFence fence;
+    BatchFence next_fence;
+    int depth = 0;  // of page, the root being 0
+
+    void release() {
+        page = ReadPageGuard();
+        parent = ReadPageGuard();
+    }
+};
+
+// Latch-couples down from the root towards key for at most max_depth
+// levels, stopping early at a leaf. False if a page could not be read.
+bool descend_for_batch(TableHandle& th, const Key& key, int max_depth, BatchDescent& d) {
+    d.release();
+    d.fence.bounded = false;
+    d.parent_fence.bounded = false;
+    d.depth = 0;
+    for (int attempt = 0; attempt < 100; attempt++) {
+        uint32_t root_page = th.root_page;
+        if (root_page == 0) {
+            return false;
+        }
+        d.page = read_page_guard(th, root_page);
+        if (!d.page || root_page == th.root_page) {
+            break;
+        }
+        d.page = ReadPageGuard();
+    }
+    while (d.page && d.depth < max_depth) {
+        PageHeader* ph = get_header(d.page.page());
+        if (ph->page_level == PageLevel::LEAF) {
+            return true;
+        }
+        if (ph->page_level != PageLevel::INTERNAL || d.depth > 100) {
+            return false;
+        }
+        uint32_t child = d.next_fence.find_child(d.page.page(), key, d.fence);
+        if (child == 0 || child == INVALID_PAGE_ID) {
+            return false;
+        }
+        ReadPageGuard next = read_page_guard(th, child);
+        if (!next) {
+            return false;
+        }
+        d.parent = std::move(d.page);
+        d.page = std::move(next);
+        std::swap(d.parent_fence, d.fence);
+        std::swap(d.fence, d.next_fence);
+        d.depth++;
+    }
+    return static_cast<bool>(d.page);
+}
+
+// Looks up keys[i] onwards in the latched leaf for as long as they fall
+// below its fence.
+size_t get_from_leaf(Page& leaf, const BatchFence& fence, const std::vector<Key>& keys, size_t& i,
+                     BTreeGetBatchCallback callback, void* ctx) {
+    size_t found = 0;
+    for (; i < keys.size() && fence.above(keys[i]); i++) {
+        BSearchResult result = search_record(leaf, keys[i].data(), keys[i].size());
+        if (!result.found) {
+            continue;
+        }
+        uint16_t value_len = 0;
+        const uint8_t* value_data = slot_value(leaf, result.index, value_len);
+        if (value_data == nullptr || value_len == 0) {
+            continue;
+        }
+        callback(i, Value(value_data, value_len), ctx);
+        found++;
+    }
+    return found;
+}
+
+// Asks the pool to read in every leaf keys[i] onwards lead to, reading
+// only the pages one level above them, which sit at leaf_depth - 1.
+void prefetch_batch_leaves(TableHandle& th, const std::vector<Key>& keys, size_t i, int leaf_depth, BatchDescent& d) {
+    if (leaf_depth == 0 || !th.bpm->is_read_ahead_enabled()) {
+        return;
+    }
+    std::vector<uint32_t> page_ids;
+    while (i < keys.size()) {
+        if (!descend_for_batch(th, keys[i], leaf_depth - 1, d) ||
+            get_header(d.page.page())->page_level != PageLevel::INTERNAL) {
+            break;
+        }
+        for (; i < keys.size() && d.fence.above(keys[i]); i++) {
+            uint32_t child = internal_find_child(d.page.page(), keys[i]);
+            if (child != 0 && child != INVALID_PAGE_ID && (page_ids.empty() || page_ids.back() != child)) {
+                page_ids.push_back(child);
+            }
+        }
+    }
+    d.release();
+    th.bpm->prefetch_pages(th.file_id, std::move(page_ids));
+}
+}
+
+size_t btree_get_batch(TableHandle& th, const std::vector<Key>& keys, BTreeGetBatchCallback callback, void* ctx) {
+    if (!th.bpm || callback == nullptr || keys.empty()) {
+        return 0;
+    }
+    size_t found = 0;
+    size_t i = 0;
+    // The first descent finds how deep the leaves are. If it had to go to
+    // disk, the rest of the batch's leaves are requested before any is
+    // read; when it did not, they are most likely cached too, and a second
+    // walk of the upper levels would only add to the batch's latency.
+    uint64_t misses = th.mapping ? 0 : th.bpm->get_stats().misses;
+    BatchDescent d;
+    if (!descend_for_batch(th, keys[0], INT_MAX, d)) {
+        return 0;
+    }
+    int leaf_depth = d.depth;
+    found += get_from_leaf(d.page.page(), d.fence, keys, i, callback, ctx);
+    d.release();
+    if (!th.mapping && th.bpm->get_stats().misses > misses) {
+        prefetch_batch_leaves(th, keys, i, leaf_depth, d);
+    }
+
+    while (i < keys.size()) {
+        if (!descend_for_batch(th, keys[i], INT_MAX, d)) {
+            return found;
+        }
+        found += get_from_leaf(d.page.page(), d.fence, keys, i, callback, ctx);
+        // Leaves under the same parent are reached from it directly.
+        while (d.parent && i < keys.size() && d.parent_fence.above(keys[i])) {
+            uint32_t child = d.fence.find_child(d.parent.page(), keys[i], d.parent_fence);
+            if (child == 0 || child == INVALID_PAGE_ID) {
+                return found;
+            }
+            d.page = read_page_guard(th, child);
+            if (!d.page || get_header(d.page.page())->page_level != PageLevel::LEAF) {
+                break;
+            }
+            found += get_from_leaf(d.page.page(), d.fence, keys, i, callback, ctx);
+        }
+        d.release();
+    }
+    return found;
+}
+
+// Puts the row in its leaf by splitting it. A split changes the pages above
+// the leaf as well, and readers latch parents before children, so the
+// caller lets go of the leaf first, untouched, and the path down to it is
+// latched again from the root. The path and the new leaf stay latched
+// until the split is linked in all the way up.
+static bool insert_with_split(TableHandle& th, const Key& key, const Value& value) {
+    std::vector<WritePageGuard> path;
+    if (!find_path_for_write(th, key, path)) {
+        return false;
+    }
+    WritePageGuard& leaf = path.back();
+    BSearchResult found = search_record(leaf.page(), key.data(), key.size());
+    if (get_header(leaf.page())->cell_count < (found.found ? 3 : 2)) {
+        return false;
+    }
+    // Kept so that the split can be taken back if the pages above cannot
+    // take the new leaf.
+    Page before;
+    copy_page(before, leaf.page());
+    SplitLeafResult split_result = split_leaf_page(th, leaf.page());
+    if (split_result.new_page == 0) {
+        return false;
+    }
+    leaf.mark_dirty();
+
+    const Key& sep_key = split_result.seperator_key;
+    std::vector<MovedChild> moved;
+    if (!insert_into_parent(th, path, path.size() - 1, sep_key, split_result.sibling, moved)) {
+        copy_page(leaf.page(), before);
+        uint32_t next_page_id = get_header(before)->next_page_id;
+        if (next_page_id != 0) {
+            WritePageGuard next(*th.bpm, th.file_id, next_page_id);
+            if (next) {
+                get_header(next.page())->prev_page_id = leaf.page_id();
+                next.mark_dirty();
+            }
+        }
+        split_result.sibling.release();
+        free_page(th, split_result.new_page);
+        th.btree_stats.leaf_splits--;
+        return false;
+    }
+
+    bool goes_left = compare_keys(key.data(), key.size(), sep_key.data(), sep_key.size()) < 0;
+    Page& half = goes_left ? leaf.page() : split_result.sibling.page();
+    if (found.found) {
+        page_delete(half, key.data(), key.size());
+    }
+    uint16_t rec_size = record_size(key.size(), value.size());
+    bool inserted = make_room_without_split(th, half, rec_size) && btree_insert_leaf_no_split(half, key, value);
+    assert(inserted && "Half doesn't have space after split");
+
+    path.clear();
+    split_result.sibling.release();
+    set_moved_parents(th, moved);
+    return inserted;
+}
+
+// Makes value key's value in the latched leaf, where search_record found
+// the key or the place it belongs: replaced in place when the new value is
+// no longer, else moved within the page. A full page is compacted if that
+// makes room, and split only if the live records fill it. A record too
+// large for any page, or a full leaf too small to split around it, fails
+// with the leaf untouched.
+static bool put_in_leaf(TableHandle& th, WritePageGuard& leaf, BSearchResult found, const Key& key, const Value& value) {
+    Page& page = leaf.page();
+    uint32_t rec_size = sizeof(RecordHeader) + key.size() + value.size();
+    if (sizeof(PageHeader) + rec_size + sizeof(uint16_t) > page_size(page)) {
+        return false;
+    }
+    uint16_t live_records = get_header(page)->cell_count;
+    if (found.found) {
+        if (page_update(page, found.index, value.data(), value.size())) {
+            leaf.mark_dirty();
+            return true;
+        }
+        // Out of room to move the record. It is moved on a copy, so that a
+        // leaf that has to split is still untouched when it is let go.
+        Page moved;
+        copy_page(moved, page);
+        page_delete(moved, key.data(), key.size());
+        if (make_room_without_split(th, moved, static_cast<uint16_t>(rec_size)) &&
+            btree_insert_leaf_no_split(moved, key, value)) {
+            copy_page(page, moved);
+            leaf.mark_dirty();
+            return true;
+        }
+        live_records--;
+    } else if (make_room_without_split(th, page, static_cast<uint16_t>(rec_size)) && btree_insert_leaf_no_split(page, key, value)) {
+        leaf.mark_dirty();
+        return true;
+    }
+    if (live_records < 2) {
+        return false;
+    }
+    leaf.release();
+    return insert_with_split(th, key, value);
+}
+
 bool btree_insert(TableHandle& th, const Key& key, const Value& value) {
     if (!th.bpm) {
         return false;
@@ -110,82 +476,123 @@ bool btree_insert(TableHandle& th, const Key& key, const Value& value) {
         if (root_page_id == INVALID_PAGE_ID) {
             return false;
         }
-        Page* root = th.bpm->new_page(root_page_id, PageType::DATA, PageLevel::LEAF);
+        WritePageGuard root = WritePageGuard::create(*th.bpm, th.file_id, root_page_id, PageType::DATA, PageLevel::LEAF);
         if (!root) {
             return false;
         }
-        th.root_page = root_page_id;
-
-        Page* meta = th.bpm->fetch_page(0);
-        if (meta) {
-            get_header(*meta)->root_page = root_page_id;
-            th.bpm->unpin_page(0, true);
-        }
+        set_root_page(th, root_page_id);
 
-        page_insert(*root, key.data(), key.size(), value.data(), value.size());
-        th.bpm->unpin_page(root_page_id, true);
+        page_insert(root.page(), key.data(), key.size(), value.data(), value.size());
         return true;
     }
 
-    Page leaf_page;
-    uint32_t leaf_page_id = find_leaf_page(th, key, leaf_page);
+    WritePageGuard leaf = find_leaf_page_for_write(th, key);
+    if (!leaf) {
+        return false;
+    }
 
-    BSearchResult search_result = search_record(leaf_page, key.data(), key.size());
+    BSearchResult search_result = search_record(leaf.page(), key.data(), key.size());
     if (search_result.found) {
         return false;
     }
+    return put_in_leaf(th, leaf, search_result, key, value);
+}
 
-    if (btree_insert_leaf_no_split(th, leaf_page_id, leaf_page, key, value)) {
-        return true;
-    }
+namespace {
+// An internal page on the path to the last leaf a batch wrote, and the
+// separator bounding its keys from above (empty if none does).
+struct BatchPathStep {
+    uint32_t page_id;
+    Key fence;
+};
 
-    Page* leaf_bp = th.bpm->fetch_page(leaf_page_id);
-    if (!leaf_bp) {
-        return false;
-    }
-    std::memcpy(leaf_page.data, leaf_bp->data, PAGE_SIZE);
-    th.bpm->unpin_page(leaf_page_id, false);
+}
 
-    SplitLeafResult split_result = split_leaf_page(th, leaf_page);
-    
-    Key sep_key;
-    sep_key.assign(split_result.seperator_key.data(), split_result.seperator_key.size());
-    
-    int cmp = compare_keys(key.data(), key.size(), sep_key.data(), sep_key.size());
-    
-    if (cmp < 0) {
-        if (!can_insert(split_result.left_page, record_size(key.size(), value.size()))) {
-            assert(false && "Left page doesn't have space after split");
-            return false;
+size_t btree_insert_batch(TableHandle& th, const std::vector<std::pair<Key, Value>>& rows) {
+    if (!th.bpm) {
+        return 0;
+    }
+    // Only this writer changes internal pages, so the path stays valid
+    // until it splits something.
+    std::vector<BatchPathStep> path;
+    size_t inserted = 0;
+    size_t i = 0;
+    while (i < rows.size()) {
+        if (th.root_page == 0) {
+            inserted += btree_insert(th, rows[i].first, rows[i].second) ? 1 : 0;
+            i++;
+            continue;
         }
-        if (!page_insert(split_result.left_page, key.data(), key.size(), value.data(), value.size())) {
-            assert(false && "page_insert failed for left page");
-            return false;
+
+        const Key& first = rows[i].first;
+        while (!path.empty() && !below_fence(first, path.back().fence)) {
+            path.pop_back();
         }
-        Page* left_bp = th.bpm->fetch_page(leaf_page_id);
-        if (left_bp) {
-            std::memcpy(left_bp->data, split_result.left_page.data, PAGE_SIZE);
-            th.bpm->unpin_page(leaf_page_id, true);
+        uint32_t page_id = th.root_page;
+        Key fence;
+        std::vector<uint8_t> fence_buf;
+        bool bounded = false;
+        if (!path.empty()) {
+            WritePageGuard parent(*th.bpm, th.file_id, path.back().page_id);
+            if (!parent) {
+                return inserted;
+            }
+            page_id = internal_find_child(parent.page(), first, fence_buf, bounded);
+            fence = bounded ? Key::owned(fence_buf.data(), static_cast<uint16_t>(fence_buf.size())) : path.back().fence;
         }
-    } else {
-        if (!can_insert(split_result.right_page, record_size(key.size(), value.size()))) {
-            assert(false && "Right page doesn't have space after split");
-            return false;
+        WritePageGuard leaf;
+        while (true) {
+            if (page_id == 0 || page_id == INVALID_PAGE_ID || path.size() > 100) {
+                return inserted;
+            }
+            leaf = WritePageGuard(*th.bpm, th.file_id, page_id);
+            if (!leaf) {
+                return inserted;
+            }
+            PageHeader* ph = get_header(leaf.page());
+            if (ph->page_level == PageLevel::LEAF) {
+                break;
+            }
+            if (ph->page_level != PageLevel::INTERNAL) {
+                return inserted;
+            }
+            path.push_back({page_id, fence});
+            page_id = internal_find_child(leaf.page(), first, fence_buf, bounded);
+            if (bounded) {
+                fence = Key::owned(fence_buf.data(), static_cast<uint16_t>(fence_buf.size()));
+            }
         }
-        if (!page_insert(split_result.right_page, key.data(), key.size(), value.data(), value.size())) {
-            assert(false && "page_insert failed for right page");
-            return false;
+
+        // Every row below the fence belongs in this leaf.
+        while (i < rows.size() && below_fence(rows[i].first, fence)) {
+            const Key& key = rows[i].first;
+            uint16_t rec_size = record_size(key.size(), rows[i].second.size());
+            if (search_record(leaf.page(), key.data(), key.size()).found ||
+                sizeof(PageHeader) + rec_size + sizeof(uint16_t) > page_size(leaf.page())) {
+                i++;
+                continue;
+            }
+            if (!make_room_without_split(th, leaf.page(), rec_size) ||
+                !btree_insert_leaf_no_split(leaf.page(), key, rows[i].second)) {
+                break;
+            }
+            leaf.mark_dirty();
+            inserted++;
+            i++;
         }
-        Page* right_bp = th.bpm->fetch_page(split_result.new_page);
-        if (right_bp) {
-            std::memcpy(right_bp->data, split_result.right_page.data, PAGE_SIZE);
-            th.bpm->unpin_page(split_result.new_page, true);
+        if (i == rows.size() || !below_fence(rows[i].first, fence)) {
+            continue;
         }
+
+        // The leaf is full: the row goes in through the single-row path,
+        // which splits it, and the next pass picks whichever half the
+        // remaining rows belong in.
+        path.clear();
+        leaf.release();
+        inserted += btree_insert(th, rows[i].first, rows[i].second) ? 1 : 0;
+        i++;
     }
-    
-    insert_into_parent(th, leaf_page_id, sep_key, split_result.new_page);
-    
-    return true;
+    return inserted;
 }
 
 struct SiblingInfo {
@@ -197,25 +604,11 @@ struct SiblingInfo {
     bool is_rightmost;
 };
 
-SiblingInfo find_leaf_siblings(TableHandle& th, uint32_t leaf_page_id, Page& leaf_page) {
+// The siblings of leaf_page_id under parent, which the caller holds latched.
+SiblingInfo find_leaf_siblings(Page& parent, uint32_t leaf_page_id) {
     SiblingInfo info = {0, 0, Key(), Key(), false, false};
 
-    PageHeader* ph = get_header(leaf_page);
-    if (ph->parent_page_id == 0) {
-        info.is_leftmost = true;
-        info.is_rightmost = true;
-        return info;
-    }
-
-    if (!th.bpm) {
-        return info;
-    }
-    Page* parent = th.bpm->fetch_page(ph->parent_page_id);
-    if (!parent) {
-        return info;
-    }
-    PageHeader* parent_ph = get_header(*parent);
-    
+    PageHeader* parent_ph = get_header(parent);
     if (parent_ph->page_level != PageLevel::INTERNAL) {
         return info;
     }
@@ -224,112 +617,78 @@ SiblingInfo find_leaf_siblings(TableHandle& th, uint32_t leaf_page_id, Page& lea
     if (leftmost == leaf_page_id) {
         info.is_leftmost = true;
         if (parent_ph->cell_count > 0) {
-            uint16_t entry_offset = *slot_ptr(*parent, 0);
-            InternalEntry* entry = reinterpret_cast<InternalEntry*>(parent->data + entry_offset);
+            uint16_t entry_offset = *slot_ptr(parent, 0);
+            InternalEntry* entry = reinterpret_cast<InternalEntry*>(parent.data + entry_offset);
             info.right_sibling = entry->child_page;
             
-            uint16_t sep_len = entry->key_size;
-            if (sep_len > 256) {
-                assert(false && "Key too large");
-                return info;
-            }
             // For leftmost page, entry[0]'s key IS the right separator
-            info.right_separator_key.assign(entry->key, sep_len);
+            info.right_separator_key = internal_entry_key(parent, 0);
         }
-        th.bpm->unpin_page(ph->parent_page_id, false);
         return info;
     }
 
     for (uint16_t i = 0; i < parent_ph->cell_count; i++) {
-        uint16_t entry_offset = *slot_ptr(*parent, i);
-        InternalEntry* entry = reinterpret_cast<InternalEntry*>(parent->data + entry_offset);
+        uint16_t entry_offset = *slot_ptr(parent, i);
+        InternalEntry* entry = reinterpret_cast<InternalEntry*>(parent.data + entry_offset);
 
         if (entry->child_page == leaf_page_id) {
             if (i == 0) {
                 info.left_sibling = leftmost;
             } else {
-                uint16_t prev_offset = *slot_ptr(*parent, i - 1);
-                InternalEntry* prev_entry = reinterpret_cast<InternalEntry*>(parent->data + prev_offset);
+                uint16_t prev_offset = *slot_ptr(parent, i - 1);
+                InternalEntry* prev_entry = reinterpret_cast<InternalEntry*>(parent.data + prev_offset);
                 info.left_sibling = prev_entry->child_page;
             }
             
             if (i + 1 < parent_ph->cell_count) {
-                uint16_t next_offset = *slot_ptr(*parent, i + 1);
-                InternalEntry* next_entry = reinterpret_cast<InternalEntry*>(parent->data + next_offset);
+                uint16_t next_offset = *slot_ptr(parent, i + 1);
+                InternalEntry* next_entry = reinterpret_cast<InternalEntry*>(parent.data + next_offset);
                 info.right_sibling = next_entry->child_page;
                 // Right separator is the key of entry[i+1]
-                info.right_separator_key.assign(next_entry->key, next_entry->key_size);
+                info.right_separator_key = internal_entry_key(parent, i + 1);
             } else {
                 info.is_rightmost = true;
             }
             
             // Current page's separator key (for merging with left)
-            uint16_t sep_len = entry->key_size;
-            if (sep_len > 256) {
-                assert(false && "Key too large");
-                return info;
-            }
-            info.separator_key.assign(entry->key, sep_len);
-
-            th.bpm->unpin_page(ph->parent_page_id, false);
+            info.separator_key = internal_entry_key(parent, i);
             return info;
         }
     }
 
-    th.bpm->unpin_page(ph->parent_page_id, false);
     assert(false && "Leaf page not found in parent");
     return info;
 }
 
-static int16_t find_internal_entry_index(Page& parent, const Key& key_to_remove) {
-    PageHeader* ph = get_header(parent);
-    for (uint16_t i = 0; i < ph->cell_count; i++) {
-        uint16_t offset = *slot_ptr(parent, i);
-        InternalEntry* entry = reinterpret_cast<InternalEntry*>(parent.data + offset);
-        const uint8_t* entry_key = parent.data + offset + sizeof(InternalEntry);
-        if (entry->key_size == key_to_remove.size() &&
-            memcmp(entry_key, key_to_remove.data(), key_to_remove.size()) == 0) {
-            return static_cast<int16_t>(i);
-        }
-    }
-    return -1;
-}
-
-void remove_from_internal(TableHandle& th, uint32_t parent_id, const Key& key_to_remove, uint32_t deleted_child_page) {
-    if (!th.bpm) {
-        return;
-    }
-    Page* parent = th.bpm->fetch_page(parent_id);
-    if (!parent) {
-        return;
-    }
-    PageHeader* ph = get_header(*parent);
-
+// Removes deleted_child_page's entry from the latched parent.
+void remove_from_internal(WritePageGuard& parent, const Key& key_to_remove, uint32_t deleted_child_page) {
+    Page& page = parent.page();
+    PageHeader* ph = get_header(page);
     if (ph->page_level != PageLevel::INTERNAL) {
-        th.bpm->unpin_page(parent_id, false);
         return;
     }
 
     uint32_t* leftmost_ptr = reinterpret_cast<uint32_t*>(ph->reserved);
     if (deleted_child_page != 0 && *leftmost_ptr == deleted_child_page) {
         if (ph->cell_count > 0) {
-            uint16_t first_offset = *slot_ptr(*parent, 0);
-            InternalEntry* first_entry = reinterpret_cast<InternalEntry*>(parent->data + first_offset);
+            uint16_t first_offset = *slot_ptr(page, 0);
+            InternalEntry* first_entry = reinterpret_cast<InternalEntry*>(page.data + first_offset);
             *leftmost_ptr = first_entry->child_page;
-            remove_slot(*parent, 0);
+            remove_slot(page, 0);
+            ph->fragmented_bytes += sizeof(InternalEntry) + first_entry->key_size;
         } else {
             *leftmost_ptr = 0;
         }
-        th.bpm->unpin_page(parent_id, true);
+        parent.mark_dirty();
         return;
     }
 
-    int16_t idx = find_internal_entry_index(*parent, key_to_remove);
+    int idx = internal_entry_index(page, key_to_remove);
     if (idx >= 0) {
-        remove_slot(*parent, static_cast<uint16_t>(idx));
-        th.bpm->unpin_page(parent_id, true);
-    } else {
-        th.bpm->unpin_page(parent_id, false);
+        auto* entry = reinterpret_cast<InternalEntry*>(page.data + *slot_ptr(page, static_cast<uint16_t>(idx)));
+        ph->fragmented_bytes += sizeof(InternalEntry) + entry->key_size;
+        remove_slot(page, static_cast<uint16_t>(idx));
+        parent.mark_dirty();
     }
 }
 
@@ -351,8 +710,8 @@ static bool is_page_underutilized(Page& page) {
     
     uint16_t slots_space = ph->cell_count * sizeof(uint16_t);
     uint16_t total_used = actual_records_size + slots_space;
-    uint16_t available_space = PAGE_SIZE - sizeof(PageHeader);
-    uint16_t utilization_percent = (total_used * 100) / available_space;
+    uint32_t available_space = page_size(page) - sizeof(PageHeader);
+    uint32_t utilization_percent = (total_used * 100) / available_space;
     
     return utilization_percent < MERGE_THRESHOLD_PERCENT;
 }
@@ -374,41 +733,24 @@ static bool can_merge_pages(Page& left_page, Page& right_page) {
     PageHeader* left_ph = get_header(left_page);
     PageHeader* right_ph = get_header(right_page);
     
-    uint16_t left_records_size = calculate_total_records_size(left_page);
-    uint16_t right_records_size = calculate_total_records_size(right_page);
-    uint16_t total_records_size = left_records_size + right_records_size;
+    uint32_t left_records_size = calculate_total_records_size(left_page);
+    uint32_t right_records_size = calculate_total_records_size(right_page);
+    uint32_t total_records_size = left_records_size + right_records_size;
     
-    uint16_t total_slots = left_ph->cell_count + right_ph->cell_count;
-    uint16_t slots_space = total_slots * sizeof(uint16_t);
+    uint32_t total_slots = left_ph->cell_count + right_ph->cell_count;
+    uint32_t slots_space = total_slots * sizeof(uint16_t);
     
-    uint16_t total_needed = sizeof(PageHeader) + total_records_size + slots_space;
-    return total_needed <= PAGE_SIZE;
-}
-
-static void update_leaf_links_on_free(TableHandle& th, uint32_t freed_page_id, Page& freed_page) {
-    (void)freed_page_id;
-    if (!th.bpm) {
-        return;
-    }
-    PageHeader* ph = get_header(freed_page);
-    if (ph->prev_page_id != 0) {
-        Page* prev_page = th.bpm->fetch_page(ph->prev_page_id);
-        if (prev_page) {
-            get_header(*prev_page)->next_page_id = ph->next_page_id;
-            th.bpm->unpin_page(ph->prev_page_id, true);
-        }
-    }
-    if (ph->next_page_id != 0) {
-        Page* next_page = th.bpm->fetch_page(ph->next_page_id);
-        if (next_page) {
-            get_header(*next_page)->prev_page_id = ph->prev_page_id;
-            th.bpm->unpin_page(ph->next_page_id, true);
-        }
-    }
+    uint32_t total_needed = sizeof(PageHeader) + total_records_size + slots_space;
+    return total_needed <= page_size(left_page);
 }
 
-static void merge_leaf_pages(TableHandle& th, uint32_t left_page_id, Page& left_page, 
-                             uint32_t right_page_id, Page& right_page) {
+// Moves right's records onto the end of left and takes right out of the
+// leaf chain; the caller frees it once it has let go of its latch. right's
+// successor is latched after both, in chain order, as a scan moves.
+static void merge_leaf_pages(TableHandle& th, WritePageGuard& left, WritePageGuard& right) {
+    Page& left_page = left.page();
+    Page& right_page = right.page();
+    uint32_t left_page_id = left.page_id();
     PageHeader* left_ph = get_header(left_page);
     PageHeader* right_ph = get_header(right_page);
     uint32_t saved_prev = left_ph->prev_page_id;
@@ -442,16 +784,16 @@ static void merge_leaf_pages(TableHandle& th, uint32_t left_page_id, Page& left_
     
     // Reinitialize left page (compacts it, removes holes)
     uint32_t parent_id = left_ph->parent_page_id;
-    init_page(left_page, left_page_id, PageType::DATA, PageLevel::LEAF);
+    init_page(left_page, left_page_id, PageType::DATA, PageLevel::LEAF, page_size(left_page));
     left_ph = get_header(left_page);
     left_ph->parent_page_id = parent_id;
     left_ph->prev_page_id = saved_prev;
     left_ph->next_page_id = right_next;
-    if (right_next != 0 && th.bpm) {
-        Page* next_page = th.bpm->fetch_page(right_next);
-        if (next_page) {
-            get_header(*next_page)->prev_page_id = left_page_id;
-            th.bpm->unpin_page(right_next, true);
+    if (right_next != 0) {
+        WritePageGuard next(*th.bpm, th.file_id, right_next);
+        if (next) {
+            get_header(next.page())->prev_page_id = left_page_id;
+            next.mark_dirty();
         }
     }
 
@@ -462,146 +804,194 @@ static void merge_leaf_pages(TableHandle& th, uint32_t left_page_id, Page& left_
         left_ph = get_header(left_page);
         insert_slot(left_page, left_ph->cell_count, new_offset);
     }
-    
-    if (th.bpm) {
-        Page* left_bp = th.bpm->fetch_page(left_page_id);
-        if (left_bp) {
-            std::memcpy(left_bp->data, left_page.data, PAGE_SIZE);
-            th.bpm->unpin_page(left_page_id, true);
+    left.mark_dirty();
+}
+
+// Merges the underfilled leaf key is in with a sibling under the same
+// parent, left first. The path from the root stays latched throughout; the
+// leaf is let go and latched again after its left sibling, so that leaves
+// are latched in chain order as a scan latches them. A parent's only leaf
+// stays even when empty: the parent would be left with no child to
+// descend to.
+static void merge_leaf(TableHandle& th, const Key& key) {
+    std::vector<WritePageGuard> path;
+    if (!find_path_for_write(th, key, path) || path.size() < 2 || !is_page_underutilized(path.back().page())) {
+        return;
+    }
+    WritePageGuard& parent = path[path.size() - 2];
+    uint32_t leaf_page_id = path.back().page_id();
+    SiblingInfo siblings = find_leaf_siblings(parent.page(), leaf_page_id);
+    path.pop_back();
+
+    WritePageGuard left;
+    if (siblings.left_sibling != 0) {
+        left = WritePageGuard(*th.bpm, th.file_id, siblings.left_sibling);
+    }
+    WritePageGuard leaf(*th.bpm, th.file_id, leaf_page_id);
+    if (!leaf) {
+        return;
+    }
+
+    if (left && can_merge_pages(left.page(), leaf.page())) {
+        merge_leaf_pages(th, left, leaf);
+        remove_from_internal(parent, siblings.separator_key, leaf_page_id);
+        leaf.release();
+        free_page(th, leaf_page_id);
+        return;
+    }
+    if (siblings.right_sibling != 0) {
+        WritePageGuard right(*th.bpm, th.file_id, siblings.right_sibling);
+        if (right && can_merge_pages(leaf.page(), right.page())) {
+            merge_leaf_pages(th, leaf, right);
+            remove_from_internal(parent, siblings.right_separator_key, siblings.right_sibling);
+            right.release();
+            free_page(th, siblings.right_sibling);
         }
     }
-    free_page(th, right_page_id);
 }
 
 bool btree_delete(TableHandle& th, const Key& key) {
-    if (th.root_page == 0) {
+    if (!th.bpm || th.root_page == 0) {
         return false;
     }
-    
-    Page leaf_page;
-    uint32_t leaf_page_id = find_leaf_page(th, key, leaf_page);
-    
-    if (leaf_page_id == UINT32_MAX) {
+
+    // Most deletes leave the leaf well filled and change nothing else.
+    bool merge = false;
+    {
+        WritePageGuard leaf = find_leaf_page_for_write(th, key);
+        if (!leaf || !page_delete(leaf.page(), key.data(), key.size())) {
+            return false;
+        }
+        leaf.mark_dirty();
+        PageHeader* ph = get_header(leaf.page());
+        if (ph->parent_page_id == 0) {
+            if (ph->cell_count == 0) {
+                // Readers that latched the root before see it no longer is.
+                uint32_t leaf_page_id = leaf.page_id();
+                set_root_page(th, 0);
+                leaf.release();
+                free_page(th, leaf_page_id);
+            }
+            return true;
+        }
+        merge = is_page_underutilized(leaf.page());
+    }
+    if (merge) {
+        merge_leaf(th, key);
+    }
+    return true;
+}
+
+bool btree_update(TableHandle& th, const Key& key, const Value& value) {
+    if (!th.bpm || th.root_page == 0) {
         return false;
     }
-    
-    BSearchResult result = search_record(leaf_page, key.data(), key.size());
-    if (!result.found) {
+    WritePageGuard leaf = find_leaf_page_for_write(th, key);
+    if (!leaf) {
         return false;
     }
-    
-    if (!th.bpm) {
+    BSearchResult found = search_record(leaf.page(), key.data(), key.size());
+    if (!found.found) {
         return false;
     }
-    Page* leaf_bp = th.bpm->fetch_page(leaf_page_id);
-    if (!leaf_bp) {
+    return put_in_leaf(th, leaf, found, key, value);
+}
+
+bool btree_upsert(TableHandle& th, const Key& key, const Value& value) {
+    if (!th.bpm) {
         return false;
     }
-    bool deleted = page_delete(*leaf_bp, key.data(), key.size());
-    if (!deleted) {
-        th.bpm->unpin_page(leaf_page_id, false);
+    if (th.root_page == 0) {
+        return btree_insert(th, key, value);
+    }
+    WritePageGuard leaf = find_leaf_page_for_write(th, key);
+    if (!leaf) {
         return false;
     }
-    th.bpm->unpin_page(leaf_page_id, true);
+    BSearchResult found = search_record(leaf.page(), key.data(), key.size());
+    return put_in_leaf(th, leaf, found, key, value);
+}
 
-    leaf_bp = th.bpm->fetch_page(leaf_page_id);
-    if (!leaf_bp) {
+bool btree_merge(TableHandle& th, const Key& key, const Value& operand, BTreeMergeOperator merge, void* ctx) {
+    if (!th.bpm || merge == nullptr) {
         return false;
     }
-    std::memcpy(leaf_page.data, leaf_bp->data, PAGE_SIZE);
-    PageHeader* ph = get_header(leaf_page);
-    th.bpm->unpin_page(leaf_page_id, false);
-
-    if (ph->parent_page_id == 0) {
-        if (ph->cell_count == 0) {
-            th.root_page = 0;
-            Page* meta = th.bpm->fetch_page(0);
-            if (meta) {
-                get_header(*meta)->root_page = 0;
-                th.bpm->unpin_page(0, true);
-            }
-            update_leaf_links_on_free(th, leaf_page_id, leaf_page);
-            free_page(th, leaf_page_id);
+    std::vector<uint8_t> merged;
+    if (th.root_page == 0) {
+        if (!merge(nullptr, operand, merged, ctx) || merged.size() > UINT16_MAX) {
+            return false;
         }
-        return true;
+        return btree_insert(th, key, Value(merged.data(), static_cast<uint16_t>(merged.size())));
     }
+    WritePageGuard leaf = find_leaf_page_for_write(th, key);
+    if (!leaf) {
+        return false;
+    }
+    Page& page = leaf.page();
+    BSearchResult found = search_record(page, key.data(), key.size());
+    bool ok;
+    if (found.found) {
+        // Read through the record header: slot_value rejects empty values.
+        const RecordHeader* rh = reinterpret_cast<const RecordHeader*>(page.data + *slot_ptr(page, found.index));
+        Value existing(reinterpret_cast<const uint8_t*>(rh + 1) + rh->key_size, rh->value_size);
+        ok = merge(&existing, operand, merged, ctx);
+    } else {
+        ok = merge(nullptr, operand, merged, ctx);
+    }
+    if (!ok || merged.size() > UINT16_MAX) {
+        return false;
+    }
+    return put_in_leaf(th, leaf, found, key, Value(merged.data(), static_cast<uint16_t>(merged.size())));
+}
 
-    if (is_page_underutilized(leaf_page)) {
-        SiblingInfo siblings = find_leaf_siblings(th, leaf_page_id, leaf_page);
-        uint32_t parent_id = ph->parent_page_id;
-
-        if (siblings.left_sibling != 0) {
-            Page* left_sibling = th.bpm->fetch_page(siblings.left_sibling);
-            if (left_sibling && can_merge_pages(*left_sibling, leaf_page)) {
-                merge_leaf_pages(th, siblings.left_sibling, *left_sibling, leaf_page_id, leaf_page);
-                th.bpm->unpin_page(siblings.left_sibling, false);
-                remove_from_internal(th, parent_id, siblings.separator_key, leaf_page_id);
-                return true;
-            }
-            if (left_sibling) {
-                th.bpm->unpin_page(siblings.left_sibling, false);
-            }
+void btree_destroy(TableHandle& th) {
+    if (!th.bpm || th.root_page == 0) {
+        return;
+    }
+    std::vector<uint32_t> pending{th.root_page};
+    std::unordered_set<uint32_t> freed;
+    while (!pending.empty()) {
+        uint32_t page_id = pending.back();
+        pending.pop_back();
+        if (page_id == 0 || page_id == INVALID_PAGE_ID || !freed.insert(page_id).second) {
+            continue;
         }
-        if (siblings.right_sibling != 0) {
-            Page* right_sibling = th.bpm->fetch_page(siblings.right_sibling);
-            if (right_sibling && can_merge_pages(leaf_page, *right_sibling)) {
-                merge_leaf_pages(th, leaf_page_id, leaf_page, siblings.right_sibling, *right_sibling);
-                th.bpm->unpin_page(siblings.right_sibling, false);
-                remove_from_internal(th, parent_id, siblings.right_separator_key, siblings.right_sibling);
-                leaf_bp = th.bpm->fetch_page(leaf_page_id);
-                if (leaf_bp) {
-                    std::memcpy(leaf_page.data, leaf_bp->data, PAGE_SIZE);
-                    th.bpm->unpin_page(leaf_page_id, false);
-                    ph = get_header(leaf_page);
+        {
+            ReadPageGuard guard(*th.bpm, th.file_id, page_id);
+            if (!guard) {
+                continue;
+            }
+            PageHeader* ph = get_header(guard.page());
+            if (ph->page_level == PageLevel::INTERNAL) {
+                pending.push_back(*reinterpret_cast<uint32_t*>(ph->reserved));
+                for (uint16_t i = 0; i < ph->cell_count; i++) {
+                    auto* entry = reinterpret_cast<InternalEntry*>(guard.page().data + *slot_ptr(guard.page(), i));
+                    pending.push_back(entry->child_page);
                 }
-            } else if (right_sibling) {
-                th.bpm->unpin_page(siblings.right_sibling, false);
             }
         }
+        free_page(th, page_id);
     }
+    th.root_page = 0;
+}
 
-    if (ph->cell_count == 0) {
-        SiblingInfo siblings = find_leaf_siblings(th, leaf_page_id, leaf_page);
-        uint32_t parent_id = ph->parent_page_id;
-
-        if (siblings.is_leftmost) {
-            if (siblings.right_sibling != 0) {
-                Page* right_sibling = th.bpm->fetch_page(siblings.right_sibling);
-                if (right_sibling) {
-                    th.bpm->unpin_page(siblings.right_sibling, false);
-                    merge_leaf_pages(th, leaf_page_id, leaf_page, siblings.right_sibling, *right_sibling);
-                }
-                remove_from_internal(th, parent_id, siblings.right_separator_key, siblings.right_sibling);
-            } else {
-                Page* parent = th.bpm->fetch_page(parent_id);
-                if (parent) {
-                    PageHeader* parent_ph = get_header(*parent);
-                    uint32_t* leftmost_ptr = reinterpret_cast<uint32_t*>(parent_ph->reserved);
-                    *leftmost_ptr = 0;
-                    th.bpm->unpin_page(parent_id, true);
-                }
-                update_leaf_links_on_free(th, leaf_page_id, leaf_page);
-                free_page(th, leaf_page_id);
-            }
-        } else if (siblings.left_sibling != 0) {
-            Page* left_sibling = th.bpm->fetch_page(siblings.left_sibling);
-            if (left_sibling) {
-                th.bpm->unpin_page(siblings.left_sibling, false);
-                merge_leaf_pages(th, siblings.left_sibling, *left_sibling, leaf_page_id, leaf_page);
-            }
-            remove_from_internal(th, parent_id, siblings.separator_key, leaf_page_id);
-        } else if (siblings.right_sibling != 0) {
-            Page* right_sibling = th.bpm->fetch_page(siblings.right_sibling);
-            if (right_sibling) {
-                th.bpm->unpin_page(siblings.right_sibling, false);
-                merge_leaf_pages(th, leaf_page_id, leaf_page, siblings.right_sibling, *right_sibling);
-            }
-            remove_from_internal(th, parent_id, siblings.right_separator_key, siblings.right_sibling);
-        } else {
-            update_leaf_links_on_free(th, leaf_page_id, leaf_page);
-            free_page(th, leaf_page_id);
+LeafLayout btree_leaf_layout(TableHandle& th) {
+    LeafLayout layout;
+    ReadPageGuard leaf = find_leftmost_leaf_page(th);
+    while (leaf) {
+        layout.leaves++;
+        uint32_t page_id = leaf.page_id();
+        uint32_t next_page_id = get_header(leaf.page())->next_page_id;
+        if (next_page_id == 0) {
+            break;
         }
+        if (next_page_id == page_id + 1) {
+            layout.sequential_hops++;
+        }
+        if (next_page_id / ALLOCATION_EXTENT_PAGES == page_id / ALLOCATION_EXTENT_PAGES) {
+            layout.extent_hops++;
+        }
+        leaf = read_page_guard(th, next_page_id);
     }
-    
-    return true;
+    return layout;
 }
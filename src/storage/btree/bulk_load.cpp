@@ -0,0 +1,268 @@
+#include <cstdint>
+#include "storage/page.hpp"
+#include "storage/btree.hpp"
+#include "storage/table_handle.hpp"
+#include "storage/buffer_pool.hpp"
+#include "storage/record.hpp"
+#include "storage/constants.hpp"
+#include <vector>
+
+// Rows arrive in key order and only ever go to the right edge of the tree,
+// so nothing is split: the rightmost leaf is filled to the fill factor and
+// then a new leaf is started after it. The new leaf's separator goes into
+// the rightmost page of the level above, which in turn starts a new page
+// once it is full, up to a new root. Each new page is allocated straight
+// after the last one, so the file is written front to back.
+//
+// The loader relies on the caller holding off other writers. Readers may
+// run alongside: the leaf being filled stays latched while rows go into it,
+// and is let go before the levels above are latched, so that pages a
+// reader can reach are latched top-down as it latches them. A new page is
+// latched before anything points at it, and is only reachable once linked.
+
+namespace {
+
+class BulkLoader {
+public:
+    BulkLoader(TableHandle& th, uint32_t fill_percent)
+        : th_(th), fill_bytes_(th.dm->get_page_size() * fill_percent / 100) {}
+
+    // Latches the rightmost leaf and finds the key rows must come after.
+    bool open() {
+        if (th_.root_page == 0) {
+            return true;
+        }
+        uint32_t page_id = th_.root_page;
+        for (int depth = 0;; depth++) {
+            if (depth > 100) {
+                return false;
+            }
+            ReadPageGuard page(*th_.bpm, th_.file_id, page_id);
+            if (!page) {
+                return false;
+            }
+            PageHeader* ph = get_header(page.page());
+            spine_.insert(spine_.begin(), page_id);
+            if (ph->page_level == PageLevel::LEAF) {
+                break;
+            }
+            page_id = ph->cell_count > 0
+                ? reinterpret_cast<InternalEntry*>(page.page().data + *slot_ptr(page.page(), ph->cell_count - 1))->child_page
+                : *reinterpret_cast<uint32_t*>(ph->reserved);
+            if (page_id == 0 || page_id == INVALID_PAGE_ID) {
+                return false;
+            }
+        }
+        leaf_ = WritePageGuard(*th_.bpm, th_.file_id, spine_.front());
+        if (!leaf_) {
+            return false;
+        }
+        last_page_ = leaf_.page_id();
+
+        // An emptied rightmost leaf leaves the bound with the leaves before it.
+        uint32_t prev_id = get_header(leaf_.page())->prev_page_id;
+        while (get_header(leaf_.page())->cell_count == 0 && prev_id != 0) {
+            ReadPageGuard prev(*th_.bpm, th_.file_id, prev_id);
+            if (!prev) {
+                return false;
+            }
+            uint16_t count = get_header(prev.page())->cell_count;
+            if (count > 0) {
+                uint16_t key_len = 0;
+                const uint8_t* key = slot_key(prev.page(), count - 1, key_len);
+                lower_bound_ = Key::owned(key, key_len);
+                break;
+            }
+            prev_id = get_header(prev.page())->prev_page_id;
+        }
+        return true;
+    }
+
+    // False, with nothing written, if key does not come after every key in
+    // the table, the row cannot fit on a page, or the leaf is full and key
+    // is too close to the last key for a separator between them.
+    bool append(const Key& key, const Value& value) {
+        uint16_t rsize = record_size(key.size(), value.size());
+        if (key.empty() || sizeof(PageHeader) + rsize + sizeof(uint16_t) > th_.dm->get_page_size()) {
+            return false;
+        }
+        if (!leaf_) {
+            return start_root(key, value);
+        }
+        Page& leaf = leaf_.page();
+        PageHeader* ph = get_header(leaf);
+        uint16_t last_len = lower_bound_.size();
+        const uint8_t* last = ph->cell_count > 0 ? slot_key(leaf, ph->cell_count - 1, last_len) : lower_bound_.data();
+        if ((ph->cell_count > 0 || !lower_bound_.empty()) &&
+            compare_keys(key.data(), key.size(), last, last_len) <= 0) {
+            return false;
+        }
+        if (ph->cell_count > 0 && (used_bytes(leaf) + rsize + sizeof(uint16_t) > fill_bytes_ || !can_insert(leaf, rsize))) {
+            // A separator too long for an internal page keeps the row on
+            // this leaf while it has room past the fill factor.
+            Key separator = shortest_separator(last, last_len, key.data(), key.size());
+            if (separator.size() > max_separator_size(page_size(leaf))) {
+                if (!can_insert(leaf, rsize)) {
+                    return false;
+                }
+            } else if (!start_leaf(separator)) {
+                return false;
+            }
+        }
+        write_row(key, value);
+        return true;
+    }
+
+private:
+    static uint32_t used_bytes(Page& page) {
+        PageHeader* ph = get_header(page);
+        return ph->free_start + (page_size(page) - ph->free_end);
+    }
+
+    // The page after the last one allocated if it is free, else one near it.
+    uint32_t next_page() {
+        uint32_t page_id = allocate_page_at(th_, last_page_ + 1);
+        if (page_id == INVALID_PAGE_ID) {
+            page_id = allocate_page(th_, last_page_);
+        }
+        if (page_id != INVALID_PAGE_ID) {
+            last_page_ = page_id;
+        }
+        return page_id;
+    }
+
+    WritePageGuard create_page(PageType type, PageLevel level) {
+        uint32_t page_id = next_page();
+        if (page_id == INVALID_PAGE_ID) {
+            return WritePageGuard();
+        }
+        WritePageGuard guard = WritePageGuard::create(*th_.bpm, th_.file_id, page_id, type, level);
+        if (!guard) {
+            free_page(th_, page_id);
+        }
+        return guard;
+    }
+
+    void write_row(const Key& key, const Value& value) {
+        Page& leaf = leaf_.page();
+        uint16_t offset = write_record(leaf, key.data(), key.size(), value.data(), value.size());
+        insert_slot(leaf, get_header(leaf)->cell_count, offset);
+        leaf_.mark_dirty();
+    }
+
+    bool start_root(const Key& key, const Value& value) {
+        leaf_ = create_page(PageType::DATA, PageLevel::LEAF);
+        if (!leaf_) {
+            return false;
+        }
+        write_row(key, value);
+        spine_.assign(1, leaf_.page_id());
+        set_root_page(th_, leaf_.page_id());
+        return true;
+    }
+
+    // Chains a new leaf after the current one, hangs it off the level above
+    // with separator, and makes it the one being filled. The new leaf is
+    // linked above before the filled one points at it, and stays empty
+    // until then, so a scan that passes over it misses nothing.
+    bool start_leaf(const Key& separator) {
+        WritePageGuard leaf = create_page(PageType::DATA, PageLevel::LEAF);
+        if (!leaf) {
+            return false;
+        }
+        uint32_t filled_id = leaf_.page_id();
+        uint32_t leaf_id = leaf.page_id();
+        get_header(leaf.page())->prev_page_id = filled_id;
+        leaf_.release();
+        if (!add_child(1, separator, leaf)) {
+            leaf.release();
+            free_page(th_, leaf_id);
+            leaf_ = WritePageGuard(*th_.bpm, th_.file_id, filled_id);
+            return false;
+        }
+        spine_[0] = leaf_id;
+        leaf.release();
+
+        // In chain order, as a scan latches them.
+        WritePageGuard filled(*th_.bpm, th_.file_id, filled_id);
+        leaf_ = WritePageGuard(*th_.bpm, th_.file_id, leaf_id);
+        if (!filled || !leaf_) {
+            return false;
+        }
+        get_header(filled.page())->next_page_id = leaf_id;
+        filled.mark_dirty();
+        return true;
+    }
+
+    // Adds child, latched by the caller, as the rightmost child of the
+    // rightmost page at level; a full page there is followed by a new one,
+    // and a new root is grown above the old one when level is past the top.
+    bool add_child(size_t level, const Key& key, WritePageGuard& child) {
+        if (level == spine_.size()) {
+            WritePageGuard upper(*th_.bpm, th_.file_id, spine_[level - 1]);
+            if (!upper || !create_new_root(th_, upper, key, child)) {
+                return false;
+            }
+            spine_.push_back(th_.root_page);
+            return true;
+        }
+
+        {
+            WritePageGuard parent(*th_.bpm, th_.file_id, spine_[level]);
+            if (!parent) {
+                return false;
+            }
+            // The fill factor holds for the page once its entries are
+            // stored under their shared prefix.
+            Page& page = parent.page();
+            if (internal_page_bytes_with(page, key) <= fill_bytes_ && insert_internal_no_split(page, key, child.page_id())) {
+                parent.mark_dirty();
+                get_header(child.page())->parent_page_id = parent.page_id();
+                return true;
+            }
+        }
+
+        WritePageGuard parent = create_page(PageType::INDEX, PageLevel::INTERNAL);
+        if (!parent) {
+            return false;
+        }
+        *reinterpret_cast<uint32_t*>(get_header(parent.page())->reserved) = child.page_id();
+        get_header(child.page())->parent_page_id = parent.page_id();
+        if (!add_child(level + 1, key, parent)) {
+            uint32_t page_id = parent.page_id();
+            parent.release();
+            free_page(th_, page_id);
+            return false;
+        }
+        spine_[level] = parent.page_id();
+        parent.mark_dirty();
+        return true;
+    }
+
+    TableHandle& th_;
+    uint32_t fill_bytes_;
+    std::vector<uint32_t> spine_;  // rightmost page of each level, the leaf first
+    WritePageGuard leaf_;          // the leaf being filled
+    Key lower_bound_;              // last key before an empty rightmost leaf
+    uint32_t last_page_ = 0;       // last page allocated
+};
+
+}  // namespace
+
+bool btree_bulk_load(TableHandle& th, BTreeBulkLoadSource source, void* ctx, uint32_t fill_percent) {
+    if (!th.bpm || source == nullptr || fill_percent == 0 || fill_percent > 100) {
+        return false;
+    }
+    BulkLoader loader(th, fill_percent);
+    if (!loader.open()) {
+        return false;
+    }
+    Key key;
+    Value value;
+    while (source(key, value, ctx)) {
+        if (!loader.append(key, value)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,801 @@
+#include <cstdint>
+#include "storage/page.hpp"
+#include "storage/btree.hpp"
+#include "storage/table_handle.hpp"
+#include "storage/buffer_pool.hpp"
+#include "storage/record.hpp"
+#include "storage/constants.hpp"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// Online compaction, one bounded step at a time, each run by the caller
+// under the table's write latch so that writers interleave between steps.
+//
+// The leaf phase walks the bottom internal pages in key order. A step takes
+// up to COMPACTION_STEP_LEAVES children of one of them, plus the last leaf
+// the previous step wrote, packs their records to COMPACTION_FILL_PERCENT
+// and writes them to the lowest pages from a cursor that only moves up the
+// file: the window's own pages where the cursor reaches them, free pages,
+// or pages of leaves that are moved out of the way to the end of the file.
+// After its last window the internal page itself is merged into its left
+// sibling, or written to the page after its leaves. The remaining internal
+// levels are then moved down to free pages after the leaves, pages still in
+// use near the end of the file into free pages below them, and the free
+// pages left at the end cut off.
+//
+// Readers are excluded from a step the usual way: internal pages are
+// latched top-down and leaves left to right, and each page is latched
+// before any page a reader holding it could be waiting for.
+
+namespace {
+
+struct ChildRef {
+    Key key;  // empty for the leftmost child
+    uint32_t page_id;
+};
+
+// An internal page's children in key order, each with the separator in
+// front of it.
+std::vector<ChildRef> read_children(Page& page) {
+    PageHeader* ph = get_header(page);
+    std::vector<ChildRef> children;
+    uint32_t leftmost = *reinterpret_cast<uint32_t*>(ph->reserved);
+    if (leftmost != 0 && leftmost != INVALID_PAGE_ID) {
+        children.push_back({Key(), leftmost});
+    }
+    for (uint16_t i = 0; i < ph->cell_count; i++) {
+        auto* entry = reinterpret_cast<InternalEntry*>(page.data + *slot_ptr(page, i));
+        children.push_back({internal_entry_key(page, i), entry->child_page});
+    }
+    return children;
+}
+
+uint32_t internal_page_bytes(const std::vector<ChildRef>& children) {
+    uint32_t bytes = sizeof(PageHeader);
+    for (size_t i = 1; i < children.size(); i++) {
+        bytes += sizeof(InternalEntry) + children[i].key.size() + sizeof(uint16_t);
+    }
+    return bytes;
+}
+
+// Lays children out on page, a scratch image or a page the step holds
+// through a WritePageGuard, with the first as the leftmost child. The
+// caller has checked that they fit with whole keys, before the page's
+// prefix is taken off them.
+void write_internal_page(Page& page, uint32_t page_id, uint32_t parent_id,
+                         const std::vector<ChildRef>& children, uint32_t page_size) {
+    init_page(page, page_id, PageType::INDEX, PageLevel::INTERNAL, page_size);
+    PageHeader* ph = get_header(page);
+    ph->parent_page_id = parent_id;
+    *reinterpret_cast<uint32_t*>(ph->reserved) = children.empty() ? 0 : children[0].page_id;
+    for (size_t i = 1; i < children.size(); i++) {
+        uint16_t offset = write_internal_entry(page, children[i].key, children[i].page_id);
+        insert_slot(page, ph->cell_count, offset);
+    }
+    compact_internal_page(page);
+}
+
+bool replace_child(Page& page, uint32_t old_child, uint32_t new_child) {
+    PageHeader* ph = get_header(page);
+    uint32_t* leftmost = reinterpret_cast<uint32_t*>(ph->reserved);
+    if (*leftmost == old_child) {
+        *leftmost = new_child;
+        return true;
+    }
+    for (uint16_t i = 0; i < ph->cell_count; i++) {
+        auto* entry = reinterpret_cast<InternalEntry*>(page.data + *slot_ptr(page, i));
+        if (entry->child_page == old_child) {
+            entry->child_page = new_child;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Pages outside a step's latches are relinked through a plain pin, as the
+// split path relinks moved children: latching them could wait on a scan
+// that waits on a page the step holds. Readers take the parent only as a
+// hint and check it again under a latch.
+void set_parent_page(TableHandle& th, uint32_t page_id, uint32_t parent_id) {
+    Page* page = th.bpm->fetch_page(th.file_id, page_id);
+    if (page) {
+        get_header(*page)->parent_page_id = parent_id;
+        th.bpm->unpin_page(th.file_id, page_id, true);
+    }
+}
+
+void set_prev_page(TableHandle& th, uint32_t page_id, uint32_t prev_id) {
+    Page* page = th.bpm->fetch_page(th.file_id, page_id);
+    if (page) {
+        get_header(*page)->prev_page_id = prev_id;
+        th.bpm->unpin_page(th.file_id, page_id, true);
+    }
+}
+
+uint32_t used_bytes(Page& page) {
+    PageHeader* ph = get_header(page);
+    return ph->free_start + (page_size(page) - ph->free_end);
+}
+
+Key first_key(Page& page) {
+    uint16_t key_len = 0;
+    const uint8_t* key = slot_key(page, 0, key_len);
+    return key ? Key::owned(key, key_len) : Key();
+}
+
+// The separator between two neighbouring new leaves, neither empty.
+Key leaf_separator(Page& left, Page& right) {
+    uint16_t left_len = 0;
+    uint16_t right_len = 0;
+    const uint8_t* left_key = slot_key(left, get_header(left)->cell_count - 1, left_len);
+    const uint8_t* right_key = slot_key(right, 0, right_len);
+    return shortest_separator(left_key, left_len, right_key, right_len);
+}
+
+// What a leaf step holds, and where the window's chain continues.
+struct Step {
+    std::vector<uint32_t> held;        // latched by the step
+    std::vector<WritePageGuard> own;   // being rewritten, so free to reuse
+    std::vector<uint32_t> claimed;     // newly taken pages, given back on failure
+    uint32_t prev_parent = 0;          // parent of the window's left neighbour
+    uint32_t window_last = 0;
+    uint32_t next_leaf = 0;            // the window's right neighbour
+
+    bool is_held(uint32_t page_id) const {
+        return page_id != 0 && std::find(held.begin(), held.end(), page_id) != held.end();
+    }
+};
+
+// Moves the leaf on page_id to to_page, which the caller has allocated, and
+// returns the guard on page_id; empty if page_id is no leaf of the tree, or
+// a reader could be waiting on a page the step holds.
+WritePageGuard move_leaf(TableHandle& th, uint32_t page_id, uint32_t to_page, Step& step) {
+    PageHeader header;
+    {
+        ReadPageGuard page(*th.bpm, th.file_id, page_id);
+        if (!page) {
+            return WritePageGuard();
+        }
+        header = *get_header(page.page());
+    }
+    uint32_t parent_id = header.parent_page_id;
+    uint32_t prev_id = header.prev_page_id;
+    uint32_t next_id = header.next_page_id;
+    if (header.page_id != page_id || header.page_type != PageType::DATA || header.page_level != PageLevel::LEAF ||
+        parent_id == 0 || step.is_held(parent_id) || parent_id == step.prev_parent || step.is_held(next_id) ||
+        (prev_id != step.window_last && step.is_held(prev_id))) {
+        return WritePageGuard();
+    }
+
+    WritePageGuard parent(*th.bpm, th.file_id, parent_id);
+    if (!parent || get_header(parent.page())->page_level != PageLevel::INTERNAL) {
+        return WritePageGuard();
+    }
+    WritePageGuard prev;
+    if (prev_id != 0 && prev_id != step.window_last) {
+        prev = WritePageGuard(*th.bpm, th.file_id, prev_id);
+        if (!prev) {
+            return WritePageGuard();
+        }
+    }
+    WritePageGuard leaf(*th.bpm, th.file_id, page_id);
+    if (!leaf || get_header(leaf.page())->parent_page_id != parent_id ||
+        get_header(leaf.page())->prev_page_id != prev_id || get_header(leaf.page())->next_page_id != next_id) {
+        return WritePageGuard();
+    }
+    WritePageGuard moved = WritePageGuard::create(*th.bpm, th.file_id, to_page);
+    if (!moved || !replace_child(parent.page(), page_id, to_page)) {
+        return WritePageGuard();
+    }
+    parent.mark_dirty();
+    copy_page(moved.page(), leaf.page());
+    get_header(moved.page())->page_id = to_page;
+    moved.mark_dirty();
+    if (prev) {
+        get_header(prev.page())->next_page_id = to_page;
+        prev.mark_dirty();
+    } else if (prev_id != 0) {
+        step.next_leaf = to_page;
+    }
+    if (next_id != 0) {
+        set_prev_page(th, next_id, to_page);
+    }
+    return leaf;
+}
+
+// Moves the internal page on page_id to to_page, which the caller has
+// allocated; false if it is no internal page of the tree.
+bool move_internal_page(TableHandle& th, uint32_t page_id, uint32_t to_page) {
+    uint32_t parent_id = 0;
+    {
+        ReadPageGuard page(*th.bpm, th.file_id, page_id);
+        if (!page || get_header(page.page())->page_id != page_id ||
+            get_header(page.page())->page_level != PageLevel::INTERNAL) {
+            return false;
+        }
+        parent_id = get_header(page.page())->parent_page_id;
+    }
+    if ((parent_id == 0) != (page_id == th.root_page)) {
+        return false;
+    }
+    WritePageGuard parent;
+    if (parent_id != 0) {
+        parent = WritePageGuard(*th.bpm, th.file_id, parent_id);
+        if (!parent) {
+            return false;
+        }
+    }
+    WritePageGuard page(*th.bpm, th.file_id, page_id);
+    if (!page || get_header(page.page())->parent_page_id != parent_id) {
+        return false;
+    }
+    WritePageGuard moved = WritePageGuard::create(*th.bpm, th.file_id, to_page, PageType::INDEX, PageLevel::INTERNAL);
+    if (!moved || (parent && !replace_child(parent.page(), page_id, to_page))) {
+        return false;
+    }
+    copy_page(moved.page(), page.page());
+    get_header(moved.page())->page_id = to_page;
+    moved.mark_dirty();
+    if (parent) {
+        parent.mark_dirty();
+    } else {
+        set_root_page(th, to_page);
+    }
+    for (const ChildRef& child : read_children(moved.page())) {
+        set_parent_page(th, child.page_id, to_page);
+    }
+    return true;
+}
+
+// The next page from the cursor that a rewritten page can go to. Pages in
+// use that cannot be moved are skipped; an empty guard means no page could
+// be had at all.
+WritePageGuard claim_page(TableHandle& th, CompactionState& state, Step& step) {
+    while (true) {
+        uint32_t page_id = state.next_page++;
+        for (WritePageGuard& guard : step.own) {
+            if (guard && guard.page_id() == page_id) {
+                return std::move(guard);
+            }
+        }
+        if (step.is_held(page_id)) {
+            continue;
+        }
+        uint32_t allocated = allocate_page_at(th, page_id);
+        if (allocated != INVALID_PAGE_ID) {
+            state.next_page = allocated + 1;
+            WritePageGuard guard = WritePageGuard::create(*th.bpm, th.file_id, allocated);
+            if (!guard) {
+                free_page(th, allocated);
+                return guard;
+            }
+            step.claimed.push_back(allocated);
+            return guard;
+        }
+        // In use, unless it holds no page at all, in which case the
+        // allocation failed. A leaf in the way is moved to the end of the
+        // file, well clear of the cursor; in a tablespace it may be another
+        // table's.
+        uint32_t in_use = 0;
+        {
+            ReadPageGuard page(*th.bpm, th.file_id, page_id);
+            if (page) {
+                in_use = get_header(page.page())->page_id;
+            }
+        }
+        if (in_use != page_id) {
+            return WritePageGuard();
+        }
+        if (th.tablespace) {
+            continue;
+        }
+        uint32_t moved_id = allocate_page_near_end(th);
+        if (moved_id == INVALID_PAGE_ID) {
+            return WritePageGuard();
+        }
+        WritePageGuard guard = move_leaf(th, page_id, moved_id, step);
+        if (!guard) {
+            free_page(th, moved_id);
+            continue;
+        }
+        step.claimed.push_back(page_id);
+        return guard;
+    }
+}
+
+// Drops the destinations of a step that could not finish. Pages that were
+// taken are given back; a moved leaf stays where it was moved to.
+bool abandon_step(TableHandle& th, Step& step, std::vector<WritePageGuard>& dests) {
+    for (WritePageGuard& dest : dests) {
+        uint32_t page_id = dest.page_id();
+        bool claimed = std::find(step.claimed.begin(), step.claimed.end(), page_id) != step.claimed.end();
+        dest.release();
+        if (claimed) {
+            free_page(th, page_id);
+        }
+    }
+    return false;
+}
+
+// A root that is a leaf is packed and moved to the cursor.
+bool compact_root_leaf(TableHandle& th, CompactionState& state, WritePageGuard root) {
+    uint32_t page_size = th.dm->get_page_size();
+    Page image;
+    init_page(image, 0, PageType::DATA, PageLevel::LEAF, page_size);
+    Page& page = root.page();
+    for (uint16_t i = 0; i < get_header(page)->cell_count; i++) {
+        uint16_t key_len = 0;
+        uint16_t value_len = 0;
+        const uint8_t* key = slot_key(page, i, key_len);
+        const uint8_t* value = slot_value(page, i, value_len);
+        uint16_t offset = write_record(image, key, key_len, value, value_len);
+        insert_slot(image, get_header(image)->cell_count, offset);
+    }
+
+    uint32_t old_root = root.page_id();
+    Step step;
+    step.held.push_back(old_root);
+    step.own.push_back(std::move(root));
+    std::vector<WritePageGuard> dests;
+    dests.push_back(claim_page(th, state, step));
+    if (!dests.back()) {
+        dests.pop_back();
+        return abandon_step(th, step, dests);
+    }
+    WritePageGuard& dest = dests.back();
+    copy_page(dest.page(), image);
+    get_header(dest.page())->page_id = dest.page_id();
+    dest.mark_dirty();
+    uint32_t new_root = dest.page_id();
+    dest.release();
+    if (new_root != old_root) {
+        set_root_page(th, new_root);
+        step.own.clear();
+        free_page(th, old_root);
+    }
+    state.phase = CompactionState::Phase::UPPER_LEVELS;
+    return true;
+}
+
+// Points next_key at the first record after the window, or ends the phase.
+void advance_past(TableHandle& th, CompactionState& state, uint32_t next_leaf) {
+    Key previous = state.next_key;
+    while (next_leaf != 0) {
+        ReadPageGuard leaf(*th.bpm, th.file_id, next_leaf);
+        if (!leaf) {
+            break;
+        }
+        if (get_header(leaf.page())->cell_count > 0) {
+            Key key = first_key(leaf.page());
+            if (previous.empty() ||
+                compare_keys(key.data(), key.size(), previous.data(), previous.size()) > 0) {
+                state.next_key = key;
+                return;
+            }
+            break;
+        }
+        next_leaf = get_header(leaf.page())->next_page_id;
+    }
+    state.phase = CompactionState::Phase::UPPER_LEVELS;
+}
+
+bool compact_leaf_window(TableHandle& th, CompactionState& state) {
+    uint32_t page_size = th.dm->get_page_size();
+    uint32_t fill_bytes = page_size * COMPACTION_FILL_PERCENT / 100;
+    if (th.root_page == 0) {
+        state.phase = CompactionState::Phase::UPPER_LEVELS;
+        return true;
+    }
+
+    WritePageGuard grandparent;
+    WritePageGuard parent(*th.bpm, th.file_id, th.root_page);
+    if (!parent) {
+        return false;
+    }
+    if (get_header(parent.page())->page_level == PageLevel::LEAF) {
+        return compact_root_leaf(th, state, std::move(parent));
+    }
+    uint32_t child_id = 0;
+    for (int depth = 0;; depth++) {
+        if (depth > 100) {
+            return false;
+        }
+        child_id = state.next_key.empty() ? read_children(parent.page()).front().page_id
+                                          : internal_find_child(parent.page(), state.next_key);
+        if (child_id == 0 || child_id == INVALID_PAGE_ID) {
+            return false;
+        }
+        PageLevel level;
+        {
+            ReadPageGuard child(*th.bpm, th.file_id, child_id);
+            if (!child) {
+                return false;
+            }
+            level = get_header(child.page())->page_level;
+        }
+        if (level == PageLevel::LEAF) {
+            break;
+        }
+        grandparent = std::move(parent);
+        parent = WritePageGuard(*th.bpm, th.file_id, child_id);
+        if (!parent) {
+            return false;
+        }
+    }
+
+    std::vector<ChildRef> children = read_children(parent.page());
+    size_t start = 0;
+    while (start < children.size() && children[start].page_id != child_id) {
+        start++;
+    }
+    if (start == children.size()) {
+        return false;
+    }
+    // The previous step's last leaf is packed again with this window.
+    size_t begin = start == 0 ? 0 : start - 1;
+    size_t end = std::min(children.size(), start + COMPACTION_STEP_LEAVES);
+    bool last_window = end == children.size();
+    uint32_t parent_id = parent.page_id();
+    uint32_t grandparent_id = grandparent ? grandparent.page_id() : 0;
+    uint32_t cursor = state.next_page;
+    if (begin < start) {
+        state.next_page = std::min(state.next_page, children[begin].page_id);
+    }
+
+    Step step;
+    step.held = {grandparent_id, parent_id};
+
+    // After its last window the internal page goes into its left sibling if
+    // they fit together.
+    WritePageGuard left_sibling;
+    std::vector<ChildRef> uncles;
+    size_t parent_index = 0;
+    if (last_window && grandparent) {
+        uncles = read_children(grandparent.page());
+        while (parent_index < uncles.size() && uncles[parent_index].page_id != parent_id) {
+            parent_index++;
+        }
+        if (parent_index == uncles.size()) {
+            return false;
+        }
+        if (parent_index > 0) {
+            left_sibling = WritePageGuard(*th.bpm, th.file_id, uncles[parent_index - 1].page_id);
+            if (!left_sibling) {
+                return false;
+            }
+            step.held.push_back(left_sibling.page_id());
+        }
+    }
+
+    uint32_t prev_id = 0;
+    {
+        ReadPageGuard first(*th.bpm, th.file_id, children[begin].page_id);
+        if (!first) {
+            return false;
+        }
+        prev_id = get_header(first.page())->prev_page_id;
+    }
+    WritePageGuard prev;
+    if (prev_id != 0) {
+        prev = WritePageGuard(*th.bpm, th.file_id, prev_id);
+        if (!prev) {
+            return false;
+        }
+        step.held.push_back(prev_id);
+        step.prev_parent = get_header(prev.page())->parent_page_id;
+    }
+
+    std::vector<WritePageGuard> window;
+    for (size_t i = begin; i < end; i++) {
+        WritePageGuard leaf(*th.bpm, th.file_id, children[i].page_id);
+        if (!leaf || get_header(leaf.page())->page_level != PageLevel::LEAF) {
+            return false;
+        }
+        step.held.push_back(leaf.page_id());
+        window.push_back(std::move(leaf));
+    }
+    step.window_last = window.back().page_id();
+    step.next_leaf = get_header(window.back().page())->next_page_id;
+
+    // Records still point into the window's frames, which stay latched
+    // until every new leaf has been laid out.
+    std::vector<std::unique_ptr<Page>> leaves;
+    for (WritePageGuard& guard : window) {
+        Page& page = guard.page();
+        for (uint16_t i = 0; i < get_header(page)->cell_count; i++) {
+            uint16_t key_len = 0;
+            uint16_t value_len = 0;
+            const uint8_t* key = slot_key(page, i, key_len);
+            const uint8_t* value = slot_value(page, i, value_len);
+            uint16_t rsize = record_size(key_len, value_len);
+            if (leaves.empty() ||
+                (get_header(*leaves.back())->cell_count > 0 &&
+                 used_bytes(*leaves.back()) + rsize + sizeof(uint16_t) > fill_bytes) ||
+                !can_insert(*leaves.back(), rsize)) {
+                leaves.push_back(std::make_unique<Page>());
+                init_page(*leaves.back(), 0, PageType::DATA, PageLevel::LEAF, page_size);
+            }
+            Page& leaf = *leaves.back();
+            uint16_t offset = write_record(leaf, key, key_len, value, value_len);
+            insert_slot(leaf, get_header(leaf)->cell_count, offset);
+        }
+    }
+    if (leaves.empty()) {
+        leaves.push_back(std::make_unique<Page>());
+        init_page(*leaves.back(), 0, PageType::DATA, PageLevel::LEAF, page_size);
+    }
+
+    std::vector<ChildRef> rebuilt(children.begin(), children.begin() + static_cast<ptrdiff_t>(begin));
+    bool separators_fit = true;
+    for (size_t j = 0; j < leaves.size(); j++) {
+        rebuilt.push_back({j == 0 ? children[begin].key : leaf_separator(*leaves[j - 1], *leaves[j]), 0});
+        separators_fit = separators_fit && rebuilt.back().key.size() <= max_separator_size(page_size);
+    }
+    rebuilt.insert(rebuilt.end(), children.begin() + static_cast<ptrdiff_t>(end), children.end());
+
+    std::vector<ChildRef> merged;
+    if (left_sibling) {
+        merged = read_children(left_sibling.page());
+        std::vector<ChildRef> tail = rebuilt;
+        tail[0].key = uncles[parent_index].key;
+        merged.insert(merged.end(), tail.begin(), tail.end());
+        if (internal_page_bytes(merged) > fill_bytes) {
+            merged.clear();
+            left_sibling.release();
+        }
+    }
+    bool merge = !merged.empty();
+    if (!separators_fit || (!merge && internal_page_bytes(rebuilt) > page_size)) {
+        // Longer separators than before, or than any internal page may
+        // hold; leave this window as it is.
+        window.clear();
+        prev.release();
+        state.next_page = cursor;
+        advance_past(th, state, step.next_leaf);
+        return true;
+    }
+
+    // The leaves go first, then the internal page if it moves.
+    for (WritePageGuard& guard : window) {
+        step.own.push_back(std::move(guard));
+    }
+    if (last_window) {
+        step.own.push_back(std::move(parent));
+    }
+    std::vector<WritePageGuard> dests;
+    for (size_t j = 0; j < leaves.size(); j++) {
+        dests.push_back(claim_page(th, state, step));
+        if (!dests.back()) {
+            dests.pop_back();
+            return abandon_step(th, step, dests);
+        }
+    }
+    WritePageGuard parent_dest;
+    if (last_window && !merge) {
+        parent_dest = claim_page(th, state, step);
+        if (!parent_dest) {
+            return abandon_step(th, step, dests);
+        }
+    }
+    uint32_t new_parent_id = merge ? left_sibling.page_id() : parent_dest ? parent_dest.page_id() : parent_id;
+
+    for (size_t j = 0; j < leaves.size(); j++) {
+        Page& page = dests[j].page();
+        copy_page(page, *leaves[j]);
+        PageHeader* ph = get_header(page);
+        ph->page_id = dests[j].page_id();
+        ph->parent_page_id = new_parent_id;
+        ph->prev_page_id = j == 0 ? prev_id : dests[j - 1].page_id();
+        ph->next_page_id = j + 1 == leaves.size() ? step.next_leaf : dests[j + 1].page_id();
+        dests[j].mark_dirty();
+        rebuilt[begin + j].page_id = dests[j].page_id();
+    }
+    if (prev) {
+        get_header(prev.page())->next_page_id = dests.front().page_id();
+        prev.mark_dirty();
+    }
+    if (step.next_leaf != 0) {
+        set_prev_page(th, step.next_leaf, dests.back().page_id());
+    }
+
+    if (merge) {
+        for (size_t i = 0; i < begin; i++) {
+            set_parent_page(th, rebuilt[i].page_id, new_parent_id);
+        }
+        merged.resize(merged.size() - rebuilt.size());
+        size_t first = merged.size();
+        merged.insert(merged.end(), rebuilt.begin(), rebuilt.end());
+        merged[first].key = uncles[parent_index].key;
+        write_internal_page(left_sibling.page(), left_sibling.page_id(), grandparent_id, merged, page_size);
+        left_sibling.mark_dirty();
+        uncles.erase(uncles.begin() + static_cast<ptrdiff_t>(parent_index));
+        write_internal_page(grandparent.page(), grandparent_id, get_header(grandparent.page())->parent_page_id,
+                            uncles, page_size);
+        grandparent.mark_dirty();
+    } else if (parent_dest) {
+        Page image;
+        write_internal_page(image, new_parent_id, grandparent_id, rebuilt, page_size);
+        copy_page(parent_dest.page(), image);
+        parent_dest.mark_dirty();
+        if (new_parent_id != parent_id) {
+            for (size_t i = 0; i < begin; i++) {
+                set_parent_page(th, rebuilt[i].page_id, new_parent_id);
+            }
+            if (grandparent) {
+                replace_child(grandparent.page(), parent_id, new_parent_id);
+                grandparent.mark_dirty();
+            } else {
+                set_root_page(th, new_parent_id);
+            }
+        }
+    } else {
+        Page image;
+        write_internal_page(image, parent_id, get_header(parent.page())->parent_page_id, rebuilt, page_size);
+        copy_page(parent.page(), image);
+        parent.mark_dirty();
+    }
+
+    // Whatever was not reused as a destination is no longer in the tree.
+    std::vector<uint32_t> unused;
+    for (WritePageGuard& guard : step.own) {
+        if (guard) {
+            unused.push_back(guard.page_id());
+            guard.release();
+        }
+    }
+    dests.clear();
+    parent_dest.release();
+    parent.release();
+    left_sibling.release();
+    prev.release();
+    grandparent.release();
+    for (uint32_t page_id : unused) {
+        free_page(th, page_id);
+    }
+    advance_past(th, state, step.next_leaf);
+    return true;
+}
+
+// Moves page_id down to the first free page from the cursor, if there is
+// one below it; returns where the page is now.
+uint32_t move_internal_page_down(TableHandle& th, CompactionState& state, uint32_t page_id) {
+    while (state.next_page < page_id) {
+        uint32_t candidate = state.next_page++;
+        if (allocate_page_at(th, candidate) != candidate) {
+            continue;
+        }
+        if (move_internal_page(th, page_id, candidate)) {
+            free_page(th, page_id);
+            return candidate;
+        }
+        free_page(th, candidate);
+        break;
+    }
+    return page_id;
+}
+
+bool compact_upper_levels(TableHandle& th, CompactionState& state) {
+    // Merges can leave a root with one child, which then takes its place.
+    while (th.root_page != 0) {
+        uint32_t old_root = th.root_page;
+        WritePageGuard root(*th.bpm, th.file_id, old_root);
+        if (!root) {
+            return false;
+        }
+        PageHeader* ph = get_header(root.page());
+        uint32_t leftmost = *reinterpret_cast<uint32_t*>(ph->reserved);
+        if (ph->page_level != PageLevel::INTERNAL || ph->cell_count > 0 || leftmost == 0 ||
+            leftmost == INVALID_PAGE_ID) {
+            break;
+        }
+        set_parent_page(th, leftmost, 0);
+        set_root_page(th, leftmost);
+        root.release();
+        free_page(th, old_root);
+    }
+
+    // Top-down, level by level, down to the parents of internal pages; the
+    // bottom internal level was placed with its leaves.
+    std::vector<uint32_t> level;
+    if (th.root_page != 0) {
+        level.push_back(th.root_page);
+    }
+    while (!level.empty()) {
+        std::vector<uint32_t> below;
+        for (uint32_t page_id : level) {
+            std::vector<ChildRef> children;
+            {
+                ReadPageGuard page(*th.bpm, th.file_id, page_id);
+                if (!page || get_header(page.page())->page_level != PageLevel::INTERNAL) {
+                    continue;
+                }
+                children = read_children(page.page());
+            }
+            if (children.empty()) {
+                continue;
+            }
+            {
+                ReadPageGuard child(*th.bpm, th.file_id, children.front().page_id);
+                if (!child || get_header(child.page())->page_level != PageLevel::INTERNAL) {
+                    continue;
+                }
+            }
+            page_id = move_internal_page_down(th, state, page_id);
+            ReadPageGuard page(*th.bpm, th.file_id, page_id);
+            if (page) {
+                for (const ChildRef& child : read_children(page.page())) {
+                    below.push_back(child.page_id);
+                }
+            }
+        }
+        level = std::move(below);
+    }
+    state.phase = CompactionState::Phase::TAIL;
+    return true;
+}
+
+// Pages that writers allocated after the leaf phase had passed, or leaves it
+// moved out of its way, can still be in use near the end of the file. They
+// are moved into the lowest free pages, COMPACTION_STEP_LEAVES a step, until
+// the last page in use is below every free page.
+bool compact_tail(TableHandle& th, CompactionState& state) {
+    // A tablespace's pages may be other tables'.
+    if (th.tablespace) {
+        state.phase = CompactionState::Phase::TRUNCATE;
+        return true;
+    }
+    for (size_t moved = 0; moved < COMPACTION_STEP_LEAVES; moved++) {
+        uint32_t page_id = last_page_in_use(th);
+        uint32_t to_page = page_id > 1 ? allocate_page_below(th, page_id) : INVALID_PAGE_ID;
+        if (to_page == INVALID_PAGE_ID) {
+            state.phase = CompactionState::Phase::TRUNCATE;
+            return true;
+        }
+        PageLevel level = PageLevel::NONE;
+        {
+            ReadPageGuard page(*th.bpm, th.file_id, page_id);
+            if (page) {
+                level = get_header(page.page())->page_level;
+            }
+        }
+        bool ok = false;
+        if (level == PageLevel::LEAF) {
+            Step step;
+            ok = static_cast<bool>(move_leaf(th, page_id, to_page, step));
+        } else if (level == PageLevel::INTERNAL) {
+            ok = move_internal_page(th, page_id, to_page);
+        }
+        if (!ok) {
+            free_page(th, to_page);
+            state.phase = CompactionState::Phase::TRUNCATE;
+            return true;
+        }
+        free_page(th, page_id);
+    }
+    return true;
+}
+
+}  // namespace
+
+bool btree_compact_step(TableHandle& th, CompactionState& state) {
+    if (!th.bpm) {
+        return false;
+    }
+    switch (state.phase) {
+    case CompactionState::Phase::LEAVES:
+        return compact_leaf_window(th, state);
+    case CompactionState::Phase::UPPER_LEVELS:
+        return compact_upper_levels(th, state);
+    case CompactionState::Phase::TAIL:
+        return compact_tail(th, state);
+    case CompactionState::Phase::TRUNCATE:
+        truncate_free_pages(th);
+        state.phase = CompactionState::Phase::DONE;
+        return true;
+    case CompactionState::Phase::DONE:
+        return true;
+    }
+    return false;
+}
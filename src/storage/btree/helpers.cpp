@@ -23,3 +23,19 @@ uint16_t write_raw_record(Page& page, const uint8_t* raw, uint16_t size) {
     
     return offset;
 }
+
+bool make_room_without_split(TableHandle& th, Page& page, uint16_t record_size) {
+    if (can_insert(page, record_size)) {
+        return true;
+    }
+    if (get_header(page)->fragmented_bytes == 0 || !can_insert_after_compact(page, record_size)) {
+        return false;
+    }
+    if (get_header(page)->page_level == PageLevel::INTERNAL) {
+        compact_internal_page(page);
+    } else {
+        page_compact(page);
+    }
+    th.btree_stats.splits_avoided++;
+    return true;
+}
@@ -5,8 +5,39 @@
 #include "storage/table_handle.hpp"
 #include "storage/buffer_pool.hpp"
 #include "storage/record.hpp"
+#include <algorithm>
 #include <cstring>
+#include <vector>
 
+// An internal page keeps the prefix all of its separators share once,
+// right after the header, and each entry holds only the rest of its key.
+// A search compares the key with the prefix once and then only with the
+// entries' suffixes.
+
+static const uint8_t* internal_prefix(Page& page) {
+    return page.data + sizeof(PageHeader);
+}
+
+static uint16_t common_prefix_size(const uint8_t* a, uint16_t a_size, const uint8_t* b, uint16_t b_size) {
+    uint16_t n = std::min(a_size, b_size);
+    uint16_t i = 0;
+    while (i < n && a[i] == b[i]) {
+        i++;
+    }
+    return i;
+}
+
+// 0 if key starts with page's prefix, otherwise negative when key sorts
+// below every separator on the page and positive when above.
+static int compare_to_prefix(Page& page, const uint8_t* key, uint16_t key_len) {
+    uint16_t prefix_size = get_header(page)->prefix_size;
+    if (key_len >= prefix_size && memcmp(key, internal_prefix(page), prefix_size) == 0) {
+        return 0;
+    }
+    return compare_keys(key, key_len, internal_prefix(page), prefix_size);
+}
+
+// The part of entry index's key stored past the page's prefix.
 static const uint8_t* internal_slot_key(Page& page, uint16_t index, uint16_t& key_len) {
     PageHeader* ph = get_header(page);
     if (index >= ph->cell_count) {
@@ -24,9 +55,27 @@ static const uint8_t* internal_slot_key(Page& page, uint16_t index, uint16_t& ke
     return page.data + offset + sizeof(InternalEntry);
 }
 
-uint32_t internal_find_child(Page& page, const Key& key) {
+Key internal_entry_key(Page& page, uint16_t index) {
+    uint16_t suffix_len = 0;
+    const uint8_t* suffix = internal_slot_key(page, index, suffix_len);
+    if (suffix == nullptr) {
+        return Key();
+    }
+    uint16_t prefix_size = get_header(page)->prefix_size;
+    std::vector<uint8_t> key(internal_prefix(page), internal_prefix(page) + prefix_size);
+    key.insert(key.end(), suffix, suffix + suffix_len);
+    return Key::owned(key.data(), static_cast<uint16_t>(key.size()));
+}
+
+// Index of the first entry whose key is greater than key, or cell_count.
+static int internal_upper_bound(Page& page, const Key& key) {
     PageHeader* ph = get_header(page);
-    assert(ph->page_level == PageLevel::INTERNAL);
+    int cmp = compare_to_prefix(page, key.data(), key.size());
+    if (cmp != 0) {
+        return cmp < 0 ? 0 : ph->cell_count;
+    }
+    const uint8_t* suffix = key.data() + ph->prefix_size;
+    uint16_t suffix_len = key.size() - ph->prefix_size;
 
     int left = 0;
     int right = ph->cell_count - 1;
@@ -39,23 +88,28 @@ uint32_t internal_find_child(Page& page, const Key& key) {
         if (mid_key == nullptr) {
             break;
         }
-        auto cmp = compare_keys(key.data(), key.size(), mid_key, mid_key_len);
-        if (cmp < 0) {
+        if (compare_keys(suffix, suffix_len, mid_key, mid_key_len) < 0) {
             pos = mid;
             right = mid - 1;
         } else {
             left = mid + 1;
         }
     }
+    return pos;
+}
 
+// The child internal_find_child picks given pos, the index of the first
+// entry greater than the key.
+static uint32_t child_at_bound(Page& page, int pos) {
+    PageHeader* ph = get_header(page);
     if (pos == 0) {
         uint32_t leftmost_child = *reinterpret_cast<uint32_t*>(ph->reserved);
-        if (leftmost_child != 0 && leftmost_child < 1000000 && leftmost_child != INVALID_PAGE_ID) {
+        if (leftmost_child != 0 && leftmost_child != INVALID_PAGE_ID) {
             return leftmost_child;
         }
         if (ph->cell_count > 0) {
             InternalEntry* entry = reinterpret_cast<InternalEntry*>(page.data + *slot_ptr(page, 0));
-            if (entry->child_page != 0 && entry->child_page < 1000000) {
+            if (entry->child_page != 0 && entry->child_page != INVALID_PAGE_ID) {
                 return entry->child_page;
             }
         }
@@ -78,24 +132,58 @@ uint32_t internal_find_child(Page& page, const Key& key) {
     return 0;
 }
 
+uint32_t internal_find_child(Page& page, const Key& key) {
+    assert(get_header(page)->page_level == PageLevel::INTERNAL);
+    return child_at_bound(page, internal_upper_bound(page, key));
+}
+
+uint32_t internal_find_child(Page& page, const Key& key, std::vector<uint8_t>& fence, bool& bounded) {
+    PageHeader* ph = get_header(page);
+    assert(ph->page_level == PageLevel::INTERNAL);
+
+    int pos = internal_upper_bound(page, key);
+    uint32_t child = child_at_bound(page, pos);
+    // Without a leftmost child, keys below the first entry go to its child.
+    uint32_t leftmost_child = *reinterpret_cast<uint32_t*>(ph->reserved);
+    if (pos == 0 && (leftmost_child == 0 || leftmost_child == INVALID_PAGE_ID)) {
+        pos = 1;
+    }
+    uint16_t suffix_len = 0;
+    const uint8_t* suffix = internal_slot_key(page, static_cast<uint16_t>(pos), suffix_len);
+    bounded = suffix != nullptr;
+    if (bounded) {
+        fence.assign(internal_prefix(page), internal_prefix(page) + ph->prefix_size);
+        fence.insert(fence.end(), suffix, suffix + suffix_len);
+    }
+    return child;
+}
+
 uint16_t write_internal_entry(Page& page, const Key& key, uint32_t child) {
     PageHeader* ph = get_header(page);
     assert(ph->page_level == PageLevel::INTERNAL);
+    assert(compare_to_prefix(page, key.data(), key.size()) == 0);
 
     uint16_t offset = static_cast<uint16_t>(ph->free_start);
     InternalEntry ieheader;
-    ieheader.key_size = key.size();
+    ieheader.key_size = key.size() - ph->prefix_size;
     ieheader.child_page = child;
 
     memcpy(page.data + offset, &ieheader, sizeof(ieheader));
-    memcpy(page.data + offset + sizeof(ieheader), key.data(), key.size());
+    memcpy(page.data + offset + sizeof(ieheader), key.data() + ph->prefix_size, ieheader.key_size);
 
-    ph->free_start += sizeof(ieheader) + key.size();
+    ph->free_start += sizeof(ieheader) + ieheader.key_size;
     return offset;
 }
 
 static BSearchResult internal_search_record(Page& page, const uint8_t* key, uint16_t key_len) {
     PageHeader* header = get_header(page);
+    int prefix_cmp = compare_to_prefix(page, key, key_len);
+    if (prefix_cmp != 0) {
+        return {false, static_cast<uint16_t>(prefix_cmp < 0 ? 0 : header->cell_count)};
+    }
+    key += header->prefix_size;
+    key_len -= header->prefix_size;
+
     uint16_t left = 0;
     uint16_t right = header->cell_count;
 
@@ -118,187 +206,342 @@ static BSearchResult internal_search_record(Page& page, const uint8_t* key, uint
     return {false, left};
 }
 
+int internal_entry_index(Page& page, const Key& key) {
+    BSearchResult sr = internal_search_record(page, key.data(), key.size());
+    return sr.found ? sr.index : -1;
+}
+
+// Bytes key's entry takes on page as it stands: all of key when it does
+// not share the page's prefix.
+static uint16_t internal_entry_size(Page& page, const Key& key) {
+    uint16_t stored = key.size();
+    if (compare_to_prefix(page, key.data(), key.size()) == 0) {
+        stored -= get_header(page)->prefix_size;
+    }
+    return sizeof(InternalEntry) + stored;
+}
+
+// The longest prefix shared by the keys of source's entries [begin, end),
+// and by key too when it is given. Entries are in key order, so that is
+// the prefix the first and last share.
+static uint16_t shared_prefix_size(Page& source, uint16_t begin, uint16_t end, const Key* key) {
+    uint16_t prefix_size = get_header(source)->prefix_size;
+    if (begin >= end) {
+        return 0;
+    }
+    uint16_t first_len = 0;
+    uint16_t last_len = 0;
+    const uint8_t* first = internal_slot_key(source, begin, first_len);
+    const uint8_t* last = internal_slot_key(source, end - 1, last_len);
+    uint16_t shared = common_prefix_size(first, first_len, last, last_len);
+    if (key != nullptr) {
+        uint16_t key_shared = common_prefix_size(key->data(), key->size(), internal_prefix(source), prefix_size);
+        if (key_shared < prefix_size) {
+            return key_shared;
+        }
+        const uint8_t* suffix = key->data() + prefix_size;
+        uint16_t suffix_len = key->size() - prefix_size;
+        shared = std::min(shared, common_prefix_size(first, first_len, suffix, suffix_len));
+        shared = std::min(shared, common_prefix_size(suffix, suffix_len, last, last_len));
+    }
+    return prefix_size + shared;
+}
+
+// Copies bytes [from, from + count) of a key split into prefix and suffix.
+static void copy_key_bytes(const uint8_t* prefix, uint16_t prefix_size, const uint8_t* suffix,
+                           uint16_t from, uint16_t count, uint8_t* out) {
+    while (count > 0 && from < prefix_size) {
+        *out++ = prefix[from++];
+        count--;
+    }
+    memcpy(out, suffix + (from - prefix_size), count);
+}
+
+// Lays source's entries [begin, end) out on page, which holds no entries,
+// under the longest prefix they share, and key too when it is given so
+// that key can be added after.
+static void write_entries(Page& page, Page& source, uint16_t begin, uint16_t end, const Key* key) {
+    PageHeader* ph = get_header(page);
+    const uint8_t* source_prefix = internal_prefix(source);
+    uint16_t source_prefix_size = get_header(source)->prefix_size;
+    uint16_t prefix_size = shared_prefix_size(source, begin, end, key);
+
+    uint16_t offset = sizeof(PageHeader) + prefix_size;
+    if (begin < end) {
+        uint16_t first_len = 0;
+        const uint8_t* first = internal_slot_key(source, begin, first_len);
+        copy_key_bytes(source_prefix, source_prefix_size, first, 0, prefix_size, page.data + sizeof(PageHeader));
+    }
+    ph->prefix_size = prefix_size;
+    ph->free_start = offset;
+    for (uint16_t i = begin; i < end; i++) {
+        uint16_t suffix_len = 0;
+        const uint8_t* suffix = internal_slot_key(source, i, suffix_len);
+        InternalEntry ieheader;
+        ieheader.key_size = source_prefix_size + suffix_len - prefix_size;
+        ieheader.child_page = reinterpret_cast<InternalEntry*>(source.data + *slot_ptr(source, i))->child_page;
+        memcpy(page.data + offset, &ieheader, sizeof(ieheader));
+        copy_key_bytes(source_prefix, source_prefix_size, suffix, prefix_size, ieheader.key_size,
+                       page.data + offset + sizeof(ieheader));
+        ph->free_start += sizeof(ieheader) + ieheader.key_size;
+        insert_slot(page, ph->cell_count, offset);
+        offset = ph->free_start;
+    }
+}
+
+// Empties page's entries, keeping the rest of its header.
+static void clear_entries(Page& page) {
+    PageHeader* ph = get_header(page);
+    ph->free_start = sizeof(PageHeader);
+    ph->free_end = static_cast<uint16_t>(page_size(page));
+    ph->cell_count = 0;
+    ph->fragmented_bytes = 0;
+    ph->prefix_size = 0;
+}
+
+// Bytes a page would use holding entries [begin, end) of page and key,
+// header and slot directory included, under the prefix they would share.
+static uint32_t entries_bytes_with(Page& page, uint16_t begin, uint16_t end, const Key& key) {
+    PageHeader* ph = get_header(page);
+    uint16_t prefix_size = shared_prefix_size(page, begin, end, &key);
+    uint32_t bytes = sizeof(PageHeader) + prefix_size;
+    for (uint16_t i = begin; i < end; i++) {
+        auto* entry = reinterpret_cast<InternalEntry*>(page.data + *slot_ptr(page, i));
+        bytes += sizeof(InternalEntry) + ph->prefix_size + entry->key_size - prefix_size + sizeof(uint16_t);
+    }
+    return bytes + sizeof(InternalEntry) + key.size() - prefix_size + sizeof(uint16_t);
+}
+
+uint32_t internal_page_bytes_with(Page& page, const Key& key) {
+    return entries_bytes_with(page, 0, get_header(page)->cell_count, key);
+}
+
+uint16_t max_separator_size(uint32_t page_size) {
+    // Four of the longest fit on a page even stored whole, so whichever
+    // half of a split page a new separator goes to has room for it.
+    return static_cast<uint16_t>((page_size - sizeof(PageHeader)) / 4 - sizeof(InternalEntry) - sizeof(uint16_t));
+}
+
 bool insert_internal_no_split(Page& page, const Key& key, uint32_t child) {
     PageHeader* ph = get_header(page);
     assert(ph->page_level == PageLevel::INTERNAL);
 
-    uint16_t rec_size = sizeof(InternalEntry) + key.size();
-    if (!can_insert(page, rec_size)) return false;
-
     BSearchResult sr = internal_search_record(page, key.data(), key.size());
     if (sr.found) return false;
-    
+
+    if (compare_to_prefix(page, key.data(), key.size()) != 0 || !can_insert(page, internal_entry_size(page, key))) {
+        // Re-encode the page under the prefix key shares with it, which
+        // also reclaims removed entries; can_insert then counts the
+        // existing slots once more.
+        if (internal_page_bytes_with(page, key) + ph->cell_count * sizeof(uint16_t) > page_size(page)) {
+            return false;
+        }
+        compact_internal_page(page, &key);
+    }
+
     uint16_t offset = write_internal_entry(page, key, child);
     insert_slot(page, sr.index, offset);
     return true;
 }
 
 
-SplitInternalResult split_internal_page(TableHandle& th, Page& page) {
+void compact_internal_page(Page& page, const Key* key) {
+    Page snapshot;
+    copy_page(snapshot, page);
+    clear_entries(page);
+    write_entries(page, snapshot, 0, get_header(snapshot)->cell_count, key);
+}
+
+SplitInternalResult split_internal_page(TableHandle& th, Page& page, const Key& key, std::vector<MovedChild>& moved) {
     auto* ph = get_header(page);
     assert(ph->page_level == PageLevel::INTERNAL);
 
-    uint32_t new_pid = allocate_page(th);
-    Page new_page;
-    init_page(new_page, new_pid, PageType::INDEX, PageLevel::INTERNAL);
-
     uint16_t total = ph->cell_count;
     if (total < 2) {
         assert(false && "Cannot split internal page with less than 2 elements");
-        return {0, Key()};
-    }
-    uint16_t mid = total / 2;
-
-    uint16_t sep_len;
-    const uint8_t* sep_data = internal_slot_key(page, mid, sep_len);
-    if (sep_len > 256 || sep_data == nullptr) {
-        assert(false && "Key too large or null");
-        return {0, Key()};
+        return {};
     }
-    Key sep;
-    sep.assign(sep_data, sep_len);
 
-    uint32_t new_leftmost_child = 0;
-    if (mid < total) {
-        uint16_t mid_entry_offset = *slot_ptr(page, mid);
-        auto* mid_entry = reinterpret_cast<InternalEntry*>(page.data + mid_entry_offset);
-        new_leftmost_child = mid_entry->child_page;
+    // Split where the entries' bytes are halved rather than their count,
+    // moving off that point as far as it takes for key's half to hold key
+    // too: a key below or above every entry may not share the page's
+    // prefix, and the entries of its half then grow when re-encoded.
+    uint16_t key_index = internal_search_record(page, key.data(), key.size()).index;
+    uint16_t first = 1;
+    uint16_t last = total > 2 ? total - 2 : 1;
+    uint32_t entry_bytes = ph->free_start - sizeof(PageHeader) - ph->prefix_size;
+    uint32_t bytes = 0;
+    uint16_t middle = first;
+    for (uint16_t i = 0; i < total; i++) {
+        bytes += sizeof(InternalEntry) + reinterpret_cast<InternalEntry*>(page.data + *slot_ptr(page, i))->key_size;
+        if (bytes * 2 >= entry_bytes) {
+            middle = std::min(std::max(i, first), last);
+            break;
+        }
     }
-    
-    for (uint16_t i = mid + 1; i < total; i++) {
-        uint16_t offset = *slot_ptr(page, i);
-        auto* ieentry = reinterpret_cast<InternalEntry*>(page.data + offset);
-        uint16_t size = sizeof(InternalEntry) + ieentry->key_size;
-
-        uint8_t buf[PAGE_SIZE];
-        memcpy(buf, page.data + offset, size);
-
-        uint16_t new_off = write_raw_record(new_page, buf, size);
-        insert_slot(new_page, get_header(new_page)->cell_count, new_off);
-
-        uint32_t child_page_id = ieentry->child_page;
-        if (th.bpm) {
-            Page* child_page = th.bpm->fetch_page(child_page_id);
-            if (child_page) {
-                get_header(*child_page)->parent_page_id = new_pid;
-                th.bpm->unpin_page(child_page_id, true);
+    uint16_t mid = 0;
+    for (uint16_t distance = 0; mid == 0 && distance <= last - first; distance++) {
+        for (int candidate : {middle - distance, middle + distance}) {
+            if (candidate < first || candidate > last || mid != 0) {
+                continue;
+            }
+            // The entry at candidate moves up, so key goes to the left half
+            // when it comes before that entry.
+            bool goes_left = key_index <= candidate;
+            uint16_t begin = goes_left ? 0 : static_cast<uint16_t>(candidate + 1);
+            uint16_t end = goes_left ? static_cast<uint16_t>(candidate) : total;
+            if (entries_bytes_with(page, begin, end, key) + sizeof(uint16_t) <= page_size(page)) {
+                mid = static_cast<uint16_t>(candidate);
             }
         }
     }
-    
-    if (new_leftmost_child != 0) {
-        *reinterpret_cast<uint32_t*>(get_header(new_page)->reserved) = new_leftmost_child;
+
+    Key sep = internal_entry_key(page, mid);
+    if (mid == 0 || sep.size() > max_separator_size(page_size(page))) {
+        return {};
     }
 
-    uint16_t num_to_remove = total - mid;
-    for(uint16_t j = 0; j < num_to_remove; j++) {
-        uint16_t last_index = get_header(page)->cell_count - 1;
-        if (last_index >= mid) {
-            remove_slot(page, last_index);
-        } else {
-            break;
-        }
+    uint32_t new_pid = allocate_page(th, get_header(page)->page_id);
+    WritePageGuard new_guard = WritePageGuard::create(*th.bpm, th.file_id, new_pid, PageType::INDEX, PageLevel::INTERNAL);
+    if (!new_guard) {
+        free_page(th, new_pid);
+        return {};
     }
+    Page& new_page = new_guard.page();
 
-    auto* new_ph = get_header(new_page);
-    new_ph->parent_page_id = ph->parent_page_id;
+    // The separator moves up; its child becomes the new page's leftmost.
+    uint16_t mid_entry_offset = *slot_ptr(page, mid);
+    auto* mid_entry = reinterpret_cast<InternalEntry*>(page.data + mid_entry_offset);
+    uint32_t new_leftmost_child = mid_entry->child_page;
+    *reinterpret_cast<uint32_t*>(get_header(new_page)->reserved) = new_leftmost_child;
+    get_header(new_page)->parent_page_id = ph->parent_page_id;
 
-    if (th.bpm) {
-        Page* new_bp = th.bpm->new_page(new_pid, PageType::INDEX, PageLevel::INTERNAL);
-        if (new_bp) {
-            memcpy(new_bp->data, new_page.data, PAGE_SIZE);
-            th.bpm->unpin_page(new_pid, true);
-        }
+    moved.push_back({new_leftmost_child, new_pid});
+    for (uint16_t i = mid + 1; i < total; i++) {
+        moved.push_back({reinterpret_cast<InternalEntry*>(page.data + *slot_ptr(page, i))->child_page, new_pid});
     }
 
-    return { new_pid, sep, page, new_page };
+    // Both halves are rebuilt from a snapshot, each under the prefix its
+    // own entries share, which is often longer than the whole page's.
+    Page old_page;
+    copy_page(old_page, page);
+    write_entries(new_page, old_page, mid + 1, total, nullptr);
+    clear_entries(page);
+    write_entries(page, old_page, 0, mid, nullptr);
+
+    th.btree_stats.internal_splits++;
+    return {new_pid, sep, std::move(new_guard)};
 }
 
-void create_new_root(TableHandle& th, uint32_t left, const Key& key, uint32_t right) {
+bool create_new_root(TableHandle& th, WritePageGuard& left, const Key& key, WritePageGuard& right) {
     if (!th.bpm) {
-        return;
+        return false;
     }
     uint32_t new_root_id = allocate_page(th);
-    Page* root = th.bpm->new_page(new_root_id, PageType::INDEX, PageLevel::INTERNAL);
+    WritePageGuard root = WritePageGuard::create(*th.bpm, th.file_id, new_root_id, PageType::INDEX, PageLevel::INTERNAL);
     if (!root) {
-        return;
+        free_page(th, new_root_id);
+        return false;
     }
 
-    auto* root_ph = get_header(*root);
-    *reinterpret_cast<uint32_t*>(root_ph->reserved) = left;
-    root_ph->root_page = left;
+    auto* root_ph = get_header(root.page());
+    *reinterpret_cast<uint32_t*>(root_ph->reserved) = left.page_id();
+    root_ph->root_page = left.page_id();
 
-    uint16_t offset = write_internal_entry(*root, key, right);
-    insert_slot(*root, 0, offset);
-
-    th.root_page = new_root_id;
-
-    Page* meta = th.bpm->fetch_page(0);
-    if (meta) {
-        get_header(*meta)->root_page = new_root_id;
-        th.bpm->unpin_page(0, true);
-    }
+    uint16_t offset = write_internal_entry(root.page(), key, right.page_id());
+    insert_slot(root.page(), 0, offset);
 
-    th.bpm->unpin_page(new_root_id, true);
+    get_header(left.page())->parent_page_id = new_root_id;
+    left.mark_dirty();
+    get_header(right.page())->parent_page_id = new_root_id;
+    right.mark_dirty();
 
-    Page* left_page = th.bpm->fetch_page(left);
-    if (left_page) {
-        get_header(*left_page)->parent_page_id = new_root_id;
-        th.bpm->unpin_page(left, true);
-    }
+    // Readers that find the new root wait on its latch until the split is
+    // done; those that latched the old one see it is no longer the root.
+    set_root_page(th, new_root_id);
+    return true;
+}
 
-    Page* right_page = th.bpm->fetch_page(right);
-    if (right_page) {
-        get_header(*right_page)->parent_page_id = new_root_id;
-        th.bpm->unpin_page(right, true);
+bool insert_into_parent(TableHandle& th, std::vector<WritePageGuard>& path, size_t level, const Key& key,
+                        WritePageGuard& right, std::vector<MovedChild>& moved) {
+    WritePageGuard& left = path[level];
+    if (level == 0) {
+        return create_new_root(th, left, key, right);
     }
-}
+    WritePageGuard& parent = path[level - 1];
+    Page& page = parent.page();
+    auto* ph = get_header(page);
 
-void insert_into_parent(TableHandle& th, uint32_t left, const Key& key, uint32_t right) {
-    if (!th.bpm) {
-        return;
+    BSearchResult sr = internal_search_record(page, key.data(), key.size());
+    if (sr.found) {
+        assert(false && "Separator already in parent");
+        return false;
     }
-    Page* left_page = th.bpm->fetch_page(left);
-    if (!left_page) {
-        return;
+    if (key.size() > max_separator_size(page_size(page))) {
+        return false;
     }
-    auto* lh = get_header(*left_page);
-    uint32_t parent_pid = lh->parent_page_id;
-    th.bpm->unpin_page(left, false);
 
-    if (parent_pid == 0 || parent_pid == INVALID_PAGE_ID) {
-        create_new_root(th, left, key, right);
-        return;
+    if (sr.index == 0) {
+        *reinterpret_cast<uint32_t*>(ph->reserved) = left.page_id();
     }
 
-    Page* parent = th.bpm->fetch_page(parent_pid);
-    if (!parent) {
-        return;
-    }
-    auto* ph = get_header(*parent);
-    if (ph->page_level != PageLevel::INTERNAL) {
-        th.bpm->unpin_page(parent_pid, false);
-        create_new_root(th, left, key, right);
-        return;
+    // insert_internal_no_split compacts and re-encodes the page itself when
+    // that makes room.
+    bool had_room = can_insert(page, internal_entry_size(page, key));
+    if (insert_internal_no_split(page, key, right.page_id())) {
+        if (!had_room) {
+            th.btree_stats.splits_avoided++;
+        }
+        parent.mark_dirty();
+        return true;
     }
 
-    BSearchResult sr = internal_search_record(*parent, key.data(), key.size());
-    if (sr.found) {
-        th.bpm->unpin_page(parent_pid, false);
-        create_new_root(th, left, key, right);
-        return;
+    // Kept so that the split can be taken back if the level above cannot
+    // take the new page.
+    Page before;
+    copy_page(before, page);
+    size_t first_moved = moved.size();
+    SplitInternalResult split = split_internal_page(th, page, key, moved);
+    if (split.new_page == 0) {
+        return false;
     }
-
-    if (sr.index == 0) {
-        *reinterpret_cast<uint32_t*>(ph->reserved) = left;
+    parent.mark_dirty();
+
+    // The split left (key, right) out; add it to whichever half now covers
+    // key, which split_internal_page left room in.
+    bool goes_left = compare_keys(key.data(), key.size(), split.seperator_key.data(), split.seperator_key.size()) < 0;
+    WritePageGuard& target = goes_left ? parent : split.sibling;
+    if (!insert_internal_no_split(target.page(), key, right.page_id()) ||
+        !insert_into_parent(th, path, level - 1, split.seperator_key, split.sibling, moved)) {
+        copy_page(page, before);
+        moved.resize(first_moved);
+        split.sibling.release();
+        free_page(th, split.new_page);
+        th.btree_stats.internal_splits--;
+        return false;
     }
 
-    if (insert_internal_no_split(*parent, key, right)) {
-        th.bpm->unpin_page(parent_pid, true);
-        return;
+    // left is latched here already; the children no one holds are pointed
+    // at the new page once the split lets go.
+    for (size_t i = first_moved; i < moved.size(); i++) {
+        if (moved[i].page_id == left.page_id()) {
+            get_header(left.page())->parent_page_id = split.new_page;
+            left.mark_dirty();
+            moved.erase(moved.begin() + static_cast<std::ptrdiff_t>(i));
+            break;
+        }
     }
+    get_header(right.page())->parent_page_id = target.page_id();
+    right.mark_dirty();
+    return true;
+}
 
-    auto split = split_internal_page(th, *parent);
-    th.bpm->unpin_page(parent_pid, true);
-    insert_into_parent(th, parent_pid, split.seperator_key, split.new_page);
+void set_moved_parents(TableHandle& th, const std::vector<MovedChild>& moved) {
+    for (const MovedChild& child : moved) {
+        WritePageGuard guard(*th.bpm, th.file_id, child.page_id);
+        if (guard) {
+            get_header(guard.page())->parent_page_id = child.parent_page_id;
+            guard.mark_dirty();
+        }
+    }
 }
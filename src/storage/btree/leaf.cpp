@@ -4,98 +4,153 @@
 #include "storage/table_handle.hpp"
 #include "storage/buffer_pool.hpp"
 #include "storage/record.hpp"
+#include <algorithm>
 #include <cassert>
 #include <vector>
 #include <cstring>
 
-uint32_t find_leaf_page(TableHandle& th, const Key& key, Page& out_page) {
-    if (!th.bpm) {
-        return UINT32_MAX;
+ReadPageGuard read_page_guard(TableHandle& th, uint32_t page_id, AccessType access_type) {
+    if (th.mapping) {
+        Page* page = th.mapping->page(page_id);
+        if (page != nullptr) {
+            return ReadPageGuard::mapped(*page, page_id);
+        }
     }
-    uint32_t page_id = th.root_page;
-    int depth = 0;
+    return ReadPageGuard(*th.bpm, th.file_id, page_id, access_type);
+}
 
-    while (true) {
-        Page* page = th.bpm->fetch_page(page_id);
-        if (!page) {
-            return UINT32_MAX;
+// Picked by guard type in descend_to_leaf; writers always go through the pool.
+static ReadPageGuard fetch_guard(TableHandle& th, uint32_t page_id, const ReadPageGuard*) {
+    return read_page_guard(th, page_id);
+}
+
+static WritePageGuard fetch_guard(TableHandle& th, uint32_t page_id, const WritePageGuard*) {
+    return WritePageGuard(*th.bpm, th.file_id, page_id);
+}
+
+// Latch coupling: the child is fetched and latched before the guard on its
+// parent is replaced. Internal pages use the same guard type as the leaf.
+// The root may move (compaction does that) and its old page be freed
+// between reading th.root_page and latching it, so the latched page only
+// counts as the root if th.root_page still names it.
+template <typename Guard>
+static Guard descend_to_leaf(TableHandle& th, const Key* key) {
+    if (!th.bpm) {
+        return Guard();
+    }
+    Guard guard;
+    for (int attempt = 0; attempt < 100; attempt++) {
+        uint32_t root_page = th.root_page;
+        if (root_page == 0) {
+            return Guard();
+        }
+        guard = fetch_guard(th, root_page, static_cast<const Guard*>(nullptr));
+        if (!guard || root_page == th.root_page) {
+            break;
         }
-        auto* ph = get_header(*page);
+        guard = Guard();
+    }
+    int depth = 0;
 
+    while (guard) {
+        PageHeader* ph = get_header(guard.page());
         if (ph->page_level == PageLevel::LEAF) {
-            std::memcpy(out_page.data, page->data, PAGE_SIZE);
-            th.bpm->unpin_page(page_id, false);
-            return page_id;
+            return guard;
+        }
+        if (ph->page_level != PageLevel::INTERNAL) {
+            return Guard();
         }
 
-        uint32_t next_page_id = internal_find_child(*page, key);
-        th.bpm->unpin_page(page_id, false);
-        if (next_page_id == 0 || next_page_id >= 1000000) {
-            return UINT32_MAX;
+        uint32_t next_page_id = key != nullptr
+            ? internal_find_child(guard.page(), *key)
+            : *reinterpret_cast<uint32_t*>(ph->reserved);
+        if (next_page_id == 0 || next_page_id == INVALID_PAGE_ID) {
+            return Guard();
         }
 
-        page_id = next_page_id;
+        guard = fetch_guard(th, next_page_id, static_cast<const Guard*>(nullptr));
         depth++;
         if (depth > 100) {
-            return UINT32_MAX;
+            return Guard();
         }
     }
+    return guard;
+}
+
+ReadPageGuard find_leaf_page(TableHandle& th, const Key& key) {
+    return descend_to_leaf<ReadPageGuard>(th, &key);
+}
+
+WritePageGuard find_leaf_page_for_write(TableHandle& th, const Key& key) {
+    return descend_to_leaf<WritePageGuard>(th, &key);
+}
+
+ReadPageGuard find_leftmost_leaf_page(TableHandle& th) {
+    return descend_to_leaf<ReadPageGuard>(th, nullptr);
 }
 
-uint32_t find_leftmost_leaf_page(TableHandle& th, Page& out_page) {
-    if (!th.bpm || th.root_page == 0) {
-        return UINT32_MAX;
+bool find_path_for_write(TableHandle& th, const Key& key, std::vector<WritePageGuard>& path) {
+    path.clear();
+    if (!th.bpm) {
+        return false;
     }
-    uint32_t page_id = th.root_page;
-    int depth = 0;
-    while (true) {
-        Page* page = th.bpm->fetch_page(page_id);
-        if (!page) {
-            return UINT32_MAX;
+    for (int attempt = 0; attempt < 100 && path.empty(); attempt++) {
+        uint32_t root_page = th.root_page;
+        if (root_page == 0) {
+            return false;
+        }
+        WritePageGuard root(*th.bpm, th.file_id, root_page);
+        if (!root) {
+            return false;
         }
-        PageHeader* ph = get_header(*page);
+        if (root_page == th.root_page) {
+            path.push_back(std::move(root));
+        }
+    }
+
+    while (!path.empty() && path.size() <= 100) {
+        PageHeader* ph = get_header(path.back().page());
         if (ph->page_level == PageLevel::LEAF) {
-            std::memcpy(out_page.data, page->data, PAGE_SIZE);
-            th.bpm->unpin_page(page_id, false);
-            return page_id;
+            return true;
         }
         if (ph->page_level != PageLevel::INTERNAL) {
-            th.bpm->unpin_page(page_id, false);
-            return UINT32_MAX;
+            break;
         }
-        uint32_t* leftmost_ptr = reinterpret_cast<uint32_t*>(ph->reserved);
-        uint32_t next_page_id = *leftmost_ptr;
-        th.bpm->unpin_page(page_id, false);
-        if (next_page_id == 0) {
-            return UINT32_MAX;
+        uint32_t child = internal_find_child(path.back().page(), key);
+        if (child == 0 || child == INVALID_PAGE_ID) {
+            break;
         }
-        page_id = next_page_id;
-        depth++;
-        if (depth > 100) {
-            return UINT32_MAX;
+        WritePageGuard guard(*th.bpm, th.file_id, child);
+        if (!guard) {
+            break;
         }
+        path.push_back(std::move(guard));
     }
+    path.clear();
+    return false;
 }
 
-bool btree_insert_leaf_no_split(TableHandle& th, uint32_t page_id, Page& page, const Key& key, const Value& value) {
-    (void)page;
-    if (!th.bpm) {
-        return false;
-    }
-    Page* p = th.bpm->fetch_page(page_id);
-    if (!p) {
-        return false;
-    }
+bool btree_insert_leaf_no_split(Page& page, const Key& key, const Value& value) {
     uint16_t rec_size = record_size(static_cast<uint16_t>(key.size()), static_cast<uint16_t>(value.size()));
-    if (!can_insert(*p, rec_size)) {
-        th.bpm->unpin_page(page_id, false);
+    if (!can_insert(page, rec_size)) {
         return false;
     }
-    page_insert(*p, key.data(), static_cast<uint16_t>(key.size()), value.data(), static_cast<uint16_t>(value.size()));
-    th.bpm->unpin_page(page_id, true);
-    return true;
+    return page_insert(page, key.data(), static_cast<uint16_t>(key.size()), value.data(), static_cast<uint16_t>(value.size()));
 }
 
+Key shortest_separator(const uint8_t* left, uint16_t left_size, const uint8_t* right, uint16_t right_size) {
+    // right is greater, so it either has left as a prefix or first differs
+    // from it at a greater byte; either way one byte past the shared prefix
+    // is enough.
+    uint16_t size = 0;
+    while (size < left_size && size < right_size && left[size] == right[size]) {
+        size++;
+    }
+    return Key::owned(right, std::min<uint16_t>(size + 1, right_size));
+}
+
+// Splits a latched leaf in place: the upper half of its records moves to a
+// freshly allocated right sibling. The caller marks the leaf dirty.
 SplitLeafResult split_leaf_page(TableHandle& th, Page& page) {
     PageHeader* ph = get_header(page);
     assert(ph->page_level == PageLevel::LEAF);
@@ -103,7 +158,7 @@ SplitLeafResult split_leaf_page(TableHandle& th, Page& page) {
     uint16_t total = ph->cell_count;
     if (total == 0) {
         assert(false && "Cannot split empty page");
-        return {0, Key()};
+        return {};
     }
 
     uint16_t split_idx = total / 2;
@@ -111,122 +166,75 @@ SplitLeafResult split_leaf_page(TableHandle& th, Page& page) {
         split_idx = 1;
     }
 
+    // The separator is settled before anything changes: one that no
+    // internal page could hold fails the split with the leaf as it was.
+    uint16_t left_len = 0;
+    const uint8_t* left_data = slot_key(page, split_idx - 1, left_len);
+    uint16_t sep_len = 0;
+    const uint8_t* sep_data = slot_key(page, split_idx, sep_len);
+    if (left_data == nullptr || sep_data == nullptr || sep_len == 0) {
+        assert(false && "Failed to read separator keys");
+        return {};
+    }
+    Key sep_key = shortest_separator(left_data, left_len, sep_data, sep_len);
+    if (sep_key.size() > max_separator_size(page_size(page))) {
+        return {};
+    }
+
     uint32_t left_page_id = ph->page_id;
     uint32_t saved_parent_id = ph->parent_page_id;
+    uint32_t saved_prev_page_id = ph->prev_page_id;
     uint32_t old_next_page_id = ph->next_page_id;
 
-    struct Record {
-        std::vector<uint8_t> key;
-        std::vector<uint8_t> value;
-    };
-    std::vector<Record> all_records;
-    
-    for (uint16_t i = 0; i < total; i++) {
-        uint16_t key_len = 0;
-        const uint8_t* key_data = slot_key(page, i, key_len);
-        uint16_t value_len = 0;
-        const uint8_t* value_data = slot_value(page, i, value_len);
-        
-        if (key_data == nullptr || value_data == nullptr) {
-            assert(false && "Failed to read record");
-            return {0, Key()};
-        }
-        
-        Record rec;
-        rec.key.assign(key_data, key_data + key_len);
-        rec.value.assign(value_data, value_data + value_len);
-        all_records.push_back(std::move(rec));
+    // Right next to the left half, so a scan reads on in the same extent.
+    uint32_t new_page_id = allocate_page(th, left_page_id);
+    WritePageGuard new_guard = WritePageGuard::create(*th.bpm, th.file_id, new_page_id, PageType::DATA, PageLevel::LEAF);
+    if (!new_guard) {
+        free_page(th, new_page_id);
+        return {};
     }
+    Page& new_page = new_guard.page();
+
+    // Both halves are rebuilt from a snapshot, which also compacts the left
+    // page.
+    Page old_page;
+    copy_page(old_page, page);
 
-    init_page(page, left_page_id, PageType::DATA, PageLevel::LEAF);
+    init_page(page, left_page_id, PageType::DATA, PageLevel::LEAF, page_size(old_page));
     ph = get_header(page);
     ph->parent_page_id = saved_parent_id;
+    ph->prev_page_id = saved_prev_page_id;
 
-    uint32_t new_page_id = allocate_page(th);
-    Page new_page;
-    init_page(new_page, new_page_id, PageType::DATA, PageLevel::LEAF);
     PageHeader* new_ph = get_header(new_page);
     new_ph->parent_page_id = saved_parent_id;
 
-    std::vector<uint16_t> left_offsets;
-    for (uint16_t i = 0; i < split_idx; i++) {
-        const auto& rec = all_records[i];
-        uint16_t offset = write_record(page, rec.key.data(), static_cast<uint16_t>(rec.key.size()), rec.value.data(), static_cast<uint16_t>(rec.value.size()));
-        left_offsets.push_back(offset);
-    }
-    ph = get_header(page);
-    ph->free_end = PAGE_SIZE - static_cast<uint16_t>(left_offsets.size() * sizeof(uint16_t));
-    for (uint16_t i = 0; i < left_offsets.size(); i++) {
-        uint16_t* slot = reinterpret_cast<uint16_t*>(page.data + ph->free_end + i * sizeof(uint16_t));
-        *slot = left_offsets[i];
-    }
-    ph->cell_count = static_cast<uint16_t>(left_offsets.size());
-
-    std::vector<uint16_t> right_offsets;
-    for (uint16_t i = split_idx; i < total; i++) {
-        const auto& rec = all_records[i];
-        uint16_t offset = write_record(new_page, rec.key.data(), static_cast<uint16_t>(rec.key.size()), rec.value.data(), static_cast<uint16_t>(rec.value.size()));
-        right_offsets.push_back(offset);
-    }
-    new_ph = get_header(new_page);
-    new_ph->free_end = PAGE_SIZE - static_cast<uint16_t>(right_offsets.size() * sizeof(uint16_t));
-    for (uint16_t i = 0; i < right_offsets.size(); i++) {
-        uint16_t* slot = reinterpret_cast<uint16_t*>(new_page.data + new_ph->free_end + i * sizeof(uint16_t));
-        *slot = right_offsets[i];
-    }
-    new_ph->cell_count = static_cast<uint16_t>(right_offsets.size());
-
-    ph = get_header(page);
-    new_ph = get_header(new_page);
-
-    if (ph->cell_count == 0 || new_ph->cell_count == 0) {
-        assert(false && "Page is empty after split");
-        return {0, Key()};
-    }
-
-    uint16_t sep_len;
-    const uint8_t* sep_data = slot_key(new_page, 0, sep_len);
-    if (sep_data == nullptr || sep_len == 0) {
-        assert(false && "Failed to get separator key from new page");
-        return {0, Key()};
-    }
-    
-    if (sep_len > 256) {
-        assert(false && "Separator key too large");
-        return {0, Key()};
+    for (uint16_t i = 0; i < total; i++) {
+        uint16_t key_len = 0;
+        const uint8_t* key_data = slot_key(old_page, i, key_len);
+        uint16_t value_len = 0;
+        const uint8_t* value_data = slot_value(old_page, i, value_len);
+        if (key_data == nullptr || value_data == nullptr) {
+            assert(false && "Failed to read record");
+            return {};
+        }
+        Page& target = i < split_idx ? page : new_page;
+        uint16_t offset = write_record(target, key_data, key_len, value_data, value_len);
+        insert_slot(target, get_header(target)->cell_count, offset);
     }
-    
-    Key sep_key;
-    sep_key.assign(sep_data, sep_len);
 
     ph->next_page_id = new_page_id;
     new_ph->prev_page_id = left_page_id;
     new_ph->next_page_id = old_next_page_id;
-    if (old_next_page_id != 0 && th.bpm) {
-        Page* old_next = th.bpm->fetch_page(old_next_page_id);
-        if (old_next) {
-            get_header(*old_next)->prev_page_id = new_page_id;
-            th.bpm->unpin_page(old_next_page_id, true);
-        }
-    }
 
-    if (th.bpm) {
-        Page* left_bp = th.bpm->fetch_page(left_page_id);
-        if (left_bp) {
-            std::memcpy(left_bp->data, page.data, PAGE_SIZE);
-            th.bpm->unpin_page(left_page_id, true);
-        }
-        Page* right_bp = th.bpm->new_page(new_page_id, PageType::DATA, PageLevel::LEAF);
-        if (right_bp) {
-            std::memcpy(right_bp->data, new_page.data, PAGE_SIZE);
-            th.bpm->unpin_page(new_page_id, true);
+    // Latched after the leaf, in chain order, as a scan moves.
+    if (old_next_page_id != 0) {
+        WritePageGuard old_next(*th.bpm, th.file_id, old_next_page_id);
+        if (old_next) {
+            get_header(old_next.page())->prev_page_id = new_page_id;
+            old_next.mark_dirty();
         }
     }
 
-    return {
-        new_page_id,
-        sep_key,
-        page,
-        new_page
-    };
+    th.btree_stats.leaf_splits++;
+    return {new_page_id, sep_key, std::move(new_guard)};
 }
@@ -1,249 +1,1150 @@
 #include "storage/buffer_pool.hpp"
 #include "storage/page.hpp"
-#include <algorithm>
 #include <stdexcept>
 #include <cstring>
+#include <algorithm>
+#include <chrono>
 
-BufferPoolManager::BufferPoolManager(DiskManager& disk_manager, size_t pool_size)
-    : disk_manager_(disk_manager), pool_size_(pool_size) {
-    frames_.resize(pool_size_);
-    
-    for (size_t i = 0; i < pool_size_; ++i) {
-        lru_list_.push_back(i);
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// Hands the OS pages wholly inside [data, data + size) back; they read as
+// zeros if touched again.
+void discard_memory(uint8_t* data, size_t size) {
+#ifdef MADV_DONTNEED
+    uintptr_t os_page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t begin = (reinterpret_cast<uintptr_t>(data) + os_page - 1) & ~(os_page - 1);
+    uintptr_t end = (reinterpret_cast<uintptr_t>(data) + size) & ~(os_page - 1);
+    if (end > begin) {
+        madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+    }
+#else
+    (void)data;
+    (void)size;
+#endif
+}
+}
+
+BufferPoolManager::BufferPoolManager(size_t pool_size, ReplacerPolicy policy, IoBackend io_backend, uint32_t page_size)
+    : io_backend_(io_backend), shard_count_(1), frames_per_shard_(pool_size), shard_bits_(0), pool_size_(pool_size),
+      frame_limit_(pool_size), page_size_(page_size) {
+    while (shard_count_ * 2 <= BUFFER_POOL_SHARDS && pool_size_ / (shard_count_ * 2) >= MIN_FRAMES_PER_SHARD) {
+        shard_count_ *= 2;
+        shard_bits_++;
+    }
+
+    write_back_io_ = std::make_unique<IoQueue>(IO_QUEUE_DEPTH, io_backend);
+    io_backend_ = write_back_io_->backend();
+
+    frames_ = std::make_unique<Frame[]>(pool_size_);
+    page_memory_ = std::make_unique<uint8_t[]>(pool_size_ * page_size_);
+    shards_ = std::make_unique<Shard[]>(shard_count_);
+
+    frames_per_shard_ = pool_size_ / shard_count_;
+    for (size_t s = 0; s < shard_count_; ++s) {
+        Shard& shard = shards_[s];
+        size_t first = s * frames_per_shard_;
+        size_t count = (s + 1 == shard_count_) ? pool_size_ - first : frames_per_shard_;
+        shard.first_frame = first;
+        shard.frame_count = count;
+        shard.frame_limit = count;
+        shard.active_frames = count;
+        shard.replacer = make_replacer(policy, count);
+        shard.page_table.reserve(count);
+
+        // Hand out low frame ids first.
+        shard.free_frames.reserve(count);
+        for (size_t i = first + count; i > first; --i) {
+            shard.free_frames.push_back(i - 1);
+        }
     }
 }
 
 BufferPoolManager::~BufferPoolManager() {
+    {
+        std::lock_guard<std::mutex> lock(read_ahead_mutex_);
+        read_ahead_stop_ = true;
+    }
+    read_ahead_cv_.notify_all();
+    if (read_ahead_thread_.joinable()) {
+        read_ahead_thread_.join();
+    }
+    stop_page_cleaner();
     flush_all();
 }
 
-Page* BufferPoolManager::fetch_page(uint32_t page_id) {
-    auto it = page_table_.find(page_id);
-    if (it != page_table_.end()) {
-        size_t frame_id = it->second;
-        Frame& frame = frames_[frame_id];
-        frame.pin_count++;
-        mark_frame_used(frame_id);
-        return &frame.page;
+size_t BufferPoolManager::frames_for_budget(size_t budget_bytes, uint32_t page_size) {
+    size_t frames = budget_bytes / page_size;
+    return frames == 0 ? 1 : frames;
+}
+
+FileId BufferPoolManager::attach_file(DiskManager& disk_manager) {
+    if (disk_manager.get_page_size() != page_size_) {
+        return INVALID_FILE_ID;
+    }
+    std::unique_lock<std::shared_mutex> lock(files_latch_);
+    if (!free_file_ids_.empty()) {
+        FileId file_id = free_file_ids_.back();
+        free_file_ids_.pop_back();
+        files_[file_id] = &disk_manager;
+        return file_id;
     }
+    files_.push_back(&disk_manager);
+    return static_cast<FileId>(files_.size() - 1);
+}
 
-    size_t frame_id = find_or_evict_frame();
-    if (frame_id == SIZE_MAX) {
-        return nullptr;
+bool BufferPoolManager::detach_file(FileId file_id) {
+    if (file_for(file_id) == nullptr) {
+        return true;
     }
 
-    Frame& frame = frames_[frame_id];
-    
-    if (frame.page_id != INVALID_PAGE_ID) {
-        if (!evict_frame(frame_id)) {
+    // Drop queued read-ahead for the file and wait out a page being read in.
+    std::lock_guard<std::mutex> read_ahead_load(read_ahead_load_latch_);
+    {
+        std::lock_guard<std::mutex> lock(read_ahead_mutex_);
+        read_ahead_queue_.erase(std::remove_if(read_ahead_queue_.begin(), read_ahead_queue_.end(),
+                                               [this, file_id](const std::pair<FileId, uint32_t>& entry) {
+                                                   if (entry.first != file_id) {
+                                                       return false;
+                                                   }
+                                                   read_ahead_queued_.erase(page_key(entry.first, entry.second));
+                                                   return true;
+                                               }),
+                                read_ahead_queue_.end());
+        read_ahead_queued_count_ = read_ahead_queued_.size();
+    }
+
+    // The caller has stopped using the file, but a fetch of another file
+    // may be writing one of its pages out as a victim, pinned and through
+    // the file's DiskManager. Wait those out; no new one starts while the
+    // shard latch is held. The rest are unpinned and can be written back
+    // without taking frame latches.
+    std::lock_guard<std::mutex> write_back(write_back_latch_);
+    for (size_t s = 0; s < shard_count_; ++s) {
+        Shard& shard = shards_[s];
+        std::unique_lock<std::mutex> lock(shard.latch);
+        shard.write_cv.wait(lock, [&] {
+            for (auto& [key, frame_id] : shard.page_table) {
+                if (frames_[frame_id].file_id == file_id && frames_[frame_id].writing) {
+                    return false;
+                }
+            }
+            return true;
+        });
+        for (auto it = shard.page_table.begin(); it != shard.page_table.end();) {
+            size_t frame_id = it->second;
+            Frame& frame = frames_[frame_id];
+            if (frame.file_id != file_id) {
+                ++it;
+                continue;
+            }
+            // Dropping a page that did not reach the file would lose it, and
+            // freeing a pinned frame would hand it out under its holder, so
+            // leave it and the rest of the file cached and attached.
+            if (frame.pin_count.load() > 0 || !write_frame(frame_id)) {
+                return false;
+            }
+            it = shard.page_table.erase(it);
+            shard.replacer->remove(frame_id - shard.first_frame);
+            release_frame(shard, frame_id);
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> files_lock(files_latch_);
+    files_[file_id] = nullptr;
+    free_file_ids_.push_back(file_id);
+    return true;
+}
+
+Page* BufferPoolManager::fetch_page(FileId file_id, uint32_t page_id, AccessType access_type) {
+    uint64_t key = page_key(file_id, page_id);
+    Shard& shard = shard_for(key);
+    std::unique_lock<std::mutex> lock(shard.latch);
+
+    DiskManager* disk_manager = nullptr;
+    size_t frame_id;
+    while (true) {
+        auto it = shard.page_table.find(key);
+        if (it != shard.page_table.end()) {
+            frame_id = it->second;
+            shard.stats.hits++;
+            Frame& frame = frames_[frame_id];
+            if (frame.prefetched) {
+                // Read-ahead only parked the page; let the replacer see this
+                // fetch as its first access.
+                frame.prefetched = false;
+                shard.stats.prefetch_used++;
+                shard.replacer->remove(frame_id - shard.first_frame);
+            }
+            pin_frame(shard, frame_id, access_type);
+            if (frame.loading && !wait_for_load(shard, lock, frame_id, key)) {
+                return nullptr;
+            }
+            return &page_at(frame_id);
+        }
+
+        disk_manager = file_for(file_id);
+        if (disk_manager == nullptr) {
             return nullptr;
         }
+        frame_id = claim_frame(shard, lock);
+        if (frame_id == SIZE_MAX) {
+            return nullptr;
+        }
+        // Another thread may have loaded the page while claim_frame wrote a
+        // victim back.
+        if (shard.page_table.count(key) == 0) {
+            break;
+        }
+        release_frame(shard, frame_id);
+    }
+
+    // Map the page as loading before reading it, so fetches of it wait for
+    // this read instead of starting their own, and read it without the
+    // shard latch.
+    shard.stats.misses++;
+    Frame& frame = frames_[frame_id];
+    frame.file_id = file_id;
+    frame.page_id = page_id;
+    frame.loading = true;
+    shard.page_table[key] = frame_id;
+    pin_frame(shard, frame_id, access_type);
+
+    // The reader got here before the read-ahead thread. Drop the request, or
+    // the thread would read the page back in after the reader has moved on.
+    if (!shard.read_ahead_in_flight.empty()) {
+        shard.read_ahead_in_flight.erase(key);
+    }
+    lock.unlock();
+    // The count is only a hint: a page queued just after it is read is
+    // found cached when the thread gets to it.
+    if (read_ahead_queued_count_.load() != 0) {
+        std::lock_guard<std::mutex> read_ahead_lock(read_ahead_mutex_);
+        if (read_ahead_queued_.erase(key) != 0) {
+            read_ahead_queued_count_ = read_ahead_queued_.size();
+        }
     }
 
+    bool loaded = true;
     try {
-        disk_manager_.read_page(static_cast<int>(page_id), frame.page.data);
+        disk_manager->read_page(page_id, page_at(frame_id).data);
     } catch (const std::exception&) {
-        return nullptr;
+        loaded = false;
     }
 
-    frame.page_id = page_id;
-    frame.pin_count = 1;
-    frame.dirty = false;
-    page_table_[page_id] = frame_id;
-    mark_frame_used(frame_id);
+    lock.lock();
+    frame.loading = false;
+    if (!loaded) {
+        shard.page_table.erase(key);
+        unpin_failed_load(shard, frame_id);
+    }
+    shard.load_cv.notify_all();
+    return loaded ? &page_at(frame_id) : nullptr;
+}
 
-    return &frame.page;
+bool BufferPoolManager::wait_for_load(Shard& shard, std::unique_lock<std::mutex>& lock, size_t frame_id, uint64_t key) {
+    shard.load_cv.wait(lock, [&] { return !frames_[frame_id].loading; });
+    // A failed read unmaps the page; the pin keeps the frame from being
+    // reused for another page meanwhile.
+    auto it = shard.page_table.find(key);
+    if (it != shard.page_table.end() && it->second == frame_id) {
+        return true;
+    }
+    unpin_failed_load(shard, frame_id);
+    return false;
 }
 
-bool BufferPoolManager::unpin_page(uint32_t page_id, bool dirty) {
-    auto it = page_table_.find(page_id);
-    if (it == page_table_.end()) {
+void BufferPoolManager::unpin_failed_load(Shard& shard, size_t frame_id) {
+    if (frames_[frame_id].pin_count.fetch_sub(1) == 1) {
+        shard.pinned_count--;
+        shard.replacer->remove(frame_id - shard.first_frame);
+        release_frame(shard, frame_id);
+    }
+}
+
+bool BufferPoolManager::unpin_page(FileId file_id, uint32_t page_id, bool dirty) {
+    uint64_t key = page_key(file_id, page_id);
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.latch);
+
+    auto it = shard.page_table.find(key);
+    if (it == shard.page_table.end()) {
         return false;
     }
 
-    size_t frame_id = it->second;
+    return unpin_frame(shard, it->second, dirty);
+}
+
+bool BufferPoolManager::unpin_page(const Page* page, bool dirty) {
+    size_t frame_id = frame_of(page);
+    Shard& shard = shards_[std::min(frame_id / frames_per_shard_, shard_count_ - 1)];
+    std::lock_guard<std::mutex> lock(shard.latch);
+    return unpin_frame(shard, frame_id, dirty);
+}
+
+bool BufferPoolManager::unpin_frame(Shard& shard, size_t frame_id, bool dirty) {
     Frame& frame = frames_[frame_id];
 
-    if (frame.pin_count == 0) {
+    if (frame.pin_count.load() == 0) {
         return false;
     }
 
-    frame.pin_count--;
     if (dirty) {
-        frame.dirty = true;
+        mark_dirty(frame);
     }
 
-    if (frame.pin_count == 0) {
-        auto lru_it = std::find(lru_list_.begin(), lru_list_.end(), frame_id);
-        if (lru_it == lru_list_.end()) {
-            lru_list_.push_back(frame_id);
-        }
+    if (frame.pin_count.fetch_sub(1) == 1) {
+        shard.pinned_count--;
+        shard.replacer->set_evictable(frame_id - shard.first_frame, true);
     }
 
     return true;
 }
 
-Page* BufferPoolManager::new_page(uint32_t page_id, PageType page_type, PageLevel page_level) {
-    auto it = page_table_.find(page_id);
-    if (it != page_table_.end()) {
-        size_t frame_id = it->second;
-        Frame& frame = frames_[frame_id];
-        frame.pin_count++;
-        mark_frame_used(frame_id);
-        return &frame.page;
-    }
+Page* BufferPoolManager::new_page(FileId file_id, uint32_t page_id, PageType page_type, PageLevel page_level) {
+    uint64_t key = page_key(file_id, page_id);
+    Shard& shard = shard_for(key);
+    std::unique_lock<std::mutex> lock(shard.latch);
 
-    size_t frame_id = find_or_evict_frame();
-    if (frame_id == SIZE_MAX) {
-        return nullptr;
-    }
+    size_t frame_id;
+    while (true) {
+        auto it = shard.page_table.find(key);
+        if (it != shard.page_table.end()) {
+            // A freed page that is still cached must not leak its old contents
+            // into the page being allocated in its place.
+            frame_id = it->second;
+            if (frames_[frame_id].prefetched) {
+                frames_[frame_id].prefetched = false;
+                shard.replacer->remove(frame_id - shard.first_frame);
+            }
+            pin_frame(shard, frame_id, AccessType::DEFAULT);
+            if (frames_[frame_id].loading && !wait_for_load(shard, lock, frame_id, key)) {
+                continue;
+            }
+            init_page(page_at(frame_id), page_id, page_type, page_level, page_size_);
+            mark_dirty(frames_[frame_id]);
+            return &page_at(frame_id);
+        }
 
-    Frame& frame = frames_[frame_id];
-    
-    if (frame.page_id != INVALID_PAGE_ID) {
-        if (!evict_frame(frame_id)) {
+        if (file_for(file_id) == nullptr) {
             return nullptr;
         }
+        frame_id = claim_frame(shard, lock);
+        if (frame_id == SIZE_MAX) {
+            return nullptr;
+        }
+        if (shard.page_table.count(key) == 0) {
+            break;
+        }
+        release_frame(shard, frame_id);
+    }
+    if (!shard.read_ahead_in_flight.empty()) {
+        shard.read_ahead_in_flight.erase(key);
     }
 
-    init_page(frame.page, page_id, page_type, page_level);
+    Frame& frame = frames_[frame_id];
+    init_page(page_at(frame_id), page_id, page_type, page_level, page_size_);
+    frame.file_id = file_id;
     frame.page_id = page_id;
-    frame.pin_count = 1;
-    frame.dirty = true;
-    page_table_[page_id] = frame_id;
-    mark_frame_used(frame_id);
+    mark_dirty(frame);
+    shard.page_table[key] = frame_id;
+    pin_frame(shard, frame_id, AccessType::DEFAULT);
 
-    return &frame.page;
+    return &page_at(frame_id);
 }
 
-bool BufferPoolManager::delete_page(uint32_t page_id) {
-    auto it = page_table_.find(page_id);
-    if (it == page_table_.end()) {
+bool BufferPoolManager::delete_page(FileId file_id, uint32_t page_id) {
+    uint64_t key = page_key(file_id, page_id);
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.latch);
+
+    auto it = shard.page_table.find(key);
+    if (it == shard.page_table.end()) {
         return false;
     }
 
     size_t frame_id = it->second;
-    Frame& frame = frames_[frame_id];
-
-    if (frame.pin_count > 0) {
+    if (frames_[frame_id].pin_count.load() > 0) {
         return false;
     }
 
-    page_table_.erase(it);
-    remove_from_lru(frame_id);
-    frame.page_id = INVALID_PAGE_ID;
-    frame.pin_count = 0;
-    frame.dirty = false;
+    shard.page_table.erase(it);
+    shard.replacer->remove(frame_id - shard.first_frame);
+    release_frame(shard, frame_id);
 
     return true;
 }
 
-bool BufferPoolManager::flush_page(uint32_t page_id) {
-    auto it = page_table_.find(page_id);
-    if (it == page_table_.end()) {
+bool BufferPoolManager::flush_page(FileId file_id, uint32_t page_id) {
+    // A write-back copies pages out before writing them, so without the
+    // latch this write could land first and be overwritten by a stale copy.
+    std::lock_guard<std::mutex> write_back_lock(write_back_latch_);
+    uint64_t key = page_key(file_id, page_id);
+    Shard& shard = shard_for(key);
+    std::unique_lock<std::mutex> lock(shard.latch);
+
+    auto it = shard.page_table.find(key);
+    if (it == shard.page_table.end()) {
         return false;
     }
+    return flush_frame(shard, lock, it->second);
+}
 
-    size_t frame_id = it->second;
-    Frame& frame = frames_[frame_id];
-
-    if (frame.dirty) {
-        try {
-            disk_manager_.write_page(static_cast<int>(page_id), frame.page.data);
-            frame.dirty = false;
-        } catch (const std::exception&) {
-            return false;
+void BufferPoolManager::flush_file(FileId file_id) {
+    std::lock_guard<std::mutex> write_back_lock(write_back_latch_);
+    std::vector<WriteBackTarget> targets;
+    for (size_t s = 0; s < shard_count_; ++s) {
+        Shard& shard = shards_[s];
+        std::lock_guard<std::mutex> lock(shard.latch);
+        for (auto& [key, frame_id] : shard.page_table) {
+            Frame& frame = frames_[frame_id];
+            if (frame.file_id == file_id && frame.dirty.load()) {
+                hold_frame(shard, frame_id);
+                targets.push_back({frame.file_id, frame.page_id, frame_id, &shard});
+            }
         }
     }
-    return true;
+    write_back(targets, false);
 }
 
 void BufferPoolManager::flush_all() {
-    for (auto& [page_id, frame_id] : page_table_) {
-        Frame& frame = frames_[frame_id];
-        if (frame.dirty) {
-            try {
-                disk_manager_.write_page(static_cast<int>(page_id), frame.page.data);
-                frame.dirty = false;
-            } catch (const std::exception&) {
+    std::lock_guard<std::mutex> write_back_lock(write_back_latch_);
+    std::vector<WriteBackTarget> targets;
+    for (size_t s = 0; s < shard_count_; ++s) {
+        Shard& shard = shards_[s];
+        std::lock_guard<std::mutex> lock(shard.latch);
+        for (auto& [key, frame_id] : shard.page_table) {
+            Frame& frame = frames_[frame_id];
+            if (frame.dirty.load()) {
+                hold_frame(shard, frame_id);
+                targets.push_back({frame.file_id, frame.page_id, frame_id, &shard});
             }
         }
     }
+    write_back(targets, false);
+}
+
+FrameLatch& BufferPoolManager::frame_latch(const Page* page) {
+    return frames_[frame_of(page)].latch;
+}
+
+void BufferPoolManager::set_frame_limit(size_t frames) {
+    frames = std::min(std::max(frames, shard_count_), pool_size_);
+    size_t limit = 0;
+    for (size_t s = 0; s < shard_count_; ++s) {
+        Shard& shard = shards_[s];
+        std::lock_guard<std::mutex> lock(shard.latch);
+        // Each shard keeps its share of the frames, and at least one.
+        size_t share = frames * (shard.first_frame + shard.frame_count) / pool_size_ - frames * shard.first_frame / pool_size_;
+        shard.frame_limit = std::min(std::max<size_t>(share, 1), shard.frame_count);
+        limit += shard.frame_limit;
+        if (shard.frame_limit < shard.active_frames) {
+            trim_shard(shard);
+            continue;
+        }
+        for (size_t i = shard.first_frame + shard.frame_limit; i > shard.first_frame + shard.active_frames; --i) {
+            shard.free_frames.push_back(i - 1);
+        }
+        shard.active_frames = shard.frame_limit;
+    }
+    frame_limit_ = limit;
+}
+
+void BufferPoolManager::trim_shard(Shard& shard) {
+    size_t limit_end = shard.first_frame + shard.frame_limit;
+    shard.free_frames.erase(std::remove_if(shard.free_frames.begin(), shard.free_frames.end(),
+                                           [limit_end](size_t frame_id) { return frame_id >= limit_end; }),
+                            shard.free_frames.end());
+    bool trimmed = true;
+    for (size_t frame_id = limit_end; frame_id < shard.first_frame + shard.active_frames; ++frame_id) {
+        Frame& frame = frames_[frame_id];
+        if (frame.page_id == INVALID_PAGE_ID) {
+            continue;
+        }
+        if (frame.pin_count.load() > 0 || !evict_frame(shard, frame_id)) {
+            trimmed = false;
+            continue;
+        }
+        shard.replacer->remove(frame_id - shard.first_frame);
+        clear_dirty(frame);
+    }
+    if (trimmed) {
+        discard_memory(page_at(limit_end).data, (shard.active_frames - shard.frame_limit) * page_size_);
+        shard.active_frames = shard.frame_limit;
+    }
 }
 
 size_t BufferPoolManager::get_pinned_count() const {
     size_t count = 0;
-    for (const auto& frame : frames_) {
-        if (frame.pin_count > 0) {
-            count++;
-        }
+    for (size_t s = 0; s < shard_count_; ++s) {
+        std::lock_guard<std::mutex> lock(shards_[s].latch);
+        count += shards_[s].pinned_count;
     }
     return count;
 }
 
 size_t BufferPoolManager::get_free_frame_count() const {
     size_t count = 0;
-    for (const auto& frame : frames_) {
-        if (frame.page_id == INVALID_PAGE_ID) {
-            count++;
-        }
+    for (size_t s = 0; s < shard_count_; ++s) {
+        std::lock_guard<std::mutex> lock(shards_[s].latch);
+        count += shards_[s].free_frames.size();
     }
     return count;
 }
 
-size_t BufferPoolManager::find_or_evict_frame() {
-    for (size_t i = 0; i < pool_size_; ++i) {
-        if (frames_[i].page_id == INVALID_PAGE_ID) {
-            return i;
-        }
+BufferPoolStats BufferPoolManager::get_stats() const {
+    BufferPoolStats total;
+    for (size_t s = 0; s < shard_count_; ++s) {
+        std::lock_guard<std::mutex> lock(shards_[s].latch);
+        total.hits += shards_[s].stats.hits;
+        total.misses += shards_[s].stats.misses;
+        total.evictions += shards_[s].stats.evictions;
+        total.prefetched += shards_[s].stats.prefetched;
+        total.prefetch_used += shards_[s].stats.prefetch_used;
+        total.prefetch_unused += shards_[s].stats.prefetch_unused;
+    }
+    total.foreground_writes = foreground_writes_.load();
+    total.background_writes = background_writes_.load();
+    total.background_write_calls = background_write_calls_.load();
+    total.flushes = flushes_.load();
+    total.flush_writes = flush_writes_.load();
+    total.flush_write_calls = flush_write_calls_.load();
+    total.flush_micros = flush_micros_.load();
+    return total;
+}
+
+void BufferPoolManager::reset_stats() {
+    for (size_t s = 0; s < shard_count_; ++s) {
+        std::lock_guard<std::mutex> lock(shards_[s].latch);
+        shards_[s].stats = BufferPoolStats();
     }
+    foreground_writes_ = 0;
+    background_writes_ = 0;
+    background_write_calls_ = 0;
+    flushes_ = 0;
+    flush_writes_ = 0;
+    flush_write_calls_ = 0;
+    flush_micros_ = 0;
+}
 
-    while (!lru_list_.empty()) {
-        size_t frame_id = lru_list_.back();
-        Frame& frame = frames_[frame_id];
+BufferPoolManager::Shard& BufferPoolManager::shard_for(uint64_t key) {
+    if (shard_bits_ == 0) {
+        return shards_[0];
+    }
+    // Fibonacci hashing spreads consecutive page ids across shards.
+    return shards_[(key * 0x9E3779B97F4A7C15ULL) >> (64 - shard_bits_)];
+}
 
-        if (frame.pin_count == 0) {
-            lru_list_.pop_back();
+DiskManager* BufferPoolManager::file_for(FileId file_id) const {
+    std::shared_lock<std::shared_mutex> lock(files_latch_);
+    if (file_id >= files_.size()) {
+        return nullptr;
+    }
+    return files_[file_id];
+}
+
+size_t BufferPoolManager::find_or_evict_frame(Shard& shard) {
+    // Frames set_frame_limit found pinned may be free to go by now.
+    if (shard.active_frames > shard.frame_limit) {
+        trim_shard(shard);
+    }
+    if (!shard.free_frames.empty()) {
+        size_t frame_id = shard.free_frames.back();
+        shard.free_frames.pop_back();
+        return frame_id;
+    }
+
+    size_t local_id;
+    if (!shard.replacer->evict(local_id)) {
+        return SIZE_MAX;
+    }
+    return shard.first_frame + local_id;
+}
+
+size_t BufferPoolManager::claim_frame(Shard& shard, std::unique_lock<std::mutex>& lock) {
+    std::unique_ptr<uint8_t[]> copy;
+    while (true) {
+        size_t frame_id = find_or_evict_frame(shard);
+        if (frame_id == SIZE_MAX) {
+            return SIZE_MAX;
+        }
+        Frame& frame = frames_[frame_id];
+        if (frame.page_id == INVALID_PAGE_ID || !frame.dirty.load()) {
+            evict_frame(shard, frame_id);
             return frame_id;
         }
-        lru_list_.pop_back();
-    }
 
-    return SIZE_MAX;
+        // Having to write a victim means the cleaner is behind. Nobody can
+        // have an unpinned page latched, so copy it out here and write the
+        // copy with the shard latch dropped. The pin keeps the page mapped,
+        // and a fetch of it meanwhile is a hit; detach_file waits for the
+        // write before letting the frame or the file go.
+        if (!copy) {
+            copy.reset(new uint8_t[page_size_]);
+        }
+        std::memcpy(copy.get(), page_at(frame_id).data, page_size_);
+        clear_dirty(frame);
+        uint32_t dirtied = frame.dirtied.load();
+        FileId file_id = frame.file_id;
+        uint32_t page_id = frame.page_id;
+        hold_frame(shard, frame_id);
+        frame.writing = true;
+        lock.unlock();
+        wake_page_cleaner();
+
+        bool written = false;
+        DiskManager* disk_manager = file_for(file_id);
+        try {
+            if (disk_manager != nullptr) {
+                disk_manager->write_page(page_id, copy.get());
+                foreground_writes_++;
+                written = true;
+            }
+        } catch (const std::exception&) {
+        }
+
+        lock.lock();
+        frame.writing = false;
+        shard.write_cv.notify_all();
+        // A change made meanwhile may have been written before this older
+        // copy, so it must be written again.
+        if (!written || frame.dirtied.load() != dirtied) {
+            mark_dirty(frame);
+        }
+        bool idle = frame.pin_count.fetch_sub(1) == 1;
+        if (idle) {
+            shard.pinned_count--;
+            if (!frame.dirty.load()) {
+                // Forget any access a fetch recorded meanwhile.
+                shard.replacer->remove(frame_id - shard.first_frame);
+                evict_frame(shard, frame_id);
+                return frame_id;
+            }
+            // Back to the replacer; a page fetched meanwhile returns there
+            // when it is unpinned.
+            shard.replacer->record_access(frame_id - shard.first_frame, AccessType::DEFAULT);
+            shard.replacer->set_evictable(frame_id - shard.first_frame, true);
+        }
+        if (!written) {
+            return SIZE_MAX;
+        }
+    }
 }
 
-bool BufferPoolManager::evict_frame(size_t frame_id) {
+bool BufferPoolManager::evict_frame(Shard& shard, size_t frame_id) {
     Frame& frame = frames_[frame_id];
     
     if (frame.page_id == INVALID_PAGE_ID) {
         return true;
     }
 
-    if (frame.dirty) {
-        try {
-            disk_manager_.write_page(static_cast<int>(frame.page_id), frame.page.data);
-        } catch (const std::exception&) {
+    // Victims are unpinned, so nobody holds their latch. claim_frame writes
+    // its dirty victims itself; trim_shard leaves them to this.
+    if (frame.dirty.load()) {
+        if (!write_frame(frame_id)) {
             return false;
         }
+        wake_page_cleaner();
     }
 
-    page_table_.erase(frame.page_id);
-    remove_from_lru(frame_id);
+    shard.page_table.erase(page_key(frame.file_id, frame.page_id));
+    frame.file_id = INVALID_FILE_ID;
     frame.page_id = INVALID_PAGE_ID;
     frame.pin_count = 0;
-    frame.dirty = false;
+    shard.stats.evictions++;
+    if (frame.prefetched) {
+        frame.prefetched = false;
+        shard.stats.prefetch_unused++;
+    }
 
     return true;
 }
 
-void BufferPoolManager::mark_frame_used(size_t frame_id) {
-    remove_from_lru(frame_id);
-    lru_list_.push_front(frame_id);
+bool BufferPoolManager::flush_frame(Shard& shard, std::unique_lock<std::mutex>& lock, size_t frame_id) {
+    Frame& frame = frames_[frame_id];
+    if (!frame.dirty.load()) {
+        return true;
+    }
+
+    // Pin so the frame cannot be evicted, then drop the shard latch before
+    // waiting on the frame latch: its holder may be blocked on this shard.
+    hold_frame(shard, frame_id);
+    lock.unlock();
+
+    bool ok;
+    {
+        std::shared_lock<FrameLatch> frame_lock(frame.latch);
+        ok = write_frame(frame_id);
+    }
+
+    lock.lock();
+    unhold_frame(shard, frame_id);
+    return ok;
+}
+
+bool BufferPoolManager::write_frame(size_t frame_id) {
+    Frame& frame = frames_[frame_id];
+    if (!clear_dirty(frame)) {
+        return true;
+    }
+    DiskManager* disk_manager = file_for(frame.file_id);
+    try {
+        if (disk_manager == nullptr) {
+            throw std::runtime_error("Frame belongs to a detached file");
+        }
+        disk_manager->write_page(frame.page_id, page_at(frame_id).data);
+        foreground_writes_++;
+        return true;
+    } catch (const std::exception&) {
+        mark_dirty(frame);
+        return false;
+    }
+}
+
+void BufferPoolManager::pin_frame(Shard& shard, size_t frame_id, AccessType access_type) {
+    hold_frame(shard, frame_id);
+    shard.replacer->record_access(frame_id - shard.first_frame, access_type);
+}
+
+void BufferPoolManager::hold_frame(Shard& shard, size_t frame_id) {
+    if (frames_[frame_id].pin_count.fetch_add(1) == 0) {
+        shard.replacer->set_evictable(frame_id - shard.first_frame, false);
+        shard.pinned_count++;
+    }
+}
+
+void BufferPoolManager::unhold_frame(Shard& shard, size_t frame_id) {
+    if (frames_[frame_id].pin_count.fetch_sub(1) == 1) {
+        shard.pinned_count--;
+        shard.replacer->set_evictable(frame_id - shard.first_frame, true);
+    }
+}
+
+void BufferPoolManager::release_frame(Shard& shard, size_t frame_id) {
+    Frame& frame = frames_[frame_id];
+    frame.file_id = INVALID_FILE_ID;
+    frame.page_id = INVALID_PAGE_ID;
+    frame.pin_count = 0;
+    frame.prefetched = false;
+    clear_dirty(frame);
+    shard.free_frames.push_back(frame_id);
+}
+
+void BufferPoolManager::mark_dirty(Frame& frame) {
+    if (!frame.dirty.exchange(true)) {
+        frame.dirtied++;
+        dirty_count_++;
+    }
+}
+
+bool BufferPoolManager::clear_dirty(Frame& frame) {
+    if (frame.dirty.exchange(false)) {
+        dirty_count_--;
+        return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Page cleaner
+
+void BufferPoolManager::start_page_cleaner(const PageCleanerOptions& options) {
+    std::lock_guard<std::mutex> lock(cleaner_mutex_);
+    cleaner_options_ = options;
+    if (cleaner_running_.load()) {
+        return;
+    }
+    cleaner_stop_ = false;
+    cleaner_running_ = true;
+    cleaner_thread_ = std::thread(&BufferPoolManager::page_cleaner_loop, this);
+}
+
+void BufferPoolManager::stop_page_cleaner() {
+    {
+        std::lock_guard<std::mutex> lock(cleaner_mutex_);
+        if (!cleaner_running_.load()) {
+            return;
+        }
+        cleaner_stop_ = true;
+    }
+    cleaner_cv_.notify_one();
+    cleaner_thread_.join();
+    cleaner_running_ = false;
+}
+
+void BufferPoolManager::set_page_cleaner_options(const PageCleanerOptions& options) {
+    {
+        std::lock_guard<std::mutex> lock(cleaner_mutex_);
+        cleaner_options_ = options;
+    }
+    cleaner_cv_.notify_one();
+}
+
+void BufferPoolManager::wake_page_cleaner() {
+    if (cleaner_running_.load() && !cleaner_wakeup_.exchange(true)) {
+        cleaner_cv_.notify_one();
+    }
+}
+
+void BufferPoolManager::page_cleaner_loop() {
+    std::unique_lock<std::mutex> lock(cleaner_mutex_);
+    while (!cleaner_stop_) {
+        cleaner_cv_.wait_for(lock, std::chrono::milliseconds(cleaner_options_.wake_interval_ms),
+                             [this] { return cleaner_stop_ || cleaner_wakeup_.load(); });
+        if (cleaner_stop_) {
+            break;
+        }
+        cleaner_wakeup_ = false;
+        lock.unlock();
+        clean_pages();
+        lock.lock();
+    }
+}
+
+size_t BufferPoolManager::clean_pages() {
+    std::lock_guard<std::mutex> write_back_lock(write_back_latch_);
+
+    uint32_t max_dirty_percent;
+    {
+        std::lock_guard<std::mutex> lock(cleaner_mutex_);
+        max_dirty_percent = cleaner_options_.max_dirty_percent;
+    }
+    size_t dirty_limit = frame_limit_.load() * max_dirty_percent / 100;
+    size_t dirty = dirty_count_.load();
+    size_t excess = dirty > dirty_limit ? dirty - dirty_limit : 0;
+    size_t excess_per_shard = (excess + shard_count_ - 1) / shard_count_;
+
+    // Pick victims while holding each shard latch, and pin them so they stay
+    // put once the latch is dropped.
+    std::vector<WriteBackTarget> targets;
+    std::vector<size_t> candidates;
+    for (size_t s = 0; s < shard_count_; ++s) {
+        Shard& shard = shards_[s];
+        std::lock_guard<std::mutex> lock(shard.latch);
+        size_t lookahead = std::max<size_t>(1, shard.frame_count * PAGE_CLEANER_LOOKAHEAD_PERCENT / 100);
+        candidates.clear();
+        shard.replacer->eviction_candidates(excess_per_shard > 0 ? shard.frame_count : lookahead, candidates);
+
+        size_t extra = 0;
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            size_t frame_id = shard.first_frame + candidates[i];
+            Frame& frame = frames_[frame_id];
+            if (!frame.dirty.load()) {
+                continue;
+            }
+            if (i >= lookahead) {
+                if (extra == excess_per_shard) {
+                    break;
+                }
+                extra++;
+            }
+            hold_frame(shard, frame_id);
+            targets.push_back({frame.file_id, frame.page_id, frame_id, &shard});
+        }
+    }
+
+    return write_back(targets, true);
+}
+
+size_t BufferPoolManager::write_back(std::vector<WriteBackTarget>& targets, bool background) {
+    auto start = std::chrono::steady_clock::now();
+    std::sort(targets.begin(), targets.end(), [](const WriteBackTarget& a, const WriteBackTarget& b) {
+        return a.file_id != b.file_id ? a.file_id < b.file_id : a.page_id < b.page_id;
+    });
+
+    // Runs of adjacent pages, each written with a single request. The
+    // cleaner keeps runs short so a pass stays quick; flushes write
+    // everything anyway and merge as much as they can.
+    size_t max_run_pages = background ? PAGE_CLEANER_MAX_WRITE_PAGES : FLUSH_MAX_WRITE_PAGES;
+    std::vector<std::pair<size_t, size_t>> runs;
+    for (size_t begin = 0; begin < targets.size();) {
+        size_t end = begin + 1;
+        while (end < targets.size() && end - begin < max_run_pages &&
+               targets[end].file_id == targets[begin].file_id &&
+               targets[end].page_id == targets[end - 1].page_id + 1) {
+            end++;
+        }
+        runs.emplace_back(begin, end);
+        begin = end;
+    }
+
+    // Split the runs into contiguous shares of about the same number of
+    // pages, one per writer thread. The calling thread takes the first
+    // share on the pool's own queue.
+    size_t workers = background ? 1 : std::min(flush_threads_.load(), runs.size());
+    std::vector<size_t> bounds(1, 0);
+    for (size_t r = 0, pages = 0; r < runs.size() && bounds.size() < workers; ++r) {
+        pages += runs[r].second - runs[r].first;
+        if (pages * workers >= targets.size() * bounds.size()) {
+            bounds.push_back(r + 1);
+        }
+    }
+    bounds.push_back(runs.size());
+
+    std::vector<uint8_t> was_dirty(targets.size());
+    std::vector<size_t> written(bounds.size() - 1, 0);
+    std::vector<size_t> calls(bounds.size() - 1, 0);
+    std::vector<std::thread> threads;
+    for (size_t w = 1; w + 1 < bounds.size(); ++w) {
+        threads.emplace_back([&, w] {
+            IoQueue io(IO_QUEUE_DEPTH, io_backend_);
+            std::vector<uint8_t> buffer;
+            written[w] = write_runs(io, buffer, targets, runs, bounds[w], bounds[w + 1], was_dirty, calls[w]);
+        });
+    }
+    if (bounds.size() > 1) {
+        written[0] = write_runs(*write_back_io_, write_back_buffer_, targets, runs, bounds[0], bounds[1], was_dirty, calls[0]);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (const WriteBackTarget& target : targets) {
+        std::lock_guard<std::mutex> lock(target.shard->latch);
+        unhold_frame(*target.shard, target.frame_id);
+    }
+
+    size_t total_written = 0;
+    size_t total_calls = 0;
+    for (size_t w = 0; w < written.size(); ++w) {
+        total_written += written[w];
+        total_calls += calls[w];
+    }
+    if (background) {
+        background_writes_ += total_written;
+        background_write_calls_ += total_calls;
+    } else {
+        foreground_writes_ += total_written;
+        if (total_written > 0) {
+            auto end = std::chrono::steady_clock::now();
+            flushes_++;
+            flush_writes_ += total_written;
+            flush_write_calls_ += total_calls;
+            flush_micros_ += static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+        }
+    }
+    return total_written;
+}
+
+size_t BufferPoolManager::write_runs(IoQueue& io, std::vector<uint8_t>& buffer, std::vector<WriteBackTarget>& targets,
+                                     const std::vector<std::pair<size_t, size_t>>& runs, size_t first_run,
+                                     size_t last_run, std::vector<uint8_t>& was_dirty, size_t& calls) {
+    // Pages are staged one frame latch at a time: holding several at once,
+    // in page order, could deadlock against latch coupling in the B+tree.
+    // A staged run is contiguous, so it goes out as one write.
+    const size_t buffer_pages = IO_QUEUE_DEPTH * PAGE_CLEANER_MAX_WRITE_PAGES;
+    buffer.resize(buffer_pages * page_size_);
+    std::vector<IoRequest> requests(io.depth());
+    std::vector<size_t> request_runs(io.depth());
+    size_t written = 0;
+
+    // Copy up to a queue's (or a buffer's) worth of runs out under shared
+    // frame latches, submit them together and wait, then move on to the
+    // next batch.
+    for (size_t next_run = first_run; next_run < last_run;) {
+        size_t batch = 0;
+        size_t staged = 0;
+        for (; next_run < last_run && batch < io.depth(); ++next_run) {
+            auto [begin, end] = runs[next_run];
+            if (staged + (end - begin) > buffer_pages) {
+                break;
+            }
+            uint8_t* run_buffer = buffer.data() + staged * page_size_;
+            for (size_t i = begin; i < end; ++i) {
+                Frame& frame = frames_[targets[i].frame_id];
+                std::shared_lock<FrameLatch> frame_lock(frame.latch);
+                was_dirty[i] = clear_dirty(frame) ? 1 : 0;
+                std::memcpy(run_buffer + (i - begin) * page_size_, page_at(targets[i].frame_id).data, page_size_);
+            }
+
+            IoRequest& request = requests[batch];
+            request.disk_manager = file_for(targets[begin].file_id);
+            request.write = true;
+            request.first_page_id = targets[begin].page_id;
+            request.page_count = end - begin;
+            request.buffer = run_buffer;
+            request.ok = false;
+            request_runs[batch] = next_run;
+            batch++;
+            staged += end - begin;
+            if (request.disk_manager != nullptr) {
+                io.submit(request);
+            }
+        }
+        io.wait();
+
+        for (size_t b = 0; b < batch; ++b) {
+            auto [begin, end] = runs[request_runs[b]];
+            if (requests[b].ok) {
+                written += end - begin;
+                calls++;
+                continue;
+            }
+            for (size_t i = begin; i < end; ++i) {
+                if (was_dirty[i]) {
+                    mark_dirty(frames_[targets[i].frame_id]);
+                }
+            }
+        }
+    }
+    return written;
 }
 
-void BufferPoolManager::remove_from_lru(size_t frame_id) {
-    auto it = std::find(lru_list_.begin(), lru_list_.end(), frame_id);
-    if (it != lru_list_.end()) {
-        lru_list_.erase(it);
+// ---------------------------------------------------------------------------
+// Read-ahead
+
+void BufferPoolManager::prefetch_pages(FileId file_id, std::vector<uint32_t> page_ids) {
+    if (!read_ahead_enabled_.load() || page_ids.empty()) {
+        return;
+    }
+    DiskManager* disk_manager = file_for(file_id);
+    if (disk_manager == nullptr) {
+        return;
+    }
+
+    page_ids.erase(std::remove_if(page_ids.begin(), page_ids.end(), [&](uint32_t page_id) {
+        uint64_t key = page_key(file_id, page_id);
+        Shard& shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.latch);
+        return shard.page_table.count(key) != 0;
+    }), page_ids.end());
+    if (page_ids.empty()) {
+        return;
+    }
+
+    // Start the OS reads now, one hint per run of adjacent pages; the
+    // read-ahead thread then mostly copies from the OS cache.
+    std::vector<uint32_t> sorted = page_ids;
+    std::sort(sorted.begin(), sorted.end());
+    size_t run_start = 0;
+    for (size_t i = 1; i <= sorted.size(); ++i) {
+        if (i == sorted.size() || sorted[i] != sorted[i - 1] + 1) {
+            disk_manager->prefetch_pages(sorted[run_start], i - run_start);
+            run_start = i;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(read_ahead_mutex_);
+        if (read_ahead_stop_) {
+            return;
+        }
+        for (uint32_t page_id : page_ids) {
+            if (read_ahead_queued_.insert(page_key(file_id, page_id)).second) {
+                read_ahead_queue_.emplace_back(file_id, page_id);
+            }
+        }
+        read_ahead_queued_count_ = read_ahead_queued_.size();
+        if (!read_ahead_thread_.joinable()) {
+            read_ahead_thread_ = std::thread(&BufferPoolManager::read_ahead_loop, this);
+        }
+    }
+    read_ahead_cv_.notify_one();
+}
+
+void BufferPoolManager::read_ahead_loop() {
+    IoQueue io(IO_QUEUE_DEPTH, io_backend_);
+    std::vector<uint8_t> buffer(io.depth() * page_size_);
+    std::vector<std::pair<FileId, uint32_t>> batch;
+
+    std::unique_lock<std::mutex> lock(read_ahead_mutex_);
+    while (true) {
+        read_ahead_cv_.wait(lock, [this] { return read_ahead_stop_ || !read_ahead_queue_.empty(); });
+        if (read_ahead_stop_) {
+            return;
+        }
+        batch.clear();
+        while (!read_ahead_queue_.empty() && batch.size() < io.depth()) {
+            auto [file_id, page_id] = read_ahead_queue_.front();
+            read_ahead_queue_.pop_front();
+            if (read_ahead_queued_.erase(page_key(file_id, page_id)) != 0) {
+                batch.emplace_back(file_id, page_id);
+            }
+        }
+        read_ahead_queued_count_ = read_ahead_queued_.size();
+        if (batch.empty()) {
+            continue;
+        }
+        lock.unlock();
+
+        {
+            std::lock_guard<std::mutex> load(read_ahead_load_latch_);
+            read_ahead_batch(io, batch, buffer);
+        }
+
+        lock.lock();
+    }
+}
+
+// Reads a batch of pages into a staging buffer and installs each one as its
+// read completes, unless somebody loaded or cancelled it meanwhile. Pages are
+// marked in flight before the reads go out, so a concurrent miss on one
+// cancels it rather than racing with it.
+void BufferPoolManager::read_ahead_batch(IoQueue& io, std::vector<std::pair<FileId, uint32_t>>& batch,
+                                         std::vector<uint8_t>& buffer) {
+    std::vector<IoRequest> requests(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        auto [file_id, page_id] = batch[i];
+        uint64_t key = page_key(file_id, page_id);
+        Shard& shard = shard_for(key);
+        {
+            std::lock_guard<std::mutex> lock(shard.latch);
+            if (shard.page_table.count(key) != 0 || !shard.read_ahead_in_flight.insert(key).second) {
+                continue;
+            }
+        }
+        IoRequest& request = requests[i];
+        request.disk_manager = file_for(file_id);
+        request.first_page_id = page_id;
+        request.page_count = 1;
+        request.buffer = buffer.data() + i * page_size_;
+        if (request.disk_manager != nullptr && io.submit(request)) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(shard.latch);
+        shard.read_ahead_in_flight.erase(key);
+    }
+
+    std::vector<IoRequest*> completed;
+    while (io.in_flight() > 0) {
+        completed.clear();
+        io.poll(completed, 1);
+        for (IoRequest* request : completed) {
+            auto [file_id, page_id] = batch[static_cast<size_t>(request - requests.data())];
+            uint64_t key = page_key(file_id, page_id);
+            Shard& shard = shard_for(key);
+            std::unique_lock<std::mutex> lock(shard.latch);
+            if (!request->ok || shard.read_ahead_in_flight.count(key) == 0) {
+                shard.read_ahead_in_flight.erase(key);
+                continue;
+            }
+            // Claim first: a miss or new_page on the page while claim_frame
+            // has the latch dropped cancels the request.
+            size_t frame_id = claim_frame(shard, lock);
+            bool cancelled = shard.read_ahead_in_flight.erase(key) == 0;
+            if (frame_id == SIZE_MAX) {
+                continue;
+            }
+            if (cancelled) {
+                release_frame(shard, frame_id);
+                continue;
+            }
+            std::memcpy(page_at(frame_id).data, request->buffer, page_size_);
+            Frame& frame = frames_[frame_id];
+            frame.file_id = file_id;
+            frame.page_id = page_id;
+            shard.page_table[key] = frame_id;
+            // Park the page as a recent access so it survives until the
+            // reader gets to it; fetch_page re-admits it with the reader's
+            // access type.
+            frame.prefetched = true;
+            shard.replacer->record_access(frame_id - shard.first_frame, AccessType::DEFAULT);
+            shard.replacer->set_evictable(frame_id - shard.first_frame, true);
+            shard.stats.prefetched++;
+        }
     }
 }
@@ -0,0 +1,324 @@
+#include "storage/compressed_page_store.hpp"
+#include <fcntl.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#define open _open
+#define close _close
+#else
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+constexpr uint32_t MAP_MAGIC = 0x504D4750;  // "PGMP"
+constexpr uint32_t MAP_VERSION = 1;
+
+struct MapHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t page_size;
+    uint32_t reserved;
+};
+
+// The header has a block to itself, so entry blocks are aligned in the file.
+constexpr uint64_t MAP_BLOCK_BYTES = PAGE_MAP_BLOCK_ENTRIES * sizeof(PageSlot);
+
+bool read_all(int fd, void* buffer, size_t length, uint64_t offset) {
+    uint8_t* data = static_cast<uint8_t*>(buffer);
+    size_t done = 0;
+    while (done < length) {
+        #ifdef _WIN32
+        if (_lseeki64(fd, static_cast<__int64>(offset + done), SEEK_SET) < 0) {
+            return false;
+        }
+        int n = _read(fd, data + done, static_cast<unsigned int>(length - done));
+        #else
+        ssize_t n = pread(fd, data + done, length - done, static_cast<off_t>(offset + done));
+        #endif
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool write_all(int fd, const void* buffer, size_t length, uint64_t offset) {
+    const uint8_t* data = static_cast<const uint8_t*>(buffer);
+    size_t done = 0;
+    while (done < length) {
+        #ifdef _WIN32
+        if (_lseeki64(fd, static_cast<__int64>(offset + done), SEEK_SET) < 0) {
+            return false;
+        }
+        int n = _write(fd, data + done, static_cast<unsigned int>(length - done));
+        #else
+        ssize_t n = pwrite(fd, data + done, length - done, static_cast<off_t>(offset + done));
+        #endif
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool sync_file(int fd) {
+    #ifdef _WIN32
+    return _commit(fd) == 0;
+    #else
+    int result;
+    do {
+        #ifdef __linux__
+        result = fdatasync(fd);
+        #else
+        result = fsync(fd);
+        #endif
+    } while (result < 0 && errno == EINTR);
+    return result == 0;
+    #endif
+}
+
+}  // namespace
+
+CompressedPageStore::CompressedPageStore(const std::string& map_path, uint32_t page_size)
+    : page_size_(page_size),
+      max_units_(page_size / COMPRESSED_SLOT_BYTES),
+      free_slots_(max_units_ + 1),
+      end_units_(page_size / COMPRESSED_SLOT_BYTES) {
+    #ifdef _WIN32
+    map_fd_ = open(map_path.c_str(), O_RDWR | O_CREAT | O_BINARY, _S_IREAD | _S_IWRITE);
+    #else
+    map_fd_ = open(map_path.c_str(), O_RDWR | O_CREAT, 0644);
+    #endif
+    if (map_fd_ < 0) {
+        throw std::runtime_error("Failed to open or create page map");
+    }
+
+    struct stat st;
+    if (fstat(map_fd_, &st) != 0) {
+        close(map_fd_);
+        throw std::runtime_error("Failed to get page map size");
+    }
+    uint64_t size = static_cast<uint64_t>(st.st_size);
+    MapHeader header{};
+    if (size == 0) {
+        header = {MAP_MAGIC, MAP_VERSION, page_size_, 0};
+        std::vector<uint8_t> block(MAP_BLOCK_BYTES, 0);
+        std::memcpy(block.data(), &header, sizeof(header));
+        if (!write_all(map_fd_, block.data(), block.size(), 0)) {
+            close(map_fd_);
+            throw std::runtime_error("Failed to write page map header");
+        }
+        return;
+    }
+    if (size < MAP_BLOCK_BYTES || !read_all(map_fd_, &header, sizeof(header), 0) || header.magic != MAP_MAGIC ||
+        header.version != MAP_VERSION || header.page_size != page_size_) {
+        close(map_fd_);
+        throw std::runtime_error("Not a page map for this page size");
+    }
+
+    slots_.resize(static_cast<size_t>((size - MAP_BLOCK_BYTES) / sizeof(PageSlot)));
+    if (!slots_.empty() && !read_all(map_fd_, slots_.data(), slots_.size() * sizeof(PageSlot), MAP_BLOCK_BYTES)) {
+        close(map_fd_);
+        throw std::runtime_error("Failed to read page map");
+    }
+    block_dirty_.resize((slots_.size() + PAGE_MAP_BLOCK_ENTRIES - 1) / PAGE_MAP_BLOCK_ENTRIES, 0);
+
+    // Whatever no page points at, up to the last slot, is free.
+    std::vector<PageSlot> used;
+    for (const PageSlot& slot : slots_) {
+        if (slot.offset_units != 0) {
+            used.push_back(slot);
+        }
+    }
+    std::sort(used.begin(), used.end(),
+              [](const PageSlot& a, const PageSlot& b) { return a.offset_units < b.offset_units; });
+    uint32_t next = end_units_;
+    for (const PageSlot& slot : used) {
+        if (slot.offset_units > next) {
+            free_units(next, slot.offset_units - next);
+        }
+        next = std::max(next, slot.offset_units + slot.units);
+    }
+    end_units_ = next;
+}
+
+CompressedPageStore::~CompressedPageStore() {
+    try {
+        save();
+    } catch (const std::exception&) {
+        // Only the slots moved since the last sync are lost.
+    }
+    if (map_fd_ >= 0) {
+        close(map_fd_);
+    }
+}
+
+PageSlot CompressedPageStore::lookup(uint32_t page_id) const {
+    std::shared_lock<std::shared_mutex> lock(latch_);
+    return page_id < slots_.size() ? slots_[page_id] : PageSlot{};
+}
+
+PageSlot CompressedPageStore::reserve(uint32_t page_id, uint16_t stored_bytes, uint8_t flags) {
+    uint32_t units = (stored_bytes + COMPRESSED_SLOT_BYTES - 1) / COMPRESSED_SLOT_BYTES;
+    std::unique_lock<std::shared_mutex> lock(latch_);
+    PageSlot slot = page_id < slots_.size() ? slots_[page_id] : PageSlot{};
+    // Stay put unless the page outgrew its slot or now wastes more than a
+    // unit of it; pages change size a little with most writes.
+    if (slot.offset_units == 0 || slot.units < units || slot.units > units + 1) {
+        slot.offset_units = allocate(units);
+        slot.units = static_cast<uint8_t>(units);
+    }
+    slot.stored_bytes = stored_bytes;
+    slot.flags = flags;
+    return slot;
+}
+
+void CompressedPageStore::publish(uint32_t page_id, const PageSlot& slot) {
+    std::unique_lock<std::shared_mutex> lock(latch_);
+    if (page_id >= slots_.size()) {
+        slots_.resize(page_id + 1);
+        block_dirty_.resize((slots_.size() + PAGE_MAP_BLOCK_ENTRIES - 1) / PAGE_MAP_BLOCK_ENTRIES, 0);
+    }
+    PageSlot& current = slots_[page_id];
+    if (current.offset_units != 0 && current.offset_units != slot.offset_units) {
+        moved_from_.push_back(current);
+    }
+    current = slot;
+    uint32_t block = page_id / PAGE_MAP_BLOCK_ENTRIES;
+    if (!block_dirty_[block]) {
+        block_dirty_[block] = 1;
+        dirty_blocks_.push_back(block);
+    }
+}
+
+void CompressedPageStore::save() {
+    std::lock_guard<std::mutex> lock(persist_latch_);
+    std::vector<uint32_t> blocks;
+    std::vector<PageSlot> entries;
+    std::vector<PageSlot> moved_from;
+    snapshot(blocks, entries, moved_from);
+    write_map(blocks, entries, false);
+    // Not durable yet: the slots stay taken until the next persist.
+    std::unique_lock<std::shared_mutex> latch(latch_);
+    moved_from_.insert(moved_from_.end(), moved_from.begin(), moved_from.end());
+}
+
+uint64_t CompressedPageStore::end_offset() const {
+    std::shared_lock<std::shared_mutex> lock(latch_);
+    return static_cast<uint64_t>(end_units_) * COMPRESSED_SLOT_BYTES;
+}
+
+void CompressedPageStore::count_compression(uint32_t page_bytes, size_t stored_bytes, uint64_t nanos) {
+    compress_nanos_ += nanos;
+    if (stored_bytes == 0) {
+        pages_incompressible_++;
+        return;
+    }
+    pages_compressed_++;
+    bytes_in_ += page_bytes;
+    bytes_out_ += stored_bytes;
+}
+
+void CompressedPageStore::count_decompression(uint64_t nanos) {
+    pages_decompressed_++;
+    decompress_nanos_ += nanos;
+}
+
+CompressionStats CompressedPageStore::get_stats() const {
+    CompressionStats stats;
+    stats.pages_compressed = pages_compressed_.load();
+    stats.pages_incompressible = pages_incompressible_.load();
+    stats.bytes_in = bytes_in_.load();
+    stats.bytes_out = bytes_out_.load();
+    stats.compress_nanos = compress_nanos_.load();
+    stats.pages_decompressed = pages_decompressed_.load();
+    stats.decompress_nanos = decompress_nanos_.load();
+    return stats;
+}
+
+void CompressedPageStore::snapshot(std::vector<uint32_t>& blocks, std::vector<PageSlot>& entries,
+                                   std::vector<PageSlot>& moved_from) {
+    std::unique_lock<std::shared_mutex> lock(latch_);
+    blocks.swap(dirty_blocks_);
+    std::sort(blocks.begin(), blocks.end());
+    entries.resize(blocks.size() * PAGE_MAP_BLOCK_ENTRIES);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        block_dirty_[blocks[i]] = 0;
+        size_t first = static_cast<size_t>(blocks[i]) * PAGE_MAP_BLOCK_ENTRIES;
+        size_t count = std::min<size_t>(PAGE_MAP_BLOCK_ENTRIES, slots_.size() - first);
+        std::copy_n(slots_.begin() + static_cast<std::ptrdiff_t>(first), count,
+                    entries.begin() + static_cast<std::ptrdiff_t>(i * PAGE_MAP_BLOCK_ENTRIES));
+    }
+    moved_from.swap(moved_from_);
+}
+
+void CompressedPageStore::write_map(const std::vector<uint32_t>& blocks, const std::vector<PageSlot>& entries,
+                                    bool sync) {
+    // Adjacent blocks go out in one write.
+    for (size_t i = 0; i < blocks.size();) {
+        size_t j = i + 1;
+        while (j < blocks.size() && blocks[j] == blocks[j - 1] + 1) {
+            j++;
+        }
+        if (!write_all(map_fd_, entries.data() + i * PAGE_MAP_BLOCK_ENTRIES, (j - i) * MAP_BLOCK_BYTES,
+                       (blocks[i] + 1) * MAP_BLOCK_BYTES)) {
+            throw std::runtime_error("Failed to write page map");
+        }
+        i = j;
+    }
+    if (sync && !sync_file(map_fd_)) {
+        throw std::runtime_error("Failed to flush page map to disk");
+    }
+}
+
+void CompressedPageStore::release(const std::vector<PageSlot>& slots) {
+    std::unique_lock<std::shared_mutex> lock(latch_);
+    for (const PageSlot& slot : slots) {
+        free_units(slot.offset_units, slot.units);
+    }
+}
+
+// Exact fits first, then the shortest longer slot, split; the end of the
+// file last. Free slots are not merged, which only matters once page sizes
+// shift for good.
+uint32_t CompressedPageStore::allocate(uint32_t units) {
+    for (uint32_t length = units; length <= max_units_; length++) {
+        std::vector<uint32_t>& free_list = free_slots_[length];
+        if (free_list.empty()) {
+            continue;
+        }
+        uint32_t offset_units = free_list.back();
+        free_list.pop_back();
+        if (length > units) {
+            free_units(offset_units + units, length - units);
+        }
+        return offset_units;
+    }
+    uint32_t offset_units = end_units_;
+    end_units_ += units;
+    return offset_units;
+}
+
+void CompressedPageStore::free_units(uint32_t offset_units, uint32_t units) {
+    while (units > 0) {
+        uint32_t length = std::min(units, max_units_);
+        free_slots_[length].push_back(offset_units);
+        offset_units += length;
+        units -= length;
+    }
+}
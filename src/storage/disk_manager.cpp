@@ -1,9 +1,12 @@
 #include "storage/disk_manager.hpp"
 #include "storage/constants.hpp"
 #include "storage/page.hpp"
+#include "storage/lz_codec.hpp"
 #include <fcntl.h>
+#include <chrono>
 #include <stdexcept>
 #include <cstring>
+#include <cerrno>
 #include <algorithm>
 
 #ifdef _WIN32
@@ -13,16 +16,47 @@
 #define open _open
 #define read _read
 #define write _write
-#define lseek _lseek
 #define close _close
 #ifndef ssize_t
 typedef intptr_t ssize_t;
 #endif
 #else
 #include <unistd.h>
+#include <sys/stat.h>
 #endif
 
-DiskManager::DiskManager(const std::string& file_path) {
+// Reads up to length bytes at offset; returns the bytes read (short at end
+// of file) or -1.
+static ssize_t read_at(int fd, std::mutex& io_latch, uint8_t* buffer, size_t length, uint64_t offset) {
+    #ifdef _WIN32
+    std::lock_guard<std::mutex> lock(io_latch);
+    if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) {
+        return -1;
+    }
+    return read(fd, buffer, static_cast<unsigned int>(length));
+    #else
+    (void)io_latch;
+    return pread(fd, buffer, length, static_cast<off_t>(offset));
+    #endif
+}
+
+static ssize_t write_at(int fd, std::mutex& io_latch, const uint8_t* buffer, size_t length, uint64_t offset) {
+    #ifdef _WIN32
+    std::lock_guard<std::mutex> lock(io_latch);
+    if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) {
+        return -1;
+    }
+    ssize_t written = write(fd, buffer, static_cast<unsigned int>(length));
+    _commit(fd);
+    return written;
+    #else
+    (void)io_latch;
+    return pwrite(fd, buffer, length, static_cast<off_t>(offset));
+    #endif
+}
+
+DiskManager::DiskManager(const std::string& file_path, size_t extent_pages, uint32_t page_size)
+    : file_path(file_path), page_size(page_size) {
     #ifdef _WIN32
     file_descriptor = open(file_path.c_str(), O_RDWR | O_CREAT | O_BINARY, _S_IREAD | _S_IWRITE);
     #else
@@ -32,10 +66,29 @@ DiskManager::DiskManager(const std::string& file_path) {
     if (file_descriptor < 0) {
         throw std::runtime_error("Failed to open or create file");
     }
+
+    #ifdef _WIN32
+    __int64 size = _lseeki64(file_descriptor, 0, SEEK_END);
+    #else
+    struct stat st;
+    off_t size = fstat(file_descriptor, &st) == 0 ? st.st_size : -1;
+    #endif
+    if (size < 0) {
+        close(file_descriptor);
+        throw std::runtime_error("Failed to get file size");
+    }
+    file_size = static_cast<uint64_t>(size);
+    set_extent_pages(extent_pages);
 }
 
 DiskManager::DiskManager(DiskManager&& other) noexcept {
     file_descriptor = other.file_descriptor;
+    file_size = other.file_size.load();
+    extent_pages = other.extent_pages;
+    page_size = other.page_size;
+    syscall_count = other.syscall_count.load();
+    file_path = std::move(other.file_path);
+    page_store = std::move(other.page_store);
     other.file_descriptor = -1;
 }
 
@@ -45,6 +98,12 @@ DiskManager& DiskManager::operator=(DiskManager&& other) noexcept {
         close(file_descriptor);
     }
     file_descriptor = other.file_descriptor;
+    file_size = other.file_size.load();
+    extent_pages = other.extent_pages;
+    page_size = other.page_size;
+    syscall_count = other.syscall_count.load();
+    file_path = std::move(other.file_path);
+    page_store = std::move(other.page_store);
     other.file_descriptor = -1;
     return *this;
 }
@@ -55,76 +114,266 @@ DiskManager::~DiskManager() {
     }
 }
 
-void DiskManager::read_page(int page_id, uint8_t* page_data) {
-    long offset = static_cast<long>(page_id * PAGE_SIZE);
-    if (lseek(file_descriptor, offset, SEEK_SET) < 0) {
-        throw std::runtime_error("Failed to seek to the correct position for reading");
+void DiskManager::read_page(uint32_t page_id, uint8_t* page_data) {
+    if (page_store && page_id != 0) {
+        read_compressed_page(page_id, page_data);
+        return;
+    }
+    size_t total_read = read_bytes(static_cast<uint64_t>(page_id) * page_size, page_data, page_size);
+    if (total_read < page_size) {
+        std::fill_n(page_data + total_read, page_size - total_read, static_cast<uint8_t>(0));
     }
-    
-    ssize_t total_read = 0;
-    ssize_t bytes_read = 0;
-    uint8_t* ptr = page_data;
-    
-    while (total_read < static_cast<ssize_t>(PAGE_SIZE)) {
-        bytes_read = read(file_descriptor, ptr + total_read, static_cast<unsigned int>(PAGE_SIZE - total_read));
+}
+
+size_t DiskManager::read_bytes(uint64_t offset, uint8_t* buffer, size_t length) {
+    size_t total_read = 0;
+    while (total_read < length) {
+        syscall_count++;
+        ssize_t bytes_read = read_at(file_descriptor, io_latch, buffer + total_read, length - total_read, offset + total_read);
         if (bytes_read < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
             throw std::runtime_error("Failed to read page data");
         }
         if (bytes_read == 0) {
             break;
         }
-        total_read += bytes_read;
+        total_read += static_cast<size_t>(bytes_read);
     }
-    
-    if (total_read < static_cast<ssize_t>(PAGE_SIZE)) {
-        std::fill_n(page_data + total_read, PAGE_SIZE - total_read, static_cast<uint8_t>(0));
+    return total_read;
+}
+
+void DiskManager::write_page(uint32_t page_id, const void* page_data) {
+    write_pages(page_id, 1, page_data);
+}
+
+void DiskManager::write_pages(uint32_t first_page_id, size_t page_count, const void* page_data) {
+    const uint8_t* data = static_cast<const uint8_t*>(page_data);
+    if (page_store) {
+        for (size_t i = 0; i < page_count; i++) {
+            uint32_t page_id = first_page_id + static_cast<uint32_t>(i);
+            if (page_id == 0) {
+                write_bytes(0, data, page_size);
+            } else {
+                write_compressed_page(page_id, data + i * page_size);
+            }
+        }
+        return;
     }
+    write_bytes(static_cast<uint64_t>(first_page_id) * page_size, data, static_cast<uint64_t>(page_count) * page_size);
 }
 
-void DiskManager::write_page(int page_id, const void* page_data) {
-    long offset = static_cast<long>(page_id * PAGE_SIZE);
-    long required_size = offset + PAGE_SIZE;
-    
-    long current_size = lseek(file_descriptor, 0, SEEK_END);
-    if (current_size < 0) {
-        throw std::runtime_error("Failed to get file size");
+void DiskManager::write_bytes(uint64_t offset, const uint8_t* data, uint64_t length) {
+    if (offset + length > file_size.load()) {
+        grow_to(offset + length);
     }
-    
-    if (current_size < required_size) {
-        if (lseek(file_descriptor, required_size - 1, SEEK_SET) < 0) {
-            throw std::runtime_error("Failed to seek to extend file");
+
+    uint64_t total_written = 0;
+    while (total_written < length) {
+        syscall_count++;
+        ssize_t bytes_written = write_at(file_descriptor, io_latch, data + total_written,
+                                         static_cast<size_t>(length - total_written), offset + total_written);
+        if (bytes_written < 0 && errno == EINTR) {
+            continue;
         }
-        char zero = 0;
-        ssize_t extend_bytes = write(file_descriptor, &zero, 1);
-        if (extend_bytes != 1) {
-            throw std::runtime_error("Failed to extend file");
+        if (bytes_written <= 0) {
+            throw std::runtime_error("Failed to write the complete page");
         }
-        #ifdef _WIN32
-        _commit(file_descriptor);
-        #endif
+        total_written += static_cast<uint64_t>(bytes_written);
+    }
+}
+
+void DiskManager::enable_compression() {
+    if (!page_store) {
+        page_store = std::make_unique<CompressedPageStore>(page_map_path(file_path), page_size);
+    }
+}
+
+CompressionStats DiskManager::get_compression_stats() const {
+    return page_store ? page_store->get_stats() : CompressionStats{};
+}
+
+// Leaf pages are compressed without the free space between the slot array
+// and the records, which holds nothing; a page that would not save a slot
+// unit is stored as it is, as are all other pages.
+void DiskManager::write_compressed_page(uint32_t page_id, const uint8_t* page_data) {
+    const PageHeader* header = reinterpret_cast<const PageHeader*>(page_data);
+    uint8_t packed[MAX_PAGE_SIZE];
+    const uint8_t* stored = page_data;
+    size_t stored_bytes = page_size;
+    uint8_t flags = PAGE_SLOT_RAW;
+    if (header->page_type == PageType::DATA && header->page_level == PageLevel::LEAF &&
+        header->free_start >= sizeof(PageHeader) && header->free_start <= header->free_end &&
+        header->free_end <= page_size) {
+        auto start = std::chrono::steady_clock::now();
+        uint8_t gathered[MAX_PAGE_SIZE];
+        size_t head = header->free_start;
+        size_t tail = page_size - header->free_end;
+        std::memcpy(gathered, page_data, head);
+        std::memcpy(gathered + head, page_data + header->free_end, tail);
+        size_t packed_bytes = lz_compress(gathered, head + tail, packed, page_size - COMPRESSED_SLOT_BYTES);
+        auto end = std::chrono::steady_clock::now();
+        page_store->count_compression(page_size, packed_bytes,
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+        if (packed_bytes > 0) {
+            stored = packed;
+            stored_bytes = packed_bytes;
+            flags = PAGE_SLOT_LZ;
+        }
+    }
+
+    PageSlot slot = page_store->reserve(page_id, static_cast<uint16_t>(stored_bytes), flags);
+    write_bytes(slot.offset(), stored, stored_bytes);
+    page_store->publish(page_id, slot);
+}
+
+void DiskManager::read_compressed_page(uint32_t page_id, uint8_t* page_data) {
+    PageSlot slot = page_store->lookup(page_id);
+    if (slot.offset_units == 0) {
+        std::fill_n(page_data, page_size, static_cast<uint8_t>(0));
+        return;
+    }
+    if (slot.flags == PAGE_SLOT_RAW) {
+        if (read_bytes(slot.offset(), page_data, page_size) < page_size) {
+            throw std::runtime_error("Failed to read page data");
+        }
+        return;
     }
 
-    if (lseek(file_descriptor, offset, SEEK_SET) < 0) {
-        throw std::runtime_error("Failed to seek to the correct position for writing");
+    uint8_t packed[MAX_PAGE_SIZE];
+    if (read_bytes(slot.offset(), packed, slot.stored_bytes) < slot.stored_bytes) {
+        throw std::runtime_error("Failed to read page data");
     }
-    
-    ssize_t bytes_written = write(file_descriptor, page_data, static_cast<unsigned int>(PAGE_SIZE)); 
-    
-    if (bytes_written != static_cast<ssize_t>(PAGE_SIZE)) {
-        throw std::runtime_error("Failed to write the complete page");
+    auto start = std::chrono::steady_clock::now();
+    size_t unpacked = lz_decompress(packed, slot.stored_bytes, page_data, page_size);
+    const PageHeader* header = reinterpret_cast<const PageHeader*>(page_data);
+    if (unpacked < sizeof(PageHeader) || header->free_start > header->free_end || header->free_end > page_size ||
+        header->free_start + (page_size - header->free_end) != unpacked) {
+        throw std::runtime_error("Corrupt compressed page");
     }
-    
+    // Put the records back at the end of the page and clear the gap.
+    size_t head = header->free_start;
+    size_t free_end = header->free_end;
+    std::memmove(page_data + free_end, page_data + head, page_size - free_end);
+    std::fill(page_data + head, page_data + free_end, static_cast<uint8_t>(0));
+    auto end = std::chrono::steady_clock::now();
+    page_store->count_decompression(
+        static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+}
+
+// Extends the file to the next whole extent covering required_size. Blocks
+// are reserved up front where possible, so later writes into the extent do
+// not allocate and the file stays contiguous on disk.
+void DiskManager::grow_to(uint64_t required_size) {
+    std::lock_guard<std::mutex> lock(io_latch);
+    uint64_t current_size = file_size.load();
+    if (required_size <= current_size) {
+        return;
+    }
+    uint64_t extent_bytes = static_cast<uint64_t>(extent_pages) * page_size;
+    uint64_t new_size = (required_size + extent_bytes - 1) / extent_bytes * extent_bytes;
+
+    syscall_count++;
     #ifdef _WIN32
-    _commit(file_descriptor);
+    bool grown = _chsize_s(file_descriptor, static_cast<__int64>(new_size)) == 0;
+    #elif defined(__linux__)
+    bool grown = fallocate(file_descriptor, 0, static_cast<off_t>(current_size), static_cast<off_t>(new_size - current_size)) == 0;
+    if (!grown && (errno == EOPNOTSUPP || errno == ENOSYS)) {
+        // The file system cannot reserve blocks; a sparse extension still
+        // saves the per-write size check.
+        syscall_count++;
+        grown = ftruncate(file_descriptor, static_cast<off_t>(new_size)) == 0;
+    }
+    #else
+    bool grown = ftruncate(file_descriptor, static_cast<off_t>(new_size)) == 0;
     #endif
+    if (!grown) {
+        throw std::runtime_error("Failed to extend file");
+    }
+    file_size = new_size;
 }
 
+void DiskManager::truncate(uint32_t page_count) {
+    std::lock_guard<std::mutex> lock(io_latch);
+    uint64_t new_size = static_cast<uint64_t>(page_count) * page_size;
+    if (new_size >= file_size.load()) {
+        return;
+    }
+    syscall_count++;
+    #ifdef _WIN32
+    bool cut = _chsize_s(file_descriptor, static_cast<__int64>(new_size)) == 0;
+    #else
+    bool cut = ftruncate(file_descriptor, static_cast<off_t>(new_size)) == 0;
+    #endif
+    if (!cut) {
+        throw std::runtime_error("Failed to truncate file");
+    }
+    file_size = new_size;
+}
+
+void DiskManager::prefetch_pages(uint32_t first_page_id, size_t page_count) {
+    #ifndef _WIN32
+    if (page_store) {
+        // Slots of adjacent pages are usually adjacent too; advise runs.
+        uint64_t run_start = 0;
+        uint64_t run_end = 0;
+        for (size_t i = 0; i <= page_count; i++) {
+            PageSlot slot = i < page_count ? page_store->lookup(first_page_id + static_cast<uint32_t>(i)) : PageSlot{};
+            uint64_t offset = slot.offset();
+            if (slot.offset_units != 0 && offset == run_end) {
+                run_end += static_cast<uint64_t>(slot.units) * COMPRESSED_SLOT_BYTES;
+                continue;
+            }
+            if (run_end > run_start) {
+                syscall_count++;
+                posix_fadvise(file_descriptor, static_cast<off_t>(run_start), static_cast<off_t>(run_end - run_start),
+                              POSIX_FADV_WILLNEED);
+            }
+            run_start = offset;
+            run_end = offset + static_cast<uint64_t>(slot.units) * COMPRESSED_SLOT_BYTES;
+        }
+        return;
+    }
+    off_t offset = static_cast<off_t>(first_page_id) * static_cast<off_t>(page_size);
+    off_t length = static_cast<off_t>(page_count) * static_cast<off_t>(page_size);
+    syscall_count++;
+    posix_fadvise(file_descriptor, offset, length, POSIX_FADV_WILLNEED);
+    #else
+    (void)first_page_id;
+    (void)page_count;
+    #endif
+}
+
+// A compressed table's slot map is made durable after the data it points
+// at.
 void DiskManager::flush() {
+    if (page_store) {
+        page_store->persist([this] { sync_data(); });
+        return;
+    }
+    sync_data();
+}
+
+void DiskManager::sync_data() {
+    syscall_count++;
     #ifdef _WIN32
     if (_commit(file_descriptor) < 0) {
         throw std::runtime_error("Failed to flush data to disk");
     }
     #else
-    // fsync(file_descriptor); // If we wanted POSIX flush
+    // Data and the size needed to read it back; fallocate has already made
+    // the extents part of the file, so metadata rarely needs writing too.
+    int result;
+    do {
+        #ifdef __linux__
+        result = fdatasync(file_descriptor);
+        #else
+        result = fsync(file_descriptor);
+        #endif
+    } while (result < 0 && errno == EINTR);
+    if (result < 0) {
+        throw std::runtime_error("Failed to flush data to disk");
+    }
     #endif
-}
\ No newline at end of file
+}
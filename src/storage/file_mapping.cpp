@@ -0,0 +1,122 @@
+#include "storage/file_mapping.hpp"
+#include "storage/constants.hpp"
+#include <algorithm>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileMapping::~FileMapping() {
+    unmap();
+}
+
+bool FileMapping::map(const std::string& file_path, uint32_t page_size) {
+#ifdef _WIN32
+    (void)file_path;
+    (void)page_size;
+    return false;
+#else
+    unmap();
+    page_size_ = page_size;
+    // PROT_NONE and MAP_NORESERVE: the reservation costs address space only.
+    void* base = mmap(nullptr, MMAP_RESERVE_BYTES, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+    base_ = static_cast<uint8_t*>(base);
+    reserved_bytes_ = MMAP_RESERVE_BYTES;
+    file_path_ = file_path;
+    if (!remap()) {
+        unmap();
+        return false;
+    }
+    return true;
+#endif
+}
+
+void FileMapping::unmap() {
+#ifndef _WIN32
+    if (base_ != nullptr) {
+        munmap(base_, reserved_bytes_);
+    }
+#endif
+    base_ = nullptr;
+    reserved_bytes_ = 0;
+    mapped_bytes_.store(0);
+}
+
+bool FileMapping::remap() {
+#ifdef _WIN32
+    return false;
+#else
+    std::lock_guard<std::mutex> lock(remap_latch_);
+    if (base_ == nullptr) {
+        return false;
+    }
+    int fd = open(file_path_.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    // Map whole OS pages only; touching a partial one past the end of the
+    // file would fault. A trailing partial page stays with the pool.
+    uint64_t os_page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t target = std::min<uint64_t>(static_cast<uint64_t>(st.st_size), reserved_bytes_);
+    target -= target % os_page;
+    uint64_t mapped = mapped_bytes_.load();
+    bool ok = true;
+    if (target > mapped) {
+        void* addr = mmap(base_ + mapped, static_cast<size_t>(target - mapped), PROT_READ,
+                          MAP_SHARED | MAP_FIXED, fd, static_cast<off_t>(mapped));
+        if (addr == MAP_FAILED) {
+            ok = false;
+        } else {
+            // Lookups touch a few pages each; scans ask for their leaves
+            // ahead explicitly through will_need().
+            madvise(addr, static_cast<size_t>(target - mapped), MADV_RANDOM);
+            mapped_bytes_.store(target);
+        }
+    } else if (target < mapped) {
+        // The file was cut: touching the pages past its end would fault, so
+        // they go back to being reserved address space.
+        mapped_bytes_.store(target);
+        void* addr = mmap(base_ + target, static_cast<size_t>(mapped - target), PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0);
+        ok = addr != MAP_FAILED;
+    }
+    close(fd);
+    return ok;
+#endif
+}
+
+Page* FileMapping::page(uint32_t page_id) const {
+    uint64_t offset = static_cast<uint64_t>(page_id) * page_size_;
+    if (base_ == nullptr || offset + page_size_ > mapped_bytes_.load()) {
+        return nullptr;
+    }
+    return reinterpret_cast<Page*>(base_ + offset);
+}
+
+void FileMapping::will_need(const std::vector<uint32_t>& page_ids) const {
+#ifdef _WIN32
+    (void)page_ids;
+#else
+    uintptr_t os_page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    for (uint32_t page_id : page_ids) {
+        Page* page = this->page(page_id);
+        if (page == nullptr) {
+            continue;
+        }
+        uintptr_t start = reinterpret_cast<uintptr_t>(page->data) & ~(os_page - 1);
+        uintptr_t end = reinterpret_cast<uintptr_t>(page->data) + page_size_;
+        madvise(reinterpret_cast<void*>(start), end - start, MADV_WILLNEED);
+    }
+#endif
+}
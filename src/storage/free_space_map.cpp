@@ -0,0 +1,495 @@
+#include "storage/free_space_map.hpp"
+#include "storage/table_handle.hpp"
+#include "storage/buffer_pool.hpp"
+#include "storage/page_guard.hpp"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+constexpr uint32_t NO_BIT = static_cast<uint32_t>(-1);
+static_assert(ALLOCATION_EXTENT_PAGES == 64, "an extent is one word of a bitmap page");
+
+inline uint32_t lowest_set_bit(uint64_t word) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(word));
+#endif
+}
+
+inline uint32_t highest_set_bit(uint64_t word) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, word);
+    return static_cast<uint32_t>(index);
+#else
+    return 63 - static_cast<uint32_t>(__builtin_clzll(word));
+#endif
+}
+
+// First clear bit of bits[0, bit_count), looking from start onwards and
+// then wrapping around; NO_BIT if every bit is set. Whole 64-bit words are
+// tested at a time, so bits must extend to a multiple of 8 bytes.
+uint32_t find_clear_bit(const uint8_t* bits, uint32_t bit_count, uint32_t start) {
+    uint32_t word_count = (bit_count + 63) / 64;
+    if (word_count == 0) {
+        return NO_BIT;
+    }
+    uint32_t start_word = start < bit_count ? start / 64 : 0;
+    for (uint32_t i = 0; i < word_count; i++) {
+        uint32_t w = (start_word + i) % word_count;
+        uint64_t word;
+        std::memcpy(&word, bits + static_cast<size_t>(w) * 8, sizeof(word));
+        uint64_t clear = ~word;
+        uint32_t valid = bit_count - w * 64;
+        if (valid < 64) {
+            clear &= (uint64_t{1} << valid) - 1;
+        }
+        if (clear != 0) {
+            return w * 64 + lowest_set_bit(clear);
+        }
+    }
+    return NO_BIT;
+}
+
+// Last bit of bits[0, bit_count) that is set, or with set false clear;
+// NO_BIT if there is none.
+uint32_t find_last_bit(const uint8_t* bits, uint32_t bit_count, bool set) {
+    for (uint32_t w = (bit_count + 63) / 64; w-- > 0;) {
+        uint64_t word;
+        std::memcpy(&word, bits + static_cast<size_t>(w) * 8, sizeof(word));
+        if (!set) {
+            word = ~word;
+        }
+        uint32_t valid = bit_count - w * 64;
+        if (valid < 64) {
+            word &= (uint64_t{1} << valid) - 1;
+        }
+        if (word != 0) {
+            return w * 64 + highest_set_bit(word);
+        }
+    }
+    return NO_BIT;
+}
+
+inline void set_bit(uint8_t* bits, uint32_t bit) {
+    bits[bit / 8] |= static_cast<uint8_t>(1u << (bit % 8));
+}
+
+inline void clear_bit(uint8_t* bits, uint32_t bit) {
+    bits[bit / 8] &= static_cast<uint8_t>(~(1u << (bit % 8)));
+}
+
+inline FreeSpaceHeader* free_space_header(Page& meta) {
+    return reinterpret_cast<FreeSpaceHeader*>(meta.data + sizeof(PageHeader));
+}
+
+// The header of a file from before the map is filled in to match: its one
+// bitmap covers the first group.
+FreeSpaceHeader* load_free_space_header(Page& meta, uint32_t group_pages) {
+    FreeSpaceHeader* fsh = free_space_header(meta);
+    if (fsh->group_count == 0) {
+        fsh->group_count = 1;
+        fsh->high_water = group_pages;
+    }
+    return fsh;
+}
+
+// The meta page's one bit per group.
+inline uint8_t* full_groups(Page& meta) {
+    return meta.data + sizeof(PageHeader) + sizeof(FreeSpaceHeader);
+}
+
+// Groups the meta page has bits for, and whose pages all have 32-bit ids.
+uint32_t max_groups(uint32_t page_size) {
+    uint64_t meta_bits = (page_size - sizeof(PageHeader) - sizeof(FreeSpaceHeader)) * 8ULL;
+    uint64_t addressable = INVALID_PAGE_ID / bitmap_group_pages(page_size);
+    return static_cast<uint32_t>(std::min(meta_bits, addressable));
+}
+
+// Allocates page_id, at or above the high-water mark, and moves the mark
+// past it. The first page of a group is its bitmap, so for one of those the
+// group is started and the page after it allocated instead. Pages skipped
+// on the way stay free below the mark.
+uint32_t raise_high_water(TableHandle& th, FreeSpaceHeader* fsh, uint8_t* full, uint32_t page_id) {
+    uint32_t page_size = th.dm->get_page_size();
+    uint32_t group_pages = bitmap_group_pages(page_size);
+    uint32_t group = page_id / group_pages;
+    WritePageGuard bitmap;
+    if (page_id % group_pages == 0) {
+        if (group >= max_groups(page_size)) {
+            return INVALID_PAGE_ID;
+        }
+        bitmap = WritePageGuard::create(*th.bpm, th.file_id, page_id, PageType::META, PageLevel::NONE);
+        if (!bitmap) {
+            return INVALID_PAGE_ID;
+        }
+        set_bit(bitmap.page().data + sizeof(PageHeader), 0);
+        fsh->group_count = group + 1;
+        page_id++;
+    } else {
+        bitmap = WritePageGuard(*th.bpm, th.file_id, bitmap_page_of_group(group, page_size));
+        if (!bitmap) {
+            return INVALID_PAGE_ID;
+        }
+    }
+    if (page_id > fsh->high_water && fsh->high_water % group_pages != 0) {
+        clear_bit(full, fsh->high_water / group_pages);
+    }
+    set_bit(bitmap.page().data + sizeof(PageHeader), page_id % group_pages);
+    bitmap.mark_dirty();
+    fsh->high_water = page_id + 1;
+    return page_id;
+}
+
+// A page in near_page's extent, the closest one after it if there is one;
+// else the first page of an extent of near_page's group with nothing in use
+// yet; else a page at the high-water mark. Extents are aligned to
+// ALLOCATION_EXTENT_PAGES, as are groups, so each is one bitmap word.
+uint32_t allocate_near(TableHandle& th, FreeSpaceHeader* fsh, uint8_t* full, uint32_t near_page) {
+    uint32_t page_size = th.dm->get_page_size();
+    uint32_t group_pages = bitmap_group_pages(page_size);
+    uint32_t group = near_page / group_pages;
+    if (group >= fsh->group_count) {
+        return INVALID_PAGE_ID;
+    }
+    {
+        WritePageGuard bitmap(*th.bpm, th.file_id, bitmap_page_of_group(group, page_size));
+        if (!bitmap) {
+            return INVALID_PAGE_ID;
+        }
+        uint8_t* bits = bitmap.page().data + sizeof(PageHeader);
+        uint32_t first_page = group * group_pages;
+        uint32_t offset = near_page - first_page;
+        uint32_t word_index = offset / ALLOCATION_EXTENT_PAGES;
+        uint64_t word;
+        std::memcpy(&word, bits + static_cast<size_t>(word_index) * 8, sizeof(word));
+
+        uint32_t bit = NO_BIT;
+        uint64_t clear = ~word;
+        uint32_t near_bit = offset % ALLOCATION_EXTENT_PAGES;
+        uint64_t after = near_bit == 63 ? 0 : clear & (~uint64_t{0} << (near_bit + 1));
+        if (after != 0) {
+            bit = word_index * ALLOCATION_EXTENT_PAGES + lowest_set_bit(after);
+        } else if (clear != 0) {
+            bit = word_index * ALLOCATION_EXTENT_PAGES + lowest_set_bit(clear);
+        } else {
+            // An empty extent, looking from near_page's onwards.
+            uint32_t used_pages = std::min(group_pages, fsh->high_water - first_page);
+            uint32_t word_count = (used_pages + ALLOCATION_EXTENT_PAGES - 1) / ALLOCATION_EXTENT_PAGES;
+            for (uint32_t i = 1; i < word_count && bit == NO_BIT; i++) {
+                uint32_t w = (word_index + i) % word_count;
+                std::memcpy(&word, bits + static_cast<size_t>(w) * 8, sizeof(word));
+                if (word == 0) {
+                    bit = w * ALLOCATION_EXTENT_PAGES;
+                }
+            }
+        }
+        if (bit != NO_BIT && first_page + bit < fsh->high_water) {
+            set_bit(bits, bit);
+            bitmap.mark_dirty();
+            return first_page + bit;
+        }
+        if (bit != NO_BIT && group == fsh->high_water / group_pages) {
+            // Past the mark, but in the group's bitmap already.
+            bitmap.release();
+            return raise_high_water(th, fsh, full, first_page + bit);
+        }
+    }
+
+    // Reserving a whole extent for a single page balloons a randomly loaded
+    // table many times over. Starting on an even page instead leaves, half
+    // the time, the page after it free for that page's own next split.
+    return raise_high_water(th, fsh, full, fsh->high_water + (fsh->high_water & 1u));
+}
+
+}  // namespace
+
+void init_free_space_map(Page& meta, Page& bitmap, uint32_t reserved_pages) {
+    FreeSpaceHeader* fsh = free_space_header(meta);
+    fsh->group_count = 1;
+    fsh->next_fit = reserved_pages;
+    fsh->high_water = reserved_pages;
+    uint8_t* bits = bitmap.data + sizeof(PageHeader);
+    for (uint32_t page_id = 0; page_id < reserved_pages; page_id++) {
+        set_bit(bits, page_id);
+    }
+}
+
+// The meta page is latched exclusively for the whole allocation, so tables
+// sharing a tablespace allocate one at a time; bitmap pages are latched
+// after it.
+uint32_t allocate_page(TableHandle& th, uint32_t near_page) {
+    if (!th.bpm) {
+        return INVALID_PAGE_ID;
+    }
+    uint32_t page_size = th.dm->get_page_size();
+    uint32_t group_pages = bitmap_group_pages(page_size);
+
+    WritePageGuard meta(*th.bpm, th.file_id, 0);
+    if (!meta) {
+        return INVALID_PAGE_ID;
+    }
+    FreeSpaceHeader* fsh = load_free_space_header(meta.page(), group_pages);
+    uint8_t* full = full_groups(meta.page());
+    meta.mark_dirty();
+
+    if (near_page != 0 && near_page != INVALID_PAGE_ID) {
+        uint32_t page_id = allocate_near(th, fsh, full, near_page);
+        if (page_id != INVALID_PAGE_ID) {
+            return page_id;
+        }
+    }
+
+    uint32_t hint = fsh->next_fit < fsh->high_water ? fsh->next_fit : 0;
+    uint32_t hint_group = hint / group_pages;
+    uint32_t group = hint_group;
+    while ((group = find_clear_bit(full, fsh->group_count, group)) != NO_BIT) {
+        WritePageGuard bitmap(*th.bpm, th.file_id, bitmap_page_of_group(group, page_size));
+        if (!bitmap) {
+            return INVALID_PAGE_ID;
+        }
+        uint8_t* bits = bitmap.page().data + sizeof(PageHeader);
+        uint32_t first_page = group * group_pages;
+        uint32_t bit_count = std::min(group_pages, fsh->high_water - first_page);
+        uint32_t bit = find_clear_bit(bits, bit_count, group == hint_group ? hint % group_pages : 0);
+        if (bit != NO_BIT) {
+            set_bit(bits, bit);
+            bitmap.mark_dirty();
+            fsh->next_fit = first_page + bit + 1;
+            return first_page + bit;
+        }
+        set_bit(full, group);
+    }
+
+    // Every page below the high-water mark is in use: raise it.
+    uint32_t page_id = raise_high_water(th, fsh, full, fsh->high_water);
+    if (page_id != INVALID_PAGE_ID) {
+        fsh->next_fit = page_id + 1;
+    }
+    return page_id;
+}
+
+// The cached copy goes first: once the bit is clear, another table of the
+// tablespace may allocate the page and start filling it in.
+void free_page(TableHandle& th, uint32_t page_id) {
+    if (!th.bpm) {
+        return;
+    }
+    th.bpm->delete_page(th.file_id, page_id);
+
+    uint32_t page_size = th.dm->get_page_size();
+    uint32_t group_pages = bitmap_group_pages(page_size);
+    uint32_t group = page_id / group_pages;
+
+    WritePageGuard meta(*th.bpm, th.file_id, 0);
+    if (!meta) {
+        return;
+    }
+    WritePageGuard bitmap(*th.bpm, th.file_id, bitmap_page_of_group(group, page_size));
+    if (!bitmap) {
+        return;
+    }
+    clear_bit(bitmap.page().data + sizeof(PageHeader), page_id % group_pages);
+    bitmap.mark_dirty();
+    clear_bit(full_groups(meta.page()), group);
+    meta.mark_dirty();
+}
+
+uint32_t allocate_page_at(TableHandle& th, uint32_t page_id) {
+    if (!th.bpm) {
+        return INVALID_PAGE_ID;
+    }
+    uint32_t page_size = th.dm->get_page_size();
+    uint32_t group_pages = bitmap_group_pages(page_size);
+
+    WritePageGuard meta(*th.bpm, th.file_id, 0);
+    if (!meta) {
+        return INVALID_PAGE_ID;
+    }
+    FreeSpaceHeader* fsh = load_free_space_header(meta.page(), group_pages);
+    if (page_id >= fsh->high_water) {
+        meta.mark_dirty();
+        return raise_high_water(th, fsh, full_groups(meta.page()), fsh->high_water);
+    }
+    WritePageGuard bitmap(*th.bpm, th.file_id, bitmap_page_of_group(page_id / group_pages, page_size));
+    if (!bitmap) {
+        return INVALID_PAGE_ID;
+    }
+    uint8_t* bits = bitmap.page().data + sizeof(PageHeader);
+    uint32_t bit = page_id % group_pages;
+    if (bits[bit / 8] & (1u << (bit % 8))) {
+        return INVALID_PAGE_ID;
+    }
+    set_bit(bits, bit);
+    bitmap.mark_dirty();
+    return page_id;
+}
+
+uint32_t allocate_page_near_end(TableHandle& th) {
+    if (!th.bpm) {
+        return INVALID_PAGE_ID;
+    }
+    uint32_t page_size = th.dm->get_page_size();
+    uint32_t group_pages = bitmap_group_pages(page_size);
+
+    WritePageGuard meta(*th.bpm, th.file_id, 0);
+    if (!meta) {
+        return INVALID_PAGE_ID;
+    }
+    FreeSpaceHeader* fsh = load_free_space_header(meta.page(), group_pages);
+    uint8_t* full = full_groups(meta.page());
+    for (uint32_t group = fsh->group_count; group-- > 0;) {
+        if (full[group / 8] & (1u << (group % 8))) {
+            continue;
+        }
+        WritePageGuard bitmap(*th.bpm, th.file_id, bitmap_page_of_group(group, page_size));
+        if (!bitmap) {
+            return INVALID_PAGE_ID;
+        }
+        uint8_t* bits = bitmap.page().data + sizeof(PageHeader);
+        uint32_t first_page = group * group_pages;
+        uint32_t bit = find_last_bit(bits, std::min(group_pages, fsh->high_water - first_page), false);
+        if (bit != NO_BIT) {
+            set_bit(bits, bit);
+            bitmap.mark_dirty();
+            return first_page + bit;
+        }
+    }
+    meta.mark_dirty();
+    return raise_high_water(th, fsh, full, fsh->high_water);
+}
+
+uint32_t allocate_page_below(TableHandle& th, uint32_t page_id) {
+    if (!th.bpm) {
+        return INVALID_PAGE_ID;
+    }
+    uint32_t page_size = th.dm->get_page_size();
+    uint32_t group_pages = bitmap_group_pages(page_size);
+
+    WritePageGuard meta(*th.bpm, th.file_id, 0);
+    if (!meta) {
+        return INVALID_PAGE_ID;
+    }
+    FreeSpaceHeader* fsh = load_free_space_header(meta.page(), group_pages);
+    uint8_t* full = full_groups(meta.page());
+    uint32_t limit = std::min(page_id, fsh->high_water);
+    for (uint32_t group = 0; group < fsh->group_count && group * group_pages < limit; group++) {
+        if (full[group / 8] & (1u << (group % 8))) {
+            continue;
+        }
+        WritePageGuard bitmap(*th.bpm, th.file_id, bitmap_page_of_group(group, page_size));
+        if (!bitmap) {
+            return INVALID_PAGE_ID;
+        }
+        uint8_t* bits = bitmap.page().data + sizeof(PageHeader);
+        uint32_t first_page = group * group_pages;
+        uint32_t bit = find_clear_bit(bits, std::min(group_pages, limit - first_page), 0);
+        if (bit != NO_BIT) {
+            set_bit(bits, bit);
+            bitmap.mark_dirty();
+            return first_page + bit;
+        }
+    }
+    return INVALID_PAGE_ID;
+}
+
+uint32_t last_page_in_use(TableHandle& th) {
+    if (!th.bpm) {
+        return 0;
+    }
+    uint32_t page_size = th.dm->get_page_size();
+    uint32_t group_pages = bitmap_group_pages(page_size);
+
+    ReadPageGuard meta(*th.bpm, th.file_id, 0);
+    if (!meta) {
+        return 0;
+    }
+    FreeSpaceHeader fsh = *free_space_header(meta.page());
+    if (fsh.group_count == 0) {
+        fsh.group_count = 1;
+        fsh.high_water = group_pages;
+    }
+    for (uint32_t group = fsh.group_count; group-- > 0;) {
+        ReadPageGuard bitmap(*th.bpm, th.file_id, bitmap_page_of_group(group, page_size));
+        if (!bitmap) {
+            return 0;
+        }
+        uint32_t first_page = group * group_pages;
+        uint32_t last = find_last_bit(bitmap.page().data + sizeof(PageHeader),
+                                      std::min(group_pages, fsh.high_water - first_page), true);
+        if (last != NO_BIT && (group == 0 || last > 0)) {
+            return first_page + last;
+        }
+    }
+    return 0;
+}
+
+// Groups left with nothing but their bitmap page are given up along with
+// it. The file is cut under the meta page's latch, so no table of a
+// tablespace can start writing past the new end before it is.
+uint32_t truncate_free_pages(TableHandle& th) {
+    if (!th.bpm) {
+        return 0;
+    }
+    uint32_t page_size = th.dm->get_page_size();
+    uint32_t group_pages = bitmap_group_pages(page_size);
+
+    WritePageGuard meta(*th.bpm, th.file_id, 0);
+    if (!meta) {
+        return 0;
+    }
+    FreeSpaceHeader* fsh = load_free_space_header(meta.page(), group_pages);
+    uint8_t* full = full_groups(meta.page());
+    uint32_t old_high_water = fsh->high_water;
+    uint32_t high_water = old_high_water;
+    std::vector<uint32_t> dropped_bitmaps;
+    for (uint32_t group = fsh->group_count; group-- > 0;) {
+        uint32_t first_page = group * group_pages;
+        ReadPageGuard bitmap(*th.bpm, th.file_id, bitmap_page_of_group(group, page_size));
+        if (!bitmap) {
+            return 0;
+        }
+        uint32_t last = find_last_bit(bitmap.page().data + sizeof(PageHeader),
+                                      std::min(group_pages, high_water - first_page), true);
+        if (last == NO_BIT || (group > 0 && last == 0)) {
+            clear_bit(full, group);
+            dropped_bitmaps.push_back(first_page);
+            high_water = first_page;
+            continue;
+        }
+        high_water = first_page + last + 1;
+        break;
+    }
+    if (high_water >= old_high_water) {
+        return 0;
+    }
+    fsh->group_count = (high_water + group_pages - 1) / group_pages;
+    fsh->high_water = high_water;
+    fsh->next_fit = std::min(fsh->next_fit, high_water);
+    meta.mark_dirty();
+    // Cached, they would be written back past the end again.
+    for (uint32_t page_id : dropped_bitmaps) {
+        th.bpm->delete_page(th.file_id, page_id);
+    }
+
+    // A compressed file keeps its pages in slots rather than by page id, so
+    // its end is not where its last pages are.
+    if (!th.dm->is_compressed()) {
+        try {
+            th.dm->truncate(high_water);
+        }
+        catch (const std::exception&) {
+            return 0;
+        }
+    }
+    return old_high_water - high_water;
+}
@@ -0,0 +1,57 @@
+#include "storage/group_commit.hpp"
+#include <algorithm>
+#include <exception>
+
+uint64_t GroupCommit::add() {
+    std::lock_guard<std::mutex> lock(latch_);
+    return ++issued_;
+}
+
+uint64_t GroupCommit::last_ticket() const {
+    std::lock_guard<std::mutex> lock(latch_);
+    return issued_;
+}
+
+bool GroupCommit::commit(uint64_t ticket, const std::function<void()>& sync) {
+    std::unique_lock<std::mutex> lock(latch_);
+    commit_count_++;
+    while (durable_ < ticket) {
+        if (syncing_) {
+            // If that sync fails, the loop makes this caller try its own.
+            synced_.wait(lock);
+            continue;
+        }
+        // Everything issued so far was written to the pool before its
+        // ticket was taken, so one sync started now covers all of it.
+        syncing_ = true;
+        uint64_t target = issued_;
+        lock.unlock();
+        bool ok = true;
+        try {
+            sync();
+        } catch (const std::exception&) {
+            ok = false;
+        }
+        lock.lock();
+        syncing_ = false;
+        sync_count_++;
+        if (ok) {
+            durable_ = std::max(durable_, target);
+        }
+        synced_.notify_all();
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t GroupCommit::get_sync_count() const {
+    std::lock_guard<std::mutex> lock(latch_);
+    return sync_count_;
+}
+
+uint64_t GroupCommit::get_commit_count() const {
+    std::lock_guard<std::mutex> lock(latch_);
+    return commit_count_;
+}
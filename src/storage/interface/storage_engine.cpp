@@ -2,31 +2,107 @@
 #include "storage/table_handle.hpp"
 #include "storage/buffer_pool.hpp"
 #include "storage/btree.hpp"
+#include "storage/tablespace.hpp"
+#include "storage/record.hpp"
 #include "storage/relational/catalog.hpp"
 #include "storage/relational/row_codec.hpp"
 #include <cstring>
 #include <algorithm>
 #include <cstdio>
+#include <thread>
+#include <shared_mutex>
 
-StorageEngine::StorageEngine() = default;
+namespace {
+bool merge_add(const uint8_t* existing, size_t existing_size, const uint8_t* operand, size_t operand_size,
+               std::vector<uint8_t>& merged, void*) {
+    int64_t sum = 0;
+    if (operand_size != sizeof(sum) || (existing != nullptr && existing_size != sizeof(sum))) {
+        return false;
+    }
+    if (existing != nullptr) {
+        std::memcpy(&sum, existing, sizeof(sum));
+    }
+    int64_t addend;
+    std::memcpy(&addend, operand, sizeof(addend));
+    // Wraps around like the unsigned sum rather than overflowing.
+    sum = static_cast<int64_t>(static_cast<uint64_t>(sum) + static_cast<uint64_t>(addend));
+    merged.resize(sizeof(sum));
+    std::memcpy(merged.data(), &sum, sizeof(sum));
+    return true;
+}
+
+bool merge_append(const uint8_t* existing, size_t existing_size, const uint8_t* operand, size_t operand_size,
+                  std::vector<uint8_t>& merged, void*) {
+    merged.assign(existing, existing + (existing != nullptr ? existing_size : 0));
+    merged.insert(merged.end(), operand, operand + operand_size);
+    return true;
+}
+}
+
+StorageEngine::StorageEngine(size_t buffer_pool_bytes) : buffer_pool_bytes_(buffer_pool_bytes) {
+    buffer_pool(PAGE_SIZE);
+    merge_operators_ = {{merge_add, nullptr}, {merge_append, nullptr}};
+}
 
 StorageEngine::~StorageEngine() {
-    flush_all();
+    for (auto& [name, handle] : open_tables_) {
+        if (handle && !::close_table(*handle)) {
+            unflushed_files_.push_back(handle->dm);
+        }
+    }
     open_tables_.clear();
+    if (tablespace_ && !tablespace_->close()) {
+        unflushed_files_.push_back(tablespace_->get_disk_manager());
+    }
+}
+
+bool StorageEngine::use_tablespace(const std::string& name, uint32_t page_size, bool compress_leaves) {
+    if (tablespace_) {
+        return false;
+    }
+    std::string path = Tablespace::path_for(name);
+    Page meta;
+    if (!read_meta_page(path, meta)) {
+        if (!Tablespace::create(name, page_size, compress_leaves) || !read_meta_page(path, meta)) {
+            return false;
+        }
+    }
+    auto tablespace = std::make_unique<Tablespace>();
+    if (!tablespace->open(name, buffer_pool(::page_size(meta)))) {
+        return false;
+    }
+    tablespace_ = std::move(tablespace);
+    return true;
 }
 
 bool StorageEngine::create_table(const std::string& table_name) {
     if (open_tables_.find(table_name) != open_tables_.end()) {
         return false;
     }
+    if (tablespace_) {
+        return tablespace_->create_table(table_name);
+    }
     return ::create_table(table_name);
 }
 
+bool StorageEngine::create_table(const std::string& table_name, uint32_t page_size, bool compress_leaves) {
+    if (open_tables_.find(table_name) != open_tables_.end()) {
+        return false;
+    }
+    if (tablespace_) {
+        if (page_size != tablespace_->get_page_size() || compress_leaves != tablespace_->is_compressed()) {
+            return false;
+        }
+        return tablespace_->create_table(table_name);
+    }
+    return ::create_table(table_name, page_size, compress_leaves);
+}
+
 bool StorageEngine::create_table(const std::string& table_name, const Relational::TableSchema& schema) {
     if (open_tables_.find(table_name) != open_tables_.end()) {
         return false;
     }
-    if (!::create_table(table_name)) {
+    if (!create_table(table_name)) {
         return false;
     }
     if (!catalog_.register_table(table_name, schema)) {
@@ -38,13 +114,17 @@ bool StorageEngine::create_table(const std::string& table_name, const Relational
 bool StorageEngine::drop_table(const std::string& table_name) {
     auto it = open_tables_.find(table_name);
     if (it != open_tables_.end()) {
-        if (it->second && it->second->bpm) {
-            it->second->bpm->flush_all();
+        if (it->second && !::close_table(*it->second)) {
+            return false;
         }
         open_tables_.erase(it);
     }
     catalog_.drop_table(table_name);
+    if (tablespace_) {
+        return tablespace_->drop_table(table_name);
+    }
     std::string path = "data/" + table_name + ".db";
+    std::remove(DiskManager::page_map_path(path).c_str());
     return std::remove(path.c_str()) == 0;
 }
 
@@ -52,20 +132,29 @@ TableHandle* StorageEngine::open_table(const std::string& table_name) {
     return get_or_open_table(table_name);
 }
 
-void StorageEngine::close_table(TableHandle* handle) {
+TableHandle* StorageEngine::open_table(const std::string& table_name, TableAccessMode mode) {
+    TableHandle* handle = get_or_open_table(table_name);
+    if (handle == nullptr || !set_access_mode(*handle, mode)) {
+        return nullptr;
+    }
+    return handle;
+}
+
+bool StorageEngine::close_table(TableHandle* handle) {
     if (handle == nullptr) {
-        return;
+        return false;
     }
     
     for (auto it = open_tables_.begin(); it != open_tables_.end(); ++it) {
         if (it->second.get() == handle) {
-            if (handle->bpm) {
-                handle->bpm->flush_all();
+            if (!::close_table(*handle)) {
+                return false;
             }
             open_tables_.erase(it);
-            return;
+            return true;
         }
     }
+    return false;
 }
 
 TableHandle* StorageEngine::get_or_open_table(const std::string& table_name) {
@@ -75,8 +164,15 @@ TableHandle* StorageEngine::get_or_open_table(const std::string& table_name) {
     }
     
     auto th = std::make_unique<TableHandle>(table_name);
-    if (!::open_table(table_name, *th)) {
-        return nullptr;
+    if (tablespace_) {
+        if (!tablespace_->open_table(table_name, *th)) {
+            return nullptr;
+        }
+    } else {
+        uint32_t page_size = table_page_size(table_name);
+        if (page_size == 0 || !::open_table(table_name, *th, buffer_pool(page_size))) {
+            return nullptr;
+        }
     }
     
     TableHandle* handle = th.get();
@@ -84,6 +180,30 @@ TableHandle* StorageEngine::get_or_open_table(const std::string& table_name) {
     return handle;
 }
 
+namespace {
+// Runs one write against the table. Writers to a table are serialized and
+// exclude readers; in PER_OPERATION mode the call then waits until the
+// change is durable, sharing the sync with writers that finished in the
+// meantime. A write that fails has changed nothing, so it is neither
+// written back to the mapping nor given a commit ticket.
+template <typename Write>
+bool run_write(TableHandle& th, Write write) {
+    uint64_t ticket;
+    {
+        std::unique_lock<std::shared_mutex> lock(th.write_latch);
+        if (!write()) {
+            return false;
+        }
+        sync_mapping(th);
+        ticket = th.group_commit.add();
+    }
+    if (th.durability == DurabilityMode::PER_OPERATION) {
+        return sync_table(th, ticket);
+    }
+    return true;
+}
+}
+
 bool StorageEngine::insert_record(TableHandle* handle, const std::vector<uint8_t>& key, const std::vector<uint8_t>& value) {
     if (handle == nullptr || key.empty() || key.size() > UINT16_MAX || value.size() > UINT16_MAX) {
         return false;
@@ -92,7 +212,7 @@ bool StorageEngine::insert_record(TableHandle* handle, const std::vector<uint8_t
     Key k(key.data(), static_cast<uint16_t>(key.size()));
     Value v(value.data(), static_cast<uint16_t>(value.size()));
     
-    return btree_insert(*handle, k, v);
+    return run_write(*handle, [&] { return btree_insert(*handle, k, v); });
 }
 
 bool StorageEngine::get_record(TableHandle* handle, const std::vector<uint8_t>& key, std::vector<uint8_t>& out_value) {
@@ -103,6 +223,7 @@ bool StorageEngine::get_record(TableHandle* handle, const std::vector<uint8_t>&
     Key k(key.data(), static_cast<uint16_t>(key.size()));
     Value v;
     
+    std::shared_lock<std::shared_mutex> lock(handle->write_latch);
     if (!btree_search(*handle, k, v)) {
         return false;
     }
@@ -111,13 +232,58 @@ bool StorageEngine::get_record(TableHandle* handle, const std::vector<uint8_t>&
     return true;
 }
 
+namespace {
+struct GetBatchContext {
+    const std::vector<size_t>* order;
+    StorageEngine::BatchResult* result;
+};
+
+void get_batch_callback(size_t index, const Value& value, void* ctx) {
+    GetBatchContext* batch = static_cast<GetBatchContext*>(ctx);
+    std::vector<uint8_t>& arena = batch->result->arena;
+    StorageEngine::BatchValue& out = batch->result->values[(*batch->order)[index]];
+    out.offset = arena.size();
+    out.size = value.size();
+    out.found = true;
+    arena.insert(arena.end(), value.data(), value.data() + value.size());
+}
+}
+
+size_t StorageEngine::get_batch(TableHandle* handle, const std::vector<std::vector<uint8_t>>& keys, BatchResult& result) {
+    result.arena.clear();
+    result.values.assign(keys.size(), BatchValue());
+    if (handle == nullptr) {
+        return 0;
+    }
+    std::vector<size_t> order;
+    order.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (!keys[i].empty() && keys[i].size() <= UINT16_MAX) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return compare_keys(keys[a].data(), static_cast<uint16_t>(keys[a].size()),
+                            keys[b].data(), static_cast<uint16_t>(keys[b].size())) < 0;
+    });
+    std::vector<Key> sorted;
+    sorted.reserve(order.size());
+    for (size_t i : order) {
+        sorted.emplace_back(keys[i].data(), static_cast<uint16_t>(keys[i].size()));
+    }
+
+    GetBatchContext ctx{&order, &result};
+    std::shared_lock<std::shared_mutex> lock(handle->write_latch);
+    return btree_get_batch(*handle, sorted, get_batch_callback, &ctx);
+}
+
 bool StorageEngine::delete_record(TableHandle* handle, const std::vector<uint8_t>& key) {
     if (handle == nullptr || key.empty() || key.size() > UINT16_MAX) {
         return false;
     }
     
     Key k(key.data(), static_cast<uint16_t>(key.size()));
-    return btree_delete(*handle, k);
+    return run_write(*handle, [&] { return btree_delete(*handle, k); });
 }
 
 bool StorageEngine::update_record(TableHandle* handle, const std::vector<uint8_t>& key, const std::vector<uint8_t>& new_value) {
@@ -126,13 +292,122 @@ bool StorageEngine::update_record(TableHandle* handle, const std::vector<uint8_t
     }
     
     Key k(key.data(), static_cast<uint16_t>(key.size()));
-    
-    if (!btree_delete(*handle, k)) {
+    Value v(new_value.data(), static_cast<uint16_t>(new_value.size()));
+    return run_write(*handle, [&] { return btree_update(*handle, k, v); });
+}
+
+bool StorageEngine::upsert(TableHandle* handle, const std::vector<uint8_t>& key, const std::vector<uint8_t>& value) {
+    if (handle == nullptr || key.empty() || key.size() > UINT16_MAX || value.size() > UINT16_MAX) {
         return false;
     }
-    
-    Value v(new_value.data(), static_cast<uint16_t>(new_value.size()));
-    return btree_insert(*handle, k, v);
+
+    Key k(key.data(), static_cast<uint16_t>(key.size()));
+    Value v(value.data(), static_cast<uint16_t>(value.size()));
+    return run_write(*handle, [&] { return btree_upsert(*handle, k, v); });
+}
+
+uint32_t StorageEngine::register_merge_operator(MergeOperator merge_operator, void* ctx) {
+    std::unique_lock<std::shared_mutex> lock(merge_operators_latch_);
+    merge_operators_.push_back({merge_operator, ctx});
+    return static_cast<uint32_t>(merge_operators_.size() - 1);
+}
+
+namespace {
+struct MergeContext {
+    StorageEngine::MergeOperator user_merge;
+    void* user_ctx;
+};
+
+bool merge_operator_wrapper(const Value* existing, const Value& operand, std::vector<uint8_t>& merged, void* ctx) {
+    MergeContext* merge_ctx = static_cast<MergeContext*>(ctx);
+    return merge_ctx->user_merge(existing != nullptr ? existing->data() : nullptr, existing != nullptr ? existing->size() : 0,
+                                 operand.data(), operand.size(), merged, merge_ctx->user_ctx);
+}
+}
+
+bool StorageEngine::merge(TableHandle* handle, const std::vector<uint8_t>& key, const std::vector<uint8_t>& operand,
+                          uint32_t merge_operator) {
+    if (handle == nullptr || key.empty() || key.size() > UINT16_MAX || operand.size() > UINT16_MAX) {
+        return false;
+    }
+    MergeContext ctx;
+    {
+        std::shared_lock<std::shared_mutex> lock(merge_operators_latch_);
+        if (merge_operator >= merge_operators_.size() || merge_operators_[merge_operator].merge == nullptr) {
+            return false;
+        }
+        ctx = {merge_operators_[merge_operator].merge, merge_operators_[merge_operator].ctx};
+    }
+
+    Key k(key.data(), static_cast<uint16_t>(key.size()));
+    Value v(operand.data(), static_cast<uint16_t>(operand.size()));
+    return run_write(*handle, [&] { return btree_merge(*handle, k, v, merge_operator_wrapper, &ctx); });
+}
+
+size_t StorageEngine::insert_batch(TableHandle* handle, const std::vector<Row>& rows) {
+    if (handle == nullptr) {
+        return 0;
+    }
+    std::vector<std::pair<Key, Value>> sorted;
+    sorted.reserve(rows.size());
+    for (const Row& row : rows) {
+        if (row.first.empty() || row.first.size() > UINT16_MAX || row.second.size() > UINT16_MAX) {
+            continue;
+        }
+        sorted.emplace_back(Key(row.first.data(), static_cast<uint16_t>(row.first.size())),
+                            Value(row.second.data(), static_cast<uint16_t>(row.second.size())));
+    }
+    // Stable, so of two rows with the same key the first one is inserted.
+    std::stable_sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+        return compare_keys(a.first.data(), a.first.size(), b.first.data(), b.first.size()) < 0;
+    });
+
+    size_t inserted = 0;
+    bool ok = run_write(*handle, [&] {
+        inserted = btree_insert_batch(*handle, sorted);
+        return inserted > 0;
+    });
+    return ok ? inserted : 0;
+}
+
+namespace {
+struct BulkLoadContext {
+    StorageEngine::BulkLoadSource user_source;
+    void* user_ctx;
+    std::vector<uint8_t> key;
+    std::vector<uint8_t> value;
+};
+
+bool bulk_load_source_wrapper(Key& k, Value& v, void* ctx) {
+    BulkLoadContext* load_ctx = static_cast<BulkLoadContext*>(ctx);
+    if (!load_ctx->user_source(load_ctx->key, load_ctx->value, load_ctx->user_ctx)) {
+        return false;
+    }
+    // Oversized rows come through as empty keys, which the loader rejects.
+    if (load_ctx->key.size() > UINT16_MAX || load_ctx->value.size() > UINT16_MAX) {
+        k = Key();
+        v = Value();
+        return true;
+    }
+    k = Key(load_ctx->key.data(), static_cast<uint16_t>(load_ctx->key.size()));
+    v = Value(load_ctx->value.data(), static_cast<uint16_t>(load_ctx->value.size()));
+    return true;
+}
+}
+
+bool StorageEngine::bulk_load(TableHandle* handle, BulkLoadSource source, void* ctx, uint32_t fill_percent) {
+    if (handle == nullptr || source == nullptr) {
+        return false;
+    }
+    BulkLoadContext load_ctx{source, ctx, {}, {}};
+    // A load that stops early keeps the rows before the one it refused, so
+    // those are committed either way.
+    bool loaded = false;
+    bool committed = run_write(*handle, [&] {
+        loaded = btree_bulk_load(*handle, bulk_load_source_wrapper, &load_ctx, fill_percent);
+        return true;
+    });
+    return committed && loaded;
 }
 
 namespace {
@@ -191,15 +466,70 @@ void StorageEngine::range_scan(TableHandle* handle, const std::vector<uint8_t>&
     scan_ctx.user_callback = callback;
     scan_ctx.user_ctx = ctx;
     
+    std::shared_lock<std::shared_mutex> lock(handle->write_latch);
     btree_range_scan(*handle, k_start, k_end, btree_scan_wrapper, &scan_ctx);
 }
 
-void StorageEngine::flush_all() {
-    for (auto& [name, handle] : open_tables_) {
-        if (handle && handle->bpm) {
-            handle->bpm->flush_all();
+void StorageEngine::set_durability(TableHandle* handle, DurabilityMode mode) {
+    if (handle != nullptr) {
+        handle->durability = mode;
+    }
+}
+
+bool StorageEngine::sync_table(TableHandle* handle) {
+    if (handle == nullptr) {
+        return false;
+    }
+    return ::sync_table(*handle, handle->group_commit.last_ticket());
+}
+
+bool StorageEngine::compact_table(TableHandle* handle) {
+    if (handle == nullptr) {
+        return false;
+    }
+    CompactionState state;
+    while (state.phase != CompactionState::Phase::DONE) {
+        // A step that fails may have moved pages first, so it is committed
+        // either way.
+        bool stepped = false;
+        if (!run_write(*handle, [&] { stepped = btree_compact_step(*handle, state); return true; }) || !stepped) {
+            return false;
         }
+        // Waiting writers get the latch between steps.
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+BTreeStats StorageEngine::get_btree_stats(TableHandle* handle) {
+    if (handle == nullptr) {
+        return BTreeStats();
+    }
+    std::shared_lock<std::shared_mutex> lock(handle->write_latch);
+    return handle->btree_stats;
+}
+
+void StorageEngine::flush_all() {
+    for (auto& [page_size, pool] : buffer_pools_) {
+        pool->flush_all();
+    }
+}
+
+BufferPoolManager& StorageEngine::buffer_pool(uint32_t page_size) {
+    auto found = buffer_pools_.find(page_size);
+    if (found != buffer_pools_.end()) {
+        return *found->second;
+    }
+    // Every page size in use gets an equal share of the budget; the pools
+    // already open shrink to make room for the new one.
+    size_t share = buffer_pool_bytes_ / (buffer_pools_.size() + 1);
+    for (auto& [pool_page_size, pool] : buffer_pools_) {
+        pool->set_frame_limit(BufferPoolManager::frames_for_budget(share, pool_page_size));
     }
+    auto& pool = buffer_pools_[page_size];
+    pool = std::make_unique<BufferPoolManager>(BufferPoolManager::frames_for_budget(share, page_size),
+                                               ReplacerPolicy::LRU, IoBackend::IO_URING, page_size);
+    return *pool;
 }
 
 bool StorageEngine::insert(const std::string& table_name, const Relational::Tuple& row) {
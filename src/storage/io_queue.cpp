@@ -0,0 +1,226 @@
+#include "storage/io_queue.hpp"
+#include "storage/disk_manager.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+IoQueue::IoQueue(size_t depth, IoBackend backend)
+    : backend_(IoBackend::SYNC), depth_(depth == 0 ? 1 : depth) {
+    if (backend == IoBackend::IO_URING && setup_ring()) {
+        backend_ = IoBackend::IO_URING;
+    }
+}
+
+IoQueue::~IoQueue() {
+    wait();
+#ifdef __linux__
+    if (sqes_ != nullptr) {
+        munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != nullptr) {
+        munmap(sq_ring_, sq_ring_size_);
+    }
+    if (ring_fd_ >= 0) {
+        close(ring_fd_);
+    }
+#endif
+}
+
+// Maps the submission and completion rings of a new io_uring instance.
+// Returns false, leaving the queue on the SYNC backend, when the kernel
+// refuses (too old, disabled by sysctl or seccomp).
+bool IoQueue::setup_ring() {
+#ifdef __linux__
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, static_cast<unsigned>(depth_), &params));
+    if (fd < 0) {
+        return false;
+    }
+    ring_fd_ = fd;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        sq_ring_ = nullptr;
+        return false;
+    }
+    if (single_mmap) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            cq_ring_ = nullptr;
+            return false;
+        }
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) {
+        sqes_ = nullptr;
+        return false;
+    }
+
+    uint8_t* sq = static_cast<uint8_t*>(sq_ring_);
+    uint8_t* cq = static_cast<uint8_t*>(cq_ring_);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = cq + params.cq_off.cqes;
+    // The kernel may round the ring up; never keep more in flight than
+    // the completion ring holds.
+    depth_ = std::min<size_t>(depth_, params.sq_entries);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool IoQueue::submit(IoRequest& request) {
+    if (in_flight_ >= depth_) {
+        return false;
+    }
+    request.ok = false;
+    // Compressed files have no fixed page offsets to hand the kernel.
+    if (backend_ == IoBackend::SYNC || request.disk_manager->is_compressed()) {
+        complete_sync(request);
+        sync_completed_.push_back(&request);
+        in_flight_++;
+        return true;
+    }
+
+#ifdef __linux__
+    uint32_t page_size = request.disk_manager->get_page_size();
+    uint64_t length = static_cast<uint64_t>(request.page_count) * page_size;
+    uint64_t offset = static_cast<uint64_t>(request.first_page_id) * page_size;
+    if (request.write && offset + length > request.disk_manager->get_file_size()) {
+        // Growing the file stays synchronous and serialized by the
+        // DiskManager, as for blocking writes.
+        try {
+            request.disk_manager->grow_to(offset + length);
+        } catch (const std::exception&) {
+            sync_completed_.push_back(&request);
+            in_flight_++;
+            return true;
+        }
+    }
+
+    unsigned tail = *sq_tail_;
+    unsigned index = tail & *sq_mask_;
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes_) + index;
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = request.write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = request.disk_manager->file_descriptor;
+    sqe->addr = reinterpret_cast<uint64_t>(request.buffer);
+    sqe->len = static_cast<uint32_t>(length);
+    sqe->off = offset;
+    sqe->user_data = reinterpret_cast<uint64_t>(&request);
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+    unsubmitted_++;
+    in_flight_++;
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t IoQueue::poll(std::vector<IoRequest*>& completed, size_t min_complete) {
+    min_complete = std::min(min_complete, in_flight_);
+    size_t reaped = sync_completed_.size();
+    completed.insert(completed.end(), sync_completed_.begin(), sync_completed_.end());
+    sync_completed_.clear();
+    in_flight_ -= reaped;
+    if (backend_ == IoBackend::SYNC) {
+        return reaped;
+    }
+
+#ifdef __linux__
+    while (true) {
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            io_uring_cqe* cqe = static_cast<io_uring_cqe*>(cqes_) + (head & *cq_mask_);
+            IoRequest* request = reinterpret_cast<IoRequest*>(cqe->user_data);
+            uint32_t page_size = request->disk_manager->get_page_size();
+            uint64_t length = static_cast<uint64_t>(request->page_count) * page_size;
+            if (cqe->res >= 0 && static_cast<uint64_t>(cqe->res) == length) {
+                request->ok = true;
+            } else if (!request->write && cqe->res >= 0 && cqe->res % page_size == 0) {
+                // Short read at the end of the file: the rest reads as zeros.
+                std::memset(request->buffer + cqe->res, 0, static_cast<size_t>(length - cqe->res));
+                request->ok = true;
+            } else {
+                complete_sync(*request);
+            }
+            completed.push_back(request);
+            reaped++;
+            in_flight_--;
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+        if (reaped >= min_complete && unsubmitted_ == 0) {
+            return reaped;
+        }
+        unsigned to_submit = static_cast<unsigned>(unsubmitted_);
+        unsigned wait_for = reaped >= min_complete ? 0 : static_cast<unsigned>(min_complete - reaped);
+        syscall_count_++;
+        int ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd_, to_submit, wait_for,
+                                           wait_for > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                continue;
+            }
+            throw std::runtime_error("io_uring_enter failed");
+        }
+        unsubmitted_ -= std::min<size_t>(unsubmitted_, static_cast<size_t>(ret));
+    }
+#else
+    return reaped;
+#endif
+}
+
+void IoQueue::wait() {
+    std::vector<IoRequest*> completed;
+    while (in_flight_ > 0) {
+        poll(completed, in_flight_);
+    }
+}
+
+// Blocking fallback: DiskManager's own calls, which retry short transfers.
+void IoQueue::complete_sync(IoRequest& request) {
+    try {
+        if (request.write) {
+            request.disk_manager->write_pages(request.first_page_id, request.page_count, request.buffer);
+        } else {
+            for (size_t i = 0; i < request.page_count; i++) {
+                request.disk_manager->read_page(request.first_page_id + static_cast<uint32_t>(i),
+                                                request.buffer + i * request.disk_manager->get_page_size());
+            }
+        }
+        request.ok = true;
+    } catch (const std::exception&) {
+        request.ok = false;
+    }
+}
@@ -0,0 +1,166 @@
+#include "storage/lz_codec.hpp"
+#include <cstring>
+
+namespace {
+
+constexpr unsigned HASH_BITS = 12;
+
+inline uint32_t read32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint32_t hash_sequence(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Writes the part of a length that did not fit in its token nibble.
+inline bool put_length(uint8_t* dst, size_t capacity, size_t& op, size_t length) {
+    while (length >= 255) {
+        if (op >= capacity) {
+            return false;
+        }
+        dst[op++] = 255;
+        length -= 255;
+    }
+    if (op >= capacity) {
+        return false;
+    }
+    dst[op++] = static_cast<uint8_t>(length);
+    return true;
+}
+
+inline bool get_length(const uint8_t* src, size_t size, size_t& ip, size_t& length) {
+    uint8_t byte;
+    do {
+        if (ip >= size) {
+            return false;
+        }
+        byte = src[ip++];
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// Emits the literals followed by a match of match_length bytes at offset;
+// match_length 0 ends the block.
+bool put_sequence(const uint8_t* literal_data, size_t literals, size_t offset, size_t match_length,
+                  uint8_t* dst, size_t capacity, size_t& op) {
+    if (op >= capacity) {
+        return false;
+    }
+    size_t token_at = op++;
+    uint8_t token = static_cast<uint8_t>((literals < 15 ? literals : 15) << 4);
+    if (literals >= 15 && !put_length(dst, capacity, op, literals - 15)) {
+        return false;
+    }
+    if (literals > capacity - op) {
+        return false;
+    }
+    std::memcpy(dst + op, literal_data, literals);
+    op += literals;
+
+    if (match_length > 0) {
+        if (capacity - op < 2) {
+            return false;
+        }
+        dst[op++] = static_cast<uint8_t>(offset);
+        dst[op++] = static_cast<uint8_t>(offset >> 8);
+        size_t extra = match_length - LZ_MIN_MATCH;
+        token |= static_cast<uint8_t>(extra < 15 ? extra : 15);
+        if (extra >= 15 && !put_length(dst, capacity, op, extra - 15)) {
+            return false;
+        }
+    }
+    dst[token_at] = token;
+    return true;
+}
+
+}  // namespace
+
+size_t lz_compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity) {
+    if (size > LZ_MAX_INPUT) {
+        return 0;
+    }
+    // Last position each hashed 4-byte sequence was seen at, plus one.
+    uint16_t table[1u << HASH_BITS] = {};
+
+    size_t op = 0;
+    size_t anchor = 0;
+    size_t ip = 0;
+    while (ip + LZ_MIN_MATCH <= size) {
+        uint32_t sequence = read32(src + ip);
+        uint32_t hash = hash_sequence(sequence);
+        size_t candidate = table[hash];
+        table[hash] = static_cast<uint16_t>(ip + 1);
+        if (candidate == 0 || read32(src + candidate - 1) != sequence) {
+            // Step faster through data that keeps failing to match.
+            ip += 1 + ((ip - anchor) >> 5);
+            continue;
+        }
+        candidate--;
+        size_t length = LZ_MIN_MATCH;
+        while (ip + length < size && src[candidate + length] == src[ip + length]) {
+            length++;
+        }
+        if (!put_sequence(src + anchor, ip - anchor, ip - candidate, length, dst, capacity, op)) {
+            return 0;
+        }
+        ip += length;
+        anchor = ip;
+        if (ip + 2 <= size) {
+            table[hash_sequence(read32(src + ip - 2))] = static_cast<uint16_t>(ip - 1);
+        }
+    }
+    if (!put_sequence(src + anchor, size - anchor, 0, 0, dst, capacity, op)) {
+        return 0;
+    }
+    return op;
+}
+
+size_t lz_decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity) {
+    size_t ip = 0;
+    size_t op = 0;
+    while (ip < size) {
+        uint8_t token = src[ip++];
+        size_t literals = token >> 4;
+        if (literals == 15 && !get_length(src, size, ip, literals)) {
+            return 0;
+        }
+        if (literals > size - ip || literals > capacity - op) {
+            return 0;
+        }
+        std::memcpy(dst + op, src + ip, literals);
+        ip += literals;
+        op += literals;
+        if (ip == size) {
+            break;
+        }
+
+        if (size - ip < 2) {
+            return 0;
+        }
+        size_t offset = static_cast<size_t>(src[ip]) | (static_cast<size_t>(src[ip + 1]) << 8);
+        ip += 2;
+        size_t length = token & 15;
+        if (length == 15 && !get_length(src, size, ip, length)) {
+            return 0;
+        }
+        length += LZ_MIN_MATCH;
+        if (offset == 0 || offset > op || length > capacity - op) {
+            return 0;
+        }
+        const uint8_t* match = dst + op - offset;
+        if (offset >= length) {
+            std::memcpy(dst + op, match, length);
+        } else {
+            // Overlapping match: a run that repeats its last offset bytes.
+            for (size_t i = 0; i < length; i++) {
+                dst[op + i] = match[i];
+            }
+        }
+        op += length;
+    }
+    return op;
+}
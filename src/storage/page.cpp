@@ -3,20 +3,39 @@
 #include <cstring>
 #include <algorithm>
 
-void init_page(Page& page, uint32_t page_id, PageType page_type, PageLevel page_level) {
+bool is_valid_page_size(uint32_t page_size) {
+    return page_size >= PAGE_SIZE && page_size <= MAX_PAGE_SIZE && (page_size & (page_size - 1)) == 0;
+}
+
+void init_page(Page& page, uint32_t page_id, PageType page_type, PageLevel page_level, uint32_t page_size) {
     PageHeader* page_header = get_header(page);
-    std::memset(page.data, 0, PAGE_SIZE);
+    std::memset(page.data, 0, page_size);
     
     page_header->page_id = page_id;
     page_header->page_type = page_type;
     page_header->page_level = page_level;
     std::fill_n(page_header->reserved, sizeof(page_header->reserved) / sizeof(page_header->reserved[0]), static_cast<uint8_t>(0));
     page_header->flags = 0;
+    page_header->page_shift = 0;
+    while ((1u << page_header->page_shift) < page_size) {
+        page_header->page_shift++;
+    }
     page_header->cell_count = 0;
     page_header->free_start = sizeof(PageHeader);
-    page_header->free_end = PAGE_SIZE;
+    // A slot offset of 32768 still fits in the uint16_t free_end.
+    page_header->free_end = static_cast<uint16_t>(page_size);
     page_header->parent_page_id = 0;
-    page_header->lsn = 0;
+    page_header->fragmented_bytes = 0;
     page_header->prev_page_id = 0;
     page_header->next_page_id = 0;
 }
+
+void copy_page(Page& dst, const Page& src) {
+    switch (page_size(src)) {
+        case 2048: std::memcpy(dst.data, src.data, 2048); break;
+        case 4096: std::memcpy(dst.data, src.data, 4096); break;
+        case 8192: std::memcpy(dst.data, src.data, 8192); break;
+        case 16384: std::memcpy(dst.data, src.data, 16384); break;
+        default: std::memcpy(dst.data, src.data, page_size(src)); break;
+    }
+}
@@ -0,0 +1,106 @@
+#include "storage/page_guard.hpp"
+
+// ---------------------------------------------------------------------------
+// ReadPageGuard
+
+ReadPageGuard::ReadPageGuard(BufferPoolManager& bpm, FileId file_id, uint32_t page_id, AccessType access_type)
+    : bpm_(&bpm), file_id_(file_id), page_id_(page_id), page_(bpm.fetch_page(file_id, page_id, access_type)) {
+    if (page_ != nullptr) {
+        bpm_->frame_latch(page_).lock_shared();
+    }
+}
+
+ReadPageGuard ReadPageGuard::mapped(Page& page, uint32_t page_id) {
+    ReadPageGuard guard;
+    guard.page_id_ = page_id;
+    guard.page_ = &page;
+    return guard;
+}
+
+ReadPageGuard::~ReadPageGuard() {
+    release();
+}
+
+ReadPageGuard::ReadPageGuard(ReadPageGuard&& other) noexcept
+    : bpm_(other.bpm_), file_id_(other.file_id_), page_id_(other.page_id_), page_(other.page_) {
+    other.page_ = nullptr;
+}
+
+ReadPageGuard& ReadPageGuard::operator=(ReadPageGuard&& other) noexcept {
+    if (this == &other) return *this;
+    release();
+    bpm_ = other.bpm_;
+    file_id_ = other.file_id_;
+    page_id_ = other.page_id_;
+    page_ = other.page_;
+    other.page_ = nullptr;
+    return *this;
+}
+
+void ReadPageGuard::release() {
+    if (page_ == nullptr) {
+        return;
+    }
+    if (bpm_ != nullptr) {
+        bpm_->frame_latch(page_).unlock_shared();
+        bpm_->unpin_page(page_, false);
+    }
+    page_ = nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// WritePageGuard
+
+WritePageGuard::WritePageGuard(BufferPoolManager& bpm, FileId file_id, uint32_t page_id, AccessType access_type)
+    : bpm_(&bpm), file_id_(file_id), page_id_(page_id), page_(bpm.fetch_page(file_id, page_id, access_type)) {
+    if (page_ != nullptr) {
+        bpm_->frame_latch(page_).lock();
+    }
+}
+
+WritePageGuard WritePageGuard::create(BufferPoolManager& bpm, FileId file_id, uint32_t page_id,
+                                      PageType page_type, PageLevel page_level) {
+    WritePageGuard guard;
+    guard.page_ = bpm.new_page(file_id, page_id, page_type, page_level);
+    if (guard.page_ != nullptr) {
+        guard.bpm_ = &bpm;
+        guard.file_id_ = file_id;
+        guard.page_id_ = page_id;
+        guard.dirty_ = true;
+        bpm.frame_latch(guard.page_).lock();
+    }
+    return guard;
+}
+
+WritePageGuard::~WritePageGuard() {
+    release();
+}
+
+WritePageGuard::WritePageGuard(WritePageGuard&& other) noexcept
+    : bpm_(other.bpm_), file_id_(other.file_id_), page_id_(other.page_id_), page_(other.page_), dirty_(other.dirty_) {
+    other.page_ = nullptr;
+    other.dirty_ = false;
+}
+
+WritePageGuard& WritePageGuard::operator=(WritePageGuard&& other) noexcept {
+    if (this == &other) return *this;
+    release();
+    bpm_ = other.bpm_;
+    file_id_ = other.file_id_;
+    page_id_ = other.page_id_;
+    page_ = other.page_;
+    dirty_ = other.dirty_;
+    other.page_ = nullptr;
+    other.dirty_ = false;
+    return *this;
+}
+
+void WritePageGuard::release() {
+    if (page_ == nullptr) {
+        return;
+    }
+    bpm_->frame_latch(page_).unlock();
+    bpm_->unpin_page(page_, dirty_);
+    page_ = nullptr;
+    dirty_ = false;
+}
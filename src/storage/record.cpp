@@ -120,5 +120,49 @@ bool page_delete(Page& page, const uint8_t* key, uint16_t key_len) {
     RecordHeader* rh = reinterpret_cast<RecordHeader*>(page.data + record_offset);
     rh->flags |= RECORD_DELETED;
     remove_slot(page, sr.index);
+    get_header(page)->fragmented_bytes += record_size(rh->key_size, rh->value_size);
     return true;
 }
+
+bool page_update(Page& page, uint16_t slot_index, const uint8_t* value, uint16_t value_size) {
+    uint16_t* slot = slot_ptr(page, slot_index);
+    if (slot == nullptr) return false;
+    PageHeader* header = get_header(page);
+    RecordHeader* rh = reinterpret_cast<RecordHeader*>(page.data + *slot);
+    if (value_size <= rh->value_size) {
+        std::memmove(page.data + *slot + sizeof(RecordHeader) + rh->key_size, value, value_size);
+        header->fragmented_bytes += rh->value_size - value_size;
+        rh->value_size = value_size;
+        return true;
+    }
+    const uint8_t* key = page.data + *slot + sizeof(RecordHeader);
+    uint16_t offset = write_record(page, key, rh->key_size, value, value_size);
+    if (offset == 0) return false;
+    rh->flags |= RECORD_DELETED;
+    header->fragmented_bytes += record_size(rh->key_size, rh->value_size);
+    *slot = offset;
+    return true;
+}
+
+void page_compact(Page& page) {
+    Page snapshot;
+    copy_page(snapshot, page);
+    PageHeader* header = get_header(page);
+    uint16_t offset = sizeof(PageHeader);
+    for (uint16_t i = 0; i < header->cell_count; i++) {
+        uint16_t* slot = slot_ptr(page, i);
+        const RecordHeader* rh = reinterpret_cast<const RecordHeader*>(snapshot.data + *slot);
+        uint16_t size = record_size(rh->key_size, rh->value_size);
+        std::memcpy(page.data + offset, rh, size);
+        *slot = offset;
+        offset += size;
+    }
+    header->free_start = offset;
+    header->fragmented_bytes = 0;
+}
+
+bool can_insert_after_compact(Page& page, uint16_t record_size) {
+    PageHeader* page_header = get_header(page);
+    uint16_t slot_space = (page_header->cell_count + 1) * sizeof(uint16_t);
+    return page_header->free_start - page_header->fragmented_bytes + record_size + slot_space <= page_header->free_end;
+}
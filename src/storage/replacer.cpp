@@ -0,0 +1,302 @@
+#include "storage/replacer.hpp"
+#include "storage/constants.hpp"
+#include <stdexcept>
+
+std::unique_ptr<Replacer> make_replacer(ReplacerPolicy policy, size_t num_frames) {
+    switch (policy) {
+        case ReplacerPolicy::LRU:
+            return std::make_unique<LRUReplacer>(num_frames);
+        case ReplacerPolicy::LRU_K:
+            return std::make_unique<LRUKReplacer>(num_frames, LRU_K_HISTORY);
+        case ReplacerPolicy::TWO_QUEUE:
+            return std::make_unique<TwoQueueReplacer>(num_frames, TWO_QUEUE_A1_PERCENT);
+    }
+    throw std::invalid_argument("Unknown replacer policy");
+}
+
+// ---------------------------------------------------------------------------
+// FrameList
+
+FrameList::FrameList(size_t num_frames)
+    : prev_(num_frames, NO_FRAME), next_(num_frames, NO_FRAME), linked_(num_frames, false),
+      head_(NO_FRAME), tail_(NO_FRAME), size_(0) {}
+
+void FrameList::push_front(size_t frame_id) {
+    if (linked_[frame_id]) {
+        return;
+    }
+    prev_[frame_id] = NO_FRAME;
+    next_[frame_id] = head_;
+    if (head_ != NO_FRAME) {
+        prev_[head_] = frame_id;
+    } else {
+        tail_ = frame_id;
+    }
+    head_ = frame_id;
+    linked_[frame_id] = true;
+    size_++;
+}
+
+void FrameList::push_back(size_t frame_id) {
+    if (linked_[frame_id]) {
+        return;
+    }
+    next_[frame_id] = NO_FRAME;
+    prev_[frame_id] = tail_;
+    if (tail_ != NO_FRAME) {
+        next_[tail_] = frame_id;
+    } else {
+        head_ = frame_id;
+    }
+    tail_ = frame_id;
+    linked_[frame_id] = true;
+    size_++;
+}
+
+void FrameList::unlink(size_t frame_id) {
+    if (!linked_[frame_id]) {
+        return;
+    }
+    if (prev_[frame_id] != NO_FRAME) {
+        next_[prev_[frame_id]] = next_[frame_id];
+    } else {
+        head_ = next_[frame_id];
+    }
+    if (next_[frame_id] != NO_FRAME) {
+        prev_[next_[frame_id]] = prev_[frame_id];
+    } else {
+        tail_ = prev_[frame_id];
+    }
+    prev_[frame_id] = NO_FRAME;
+    next_[frame_id] = NO_FRAME;
+    linked_[frame_id] = false;
+    size_--;
+}
+
+// ---------------------------------------------------------------------------
+// LRUReplacer
+
+LRUReplacer::LRUReplacer(size_t num_frames)
+    : lru_(num_frames), scanned_(num_frames, false), touched_(num_frames, false) {}
+
+void LRUReplacer::record_access(size_t frame_id, AccessType access_type) {
+    // A scan passing over a page that lookups already use must not demote it;
+    // only pages the scan itself brought in stay marked.
+    if (!touched_[frame_id]) {
+        scanned_[frame_id] = access_type == AccessType::SCAN;
+        touched_[frame_id] = true;
+    } else if (access_type != AccessType::SCAN) {
+        scanned_[frame_id] = false;
+    }
+}
+
+void LRUReplacer::set_evictable(size_t frame_id, bool evictable) {
+    if (!evictable) {
+        lru_.unlink(frame_id);
+        return;
+    }
+    if (scanned_[frame_id]) {
+        lru_.push_back(frame_id);
+    } else {
+        lru_.push_front(frame_id);
+    }
+}
+
+bool LRUReplacer::evict(size_t& frame_id) {
+    if (lru_.empty()) {
+        return false;
+    }
+    frame_id = lru_.back();
+    remove(frame_id);
+    return true;
+}
+
+void LRUReplacer::remove(size_t frame_id) {
+    lru_.unlink(frame_id);
+    scanned_[frame_id] = false;
+    touched_[frame_id] = false;
+}
+
+void LRUReplacer::eviction_candidates(size_t max_frames, std::vector<size_t>& out) const {
+    for (size_t frame_id = lru_.back(); frame_id != FrameList::NO_FRAME && max_frames > 0; frame_id = lru_.prev(frame_id)) {
+        out.push_back(frame_id);
+        max_frames--;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// LRUKReplacer
+
+LRUKReplacer::LRUKReplacer(size_t num_frames, size_t k)
+    : k_(k == 0 ? 1 : k), clock_(0), history_(num_frames * (k == 0 ? 1 : k), 0),
+      history_count_(num_frames, 0), evictable_(num_frames, false), scan_only_(num_frames) {}
+
+uint64_t LRUKReplacer::history_at(size_t frame_id, size_t back) const {
+    size_t count = history_count_[frame_id];
+    return history_[frame_id * k_ + (count - 1 - back) % k_];
+}
+
+void LRUKReplacer::clear_history(size_t frame_id) {
+    history_count_[frame_id] = 0;
+}
+
+void LRUKReplacer::record_access(size_t frame_id, AccessType access_type) {
+    ++clock_;
+    if (access_type == AccessType::SCAN) {
+        return;
+    }
+    size_t count = history_count_[frame_id];
+    history_[frame_id * k_ + count % k_] = clock_;
+    history_count_[frame_id] = count + 1;
+}
+
+void LRUKReplacer::set_evictable(size_t frame_id, bool evictable) {
+    if (evictable_[frame_id] == evictable) {
+        return;
+    }
+    evictable_[frame_id] = evictable;
+
+    size_t count = history_count_[frame_id];
+    if (count == 0) {
+        if (evictable) {
+            scan_only_.push_front(frame_id);
+        } else {
+            scan_only_.unlink(frame_id);
+        }
+        return;
+    }
+
+    std::set<Entry>& bucket = count < k_ ? cold_ : hot_;
+    Entry entry{history_at(frame_id, count < k_ ? 0 : k_ - 1), frame_id};
+    if (evictable) {
+        bucket.insert(entry);
+    } else {
+        bucket.erase(entry);
+    }
+}
+
+bool LRUKReplacer::evict(size_t& frame_id) {
+    if (!scan_only_.empty()) {
+        frame_id = scan_only_.back();
+        scan_only_.unlink(frame_id);
+    } else if (!cold_.empty()) {
+        frame_id = cold_.begin()->second;
+        cold_.erase(cold_.begin());
+    } else if (!hot_.empty()) {
+        frame_id = hot_.begin()->second;
+        hot_.erase(hot_.begin());
+    } else {
+        return false;
+    }
+    evictable_[frame_id] = false;
+    clear_history(frame_id);
+    return true;
+}
+
+void LRUKReplacer::remove(size_t frame_id) {
+    set_evictable(frame_id, false);
+    clear_history(frame_id);
+}
+
+void LRUKReplacer::eviction_candidates(size_t max_frames, std::vector<size_t>& out) const {
+    for (size_t frame_id = scan_only_.back(); frame_id != FrameList::NO_FRAME && max_frames > 0; frame_id = scan_only_.prev(frame_id)) {
+        out.push_back(frame_id);
+        max_frames--;
+    }
+    for (const std::set<Entry>* bucket : {&cold_, &hot_}) {
+        for (auto it = bucket->begin(); it != bucket->end() && max_frames > 0; ++it) {
+            out.push_back(it->second);
+            max_frames--;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// TwoQueueReplacer
+
+TwoQueueReplacer::TwoQueueReplacer(size_t num_frames, size_t a1_share_percent)
+    : a1_(num_frames), am_(num_frames), queue_(num_frames, Queue::NONE),
+      scanned_(num_frames, false), a1_target_(num_frames * a1_share_percent / 100),
+      a1_resident_(0) {
+    if (a1_target_ == 0) {
+        a1_target_ = 1;
+    }
+}
+
+void TwoQueueReplacer::record_access(size_t frame_id, AccessType access_type) {
+    switch (queue_[frame_id]) {
+        case Queue::NONE:
+            queue_[frame_id] = Queue::A1;
+            scanned_[frame_id] = access_type == AccessType::SCAN;
+            a1_resident_++;
+            break;
+        case Queue::A1:
+            if (access_type != AccessType::SCAN) {
+                a1_.unlink(frame_id);
+                queue_[frame_id] = Queue::AM;
+                scanned_[frame_id] = false;
+                a1_resident_--;
+            }
+            break;
+        case Queue::AM:
+            break;
+    }
+}
+
+void TwoQueueReplacer::set_evictable(size_t frame_id, bool evictable) {
+    FrameList& list = queue_[frame_id] == Queue::AM ? am_ : a1_;
+    if (!evictable) {
+        list.unlink(frame_id);
+        return;
+    }
+    if (queue_[frame_id] == Queue::NONE) {
+        return;
+    }
+    if (scanned_[frame_id]) {
+        list.push_back(frame_id);
+    } else {
+        list.push_front(frame_id);
+    }
+}
+
+bool TwoQueueReplacer::evict_from_a1() const {
+    return !a1_.empty() && (a1_resident_ > a1_target_ || am_.empty());
+}
+
+bool TwoQueueReplacer::evict(size_t& frame_id) {
+    FrameList* victim_list = nullptr;
+    if (evict_from_a1()) {
+        victim_list = &a1_;
+    } else if (!am_.empty()) {
+        victim_list = &am_;
+    } else {
+        return false;
+    }
+    frame_id = victim_list->back();
+    remove(frame_id);
+    return true;
+}
+
+void TwoQueueReplacer::remove(size_t frame_id) {
+    if (queue_[frame_id] == Queue::A1) {
+        a1_.unlink(frame_id);
+        a1_resident_--;
+    } else if (queue_[frame_id] == Queue::AM) {
+        am_.unlink(frame_id);
+    }
+    queue_[frame_id] = Queue::NONE;
+    scanned_[frame_id] = false;
+}
+
+void TwoQueueReplacer::eviction_candidates(size_t max_frames, std::vector<size_t>& out) const {
+    // Approximates the order evict() would produce: the queue it drains now,
+    // then the other one.
+    const FrameList* first = evict_from_a1() ? &a1_ : &am_;
+    const FrameList* second = first == &a1_ ? &am_ : &a1_;
+    for (const FrameList* list : {first, second}) {
+        for (size_t frame_id = list->back(); frame_id != FrameList::NO_FRAME && max_frames > 0; frame_id = list->prev(frame_id)) {
+            out.push_back(frame_id);
+            max_frames--;
+        }
+    }
+}
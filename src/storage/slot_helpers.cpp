@@ -11,7 +11,7 @@ uint16_t* slot_ptr(Page& page, uint16_t index) {
         return nullptr;
     }
     uint16_t slot_offset = header->free_end + (index * sizeof(uint16_t));
-    if (slot_offset + sizeof(uint16_t) > PAGE_SIZE) {
+    if (slot_offset + sizeof(uint16_t) > page_size(page)) {
         return nullptr;
     }
     return reinterpret_cast<uint16_t*>(page.data + slot_offset);
@@ -34,7 +34,7 @@ const uint8_t* slot_key(Page& page, uint16_t slot_index, uint16_t& key_len) {
         return nullptr;
     }
     RecordHeader* record_header = reinterpret_cast<RecordHeader*>(page.data + record_offset);
-    if (record_header->key_size == 0 || record_header->key_size > PAGE_SIZE) {
+    if (record_header->key_size == 0 || record_header->key_size > page_size(page)) {
         key_len = 0;
         return nullptr;
     }
@@ -63,8 +63,9 @@ const uint8_t* slot_value(Page& page, uint16_t slot_index, uint16_t& value_len)
         return nullptr;
     }
     RecordHeader* record_header = reinterpret_cast<RecordHeader*>(page.data + record_offset);
-    if (record_header->key_size == 0 || record_header->key_size > PAGE_SIZE ||
-        record_header->value_size == 0 || record_header->value_size > PAGE_SIZE) {
+    uint32_t size = page_size(page);
+    if (record_header->key_size == 0 || record_header->key_size > size ||
+        record_header->value_size == 0 || record_header->value_size > size) {
         value_len = 0;
         return nullptr;
     }
@@ -92,7 +93,7 @@ void insert_slot(Page& page, uint16_t index, uint16_t record_offset) {
         throw std::runtime_error("Slot directory would overlap with records");
     }
     
-    if (new_free_end + (current_count + 1) * sizeof(uint16_t) > PAGE_SIZE) {
+    if (new_free_end + (current_count + 1) * sizeof(uint16_t) > page_size(page)) {
         throw std::runtime_error("Slot directory would exceed page size");
     }
     
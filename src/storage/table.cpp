@@ -1,14 +1,44 @@
 #include "storage/table_handle.hpp"
 #include "storage/buffer_pool.hpp"
 #include "storage/page.hpp"
+#include "storage/free_space_map.hpp"
+#include "storage/tablespace.hpp"
 #include <sys/stat.h>
-#include <stdexcept>
+#ifdef _WIN32
 #include <direct.h> // _mkdir
+#endif
+#include <stdexcept>
 #include <cerrno>
+#include <cstdio>
 #include <assert.h>
 
 
-bool open_table(const std::string &name, TableHandle &th) {
+// The meta page stays at the start of the file in every format, and every
+// page records its size in its header, so it can be read with the smallest
+// size before anything else is known.
+bool read_meta_page(const std::string &path, Page &meta) {
+    struct stat buffer;
+    if (stat(path.c_str(), &buffer) != 0) {
+        return false;
+    }
+
+    try {
+        DiskManager dm(path);
+        dm.read_page(0, meta.data);
+        return is_valid_page_size(page_size(meta));
+    }
+    catch (const std::exception &) {
+        return false;
+    }
+}
+
+// Returns 0 if the table cannot be read.
+uint32_t table_page_size(const std::string &name) {
+    Page meta;
+    return read_meta_page("data/" + name + ".db", meta) ? page_size(meta) : 0;
+}
+
+bool open_table(const std::string &name, TableHandle &th, BufferPoolManager &bpm) {
     th.table_name = name;
     th.file_path = "data/" + name + ".db";
 
@@ -18,24 +48,110 @@ bool open_table(const std::string &name, TableHandle &th) {
     }
 
     try {
-        th.dm = DiskManager(th.file_path);
-        th.bpm = std::make_unique<BufferPoolManager>(th.dm);
+        Page meta_page;
+        if (!read_meta_page(th.file_path, meta_page)) {
+            return false;
+        }
+        if (get_header(meta_page)->flags & PAGE_FLAG_TABLESPACE) {
+            // Its tables are opened through the Tablespace.
+            return false;
+        }
+        th.dm = std::make_shared<DiskManager>(th.file_path, DISK_EXTENT_PAGES, page_size(meta_page));
+        if (get_header(meta_page)->flags & PAGE_FLAG_COMPRESSED_LEAVES) {
+            th.dm->enable_compression();
+        }
+        th.bpm = &bpm;
+        th.file_id = bpm.attach_file(*th.dm);
+        if (th.file_id == INVALID_FILE_ID) {
+            // The pool caches pages of another size.
+            th.bpm = nullptr;
+            return false;
+        }
 
-        Page* meta = th.bpm->fetch_page(0);
+        Page* meta = th.bpm->fetch_page(th.file_id, 0);
         if (!meta) {
+            close_table(th);
             return false;
         }
         PageHeader* ph = get_header(*meta);
         th.root_page = ph->root_page;
-        th.bpm->unpin_page(0, false);
+        th.bpm->unpin_page(th.file_id, 0, false);
         return true;
     }
     catch (const std::exception &) {
+        close_table(th);
+        return false;
+    }
+}
+
+bool close_table(TableHandle &th) {
+    th.mapping.reset();
+    th.access_mode = TableAccessMode::BUFFERED;
+    // The file of a tablespace stays attached for its other tables.
+    if (th.bpm && !th.tablespace && !th.bpm->detach_file(th.file_id)) {
         return false;
     }
+    th.bpm = nullptr;
+    th.file_id = INVALID_FILE_ID;
+    return true;
 }
 
-bool create_table(const std::string &name) {
+// Switching to MMAP writes the table's dirty pages back first so the new
+// mapping starts out current. Returns false, leaving the table buffered,
+// where the file cannot be mapped; compressed tables never can.
+bool set_access_mode(TableHandle &th, TableAccessMode mode) {
+    if (!th.bpm) {
+        return false;
+    }
+    if (mode == TableAccessMode::MMAP && th.dm->is_compressed()) {
+        return false;
+    }
+    if (mode == TableAccessMode::BUFFERED) {
+        th.mapping.reset();
+        th.access_mode = mode;
+        return true;
+    }
+    if (th.mapping) {
+        return true;
+    }
+    th.bpm->flush_file(th.file_id);
+    auto mapping = std::make_unique<FileMapping>();
+    if (!mapping->map(th.file_path, th.dm->get_page_size())) {
+        return false;
+    }
+    th.mapping = std::move(mapping);
+    th.access_mode = mode;
+    return true;
+}
+
+// Makes a write visible through the mapping: the table's dirty pages are
+// written back and the mapping follows any change in the file's length. A
+// no-op when buffered.
+void sync_mapping(TableHandle &th) {
+    if (!th.mapping || !th.bpm) {
+        return;
+    }
+    th.bpm->flush_file(th.file_id);
+    th.mapping->remap();
+}
+
+// Makes every write up to ticket (from th.group_commit) durable: the
+// table's dirty pages are written back and the file is synced, once for
+// all the writers waiting at the time.
+bool sync_table(TableHandle &th, uint64_t ticket) {
+    if (!th.bpm) {
+        return false;
+    }
+    return th.group_commit.commit(ticket, [&th] {
+        th.bpm->flush_file(th.file_id);
+        th.dm->flush();
+    });
+}
+
+bool create_table(const std::string &name, uint32_t page_size, bool compress_leaves) {
+    if (!is_valid_page_size(page_size)) {
+        return false;
+    }
     std::string path = "data/" + name + ".db";
 
     struct stat buffer;
@@ -44,28 +160,37 @@ bool create_table(const std::string &name) {
     }
 
     try {
-        if (_mkdir("data") != 0 && errno != EEXIST) {
+#ifdef _WIN32
+        int made = _mkdir("data");
+#else
+        int made = mkdir("data", 0755);
+#endif
+        if (made != 0 && errno != EEXIST) {
             return false;
         }
 
-        DiskManager dm(path);
+        DiskManager dm(path, DISK_EXTENT_PAGES, page_size);
+        if (compress_leaves) {
+            // A map left behind by a table of the same name is stale.
+            std::remove(DiskManager::page_map_path(path).c_str());
+            dm.enable_compression();
+        }
 
         Page meta;
-        init_page(meta, 0, PageType::META, PageLevel::NONE);
+        init_page(meta, 0, PageType::META, PageLevel::NONE, page_size);
 
         Page bitmap;
-        init_page(bitmap, 1, PageType::META, PageLevel::NONE);
+        init_page(bitmap, 1, PageType::META, PageLevel::NONE, page_size);
+        init_free_space_map(meta, bitmap, 3);
 
-        uint8_t *bm = bitmap.data + sizeof(PageHeader);
-
-        bm[0] |= (1 << 0);
-        bm[0] |= (1 << 1);
-        bm[0] |= (1 << 2);
         Page root;
-        init_page(root, 2, PageType::DATA, PageLevel::LEAF);
+        init_page(root, 2, PageType::DATA, PageLevel::LEAF, page_size);
 
         PageHeader *h = get_header(meta);
         h->root_page = 2;
+        if (compress_leaves) {
+            h->flags |= PAGE_FLAG_COMPRESSED_LEAVES;
+        }
 
         dm.write_page(0, meta.data);
         dm.write_page(1, bitmap.data);
@@ -79,54 +204,18 @@ bool create_table(const std::string &name) {
     }
 }
 
-uint32_t allocate_page(TableHandle& th) {
-    if (!th.bpm) {
-        return INVALID_PAGE_ID;
-    }
-    Page* bitmap = th.bpm->fetch_page(1);
-    if (!bitmap) {
-        return INVALID_PAGE_ID;
-    }
-
-    uint8_t* bm = bitmap->data + sizeof(PageHeader);
-    uint32_t bitmap_size = PAGE_SIZE - sizeof(PageHeader);
-
-    for (uint32_t byte_idx = 0; byte_idx < bitmap_size; byte_idx++) {
-        uint8_t byte = bm[byte_idx];
-        for (uint8_t bit_idx = 0; bit_idx < 8; bit_idx++) {
-            uint32_t page_id = byte_idx * 8 + bit_idx;
-            if (page_id < 3) {
-                continue;
-            }
-            if ((byte & (1 << bit_idx)) == 0) {
-                bm[byte_idx] |= (1 << bit_idx);
-                th.bpm->unpin_page(1, true);
-                th.bpm->flush_page(1);
-                return page_id;
-            }
-        }
+void set_root_page(TableHandle& th, uint32_t root_page) {
+    th.root_page = root_page;
+    if (th.tablespace) {
+        th.tablespace->set_root_page(th.table_name, root_page);
+        return;
     }
-
-    th.bpm->unpin_page(1, false);
-    return INVALID_PAGE_ID;
-}
-
-void free_page(TableHandle& th, uint32_t page_id) {
     if (!th.bpm) {
         return;
     }
-    Page* bitmap = th.bpm->fetch_page(1);
-    if (!bitmap) {
-        return;
+    Page* meta = th.bpm->fetch_page(th.file_id, 0);
+    if (meta) {
+        get_header(*meta)->root_page = root_page;
+        th.bpm->unpin_page(th.file_id, 0, true);
     }
-
-    uint8_t* bm = bitmap->data + sizeof(PageHeader);
-    uint32_t byte_idx = page_id / 8;
-    uint32_t bit_idx = page_id % 8;
-    bm[byte_idx] &= ~(1 << bit_idx);
-    th.bpm->unpin_page(1, true);
-    th.bpm->flush_page(1);
-    th.bpm->delete_page(page_id);
 }
-
-
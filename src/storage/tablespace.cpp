@@ -0,0 +1,325 @@
+#include "storage/tablespace.hpp"
+#include "storage/buffer_pool.hpp"
+#include "storage/btree.hpp"
+#include "storage/free_space_map.hpp"
+#include "storage/page.hpp"
+#include "storage/page_guard.hpp"
+#include "storage/record.hpp"
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h> // _mkdir
+#endif
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+bool Tablespace::create(const std::string& name, uint32_t page_size, bool compress_leaves) {
+    if (!is_valid_page_size(page_size)) {
+        return false;
+    }
+    std::string path = path_for(name);
+
+    struct stat buffer;
+    if (stat(path.c_str(), &buffer) == 0) {
+        return false;
+    }
+
+    try {
+#ifdef _WIN32
+        int made = _mkdir("data");
+#else
+        int made = mkdir("data", 0755);
+#endif
+        if (made != 0 && errno != EEXIST) {
+            return false;
+        }
+
+        DiskManager dm(path, DISK_EXTENT_PAGES, page_size);
+        if (compress_leaves) {
+            std::remove(DiskManager::page_map_path(path).c_str());
+            dm.enable_compression();
+        }
+
+        Page meta;
+        init_page(meta, 0, PageType::META, PageLevel::NONE, page_size);
+        PageHeader* h = get_header(meta);
+        h->root_page = 2;
+        h->flags |= PAGE_FLAG_TABLESPACE;
+        if (compress_leaves) {
+            h->flags |= PAGE_FLAG_COMPRESSED_LEAVES;
+        }
+
+        Page bitmap;
+        init_page(bitmap, 1, PageType::META, PageLevel::NONE, page_size);
+        init_free_space_map(meta, bitmap, 3);
+
+        Page directory;
+        init_page(directory, 2, PageType::META, PageLevel::NONE, page_size);
+
+        dm.write_page(0, meta.data);
+        dm.write_page(1, bitmap.data);
+        dm.write_page(2, directory.data);
+        dm.flush();
+        return true;
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+}
+
+Tablespace::~Tablespace() {
+    close();
+}
+
+bool Tablespace::open(const std::string& name, BufferPoolManager& bpm) {
+    if (is_open()) {
+        return false;
+    }
+    space_.table_name = name;
+    space_.file_path = path_for(name);
+
+    Page meta;
+    if (!read_meta_page(space_.file_path, meta)) {
+        return false;
+    }
+    PageHeader* h = get_header(meta);
+    if (!(h->flags & PAGE_FLAG_TABLESPACE) || h->root_page == 0) {
+        return false;
+    }
+
+    try {
+        space_.dm = std::make_shared<DiskManager>(space_.file_path, DISK_EXTENT_PAGES, page_size(meta));
+        if (h->flags & PAGE_FLAG_COMPRESSED_LEAVES) {
+            space_.dm->enable_compression();
+        }
+    }
+    catch (const std::exception&) {
+        space_.dm.reset();
+        return false;
+    }
+    space_.file_id = bpm.attach_file(*space_.dm);
+    if (space_.file_id == INVALID_FILE_ID) {
+        space_.dm.reset();
+        return false;
+    }
+    space_.bpm = &bpm;
+    space_.root_page = h->root_page;
+    return true;
+}
+
+bool Tablespace::close() {
+    if (!is_open()) {
+        return true;
+    }
+    if (!::close_table(space_)) {
+        return false;
+    }
+    space_.dm.reset();
+    return true;
+}
+
+uint32_t Tablespace::find_entry(const std::string& table_name, uint32_t& root_page) {
+    uint32_t page_id = space_.root_page;
+    while (page_id != 0) {
+        ReadPageGuard guard(*space_.bpm, space_.file_id, page_id);
+        if (!guard) {
+            return INVALID_PAGE_ID;
+        }
+        Page& page = guard.page();
+        BSearchResult result = search_record(page, reinterpret_cast<const uint8_t*>(table_name.data()),
+                                             static_cast<uint16_t>(table_name.size()));
+        if (result.found) {
+            uint16_t value_len = 0;
+            const uint8_t* value = slot_value(page, result.index, value_len);
+            if (value == nullptr || value_len != sizeof(uint32_t)) {
+                return INVALID_PAGE_ID;
+            }
+            std::memcpy(&root_page, value, sizeof(root_page));
+            return page_id;
+        }
+        page_id = get_header(page)->next_page_id;
+    }
+    return INVALID_PAGE_ID;
+}
+
+bool Tablespace::compact_directory_page(Page& page, uint16_t record_bytes) {
+    PageHeader* ph = get_header(page);
+    uint32_t live_bytes = 0;
+    for (uint16_t i = 0; i < ph->cell_count; i++) {
+        uint16_t key_len = 0;
+        uint16_t value_len = 0;
+        slot_key(page, i, key_len);
+        slot_value(page, i, value_len);
+        live_bytes += record_size(key_len, value_len);
+    }
+    uint32_t needed = sizeof(PageHeader) + live_bytes + record_bytes + (ph->cell_count + 1u) * sizeof(uint16_t);
+    if (needed > page_size(page)) {
+        return false;
+    }
+
+    Page rebuilt;
+    init_page(rebuilt, ph->page_id, PageType::META, PageLevel::NONE, page_size(page));
+    get_header(rebuilt)->next_page_id = ph->next_page_id;
+    for (uint16_t i = 0; i < ph->cell_count; i++) {
+        uint16_t key_len = 0;
+        uint16_t value_len = 0;
+        const uint8_t* key = slot_key(page, i, key_len);
+        const uint8_t* value = slot_value(page, i, value_len);
+        page_insert(rebuilt, key, key_len, value, value_len);
+    }
+    copy_page(page, rebuilt);
+    return true;
+}
+
+bool Tablespace::create_table(const std::string& table_name) {
+    if (!is_open() || table_name.empty() || table_name.size() > MAX_FILE_PATH_LENGTH) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(latch_);
+    uint32_t root_page = 0;
+    if (find_entry(table_name, root_page) != INVALID_PAGE_ID) {
+        return false;
+    }
+
+    const uint8_t* key = reinterpret_cast<const uint8_t*>(table_name.data());
+    uint16_t key_len = static_cast<uint16_t>(table_name.size());
+    uint8_t value[sizeof(uint32_t)] = {};
+    uint16_t rsize = record_size(key_len, sizeof(value));
+
+    uint32_t page_id = space_.root_page;
+    while (true) {
+        WritePageGuard guard(*space_.bpm, space_.file_id, page_id);
+        if (!guard) {
+            return false;
+        }
+        Page& page = guard.page();
+        if (page_insert(page, key, key_len, value, sizeof(value)) ||
+            (compact_directory_page(page, rsize) && page_insert(page, key, key_len, value, sizeof(value)))) {
+            guard.mark_dirty();
+            return true;
+        }
+
+        uint32_t next_page_id = get_header(page)->next_page_id;
+        if (next_page_id == 0) {
+            next_page_id = allocate_page(space_);
+            if (next_page_id == INVALID_PAGE_ID) {
+                return false;
+            }
+            WritePageGuard next = WritePageGuard::create(*space_.bpm, space_.file_id, next_page_id,
+                                                         PageType::META, PageLevel::NONE);
+            if (!next) {
+                free_page(space_, next_page_id);
+                return false;
+            }
+            get_header(page)->next_page_id = next_page_id;
+            guard.mark_dirty();
+        }
+        page_id = next_page_id;
+    }
+}
+
+bool Tablespace::drop_table(const std::string& table_name) {
+    if (!is_open()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(latch_);
+    uint32_t root_page = 0;
+    uint32_t directory_page = find_entry(table_name, root_page);
+    if (directory_page == INVALID_PAGE_ID) {
+        return false;
+    }
+
+    TableHandle tree;
+    tree.table_name = table_name;
+    tree.dm = space_.dm;
+    tree.bpm = space_.bpm;
+    tree.file_id = space_.file_id;
+    tree.root_page = root_page;
+    btree_destroy(tree);
+
+    WritePageGuard guard(*space_.bpm, space_.file_id, directory_page);
+    if (!guard) {
+        return false;
+    }
+    if (!page_delete(guard.page(), reinterpret_cast<const uint8_t*>(table_name.data()),
+                     static_cast<uint16_t>(table_name.size()))) {
+        return false;
+    }
+    guard.mark_dirty();
+    return true;
+}
+
+bool Tablespace::open_table(const std::string& table_name, TableHandle& th) {
+    if (!is_open()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(latch_);
+    uint32_t root_page = 0;
+    if (find_entry(table_name, root_page) == INVALID_PAGE_ID) {
+        return false;
+    }
+    th.table_name = table_name;
+    th.file_path = space_.file_path;
+    th.dm = space_.dm;
+    th.bpm = space_.bpm;
+    th.file_id = space_.file_id;
+    th.root_page = root_page;
+    th.tablespace = this;
+    return true;
+}
+
+bool Tablespace::has_table(const std::string& table_name) {
+    if (!is_open()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(latch_);
+    uint32_t root_page = 0;
+    return find_entry(table_name, root_page) != INVALID_PAGE_ID;
+}
+
+std::vector<std::string> Tablespace::table_names() {
+    std::vector<std::string> names;
+    if (!is_open()) {
+        return names;
+    }
+    std::lock_guard<std::mutex> lock(latch_);
+    uint32_t page_id = space_.root_page;
+    while (page_id != 0) {
+        ReadPageGuard guard(*space_.bpm, space_.file_id, page_id);
+        if (!guard) {
+            break;
+        }
+        Page& page = guard.page();
+        for (uint16_t i = 0; i < get_header(page)->cell_count; i++) {
+            uint16_t key_len = 0;
+            const uint8_t* key = slot_key(page, i, key_len);
+            names.emplace_back(reinterpret_cast<const char*>(key), key_len);
+        }
+        page_id = get_header(page)->next_page_id;
+    }
+    return names;
+}
+
+void Tablespace::set_root_page(const std::string& table_name, uint32_t root_page) {
+    std::lock_guard<std::mutex> lock(latch_);
+    uint32_t old_root = 0;
+    uint32_t directory_page = find_entry(table_name, old_root);
+    if (directory_page == INVALID_PAGE_ID) {
+        return;
+    }
+    WritePageGuard guard(*space_.bpm, space_.file_id, directory_page);
+    if (!guard) {
+        return;
+    }
+    Page& page = guard.page();
+    BSearchResult result = search_record(page, reinterpret_cast<const uint8_t*>(table_name.data()),
+                                         static_cast<uint16_t>(table_name.size()));
+    if (!result.found) {
+        return;
+    }
+    // The entry keeps its size, so the root is rewritten in place.
+    uint16_t value_len = 0;
+    const uint8_t* value = slot_value(page, result.index, value_len);
+    std::memcpy(page.data + (value - page.data), &root_page, sizeof(root_page));
+    guard.mark_dirty();
+}
@@ -1,9 +1,24 @@
 #include "storage/interface/storage_engine.hpp"
+#include "storage/buffer_pool.hpp"
+#include "storage/page_guard.hpp"
+#include "storage/io_queue.hpp"
+#include "storage/table_handle.hpp"
+#include "storage/lz_codec.hpp"
+#include "storage/free_space_map.hpp"
+#include "storage/btree.hpp"
+#include "storage/record.hpp"
 #include <iostream>
 #include <vector>
 #include <string>
 #include <cassert>
 #include <cstring>
+#include <algorithm>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <mutex>
 
 void test_basic_operations() {
     std::cout << "\n=== StorageEngine Basic Operations Test ===\n";
@@ -170,12 +185,2169 @@ static void test_range_scan() {
     std::cout << "\n=== Range Scan Test PASSED ===\n";
 }
 
+static void test_shared_buffer_pool() {
+    std::cout << "\n=== StorageEngine Shared Buffer Pool Test ===\n";
+
+    // Eight frames shared by both tables forces them to evict each other.
+    StorageEngine se(8 * PAGE_SIZE);
+    const std::string hot_table = "test_pool_hot";
+    const std::string cold_table = "test_pool_cold";
+    std::remove(("data/" + hot_table + ".db").c_str());
+    std::remove(("data/" + cold_table + ".db").c_str());
+
+    assert(se.create_table(hot_table) && "create_table failed");
+    assert(se.create_table(cold_table) && "create_table failed");
+    TableHandle* hot = se.open_table(hot_table);
+    TableHandle* cold = se.open_table(cold_table);
+    assert(hot != nullptr && cold != nullptr && "open_table failed");
+    assert(se.buffer_pool().get_pool_size() == 8 && "pool not sized from byte budget");
+
+    for (int i = 0; i < 20; i++) {
+        std::string key_str = "key" + std::to_string(i);
+        std::vector<uint8_t> key(key_str.begin(), key_str.end());
+        std::vector<uint8_t> hot_value = { 'h', static_cast<uint8_t>('0' + i % 10) };
+        std::vector<uint8_t> cold_value = { 'c', static_cast<uint8_t>('0' + i % 10) };
+        assert(se.insert_record(hot, key, hot_value) && "insert into hot table failed");
+        assert(se.insert_record(cold, key, cold_value) && "insert into cold table failed");
+    }
+    std::cout << "[OK] Inserted into two tables through one pool\n";
+
+    se.close_table(cold);
+    assert(se.buffer_pool().get_pinned_count() == 0 && "close_table left pages pinned");
+    std::vector<uint8_t> out_value;
+    std::vector<uint8_t> key = { 'k', 'e', 'y', '7' };
+    assert(se.get_record(hot, key, out_value) && out_value[0] == 'h' && "hot table lost data after detach");
+    std::cout << "[OK] Closing one table left the other readable\n";
+
+    cold = se.open_table(cold_table);
+    assert(cold != nullptr && "reopen failed");
+    assert(se.get_record(cold, key, out_value) && out_value[0] == 'c' && "cold table not written back on close");
+    std::cout << "[OK] Reopened table sees its data\n";
+
+    se.close_table(hot);
+    se.close_table(cold);
+    se.drop_table(hot_table);
+    se.drop_table(cold_table);
+    std::cout << "\n=== Shared Buffer Pool Test PASSED ===\n";
+}
+
+static void test_disk_manager() {
+    std::cout << "\n=== DiskManager Test ===\n";
+
+    const std::string path = "data/test_disk_manager.db";
+    std::remove(path.c_str());
+    {
+        DiskManager dm(path, 16);
+        assert(dm.get_file_size() == 0 && "new file not empty");
+
+        Page page;
+        std::memset(page.data, 0xAB, PAGE_SIZE);
+        dm.write_page(20, page.data);
+        assert(dm.get_file_size() == 32ULL * PAGE_SIZE && "file not grown to a whole extent");
+        std::cout << "[OK] File grown to " << dm.get_file_size() / PAGE_SIZE << " pages\n";
+
+        uint64_t calls = dm.get_syscall_count();
+        dm.write_page(25, page.data);
+        assert(dm.get_syscall_count() == calls + 1 && "write inside the extent took more than one call");
+        std::cout << "[OK] Write inside an extent is one system call\n";
+
+        Page out;
+        dm.read_page(25, out.data);
+        assert(std::memcmp(out.data, page.data, PAGE_SIZE) == 0 && "page read back differs");
+        dm.read_page(30, out.data);
+        assert(out.data[0] == 0 && out.data[PAGE_SIZE - 1] == 0 && "preallocated page not zeroed");
+        dm.read_page(1000, out.data);
+        assert(out.data[0] == 0 && "page past end of file not zeroed");
+    }
+    {
+        DiskManager dm(path);
+        assert(dm.get_file_size() == 32ULL * PAGE_SIZE && "reopened file size not picked up");
+        Page out;
+        dm.read_page(20, out.data);
+        assert(out.data[0] == 0xAB && "page lost after reopen");
+    }
+    std::remove(path.c_str());
+    std::cout << "\n=== DiskManager Test PASSED ===\n";
+}
+
+static void test_io_queue() {
+    std::cout << "\n=== IoQueue Test ===\n";
+
+    const std::string path = "data/test_io_queue.db";
+    for (IoBackend backend : {IoBackend::SYNC, IoBackend::IO_URING}) {
+        std::remove(path.c_str());
+        DiskManager dm(path, 4);
+        IoQueue io(8, backend);
+        std::cout << "[OK] Backend " << (io.backend() == IoBackend::IO_URING ? "io_uring" : "sync") << "\n";
+
+        // Eight single-page writes and one four-page write, all in flight
+        // together.
+        std::vector<uint8_t> data(12 * PAGE_SIZE);
+        for (size_t i = 0; i < data.size(); i++) {
+            data[i] = static_cast<uint8_t>(i / PAGE_SIZE + 1);
+        }
+        std::vector<IoRequest> writes(8);
+        for (uint32_t i = 0; i < 7; i++) {
+            writes[i] = {&dm, true, i, 1, data.data() + i * PAGE_SIZE, false};
+            assert(io.submit(writes[i]) && "submit failed below queue depth");
+        }
+        writes[7] = {&dm, true, 7, 4, data.data() + 7 * PAGE_SIZE, false};
+        assert(io.submit(writes[7]) && "submit failed below queue depth");
+        IoRequest extra = {&dm, true, 20, 1, data.data(), false};
+        assert(!io.submit(extra) && "submit accepted past queue depth");
+
+        std::vector<IoRequest*> completed;
+        while (completed.size() < writes.size()) {
+            io.poll(completed);
+        }
+        for (const IoRequest& request : writes) {
+            assert(request.ok && "write failed");
+        }
+        assert(io.in_flight() == 0 && "requests left in flight");
+
+        std::vector<uint8_t> out(12 * PAGE_SIZE);
+        std::vector<IoRequest> reads(3);
+        reads[0] = {&dm, false, 0, 7, out.data(), false};
+        reads[1] = {&dm, false, 7, 4, out.data() + 7 * PAGE_SIZE, false};
+        reads[2] = {&dm, false, 100, 1, out.data() + 11 * PAGE_SIZE, false};
+        for (IoRequest& request : reads) {
+            io.submit(request);
+        }
+        io.wait();
+        for (const IoRequest& request : reads) {
+            assert(request.ok && "read failed");
+        }
+        assert(std::memcmp(out.data(), data.data(), 11 * PAGE_SIZE) == 0 && "pages read back differ");
+        assert(out[11 * PAGE_SIZE] == 0 && out[12 * PAGE_SIZE - 1] == 0 && "page past end of file not zeroed");
+        std::cout << "[OK] Batched writes and reads round-trip\n";
+    }
+    std::remove(path.c_str());
+    std::cout << "\n=== IoQueue Test PASSED ===\n";
+}
+
+static void test_page_cleaner() {
+    std::cout << "\n=== BufferPoolManager Page Cleaner Test ===\n";
+
+    const std::string path = "data/test_page_cleaner.db";
+    std::remove(path.c_str());
+    DiskManager dm(path);
+    {
+        BufferPoolManager bpm(64);
+        FileId file_id = bpm.attach_file(dm);
+
+        // Sixteen adjacent dirty pages, none pinned.
+        for (uint32_t page_id = 0; page_id < 16; page_id++) {
+            Page* page = bpm.new_page(file_id, page_id);
+            assert(page != nullptr && "new_page failed");
+            page->data[PAGE_SIZE - 1] = static_cast<uint8_t>(page_id + 1);
+            bpm.unpin_page(file_id, page_id, true);
+        }
+        assert(bpm.get_dirty_count() == 16 && "dirty pages not tracked");
+
+        // With a zero dirty budget one pass has to clean everything.
+        PageCleanerOptions options;
+        options.max_dirty_percent = 0;
+        bpm.set_page_cleaner_options(options);
+        assert(bpm.clean_pages() == 16 && "cleaner skipped dirty pages");
+        assert(bpm.get_dirty_count() == 0 && "pages still dirty after a pass");
+        assert(bpm.get_pinned_count() == 0 && "cleaner left pages pinned");
+
+        BufferPoolStats stats = bpm.get_stats();
+        assert(stats.foreground_writes == 0 && "cleaner pass wrote on the caller path");
+        assert(stats.background_writes == 16 && "background writes not counted");
+        assert(stats.background_write_calls < 16 && "adjacent pages were not coalesced");
+        std::cout << "[OK] 16 dirty pages cleaned in " << stats.background_write_calls << " writes\n";
+
+        bpm.start_page_cleaner(options);
+        Page* page = bpm.fetch_page(file_id, 3);
+        page->data[0] = 42;
+        bpm.unpin_page(file_id, 3, true);
+        bpm.stop_page_cleaner();
+        assert(!bpm.is_page_cleaner_running() && "cleaner thread still running");
+        std::cout << "[OK] Cleaner thread starts and stops\n";
+    }
+    {
+        BufferPoolManager bpm(8);
+        FileId file_id = bpm.attach_file(dm);
+        for (uint32_t page_id = 0; page_id < 16; page_id++) {
+            Page* page = bpm.fetch_page(file_id, page_id);
+            assert(page->data[PAGE_SIZE - 1] == page_id + 1 && "cleaned page not on disk");
+            bpm.unpin_page(file_id, page_id, false);
+        }
+        Page* page = bpm.fetch_page(file_id, 3);
+        assert(page->data[0] == 42 && "page dirtied while the cleaner ran was lost");
+        bpm.unpin_page(file_id, 3, false);
+        bpm.detach_file(file_id);
+    }
+    std::remove(path.c_str());
+    std::cout << "\n=== Page Cleaner Test PASSED ===\n";
+}
+
+static void test_flush_coalescing() {
+    std::cout << "\n=== BufferPoolManager Flush Coalescing Test ===\n";
+
+    const std::string path = "data/test_flush_coalescing.db";
+    std::remove(path.c_str());
+    DiskManager dm(path);
+    for (size_t threads : {1, 3}) {
+        BufferPoolManager bpm(1024);
+        bpm.set_flush_threads(threads);
+        FileId file_id = bpm.attach_file(dm);
+        // 600 adjacent pages, dirtied in reverse order, and one stray page.
+        for (uint32_t page_id = 600; page_id > 0; page_id--) {
+            Page* page = bpm.new_page(file_id, page_id - 1);
+            page->data[PAGE_SIZE - 1] = static_cast<uint8_t>(page_id + threads);
+            bpm.unpin_page(file_id, page_id - 1, true);
+        }
+        Page* stray = bpm.new_page(file_id, 900);
+        stray->data[PAGE_SIZE - 1] = 0x5A;
+        bpm.unpin_page(file_id, 900, true);
+
+        bpm.flush_all();
+        BufferPoolStats stats = bpm.get_stats();
+        assert(bpm.get_dirty_count() == 0 && bpm.get_pinned_count() == 0 && "flush left pages dirty or pinned");
+        assert(stats.flushes == 1 && stats.flush_writes == 601 && "flush not counted");
+        // ceil(600 / FLUSH_MAX_WRITE_PAGES) runs, plus the stray page, plus
+        // at most one split per extra writer thread.
+        assert(stats.flush_write_calls <= 600 / FLUSH_MAX_WRITE_PAGES + 2 + (threads - 1) && "runs were not merged");
+        std::cout << "[OK] " << threads << " thread(s): 601 pages flushed in " << stats.flush_write_calls << " writes\n";
+        bpm.detach_file(file_id);
+
+        BufferPoolManager reader(16);
+        file_id = reader.attach_file(dm);
+        for (uint32_t page_id : {0u, 255u, 256u, 599u}) {
+            Page* page = reader.fetch_page(file_id, page_id);
+            assert(page->data[PAGE_SIZE - 1] == static_cast<uint8_t>(page_id + 1 + threads) && "flushed page not on disk");
+            reader.unpin_page(file_id, page_id, false);
+        }
+        Page* page = reader.fetch_page(file_id, 900);
+        assert(page->data[PAGE_SIZE - 1] == 0x5A && "stray page not flushed");
+        reader.unpin_page(file_id, 900, false);
+        reader.detach_file(file_id);
+    }
+    std::remove(path.c_str());
+    std::cout << "\n=== Flush Coalescing Test PASSED ===\n";
+}
+
+static void test_lru_replacer() {
+    std::cout << "\n=== LRU Replacer Test ===\n";
+
+    // Drives the replacer the way the pool does: a pin and an access, then
+    // the unpin that makes the frame a candidate again.
+    LRUReplacer lru(8);
+    auto use = [&lru](size_t frame_id) {
+        lru.set_evictable(frame_id, false);
+        lru.record_access(frame_id, AccessType::DEFAULT);
+        lru.set_evictable(frame_id, true);
+    };
+    for (size_t frame_id = 0; frame_id < 6; frame_id++) {
+        use(frame_id);
+    }
+    use(1);
+    use(3);
+    lru.set_evictable(2, false);
+    assert(lru.size() == 5 && "pinned frame still counted");
+
+    std::vector<size_t> candidates;
+    lru.eviction_candidates(8, candidates);
+    assert((candidates == std::vector<size_t>{0, 4, 5, 1, 3}) && "candidates not in LRU order");
+    size_t victim = 0;
+    assert(lru.evict(victim) && victim == 0 && "least recently unpinned frame not evicted first");
+    assert(lru.evict(victim) && victim == 4 && "wrong second victim");
+    lru.remove(5);
+    assert(lru.evict(victim) && victim == 1 && "removed frame evicted");
+    assert(lru.evict(victim) && victim == 3 && "wrong last victim");
+    assert(!lru.evict(victim) && "evicted a pinned frame");
+    lru.set_evictable(2, true);
+    assert(lru.evict(victim) && victim == 2 && "unpinned frame not evictable");
+    std::cout << "[OK] Victims leave in least recently used order\n";
+
+    // One shard of 32 frames: re-fetching page 0 saves it from the next miss.
+    const std::string path = "data/test_lru_replacer.db";
+    std::remove(path.c_str());
+    DiskManager dm(path);
+    BufferPoolManager bpm(32, ReplacerPolicy::LRU);
+    FileId file_id = bpm.attach_file(dm);
+    for (uint32_t page_id = 0; page_id < 32; page_id++) {
+        Page* page = bpm.new_page(file_id, page_id);
+        assert(page != nullptr && "new_page failed");
+        bpm.unpin_page(file_id, page_id, true);
+    }
+    auto touch = [&bpm, file_id](uint32_t page_id) {
+        Page* page = bpm.fetch_page(file_id, page_id);
+        assert(page != nullptr && "fetch failed");
+        bpm.unpin_page(file_id, page_id, false);
+    };
+    touch(0);
+    touch(32);
+    bpm.reset_stats();
+    touch(0);
+    assert(bpm.get_stats().misses == 0 && "recently used page evicted");
+    touch(1);
+    assert(bpm.get_stats().misses == 1 && "least recently used page not evicted");
+    std::cout << "[OK] Pool evicts its least recently used page\n";
+
+    bpm.detach_file(file_id);
+    std::remove(path.c_str());
+    std::cout << "\n=== LRU Replacer Test PASSED ===\n";
+}
+
+static void test_replacer_policies() {
+    std::cout << "\n=== Replacer Policies Test ===\n";
+
+    size_t victim = 0;
+    std::vector<size_t> order;
+    auto use = [](Replacer& replacer, size_t frame_id, AccessType access_type) {
+        replacer.set_evictable(frame_id, false);
+        replacer.record_access(frame_id, access_type);
+        replacer.set_evictable(frame_id, true);
+    };
+
+    // LRU-2: the scan-only frame goes first, then frames seen once (oldest
+    // first), then frames seen twice by their second most recent access.
+    LRUKReplacer lru_k(8, 2);
+    for (size_t frame_id : {0, 1, 2, 0, 1, 3}) {
+        use(lru_k, frame_id, AccessType::DEFAULT);
+    }
+    use(lru_k, 4, AccessType::SCAN);
+    while (lru_k.evict(victim)) {
+        order.push_back(victim);
+    }
+    assert((order == std::vector<size_t>{4, 2, 3, 0, 1}) && "LRU-K victims out of order");
+    std::cout << "[OK] LRU-K evicts by k-th most recent access\n";
+
+    // 2Q with room for two frames on probation: A1 gives up its oldest frame
+    // while it holds more than that, Am its least recently used one
+    // otherwise. Frame 5 was only scanned, so it joins A1 at the cold end
+    // and repeat visits never promote it.
+    TwoQueueReplacer two_queue(8, 25);
+    for (size_t frame_id : {0, 0, 1, 1, 2, 3, 4}) {
+        use(two_queue, frame_id, AccessType::DEFAULT);
+    }
+    order.clear();
+    for (int i = 0; i < 2 && two_queue.evict(victim); i++) {
+        order.push_back(victim);
+    }
+    use(two_queue, 5, AccessType::SCAN);
+    use(two_queue, 5, AccessType::SCAN);
+    while (two_queue.evict(victim)) {
+        order.push_back(victim);
+    }
+    assert((order == std::vector<size_t>{2, 0, 5, 1, 3, 4}) && "2Q victims out of order");
+    std::cout << "[OK] 2Q evicts probation first and never promotes scans\n";
+
+    // Under every policy a scan hinted as such, ten times the pool, must
+    // leave a hot set that was used twice resident.
+    const std::string path = "data/test_replacer_policies.db";
+    for (ReplacerPolicy policy : {ReplacerPolicy::LRU, ReplacerPolicy::LRU_K, ReplacerPolicy::TWO_QUEUE}) {
+        std::remove(path.c_str());
+        DiskManager dm(path);
+        BufferPoolManager bpm(32, policy);
+        FileId file_id = bpm.attach_file(dm);
+        auto touch = [&bpm, file_id](uint32_t page_id, AccessType access_type) {
+            Page* page = bpm.fetch_page(file_id, page_id, access_type);
+            assert(page != nullptr && "fetch failed");
+            bpm.unpin_page(file_id, page_id, false);
+        };
+        for (uint32_t page_id = 0; page_id < 8; page_id++) {
+            Page* page = bpm.new_page(file_id, page_id);
+            assert(page != nullptr && "new_page failed");
+            bpm.unpin_page(file_id, page_id, true);
+            touch(page_id, AccessType::DEFAULT);
+        }
+        for (uint32_t page_id = 100; page_id < 420; page_id++) {
+            touch(page_id, AccessType::SCAN);
+        }
+        bpm.reset_stats();
+        for (uint32_t page_id = 0; page_id < 8; page_id++) {
+            touch(page_id, AccessType::DEFAULT);
+        }
+        assert(bpm.get_stats().misses == 0 && "scan evicted the hot set");
+        bpm.detach_file(file_id);
+    }
+    std::remove(path.c_str());
+    std::cout << "[OK] Hinted scans leave the hot set resident under LRU, LRU-K and 2Q\n";
+
+    std::cout << "\n=== Replacer Policies Test PASSED ===\n";
+}
+
+static void test_page_guards() {
+    std::cout << "\n=== Page Guard Test ===\n";
+
+    const std::string path = "data/test_page_guards.db";
+    std::remove(path.c_str());
+    DiskManager dm(path);
+    BufferPoolManager bpm(16);
+    FileId file_id = bpm.attach_file(dm);
+
+    {
+        WritePageGuard guard = WritePageGuard::create(bpm, file_id, 5);
+        assert(guard && "create failed");
+        guard.page().data[PAGE_SIZE - 1] = 7;
+        assert(bpm.get_pinned_count() == 1 && "write guard did not pin");
+    }
+    assert(bpm.get_pinned_count() == 0 && "write guard did not unpin");
+    assert(bpm.get_dirty_count() == 1 && "created page not dirty");
+    std::cout << "[OK] WritePageGuard pins, unpins and dirties\n";
+
+    {
+        ReadPageGuard first(bpm, file_id, 5);
+        ReadPageGuard second(bpm, file_id, 5);
+        assert(first && second && "shared guards must coexist");
+        assert(&first.page() == &second.page() && "guards see different frames");
+        assert(first.page().data[PAGE_SIZE - 1] == 7 && "guard reads stale data");
+
+        ReadPageGuard moved = std::move(first);
+        assert(!first && moved && "move did not transfer the guard");
+        moved.release();
+        assert(!moved && "release left the guard valid");
+        assert(!bpm.frame_latch(&second.page()).try_lock() && "writer got in under a reader");
+    }
+    assert(bpm.get_pinned_count() == 0 && "read guards leaked pins");
+    assert(bpm.frame_latch(bpm.fetch_page(file_id, 5)).try_lock() && "latch still held");
+    bpm.frame_latch(bpm.fetch_page(file_id, 5)).unlock();
+    bpm.unpin_page(file_id, 5, false);
+    bpm.unpin_page(file_id, 5, false);
+    std::cout << "[OK] ReadPageGuard shares, moves and releases\n";
+
+    bpm.detach_file(file_id);
+    std::remove(path.c_str());
+    std::cout << "\n=== Page Guard Test PASSED ===\n";
+}
+
+static void test_concurrent_misses() {
+    std::cout << "\n=== BufferPoolManager Concurrent Miss Test ===\n";
+
+    // Four threads bump counters on pages of a pool a tenth their number:
+    // most fetches miss, often on a page another thread is reading in, and
+    // most victims are dirty.
+    const std::string path = "data/test_concurrent_misses.db";
+    std::remove(path.c_str());
+    DiskManager dm(path);
+    const uint32_t pages = 320;
+    const int threads = 4;
+    const int per_thread = 5000;
+    std::vector<std::atomic<uint32_t>> expected(pages);
+    std::atomic<int> failures{0};
+    {
+        BufferPoolManager bpm(32);
+        FileId file_id = bpm.attach_file(dm);
+        for (uint32_t page_id = 0; page_id < pages; page_id++) {
+            Page* page = bpm.new_page(file_id, page_id);
+            assert(page != nullptr && "new_page failed");
+            bpm.unpin_page(page, true);
+        }
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                uint32_t seed = 12345 + t;
+                for (int i = 0; i < per_thread; i++) {
+                    seed = seed * 1103515245 + 12345;
+                    uint32_t page_id = (seed >> 8) % pages;
+                    Page* page = bpm.fetch_page(file_id, page_id);
+                    if (page == nullptr || get_header(*page)->page_id != page_id) {
+                        failures++;
+                        continue;
+                    }
+                    {
+                        std::unique_lock<FrameLatch> latch(bpm.frame_latch(page));
+                        uint32_t count;
+                        std::memcpy(&count, page->data + sizeof(PageHeader), sizeof(count));
+                        count++;
+                        std::memcpy(page->data + sizeof(PageHeader), &count, sizeof(count));
+                    }
+                    expected[page_id]++;
+                    bpm.unpin_page(page, true);
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        assert(failures == 0 && "fetch failed or returned the wrong page");
+        assert(bpm.get_pinned_count() == 0 && "concurrent misses leaked pins");
+        assert(bpm.get_stats().misses > static_cast<uint64_t>(threads * per_thread / 2) && "test did not miss");
+        bpm.detach_file(file_id);
+    }
+    BufferPoolManager reader(16);
+    FileId file_id = reader.attach_file(dm);
+    for (uint32_t page_id = 0; page_id < pages; page_id++) {
+        Page* page = reader.fetch_page(file_id, page_id);
+        uint32_t count;
+        std::memcpy(&count, page->data + sizeof(PageHeader), sizeof(count));
+        assert(count == expected[page_id] && "update lost across eviction");
+        reader.unpin_page(page, false);
+    }
+    reader.detach_file(file_id);
+    std::cout << "[OK] " << threads * per_thread << " updates from " << threads << " threads through 32 frames\n";
+
+    // Misses on one file write the other's dirty pages out as victims while
+    // that file is detached: the detach must wait for those writes, not
+    // free their frames under them.
+    const std::string other_path = "data/test_concurrent_misses_other.db";
+    std::remove(other_path.c_str());
+    DiskManager other_dm(other_path);
+    const uint32_t rounds = 500;
+    {
+        BufferPoolManager bpm(32);
+        FileId other_id = bpm.attach_file(other_dm);
+        for (uint32_t page_id = 0; page_id < 64; page_id++) {
+            bpm.unpin_page(bpm.new_page(other_id, page_id), true);
+        }
+        for (uint32_t round = 0; round < rounds; round++) {
+            // Gone right after the detach, as close_table leaves it.
+            DiskManager round_dm(path);
+            file_id = bpm.attach_file(round_dm);
+            for (uint32_t page_id = 0; page_id < 32; page_id++) {
+                Page* page = round == 0 ? bpm.new_page(file_id, page_id) : bpm.fetch_page(file_id, page_id);
+                page->data[PAGE_SIZE - 1] = static_cast<uint8_t>(round);
+                bpm.unpin_page(page, true);
+            }
+            std::atomic<bool> fetching{false};
+            std::atomic<bool> detached{false};
+            std::thread fetcher([&] {
+                for (uint32_t page_id = 0; !detached.load(); page_id = (page_id + 1) % 64) {
+                    Page* page = bpm.fetch_page(other_id, page_id);
+                    fetching = true;
+                    if (page == nullptr || !bpm.unpin_page(page, true)) {
+                        failures++;
+                    }
+                }
+            });
+            while (!fetching.load()) {
+                std::this_thread::yield();
+            }
+            if (!bpm.detach_file(file_id)) {
+                failures++;
+            }
+            detached = true;
+            fetcher.join();
+        }
+        assert(failures == 0 && "detach failed or a fetch lost its frame");
+        assert(bpm.get_pinned_count() == 0 && "victim writes left pins behind");
+        // Every frame must still be free to pin.
+        std::vector<Page*> held;
+        for (uint32_t page_id = 0; page_id < 32; page_id++) {
+            held.push_back(bpm.fetch_page(other_id, page_id));
+            assert(held.back() != nullptr && "a frame stayed pinned after its victim write");
+        }
+        assert(bpm.get_pinned_count() == 32 && "pins miscounted after victim writes");
+        for (Page* page : held) {
+            bpm.unpin_page(page, false);
+        }
+        bpm.detach_file(other_id);
+    }
+    DiskManager written_dm(path);
+    file_id = reader.attach_file(written_dm);
+    for (uint32_t page_id = 0; page_id < 32; page_id++) {
+        Page* page = reader.fetch_page(file_id, page_id);
+        assert(page->data[PAGE_SIZE - 1] == static_cast<uint8_t>(rounds - 1) && "victim written after detach lost");
+        reader.unpin_page(page, false);
+    }
+    reader.detach_file(file_id);
+    std::remove(path.c_str());
+    std::remove(other_path.c_str());
+    std::cout << "[OK] files detached while misses wrote their pages out\n";
+    std::cout << "\n=== Concurrent Miss Test PASSED ===\n";
+}
+
+static void test_concurrent_pins() {
+    std::cout << "\n=== BufferPoolManager Concurrent Pin Test ===\n";
+
+    // Threads pin batches of their own pages across every shard, through
+    // new_page and fetch_page, with three times as many pages as frames.
+    // Every pinned page must sit in a frame no other pinned page has.
+    const std::string path = "data/test_concurrent_pins.db";
+    std::remove(path.c_str());
+    DiskManager dm(path);
+    const size_t frames = 1024;
+    const int threads = 4;
+    const uint32_t batch = 64;
+    const int rounds = 40;
+    BufferPoolManager bpm(frames);
+    FileId file_id = bpm.attach_file(dm);
+    assert(bpm.get_shard_count() > 1 && "pool not sharded");
+
+    std::mutex owners_latch;
+    std::unordered_map<const Page*, uint32_t> owners;  // pinned frame -> page
+    std::atomic<int> failures{0};
+    std::atomic<int> pinned_batches{0};
+    std::atomic<bool> checked{false};
+    std::atomic<size_t> pinned_at_barrier{0};
+
+    auto worker = [&](int t) {
+        uint32_t seed = 777 + t;
+        std::vector<std::pair<uint32_t, Page*>> held;
+        for (int round = 0; round < rounds; round++) {
+            // Distinct pages of this thread: page_id % threads == t.
+            uint32_t first = (seed >> 4) % (3 * frames / threads - batch);
+            seed = seed * 1103515245 + 12345;
+            for (uint32_t k = first; k < first + batch; k++) {
+                uint32_t page_id = k * threads + t;
+                Page* page = round == 0 ? bpm.new_page(file_id, page_id) : bpm.fetch_page(file_id, page_id);
+                if (page == nullptr) {
+                    failures++;
+                    continue;
+                }
+                if (round == 0) {
+                    get_header(*page)->page_id = page_id;
+                } else if (get_header(*page)->page_id != page_id && get_header(*page)->page_id != 0) {
+                    failures++;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(owners_latch);
+                    if (!owners.emplace(page, page_id).second) {
+                        failures++;
+                    }
+                }
+                held.emplace_back(page_id, page);
+            }
+            if (round == rounds / 2) {
+                // Everyone holds a full batch: the pool must count them all.
+                pinned_batches++;
+                while (!checked.load()) {
+                    std::this_thread::yield();
+                }
+            }
+            for (auto& [page_id, page] : held) {
+                {
+                    std::lock_guard<std::mutex> lock(owners_latch);
+                    owners.erase(page);
+                }
+                if (!bpm.unpin_page(page, round == 0)) {
+                    failures++;
+                }
+            }
+            held.clear();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back(worker, t);
+    }
+    while (pinned_batches.load() < threads) {
+        std::this_thread::yield();
+    }
+    pinned_at_barrier = bpm.get_pinned_count();
+    checked = true;
+    for (std::thread& w : workers) {
+        w.join();
+    }
+
+    assert(failures == 0 && "a frame was handed to two pages, or a pin failed");
+    assert(pinned_at_barrier == threads * batch && "pinned count wrong while pages were held");
+    assert(bpm.get_pinned_count() == 0 && "pins leaked");
+    assert(bpm.get_stats().evictions > 0 && "pool did not cycle its frames");
+    std::cout << "[OK] " << threads << " threads pinned " << threads * batch << " pages at once across "
+              << bpm.get_shard_count() << " shards; no frame shared\n";
+
+    bpm.detach_file(file_id);
+    std::remove(path.c_str());
+    std::cout << "\n=== Concurrent Pin Test PASSED ===\n";
+}
+
+static void test_read_ahead() {
+    std::cout << "\n=== Read-Ahead Test ===\n";
+
+    const std::string path = "data/test_read_ahead.db";
+    std::remove(path.c_str());
+    DiskManager dm(path);
+    {
+        BufferPoolManager bpm(64);
+        FileId file_id = bpm.attach_file(dm);
+        for (uint32_t page_id = 0; page_id < 128; page_id++) {
+            Page* page = bpm.new_page(file_id, page_id);
+            page->data[PAGE_SIZE - 1] = static_cast<uint8_t>(page_id);
+            bpm.unpin_page(file_id, page_id, true);
+        }
+        bpm.detach_file(file_id);
+        file_id = bpm.attach_file(dm);
+        bpm.reset_stats();
+
+        std::vector<uint32_t> page_ids;
+        for (uint32_t page_id = 0; page_id < 16; page_id++) {
+            page_ids.push_back(page_id);
+        }
+        bpm.prefetch_pages(file_id, page_ids);
+        for (int i = 0; i < 1000 && bpm.get_stats().prefetched < 16; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        assert(bpm.get_stats().prefetched == 16 && "read-ahead thread did not load the pages");
+        assert(bpm.get_pinned_count() == 0 && "prefetched pages left pinned");
+
+        Page* page = bpm.fetch_page(file_id, 3, AccessType::SCAN);
+        assert(page->data[PAGE_SIZE - 1] == 3 && "prefetched page has wrong contents");
+        bpm.unpin_page(file_id, 3, false);
+        BufferPoolStats stats = bpm.get_stats();
+        assert(stats.prefetch_used == 1 && stats.misses == 0 && "prefetched page not served from the pool");
+        std::cout << "[OK] Prefetched page served without a miss\n";
+
+        for (uint32_t page_id = 32; page_id < 128; page_id++) {
+            bpm.fetch_page(file_id, page_id);
+            bpm.unpin_page(file_id, page_id, false);
+        }
+        stats = bpm.get_stats();
+        assert(stats.prefetch_unused == 15 && "evicted prefetched pages not counted as unused");
+        std::cout << "[OK] " << stats.prefetch_unused << " prefetched pages evicted unused\n";
+
+        bpm.set_read_ahead(false);
+        bpm.prefetch_pages(file_id, {0, 1, 2});
+        assert(bpm.get_stats().prefetched == stats.prefetched && "prefetch ran while disabled");
+        bpm.detach_file(file_id);
+    }
+    std::remove(path.c_str());
+
+    // A scan over a table much larger than the pool returns the same rows
+    // with read-ahead on and off.
+    StorageEngine se(64 * PAGE_SIZE);
+    const std::string table_name = "test_read_ahead_scan";
+    std::remove(("data/" + table_name + ".db").c_str());
+    assert(se.create_table(table_name) && "create_table failed");
+    TableHandle* th = se.open_table(table_name);
+    assert(th != nullptr && "open_table failed");
+    const int num_records = 3000;
+    std::vector<uint8_t> value(64, 'v');
+    for (int i = 0; i < num_records; i++) {
+        char key_buf[16];
+        std::snprintf(key_buf, sizeof(key_buf), "key%05d", i * 7919 % num_records);
+        std::vector<uint8_t> key(key_buf, key_buf + 8);
+        assert(se.insert_record(th, key, value) && "insert failed");
+    }
+    for (bool enabled : {true, false}) {
+        se.buffer_pool().set_read_ahead(enabled);
+        se.close_table(th);
+        th = se.open_table(table_name);
+        scan_count = 0;
+        se.scan_table(th, scan_callback, nullptr);
+        assert(scan_count == num_records && "scan lost rows");
+    }
+    std::cout << "[OK] Cold scans return all " << num_records << " rows with and without read-ahead\n";
+    se.close_table(th);
+    se.drop_table(table_name);
+    std::cout << "\n=== Read-Ahead Test PASSED ===\n";
+}
+
+static void test_mmap_access_mode() {
+    std::cout << "\n=== Memory-Mapped Access Test ===\n";
+
+    StorageEngine se(64 * PAGE_SIZE);
+    const std::string table_name = "test_mmap";
+    std::remove(("data/" + table_name + ".db").c_str());
+    assert(se.create_table(table_name) && "create_table failed");
+    TableHandle* th = se.open_table(table_name);
+    assert(th != nullptr && "open_table failed");
+
+    auto make_key = [](int i) {
+        char key_buf[16];
+        std::snprintf(key_buf, sizeof(key_buf), "key%05d", i);
+        return std::vector<uint8_t>(key_buf, key_buf + 8);
+    };
+    const int num_records = 2000;
+    std::vector<uint8_t> value(64, 'v');
+    for (int i = 0; i < num_records; i++) {
+        assert(se.insert_record(th, make_key(i * 7919 % num_records), value) && "insert failed");
+    }
+
+    th = se.open_table(table_name, TableAccessMode::MMAP);
+    assert(th != nullptr && th->mapping && "table not mapped");
+    se.buffer_pool().reset_stats();
+    std::vector<uint8_t> out;
+    for (int i = 0; i < num_records; i += 7) {
+        assert(se.get_record(th, make_key(i), out) && out == value && "mapped lookup failed");
+    }
+    scan_count = 0;
+    se.scan_table(th, scan_callback, nullptr);
+    assert(scan_count == num_records && "mapped scan lost rows");
+    BufferPoolStats stats = se.buffer_pool().get_stats();
+    assert(stats.hits + stats.misses == 0 && "mapped reads went through the pool");
+    std::cout << "[OK] Lookups and a full scan read the mapping, not the pool\n";
+
+    // Writes grow the file past the mapped length; each is written back
+    // and mapped before the next read.
+    std::vector<uint8_t> new_value(32, 'n');
+    for (int i = num_records; i < 2 * num_records; i++) {
+        assert(se.insert_record(th, make_key(i), new_value) && "insert while mapped failed");
+    }
+    for (int i = 0; i < num_records; i += 2) {
+        assert(se.delete_record(th, make_key(i)) && "delete while mapped failed");
+    }
+    assert(se.update_record(th, make_key(1), new_value) && "update while mapped failed");
+    assert(se.get_record(th, make_key(1), out) && out == new_value && "update not visible");
+    assert(se.get_record(th, make_key(2 * num_records - 1), out) && out == new_value && "insert not visible");
+    assert(!se.get_record(th, make_key(0), out) && "deleted row still visible");
+    scan_count = 0;
+    se.scan_table(th, scan_callback, nullptr);
+    assert(scan_count == num_records + num_records / 2 && "scan after writes returned wrong count");
+    std::cout << "[OK] Writes while mapped are visible to mapped reads\n";
+
+    th = se.open_table(table_name, TableAccessMode::BUFFERED);
+    assert(th != nullptr && !th->mapping && "table still mapped");
+    scan_count = 0;
+    se.scan_table(th, scan_callback, nullptr);
+    assert(scan_count == num_records + num_records / 2 && "buffered scan returned wrong count");
+    std::cout << "[OK] Switched back to buffered access\n";
+
+    se.close_table(th);
+    se.drop_table(table_name);
+    std::cout << "\n=== Memory-Mapped Access Test PASSED ===\n";
+}
+
+static void test_durability_modes() {
+    std::cout << "\n=== Durability Modes Test ===\n";
+
+    StorageEngine se;
+    const std::string table_name = "test_durability";
+    std::remove(("data/" + table_name + ".db").c_str());
+    assert(se.create_table(table_name) && "create_table failed");
+    TableHandle* th = se.open_table(table_name);
+    assert(th != nullptr && "open_table failed");
+    std::vector<uint8_t> value(64, 'v');
+    auto make_key = [](int i) {
+        char key_buf[16];
+        std::snprintf(key_buf, sizeof(key_buf), "key%05d", i);
+        return std::vector<uint8_t>(key_buf, key_buf + 8);
+    };
+
+    assert(se.insert_record(th, make_key(0), value) && "insert failed");
+    assert(se.buffer_pool().get_dirty_count() > 0 && "NONE mode wrote back eagerly");
+    se.set_durability(th, DurabilityMode::PER_BATCH);
+    assert(se.insert_record(th, make_key(1), value) && "insert failed");
+    assert(se.buffer_pool().get_dirty_count() > 0 && "PER_BATCH mode synced before the batch ended");
+    assert(se.sync_table(th) && "sync_table failed");
+    assert(se.buffer_pool().get_dirty_count() == 0 && "sync_table left dirty pages");
+    std::cout << "[OK] NONE and PER_BATCH leave pages dirty until sync_table\n";
+
+    se.set_durability(th, DurabilityMode::PER_OPERATION);
+    const int threads = 4;
+    const int per_thread = 100;
+    std::vector<std::thread> writers;
+    for (int t = 0; t < threads; t++) {
+        writers.emplace_back([&, t] {
+            for (int i = 0; i < per_thread; i++) {
+                assert(se.insert_record(th, make_key(100 + t * per_thread + i), value) && "durable insert failed");
+            }
+        });
+    }
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+    assert(se.buffer_pool().get_dirty_count() == 0 && "PER_OPERATION insert returned before write-back");
+    scan_count = 0;
+    se.scan_table(th, scan_callback, nullptr);
+    assert(scan_count == 2 + threads * per_thread && "concurrent durable inserts lost rows");
+    uint64_t syncs = th->group_commit.get_sync_count();
+    uint64_t commits = th->group_commit.get_commit_count();
+    assert(syncs <= commits && "more syncs than commits");
+    std::cout << "[OK] " << commits << " durable commits from " << threads << " threads took " << syncs << " syncs\n";
+
+    uint64_t ticket = th->group_commit.last_ticket();
+    assert(!se.insert_record(th, make_key(100), value) && "duplicate insert succeeded");
+    assert(!se.delete_record(th, make_key(99999)) && "delete of a missing key succeeded");
+    assert(th->group_commit.last_ticket() == ticket && th->group_commit.get_sync_count() == syncs &&
+           "failed writes were committed");
+    std::cout << "[OK] Failed writes take no commit ticket\n";
+
+    se.close_table(th);
+    se.drop_table(table_name);
+    std::cout << "\n=== Durability Modes Test PASSED ===\n";
+}
+
+static void test_page_sizes() {
+    std::cout << "\n=== Page Size Test ===\n";
+
+    assert(!StorageEngine().create_table("test_page_size_bad", 3000) && "odd page size accepted");
+    assert(!StorageEngine().create_table("test_page_size_bad", 2 * MAX_PAGE_SIZE) && "oversized page accepted");
+
+    auto make_key = [](int i) {
+        char key_buf[16];
+        std::snprintf(key_buf, sizeof(key_buf), "key%05d", i);
+        return std::vector<uint8_t>(key_buf, key_buf + 8);
+    };
+    const int num_records = 3000;
+    std::vector<uint8_t> value(64, 'v');
+    for (uint32_t page_size : {4096u, 32768u}) {
+        const std::string table_name = "test_page_size_" + std::to_string(page_size);
+        std::remove(("data/" + table_name + ".db").c_str());
+        {
+            StorageEngine se(64 * page_size);
+            assert(se.create_table(table_name, page_size) && "create_table failed");
+            TableHandle* th = se.open_table(table_name);
+            assert(th != nullptr && "open_table failed");
+            assert(th->dm->get_page_size() == page_size && "table opened with the wrong page size");
+            for (int i = 0; i < num_records; i++) {
+                assert(se.insert_record(th, make_key(i * 7919 % num_records), value) && "insert failed");
+            }
+            for (int i = 0; i < num_records; i += 3) {
+                assert(se.delete_record(th, make_key(i)) && "delete failed");
+            }
+            BufferPoolStats stats = se.buffer_pool(page_size).get_stats();
+            assert(stats.hits + stats.misses > 0 && "table not cached in its page size's pool");
+            assert(se.buffer_pool().get_pool_size() * PAGE_SIZE + se.buffer_pool(page_size).get_pool_size() * page_size <=
+                   64 * page_size && "pools of two page sizes overran the budget");
+            se.close_table(th);
+        }
+
+        StorageEngine se(64 * page_size);
+        assert(table_page_size(table_name) == page_size && "page size not persisted");
+        TableHandle* th = se.open_table(table_name);
+        assert(th != nullptr && "reopen failed");
+        std::vector<uint8_t> out;
+        for (int i = 0; i < num_records; i++) {
+            bool found = se.get_record(th, make_key(i), out);
+            assert(found == (i % 3 != 0) && "wrong rows after reopen");
+            assert((!found || out == value) && "wrong value after reopen");
+        }
+        scan_count = 0;
+        se.scan_table(th, scan_callback, nullptr);
+        assert(scan_count == num_records - (num_records + 2) / 3 && "scan after reopen returned wrong count");
+
+        TableHandle other(table_name);
+        assert(!open_table(table_name, other, se.buffer_pool()) && "pool of another page size accepted the table");
+        se.close_table(th);
+        se.drop_table(table_name);
+        std::cout << "[OK] " << page_size << "-byte pages persist across reopen\n";
+    }
+
+    // Shrinking a pool writes back the pages it gives up; growing it back
+    // returns their frames.
+    const std::string table_name = "test_page_size_limit";
+    std::remove(("data/" + table_name + ".db").c_str());
+    assert(create_table(table_name) && "create_table failed");
+    {
+        BufferPoolManager bpm(64);
+        TableHandle th(table_name);
+        assert(open_table(table_name, th, bpm) && "open_table failed");
+        for (uint32_t page_id = 1; page_id <= 64; page_id++) {
+            Page* page = bpm.new_page(th.file_id, page_id);
+            assert(page != nullptr && "new_page failed");
+            page->data[sizeof(PageHeader)] = static_cast<uint8_t>(page_id);
+            bpm.unpin_page(page, true);
+        }
+        Page* pinned = bpm.fetch_page(th.file_id, 64);
+        bpm.set_frame_limit(16);
+        assert(bpm.get_pool_size() == 16 && bpm.get_free_frame_count() == 0 && "pool did not shrink");
+        bpm.unpin_page(pinned, false);
+        for (uint32_t page_id = 1; page_id <= 64; page_id++) {
+            Page* page = bpm.fetch_page(th.file_id, page_id);
+            assert(page != nullptr && page->data[sizeof(PageHeader)] == page_id && "page lost by shrinking");
+            bpm.unpin_page(page, false);
+        }
+        bpm.set_frame_limit(64);
+        assert(bpm.get_pool_size() == 64 && bpm.get_free_frame_count() == 48 && "pool did not grow back");
+        close_table(th);
+    }
+    std::remove(("data/" + table_name + ".db").c_str());
+    std::cout << "[OK] Pool shrunk to 16 of 64 frames and grown back\n";
+
+    std::cout << "\n=== Page Size Test PASSED ===\n";
+}
+
+static void test_page_compression() {
+    std::cout << "\n=== Page Compression Test ===\n";
+
+    std::string text = "{\"id\":12,\"name\":\"widget\",\"tags\":[\"a\",\"b\",\"b\",\"b\"],\"price\":0.5}";
+    std::vector<uint8_t> packed(text.size() + 16);
+    std::vector<uint8_t> unpacked(text.size());
+    size_t packed_size = lz_compress(reinterpret_cast<const uint8_t*>(text.data()), text.size(), packed.data(),
+                                     packed.size());
+    assert(packed_size > 0 && "lz_compress failed");
+    assert(lz_decompress(packed.data(), packed_size, unpacked.data(), unpacked.size()) == text.size() &&
+           std::memcmp(unpacked.data(), text.data(), text.size()) == 0 && "lz round trip failed");
+    assert(lz_compress(reinterpret_cast<const uint8_t*>(text.data()), text.size(), packed.data(), 4) == 0 &&
+           "lz_compress overran its buffer");
+    std::cout << "[OK] Codec round trip\n";
+
+    auto make_key = [](int i) {
+        char key_buf[16];
+        std::snprintf(key_buf, sizeof(key_buf), "key%05d", i);
+        return std::vector<uint8_t>(key_buf, key_buf + 8);
+    };
+    auto make_value = [](int i) {
+        char value_buf[128];
+        int length = std::snprintf(value_buf, sizeof(value_buf),
+                                   "{\"id\":%d,\"status\":\"active\",\"owner\":\"user%03d\",\"tags\":[\"red\",\"blue\"]}",
+                                   i, i % 100);
+        return std::vector<uint8_t>(value_buf, value_buf + length);
+    };
+    const int num_records = 3000;
+    size_t file_bytes[2] = {};
+    for (bool compress : {false, true}) {
+        const std::string table_name = compress ? "test_compressed" : "test_uncompressed";
+        const std::string path = "data/" + table_name + ".db";
+        std::remove(path.c_str());
+        {
+            // A small pool, so pages are written and read back many times.
+            StorageEngine se(32 * PAGE_SIZE);
+            assert(se.create_table(table_name, PAGE_SIZE, compress) && "create_table failed");
+            TableHandle* th = se.open_table(table_name);
+            assert(th != nullptr && th->dm->is_compressed() == compress && "open_table failed");
+            for (int i = 0; i < num_records; i++) {
+                int k = i * 7919 % num_records;
+                assert(se.insert_record(th, make_key(k), make_value(k)) && "insert failed");
+            }
+            for (int i = 0; i < num_records; i += 3) {
+                assert(se.delete_record(th, make_key(i)) && "delete failed");
+            }
+            assert(se.sync_table(th) && "sync_table failed");
+            if (compress) {
+                assert(se.open_table(table_name, TableAccessMode::MMAP) == nullptr && "compressed table mapped");
+                CompressionStats stats = th->dm->get_compression_stats();
+                assert(stats.pages_compressed > 0 && stats.pages_decompressed > 0 && "pool never hit the disk");
+                assert(stats.ratio() > 2.0 && "leaf pages barely compressed");
+                std::cout << "[OK] Ratio " << stats.ratio() << ", " << stats.compress_ns_per_page() << " ns to compress and "
+                          << stats.decompress_ns_per_page() << " ns to decompress a page\n";
+            }
+            se.close_table(th);
+        }
+        if (FILE* file = std::fopen(path.c_str(), "rb")) {
+            std::fseek(file, 0, SEEK_END);
+            file_bytes[compress] = static_cast<size_t>(std::ftell(file));
+            std::fclose(file);
+        }
+
+        StorageEngine se(32 * PAGE_SIZE);
+        TableHandle* th = se.open_table(table_name);
+        assert(th != nullptr && th->dm->is_compressed() == compress && "reopen failed");
+        std::vector<uint8_t> out;
+        for (int i = 0; i < num_records; i++) {
+            bool found = se.get_record(th, make_key(i), out);
+            assert(found == (i % 3 != 0) && "wrong rows after reopen");
+            assert((!found || out == make_value(i)) && "wrong value after reopen");
+        }
+        se.close_table(th);
+        se.drop_table(table_name);
+        assert(std::fopen(DiskManager::page_map_path(path).c_str(), "rb") == nullptr && "drop_table left the map");
+    }
+    assert(file_bytes[1] * 2 < file_bytes[0] && "compressed file not smaller");
+    std::cout << "[OK] Compressed file " << file_bytes[1] / 1024 << " KB, uncompressed " << file_bytes[0] / 1024
+              << " KB; rows survive reopen\n";
+
+    std::cout << "\n=== Page Compression Test PASSED ===\n";
+}
+
+static void test_tablespace() {
+    std::cout << "\n=== Tablespace Test ===\n";
+
+    const std::string path = "data/test_space.tbs";
+    std::remove(path.c_str());
+    auto table_name = [](int t) { return "space_table_" + std::to_string(t); };
+    auto rows_of = [](int t) { return t % 50 == 0 ? 400 : 20; };
+    auto make_key = [](int t, int i) {
+        std::string key = "t" + std::to_string(t) + "_key" + std::to_string(100000 + i);
+        return std::vector<uint8_t>(key.begin(), key.end());
+    };
+    auto make_value = [](int t, int i) {
+        std::string value = "value_" + std::to_string(t * 1000 + i);
+        return std::vector<uint8_t>(value.begin(), value.end());
+    };
+    auto fill = [&](StorageEngine& se, int t) {
+        assert(se.create_table(table_name(t)) && "create_table failed");
+        TableHandle* th = se.open_table(table_name(t));
+        assert(th != nullptr && "open_table failed");
+        for (int i = 0; i < rows_of(t); i++) {
+            assert(se.insert_record(th, make_key(t, i), make_value(t, i)) && "insert failed");
+        }
+        se.close_table(th);
+    };
+    auto file_size = [&path] {
+        FILE* file = std::fopen(path.c_str(), "rb");
+        assert(file != nullptr && "tablespace file missing");
+        std::fseek(file, 0, SEEK_END);
+        long size = std::ftell(file);
+        std::fclose(file);
+        return size;
+    };
+
+    const int num_tables = 500;
+    {
+        StorageEngine se(64 * PAGE_SIZE);
+        assert(se.use_tablespace("test_space") && "use_tablespace failed");
+        for (int t = 0; t < num_tables; t++) {
+            fill(se, t);
+        }
+        assert(!se.create_table(table_name(7)) && "duplicate table created");
+        assert(!se.create_table("space_table_4k", 4096) && "table of another page size created");
+    }
+    for (int t = 0; t < num_tables; t += 97) {
+        assert(std::fopen(("data/" + table_name(t) + ".db").c_str(), "rb") == nullptr && "table got its own file");
+    }
+    long size_before = file_size();
+    std::cout << "[OK] " << num_tables << " tables in one " << size_before / 1024 << " KB file\n";
+
+    {
+        StorageEngine se(64 * PAGE_SIZE);
+        assert(se.use_tablespace("test_space") && "reopening the tablespace failed");
+        std::vector<uint8_t> out;
+        for (int t = 0; t < num_tables; t++) {
+            TableHandle* th = se.open_table(table_name(t));
+            assert(th != nullptr && "table lost on reopen");
+            for (int i = 0; i < rows_of(t); i += 7) {
+                assert(se.get_record(th, make_key(t, i), out) && out == make_value(t, i) && "wrong row after reopen");
+            }
+            assert(!se.get_record(th, make_key(t + 1, 0), out) && "row of another table visible");
+        }
+        for (int t = 0; t < num_tables; t += 2) {
+            assert(se.drop_table(table_name(t)) && "drop_table failed");
+        }
+        assert(se.open_table(table_name(0)) == nullptr && "dropped table still opens");
+        assert(!se.drop_table(table_name(0)) && "table dropped twice");
+        for (int t = num_tables; t < num_tables + num_tables / 2; t++) {
+            fill(se, t);
+        }
+    }
+    assert(file_size() <= size_before && "freed pages not reused");
+    std::cout << "[OK] Dropped half the tables; the pages went to " << num_tables / 2 << " new ones\n";
+
+    {
+        StorageEngine se(64 * PAGE_SIZE);
+        assert(se.use_tablespace("test_space") && "reopening the tablespace failed");
+        std::vector<uint8_t> out;
+        for (int t = 1; t < num_tables + num_tables / 2; t++) {
+            TableHandle* th = se.open_table(table_name(t));
+            assert((th != nullptr) == (t % 2 == 1 || t >= num_tables) && "wrong set of tables");
+            if (th != nullptr) {
+                assert(se.get_record(th, make_key(t, rows_of(t) - 1), out) && out == make_value(t, rows_of(t) - 1) &&
+                       "wrong row after reuse");
+            }
+        }
+    }
+    std::remove(path.c_str());
+    std::cout << "[OK] Surviving and new tables intact after reopen\n";
+
+    std::cout << "\n=== Tablespace Test PASSED ===\n";
+}
+
+static void test_free_space_map() {
+    std::cout << "\n=== Free Space Map Test ===\n";
+
+    const std::string table_name = "test_fsm";
+    std::remove(("data/" + table_name + ".db").c_str());
+    const uint32_t group_pages = bitmap_group_pages(PAGE_SIZE);
+    const uint32_t num_pages = 40000;  // spans three bitmap groups
+    std::vector<bool> in_use(3 * group_pages, false);
+    {
+        StorageEngine se;
+        assert(se.create_table(table_name) && "create_table failed");
+        TableHandle* th = se.open_table(table_name);
+        assert(th != nullptr && "open_table failed");
+
+        uint64_t syscalls = th->dm->get_syscall_count();
+        uint32_t last = 2;
+        for (uint32_t i = 0; i < num_pages; i++) {
+            uint32_t page_id = allocate_page(*th);
+            assert(page_id != INVALID_PAGE_ID && "allocation failed");
+            assert(page_id > last && "next-fit allocation went backwards");
+            assert(page_id % group_pages != 0 && "bitmap page handed out");
+            in_use[page_id] = true;
+            last = page_id;
+        }
+        assert(th->dm->get_syscall_count() - syscalls < 8 && "allocations written through");
+        std::cout << "[OK] " << num_pages << " pages allocated across " << last / group_pages + 1
+                  << " bitmap groups without writes\n";
+
+        uint32_t freed = 0;
+        for (uint32_t page_id = 3; page_id < in_use.size(); page_id += 3) {
+            if (in_use[page_id]) {
+                free_page(*th, page_id);
+                in_use[page_id] = false;
+                freed++;
+            }
+        }
+        for (uint32_t i = 0; i < freed; i++) {
+            uint32_t page_id = allocate_page(*th);
+            assert(page_id < in_use.size() && !in_use[page_id] && "freed pages not reused before growing");
+            in_use[page_id] = true;
+        }
+        std::cout << "[OK] " << freed << " freed pages reused\n";
+        se.close_table(th);
+    }
+
+    StorageEngine se;
+    TableHandle* th = se.open_table(table_name);
+    assert(th != nullptr && "reopen failed");
+    uint32_t page_id = allocate_page(*th);
+    assert(page_id < in_use.size() && !in_use[page_id] && "free-space map lost on reopen");
+    se.close_table(th);
+    se.drop_table(table_name);
+    std::cout << "[OK] Free-space map survives reopen\n";
+
+    std::cout << "\n=== Free Space Map Test PASSED ===\n";
+}
+
+static void test_leaf_locality() {
+    std::cout << "\n=== Leaf Locality Test ===\n";
+
+    const std::string table_name = "test_locality";
+    std::remove(("data/" + table_name + ".db").c_str());
+    const uint32_t rows = 20000;
+    StorageEngine se;
+    assert(se.create_table(table_name) && "create_table failed");
+    TableHandle* th = se.open_table(table_name);
+    assert(th != nullptr && "open_table failed");
+
+    uint32_t first = allocate_page(*th);
+    uint32_t near = allocate_page(*th, first);
+    assert(near / ALLOCATION_EXTENT_PAGES == first / ALLOCATION_EXTENT_PAGES && "hint left the extent");
+    free_page(*th, near);
+    free_page(*th, first);
+    std::cout << "[OK] Hinted allocation stays in the extent\n";
+
+    std::vector<uint8_t> value(64, 'v');
+    for (uint32_t i = 0; i < rows; i++) {
+        std::string key = "key" + std::to_string(100000 + i);
+        assert(se.insert_record(th, std::vector<uint8_t>(key.begin(), key.end()), value) && "insert failed");
+    }
+    LeafLayout ordered = btree_leaf_layout(*th);
+    assert(ordered.leaves > 100 && ordered.sequential_share() > 0.9 && "ordered load scattered its leaves");
+    std::cout << "[OK] Ordered load: " << ordered.sequential_share() * 100.0 << "% of leaf hops sequential\n";
+
+    // Four keys after each existing one, in random order, split leaves all over the tree.
+    for (uint32_t i = 0; i < 4 * rows; i++) {
+        uint32_t k = static_cast<uint32_t>(i * 2654435761ULL % (4 * rows));
+        std::string key = "key" + std::to_string(100000 + k / 4) + "x" + std::to_string(k % 4);
+        assert(se.insert_record(th, std::vector<uint8_t>(key.begin(), key.end()), value) && "insert failed");
+    }
+    LeafLayout random = btree_leaf_layout(*th);
+    assert(random.leaves > 2 * ordered.leaves && random.extent_share() > 0.1 && "random splits lost all locality");
+    scan_count = 0;
+    se.scan_table(th, scan_callback, nullptr);
+    assert(scan_count == static_cast<int>(5 * rows) && "rows missing after random splits");
+    std::cout << "[OK] Random splits: " << random.extent_share() * 100.0 << "% of leaf hops within an extent\n";
+
+    se.close_table(th);
+    se.drop_table(table_name);
+    std::cout << "\n=== Leaf Locality Test PASSED ===\n";
+}
+
+static void test_compact_table() {
+    std::cout << "\n=== Compact Table Test ===\n";
+
+    const std::string table_name = "test_compact";
+    std::remove(("data/" + table_name + ".db").c_str());
+    const uint32_t rows = 30000;
+    StorageEngine se;
+    assert(se.create_table(table_name) && "create_table failed");
+    TableHandle* th = se.open_table(table_name);
+    assert(th != nullptr && "open_table failed");
+
+    auto make_key = [](const std::string& prefix, uint32_t i) {
+        std::string key = prefix + std::to_string(100000 + i);
+        return std::vector<uint8_t>(key.begin(), key.end());
+    };
+    std::vector<uint8_t> value(64, 'v');
+    for (uint32_t i = 0; i < rows; i++) {
+        uint32_t k = static_cast<uint32_t>(i * 2654435761ULL % rows);
+        assert(se.insert_record(th, make_key("key", k), value) && "insert failed");
+    }
+    // Purge most of the table, leaving every leaf sparse.
+    for (uint32_t i = 0; i < rows; i++) {
+        if (i % 4 != 0) {
+            assert(se.delete_record(th, make_key("key", i)) && "delete failed");
+        }
+    }
+    se.flush_all();
+    uint64_t size_before = th->dm->get_file_size();
+    LeafLayout before = btree_leaf_layout(*th);
+
+    // Writers carry on while the table is compacted.
+    const uint32_t extra = 3000;
+    std::thread writer([&] {
+        for (uint32_t i = 0; i < extra; i++) {
+            se.insert_record(th, make_key("new", i), value);
+        }
+    });
+    assert(se.compact_table(th) && "compact_table failed");
+    writer.join();
+    std::cout << "[OK] Compacted while " << extra << " rows were inserted\n";
+
+    for (uint32_t i = 0; i < rows; i += 4) {
+        std::vector<uint8_t> out;
+        assert(se.get_record(th, make_key("key", i), out) && out == value && "row lost by compaction");
+    }
+    for (uint32_t i = 0; i < extra; i++) {
+        std::vector<uint8_t> out;
+        assert(se.get_record(th, make_key("new", i), out) && "concurrent insert lost");
+    }
+    scan_count = 0;
+    se.scan_table(th, scan_callback, nullptr);
+    assert(scan_count == static_cast<int>(rows / 4 + extra) && "scan count wrong after compaction");
+    std::cout << "[OK] All " << scan_count << " rows present\n";
+
+    // Compacting again with no writers lays every leaf out in order.
+    assert(se.compact_table(th) && "second compact_table failed");
+    LeafLayout after = btree_leaf_layout(*th);
+    uint64_t size_after = th->dm->get_file_size();
+    double rows_per_leaf_before = static_cast<double>(rows / 4) / static_cast<double>(before.leaves);
+    double rows_per_leaf_after = static_cast<double>(rows / 4 + extra) / static_cast<double>(after.leaves);
+    assert(rows_per_leaf_after > rows_per_leaf_before * 1.1 && "leaves not packed");
+    assert(after.sequential_share() > 0.95 && "leaves not sequential after compaction");
+    assert(size_after * 2 < size_before && "file not truncated");
+    std::cout << "[OK] Rows per leaf " << rows_per_leaf_before << " -> " << rows_per_leaf_after << ", "
+              << after.sequential_share() * 100.0 << "% of hops sequential, file "
+              << size_before / 1024 << " KB -> " << size_after / 1024 << " KB\n";
+
+    se.close_table(th);
+    th = se.open_table(table_name);
+    assert(th != nullptr && "reopen failed");
+    scan_count = 0;
+    se.scan_table(th, scan_callback, nullptr);
+    assert(scan_count == static_cast<int>(rows / 4 + extra) && "rows lost across reopen");
+    assert(se.insert_record(th, make_key("after", 0), value) && "insert after compaction failed");
+    std::cout << "[OK] Reopened and still writable\n";
+
+    se.close_table(th);
+    se.drop_table(table_name);
+    std::cout << "\n=== Compact Table Test PASSED ===\n";
+}
+
+struct BulkRows {
+    uint32_t next;
+    uint32_t end;
+    uint32_t step;
+    std::vector<uint8_t> value;
+};
+
+static std::vector<uint8_t> bulk_key(uint32_t i) {
+    std::string key = "bulk" + std::to_string(1000000 + i);
+    return std::vector<uint8_t>(key.begin(), key.end());
+}
+
+static bool bulk_rows_source(std::vector<uint8_t>& key, std::vector<uint8_t>& value, void* ctx) {
+    BulkRows* rows = static_cast<BulkRows*>(ctx);
+    if (rows->next >= rows->end) {
+        return false;
+    }
+    key = bulk_key(rows->next);
+    value = rows->value;
+    rows->next += rows->step;
+    return true;
+}
+
+static void test_bulk_load() {
+    std::cout << "\n=== Bulk Load Test ===\n";
+
+    const std::string table_name = "test_bulk_load";
+    std::remove(("data/" + table_name + ".db").c_str());
+    StorageEngine se;
+    assert(se.create_table(table_name) && "create_table failed");
+    TableHandle* th = se.open_table(table_name);
+    assert(th != nullptr && "open_table failed");
+
+    // Even keys into the empty table.
+    const uint32_t rows = 40000;
+    BulkRows source{0, rows, 2, std::vector<uint8_t>(64, 'a')};
+    assert(se.bulk_load(th, bulk_rows_source, &source) && "bulk_load into empty table failed");
+    scan_count = 0;
+    se.scan_table(th, scan_callback, nullptr);
+    assert(scan_count == static_cast<int>(rows / 2) && "bulk_load row count wrong");
+    for (uint32_t i = 0; i < rows; i += 2) {
+        std::vector<uint8_t> out;
+        assert(se.get_record(th, bulk_key(i), out) && out == source.value && "bulk loaded row missing");
+    }
+    LeafLayout layout = btree_leaf_layout(*th);
+    assert(layout.sequential_share() > 0.95 && "bulk loaded leaves not sequential");
+    std::cout << "[OK] Loaded " << scan_count << " rows into " << layout.leaves << " leaves, "
+              << layout.sequential_share() * 100.0 << "% of hops sequential\n";
+
+    // Keys must come after every key already in the table.
+    BulkRows overlap{rows - 3, rows + 10, 1, std::vector<uint8_t>(8, 'x')};
+    assert(!se.bulk_load(th, bulk_rows_source, &overlap) && "overlapping bulk_load accepted");
+    std::vector<uint8_t> out;
+    assert(!se.get_record(th, bulk_key(rows - 3), out) && "rejected row was loaded");
+
+    // Appending past the current max key, in a second call, at a lower fill.
+    BulkRows append{rows, rows * 2, 1, std::vector<uint8_t>(32, 'b')};
+    assert(se.bulk_load(th, bulk_rows_source, &append, 50) && "appending bulk_load failed");
+    scan_count = 0;
+    se.scan_table(th, scan_callback, nullptr);
+    assert(scan_count == static_cast<int>(rows / 2 + rows) && "row count wrong after append");
+    assert(se.get_record(th, bulk_key(rows), out) && out == append.value && "first appended row missing");
+    assert(se.get_record(th, bulk_key(rows * 2 - 1), out) && "last appended row missing");
+    std::cout << "[OK] Appended " << rows << " rows past the largest key\n";
+
+    // A load stops at the first key out of order, keeping the rows before it.
+    BulkRows backwards{rows * 2 + 5, rows * 2 + 10, 1, std::vector<uint8_t>(8, 'c')};
+    assert(se.bulk_load(th, bulk_rows_source, &backwards) && "bulk_load failed");
+    BulkRows restart{rows * 2 + 10, rows * 2 + 20, 1, std::vector<uint8_t>(8, 'c')};
+    assert(se.bulk_load(th, bulk_rows_source, &restart) && "bulk_load failed");
+    BulkRows early{rows * 2, rows * 2 + 5, 1, std::vector<uint8_t>(8, 'c')};
+    assert(!se.bulk_load(th, bulk_rows_source, &early) && "out-of-order key accepted");
+    assert(!se.get_record(th, bulk_key(rows * 2), out) && "out-of-order row was loaded");
+    std::cout << "[OK] Out-of-order keys rejected\n";
+
+    // The loaded tree takes ordinary inserts and deletes in its gaps.
+    for (uint32_t i = 1; i < rows; i += 2) {
+        assert(se.insert_record(th, bulk_key(i), source.value) && "insert into loaded table failed");
+    }
+    for (uint32_t i = 0; i < rows; i += 4) {
+        assert(se.delete_record(th, bulk_key(i)) && "delete from loaded table failed");
+    }
+    scan_count = 0;
+    se.scan_table(th, scan_callback, nullptr);
+    assert(scan_count == static_cast<int>(rows - rows / 4 + rows + 15) && "row count wrong after writes");
+
+    se.close_table(th);
+    th = se.open_table(table_name);
+    assert(th != nullptr && "reopen failed");
+    assert(se.get_record(th, bulk_key(rows * 2 - 1), out) && "loaded row lost across reopen");
+    std::cout << "[OK] Inserts and deletes work on the loaded table\n";
+
+    // Readers descend alongside a load, which latches the pages they can
+    // reach in the order they do. The engine's lookups wait for writers,
+    // so these call the tree directly.
+    struct DirectRows {
+        BulkRows rows;
+        std::vector<uint8_t> key;
+    } more{{rows * 2 + 20, rows * 4, 1, std::vector<uint8_t>(32, 'd')}, {}};
+    std::atomic<bool> loading{true};
+    std::atomic<uint64_t> lookups{0};
+    std::atomic<uint64_t> misses{0};
+    std::thread reader([&] {
+        // Every other lookup goes past the largest key, to the leaf being
+        // filled.
+        const std::vector<uint8_t> past_end = bulk_key(rows * 4);
+        Value value;
+        for (uint32_t i = 0; loading.load(); i = (i + 7) % rows) {
+            std::vector<uint8_t> key = bulk_key(rows + i);
+            misses += btree_search(*th, Key(key.data(), static_cast<uint16_t>(key.size())), value) ? 0 : 1;
+            btree_search(*th, Key(past_end.data(), static_cast<uint16_t>(past_end.size())), value);
+            lookups += 2;
+        }
+    });
+    bool loaded = btree_bulk_load(*th, [](Key& key, Value& value, void* ctx) {
+        auto* more = static_cast<DirectRows*>(ctx);
+        if (more->rows.next >= more->rows.end) {
+            return false;
+        }
+        more->key = bulk_key(more->rows.next++);
+        key = Key(more->key.data(), static_cast<uint16_t>(more->key.size()));
+        value = Value(more->rows.value.data(), static_cast<uint16_t>(more->rows.value.size()));
+        return true;
+    }, &more, 100);
+    loading = false;
+    reader.join();
+    assert(loaded && "bulk_load alongside readers failed");
+    assert(misses == 0 && "reader missed a row during a load");
+    assert(se.get_record(th, bulk_key(rows * 4 - 1), out) && out == more.rows.value && "row loaded alongside readers missing");
+    std::cout << "[OK] " << lookups << " lookups ran alongside a load of " << rows * 2 - 20 << " rows\n";
+
+    se.close_table(th);
+    se.drop_table(table_name);
+    std::cout << "\n=== Bulk Load Test PASSED ===\n";
+}
+
+static void test_insert_batch() {
+    std::cout << "\n=== Insert Batch Test ===\n";
+
+    const std::string table_name = "test_insert_batch";
+    std::remove(("data/" + table_name + ".db").c_str());
+    StorageEngine se;
+    assert(se.create_table(table_name) && "create_table failed");
+    TableHandle* th = se.open_table(table_name);
+    assert(th != nullptr && "open_table failed");
+
+    auto make_key = [](uint32_t i) {
+        std::string key = "batch" + std::to_string(100000 + i);
+        return std::vector<uint8_t>(key.begin(), key.end());
+    };
+    std::vector<uint8_t> value(48, 'v');
+
+    // Unsorted rows into the empty table, with enough to split many times.
+    const uint32_t rows = 20000;
+    std::vector<StorageEngine::Row> batch;
+    for (uint32_t i = 0; i < rows; i++) {
+        batch.emplace_back(make_key(static_cast<uint32_t>(i * 2654435761ULL % rows) * 2), value);
+    }
+    assert(se.insert_batch(th, batch) == rows && "insert_batch into empty table");
+    scan_count = 0;
+    se.scan_table(th, scan_callback, nullptr);
+    assert(scan_count == static_cast<int>(rows) && "row count wrong after insert_batch");
+    std::cout << "[OK] Inserted " << rows << " unsorted rows in one batch\n";
+
+    // Existing keys, repeats within the batch and invalid rows are skipped.
+    batch.clear();
+    for (uint32_t i = 0; i < 1000; i++) {
+        batch.emplace_back(make_key(i * 2 + 1), std::vector<uint8_t>(8, 'n'));
+        batch.emplace_back(make_key(i * 2), std::vector<uint8_t>(8, 'x'));
+    }
+    batch.emplace_back(make_key(1), std::vector<uint8_t>(8, 'x'));
+    batch.emplace_back(std::vector<uint8_t>(), value);
+    assert(se.insert_batch(th, batch) == 1000 && "insert_batch skipped the wrong rows");
+    std::vector<uint8_t> out;
+    assert(se.get_record(th, make_key(1), out) && out == std::vector<uint8_t>(8, 'n') && "first of repeated keys not kept");
+    assert(se.get_record(th, make_key(0), out) && out == value && "existing row overwritten");
+    std::cout << "[OK] Existing and repeated keys skipped\n";
+
+    for (uint32_t i = 0; i < rows; i++) {
+        assert(se.get_record(th, make_key(i * 2), out) && out == value && "batched row missing");
+    }
+    assert(se.insert_batch(th, {}) == 0 && "empty batch");
+    assert(se.delete_record(th, make_key(2)) && "delete after insert_batch failed");
+    assert(se.insert_record(th, make_key(2), value) && "insert after insert_batch failed");
+
+    se.close_table(th);
+    th = se.open_table(table_name);
+    assert(th != nullptr && "reopen failed");
+    scan_count = 0;
+    se.scan_table(th, scan_callback, nullptr);
+    assert(scan_count == static_cast<int>(rows + 1000) && "rows lost across reopen");
+    std::cout << "[OK] All " << scan_count << " rows present after reopen\n";
+
+    se.close_table(th);
+    se.drop_table(table_name);
+    std::cout << "\n=== Insert Batch Test PASSED ===\n";
+}
+
+static void test_get_batch() {
+    std::cout << "\n=== Get Batch Test ===\n";
+
+    const std::string table_name = "test_get_batch";
+    std::remove(("data/" + table_name + ".db").c_str());
+    StorageEngine se;
+    assert(se.create_table(table_name) && "create_table failed");
+    TableHandle* th = se.open_table(table_name);
+    assert(th != nullptr && "open_table failed");
+
+    auto make_key = [](uint32_t i) {
+        std::string key = "get" + std::to_string(100000 + i);
+        return std::vector<uint8_t>(key.begin(), key.end());
+    };
+    auto make_value = [](uint32_t i) {
+        std::string value = "value-" + std::to_string(i * 7);
+        return std::vector<uint8_t>(value.begin(), value.end());
+    };
+    StorageEngine::BatchResult result;
+    assert(se.get_batch(th, {make_key(1)}, result) == 0 && "get_batch on empty table");
+    assert(result.values.size() == 1 && !result.values[0].found && "empty table result");
+
+    const uint32_t rows = 20000;
+    for (uint32_t i = 0; i < rows; i++) {
+        assert(se.insert_record(th, make_key(i * 2), make_value(i * 2)) && "insert failed");
+    }
+
+    // Unsorted keys spread over the table, half of them missing, a repeat
+    // and an invalid one; results come back in the order asked.
+    std::vector<std::vector<uint8_t>> keys;
+    for (uint32_t i = 0; i < 500; i++) {
+        keys.push_back(make_key(static_cast<uint32_t>(i * 2654435761ULL % (rows * 2))));
+    }
+    keys.push_back(keys[3]);
+    keys.push_back(std::vector<uint8_t>());
+    size_t found = se.get_batch(th, keys, result);
+    assert(result.values.size() == keys.size() && "one result per key");
+    size_t expected = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        std::vector<uint8_t> value;
+        bool present = se.get_record(th, keys[i], value);
+        const StorageEngine::BatchValue& out = result.values[i];
+        assert(out.found == present && "get_batch disagrees with get_record");
+        if (present) {
+            expected++;
+            assert(std::vector<uint8_t>(result.arena.begin() + out.offset, result.arena.begin() + out.offset + out.size) == value &&
+                   "get_batch value wrong");
+        }
+    }
+    assert(found == expected && expected > 200 && "get_batch found count");
+    std::cout << "[OK] " << found << " of " << keys.size() << " keys found, in request order\n";
+
+    // Every key in one batch, in key order, then reused for a small one.
+    keys.clear();
+    for (uint32_t i = 0; i < rows; i++) {
+        keys.push_back(make_key(i * 2));
+    }
+    assert(se.get_batch(th, keys, result) == rows && "full-table get_batch");
+    assert(se.get_batch(th, {make_key(rows * 2 - 2), make_key(0)}, result) == 2 && "small get_batch");
+    assert(result.values.size() == 2 && result.values[0].offset == result.values[1].size &&
+           result.arena.size() == result.values[0].size + result.values[1].size && "arena not reused");
+    std::cout << "[OK] All " << rows << " keys found in one batch\n";
+
+    se.close_table(th);
+    se.drop_table(table_name);
+    std::cout << "\n=== Get Batch Test PASSED ===\n";
+}
+
+static void test_update_record() {
+    std::cout << "\n=== Update Record Test ===\n";
+
+    const std::string table_name = "test_update_record";
+    std::remove(("data/" + table_name + ".db").c_str());
+    StorageEngine se;
+    assert(se.create_table(table_name) && "create_table failed");
+    TableHandle* th = se.open_table(table_name);
+    assert(th != nullptr && "open_table failed");
+
+    auto make_key = [](uint32_t i) {
+        std::string key = "update" + std::to_string(100000 + i);
+        return std::vector<uint8_t>(key.begin(), key.end());
+    };
+    auto make_value = [](uint32_t i, size_t size) {
+        std::string value = std::to_string(i);
+        value.resize(size, static_cast<char>('a' + i % 26));
+        return std::vector<uint8_t>(value.begin(), value.end());
+    };
+
+    const uint32_t rows = 5000;
+    for (uint32_t i = 0; i < rows; i++) {
+        assert(se.insert_record(th, make_key(i), make_value(0, 8)) && "insert failed");
+    }
+    uint64_t leaves = btree_leaf_layout(*th).leaves;
+    uint64_t file_size = th->dm->get_file_size();
+
+    // Same-size overwrites stay in place.
+    for (uint32_t round = 1; round <= 10; round++) {
+        for (uint32_t i = 0; i < rows; i++) {
+            assert(se.update_record(th, make_key(i), make_value(round, 8)) && "same-size update failed");
+        }
+    }
+    assert(btree_leaf_layout(*th).leaves == leaves && th->dm->get_file_size() == file_size &&
+           "same-size updates changed the tree");
+    std::vector<uint8_t> out;
+    for (uint32_t i = 0; i < rows; i++) {
+        assert(se.get_record(th, make_key(i), out) && out == make_value(10, 8) && "same-size update lost");
+    }
+    std::cout << "[OK] " << rows * 10 << " same-size updates left " << leaves << " leaves as they were\n";
+
+    // A value growing and shrinking over and over is moved within its leaf,
+    // which is compacted rather than split.
+    for (uint32_t round = 0; round < 200; round++) {
+        assert(se.update_record(th, make_key(rows / 2), make_value(round, round % 2 ? 8 : 64)) && "resize failed");
+    }
+    assert(btree_leaf_layout(*th).leaves == leaves && "growing a value in a leaf with room split it");
+    assert(se.get_record(th, make_key(rows / 2), out) && out == make_value(199, 8) && "resized value wrong");
+    std::cout << "[OK] 200 alternating grow/shrink updates kept within one leaf\n";
+
+    // Growing every value overflows the leaves, which split.
+    for (uint32_t i = 0; i < rows; i++) {
+        assert(se.update_record(th, make_key(i), make_value(i, 40)) && "growing update failed");
+    }
+    assert(btree_leaf_layout(*th).leaves > leaves && "full leaves not split");
+    scan_count = 0;
+    se.scan_table(th, scan_callback, nullptr);
+    assert(scan_count == static_cast<int>(rows) && "row count changed by updates");
+    std::cout << "[OK] Growing all values split " << leaves << " leaves into "
+              << btree_leaf_layout(*th).leaves << "\n";
+
+    assert(!se.update_record(th, make_key(rows), make_value(0, 8)) && "update of missing key succeeded");
+    assert(!se.update_record(th, make_key(0), std::vector<uint8_t>(PAGE_SIZE, 'x')) && "oversized update succeeded");
+    assert(se.get_record(th, make_key(0), out) && out == make_value(0, 40) && "failed update changed the value");
+    std::cout << "[OK] Missing keys and oversized values rejected\n";
+
+    se.close_table(th);
+    th = se.open_table(table_name);
+    assert(th != nullptr && "reopen failed");
+    for (uint32_t i = 0; i < rows; i++) {
+        assert(se.get_record(th, make_key(i), out) && out == make_value(i, 40) && "update lost across reopen");
+    }
+    std::cout << "[OK] All updates present after reopen\n";
+
+    se.close_table(th);
+    se.drop_table(table_name);
+    std::cout << "\n=== Update Record Test PASSED ===\n";
+}
+
+// Keeps the larger of the two values, counting its calls in ctx.
+static bool merge_max(const uint8_t* existing, size_t existing_size, const uint8_t* operand, size_t operand_size,
+                      std::vector<uint8_t>& merged, void* ctx) {
+    (*static_cast<int*>(ctx))++;
+    if (existing != nullptr &&
+        !std::lexicographical_compare(existing, existing + existing_size, operand, operand + operand_size)) {
+        return false;
+    }
+    merged.assign(operand, operand + operand_size);
+    return true;
+}
+
+static void test_upsert_and_merge() {
+    std::cout << "\n=== Upsert And Merge Test ===\n";
+
+    const std::string table_name = "test_upsert_merge";
+    std::remove(("data/" + table_name + ".db").c_str());
+    StorageEngine se;
+    assert(se.create_table(table_name) && "create_table failed");
+    TableHandle* th = se.open_table(table_name);
+    assert(th != nullptr && "open_table failed");
+
+    auto make_key = [](uint32_t i) {
+        std::string key = "merge" + std::to_string(100000 + i);
+        return std::vector<uint8_t>(key.begin(), key.end());
+    };
+    auto int64_bytes = [](int64_t n) {
+        std::vector<uint8_t> bytes(sizeof(n));
+        std::memcpy(bytes.data(), &n, sizeof(n));
+        return bytes;
+    };
+
+    std::vector<uint8_t> out;
+    assert(se.upsert(th, make_key(0), {'a'}) && "upsert into empty table failed");
+    assert(se.upsert(th, make_key(0), std::vector<uint8_t>(100, 'b')) && "upsert of a longer value failed");
+    assert(se.get_record(th, make_key(0), out) && out == std::vector<uint8_t>(100, 'b') && "upsert did not replace");
+    assert(se.upsert(th, make_key(0), {'c'}) && se.get_record(th, make_key(0), out) &&
+           out == std::vector<uint8_t>{'c'} && "upsert of a shorter value failed");
+    std::cout << "[OK] Upsert inserts and replaces\n";
+
+    // Counters: every key starts absent and is incremented many times.
+    const uint32_t counters = 2000;
+    for (uint32_t round = 0; round < 10; round++) {
+        for (uint32_t i = 1; i <= counters; i++) {
+            assert(se.merge(th, make_key(i), int64_bytes(i), StorageEngine::MERGE_ADD) && "add failed");
+        }
+    }
+    assert(se.merge(th, make_key(1), int64_bytes(-100), StorageEngine::MERGE_ADD) && "negative add failed");
+    for (uint32_t i = 1; i <= counters; i++) {
+        assert(se.get_record(th, make_key(i), out) && out == int64_bytes(int64_t{i} * 10 - (i == 1 ? 100 : 0)) && "counter wrong");
+    }
+    assert(!se.merge(th, make_key(1), {1, 2}, StorageEngine::MERGE_ADD) && "add of a short operand succeeded");
+    assert(!se.merge(th, make_key(0), int64_bytes(1), StorageEngine::MERGE_ADD) && "add to a non-integer succeeded");
+    assert(se.get_record(th, make_key(0), out) && out == std::vector<uint8_t>{'c'} && "refused add changed the value");
+    std::cout << "[OK] " << counters * 10 << " adds to " << counters << " counters\n";
+
+    // Appends grow values until the leaves split.
+    uint64_t leaves = btree_leaf_layout(*th).leaves;
+    for (uint32_t round = 0; round < 20; round++) {
+        for (uint32_t i = 1; i <= 100; i++) {
+            assert(se.merge(th, make_key(counters + i), {static_cast<uint8_t>('a' + round)}, StorageEngine::MERGE_APPEND) &&
+                   "append failed");
+        }
+    }
+    std::vector<uint8_t> appended;
+    for (uint32_t round = 0; round < 20; round++) {
+        appended.push_back(static_cast<uint8_t>('a' + round));
+    }
+    for (uint32_t i = 1; i <= 100; i++) {
+        assert(se.get_record(th, make_key(counters + i), out) && out == appended && "appended value wrong");
+    }
+    assert(btree_leaf_layout(*th).leaves > leaves && "growing values did not split");
+    assert(!se.merge(th, make_key(1), std::vector<uint8_t>(PAGE_SIZE, 'x'), StorageEngine::MERGE_APPEND) &&
+           "oversized append succeeded");
+    std::cout << "[OK] Appends grew 100 values to " << appended.size() << " bytes\n";
+
+    int calls = 0;
+    uint32_t max_id = se.register_merge_operator(merge_max, &calls);
+    assert(max_id > StorageEngine::MERGE_APPEND && "registered over a built-in operator");
+    assert(se.merge(th, make_key(0), {'e'}, max_id) && "custom merge failed");
+    assert(!se.merge(th, make_key(0), {'d'}, max_id) && "custom merge did not refuse");
+    assert(se.get_record(th, make_key(0), out) && out == std::vector<uint8_t>{'e'} && calls == 2 && "custom merge wrong");
+    assert(!se.merge(th, make_key(0), {'f'}, max_id + 1) && "unknown operator accepted");
+    std::cout << "[OK] Registered operator applied\n";
+
+    // Registering while another thread merges.
+    std::thread registrar([&] {
+        for (int i = 0; i < 200; i++) {
+            se.register_merge_operator(merge_max, nullptr);
+        }
+    });
+    for (uint32_t i = 0; i < 200; i++) {
+        assert(se.merge(th, make_key(1), int64_bytes(1), StorageEngine::MERGE_ADD) && "add during registration failed");
+    }
+    registrar.join();
+    assert(se.get_record(th, make_key(1), out) && out == int64_bytes(110) && "adds during registration lost");
+    assert(se.register_merge_operator(merge_max, nullptr) == max_id + 201 && "concurrent registrations lost");
+    std::cout << "[OK] Merges ran while 200 operators were registered\n";
+
+    se.close_table(th);
+    th = se.open_table(table_name);
+    assert(th != nullptr && "reopen failed");
+    scan_count = 0;
+    se.scan_table(th, scan_callback, nullptr);
+    assert(scan_count == static_cast<int>(counters + 101) && "rows lost across reopen");
+    assert(se.get_record(th, make_key(counters), out) && out == int64_bytes(counters * 10) && "counter lost across reopen");
+    std::cout << "[OK] All " << scan_count << " rows present after reopen\n";
+
+    se.close_table(th);
+    se.drop_table(table_name);
+    std::cout << "\n=== Upsert And Merge Test PASSED ===\n";
+}
+
+static void test_page_compaction() {
+    std::cout << "\n=== Page Compaction Test ===\n";
+
+    // A page full of deleted records compacts to make room.
+    Page page;
+    init_page(page, 1, PageType::DATA, PageLevel::LEAF, PAGE_SIZE);
+    std::vector<uint8_t> value(100, 'v');
+    uint32_t filled = 0;
+    for (; ; filled++) {
+        std::string key = "page" + std::to_string(1000 + filled);
+        if (!page_insert(page, reinterpret_cast<const uint8_t*>(key.data()), static_cast<uint16_t>(key.size()),
+                         value.data(), static_cast<uint16_t>(value.size()))) {
+            break;
+        }
+    }
+    uint16_t rec_size = record_size(8, static_cast<uint16_t>(value.size()));
+    for (uint32_t i = 0; i < filled; i += 2) {
+        std::string key = "page" + std::to_string(1000 + i);
+        assert(page_delete(page, reinterpret_cast<const uint8_t*>(key.data()), static_cast<uint16_t>(key.size())) && "page_delete failed");
+    }
+    assert(get_header(page)->fragmented_bytes == (filled + 1) / 2 * rec_size && "fragmented bytes not counted");
+    assert(!can_insert(page, rec_size) && can_insert_after_compact(page, rec_size) && "garbage not seen as room");
+    page_compact(page);
+    assert(get_header(page)->fragmented_bytes == 0 && can_insert(page, rec_size) && "compaction made no room");
+    for (uint32_t i = 1; i < filled; i += 2) {
+        std::string key = "page" + std::to_string(1000 + i);
+        assert(search_record(page, reinterpret_cast<const uint8_t*>(key.data()), static_cast<uint16_t>(key.size())).found &&
+               "record lost by compaction");
+    }
+    std::cout << "[OK] " << (filled + 1) / 2 << " deleted records reclaimed in place\n";
+
+    // Delete/insert churn at a steady live size keeps its leaves.
+    const std::string table_name = "test_page_compaction";
+    std::remove(("data/" + table_name + ".db").c_str());
+    StorageEngine se;
+    assert(se.create_table(table_name) && "create_table failed");
+    TableHandle* th = se.open_table(table_name);
+    assert(th != nullptr && "open_table failed");
+
+    auto make_key = [](uint32_t i) {
+        std::string key = "churn" + std::to_string(100000 + i);
+        return std::vector<uint8_t>(key.begin(), key.end());
+    };
+    const uint32_t rows = 4000;
+    for (uint32_t i = 0; i < rows; i++) {
+        assert(se.insert_record(th, make_key(i), std::vector<uint8_t>(40, 'a')) && "insert failed");
+    }
+    uint64_t leaves = btree_leaf_layout(*th).leaves;
+    BTreeStats before = se.get_btree_stats(th);
+    for (uint32_t round = 0; round < 10; round++) {
+        for (uint32_t i = 0; i < rows; i++) {
+            uint32_t k = static_cast<uint32_t>((i * 2654435761ULL + round) % rows);
+            assert(se.delete_record(th, make_key(k)) && "churn delete failed");
+            assert(se.insert_record(th, make_key(k), std::vector<uint8_t>(40, static_cast<char>('b' + round))) &&
+                   "churn insert failed");
+        }
+    }
+    BTreeStats after = se.get_btree_stats(th);
+    assert(after.leaf_splits == before.leaf_splits && "churn split leaves");
+    assert(after.splits_avoided > before.splits_avoided && "no page compacted");
+    uint64_t churned_leaves = btree_leaf_layout(*th).leaves;
+    assert(churned_leaves <= leaves && "churn grew the tree");
+    std::vector<uint8_t> out;
+    for (uint32_t i = 0; i < rows; i++) {
+        assert(se.get_record(th, make_key(i), out) && out == std::vector<uint8_t>(40, 'k') && "churned row wrong");
+    }
+    std::cout << "[OK] " << rows * 10 << " deletes and inserts: " << after.splits_avoided - before.splits_avoided
+              << " splits avoided, " << leaves << " leaves down to " << churned_leaves << "\n";
+
+    se.close_table(th);
+    se.drop_table(table_name);
+    std::cout << "\n=== Page Compaction Test PASSED ===\n";
+}
+
+static void test_separator_truncation() {
+    std::cout << "\n=== Separator Truncation Test ===\n";
+
+    auto as_bytes = [](const std::string& s) { return reinterpret_cast<const uint8_t*>(s.data()); };
+    auto separator = [&](const std::string& left, const std::string& right) {
+        Key sep = shortest_separator(as_bytes(left), static_cast<uint16_t>(left.size()),
+                                     as_bytes(right), static_cast<uint16_t>(right.size()));
+        return std::string(reinterpret_cast<const char*>(sep.data()), sep.size());
+    };
+    assert(separator("https://a.com/apple", "https://a.com/banana") == "https://a.com/b" && "separator not truncated");
+    assert(separator("https://a.com/x", "https://a.com/x/y") == "https://a.com/x/" && "prefix key separator wrong");
+    std::cout << "[OK] Separators cut one byte past the shared prefix\n";
+
+    // An internal page stores its shared prefix once and finds children
+    // through it, re-encoding when a key does not share it.
+    Page page;
+    init_page(page, 1, PageType::INDEX, PageLevel::INTERNAL, PAGE_SIZE);
+    *reinterpret_cast<uint32_t*>(get_header(page)->reserved) = 100;
+    const std::string base = "https://www.example.com/catalog/";
+    for (uint32_t i = 1; i <= 20; i++) {
+        std::string key = base + std::to_string(1000 + i * 10);
+        assert(insert_internal_no_split(page, Key(key), 100 + i) && "internal insert failed");
+    }
+    compact_internal_page(page);
+    assert(get_header(page)->prefix_size == base.size() + 1 && "prefix not taken off");
+    auto child_of = [&](const std::string& key) { return internal_find_child(page, Key(key)); };
+    assert(child_of("https://") == 100 && child_of(base + "0") == 100 && child_of(base + "1015") == 101 &&
+           child_of(base + "1205") == 120 && child_of("zzz") == 120 && "lookup through prefix wrong");
+    Key entry = internal_entry_key(page, 4);
+    assert(std::string(reinterpret_cast<const char*>(entry.data()), entry.size()) == base + "1050" && "entry not decoded");
+    assert(insert_internal_no_split(page, Key(std::string("https://www.example.org/")), 200) && "re-encoding insert failed");
+    assert(get_header(page)->prefix_size == std::string("https://www.example.").size() && "prefix not shortened");
+    assert(child_of(base + "1015") == 101 && child_of("https://www.example.org/a") == 200 && "lookup after re-encoding wrong");
+    std::cout << "[OK] Internal page keeps a " << get_header(page)->prefix_size << " byte prefix once\n";
+
+    // URL keys share long prefixes: the tree's separators stay short.
+    const std::string table_name = "test_separator_truncation";
+    std::remove(("data/" + table_name + ".db").c_str());
+    StorageEngine se;
+    assert(se.create_table(table_name) && "create_table failed");
+    TableHandle* th = se.open_table(table_name);
+    assert(th != nullptr && "open_table failed");
+
+    auto make_key = [](uint32_t i) {
+        std::string key = "https://shop.example.com/catalog/department-" + std::to_string(i % 7) + "/product/" +
+                          std::to_string(1000000 + i) + "/reviews?page=1";
+        return std::vector<uint8_t>(key.begin(), key.end());
+    };
+    const uint32_t rows = 6000;
+    for (uint32_t i = 0; i < rows; i++) {
+        uint32_t k = static_cast<uint32_t>(i * 2654435761ULL % rows);
+        assert(se.insert_record(th, make_key(k), std::vector<uint8_t>(8, 'u')) && "insert failed");
+    }
+
+    uint32_t height = 0;
+    size_t separators = 0;
+    size_t separator_bytes = 0;
+    size_t stored_bytes = 0;
+    std::vector<uint32_t> level = {th->root_page};
+    while (!level.empty()) {
+        std::vector<uint32_t> next;
+        for (uint32_t page_id : level) {
+            ReadPageGuard guard = read_page_guard(*th, page_id);
+            assert(guard && "page unreadable");
+            PageHeader* ph = get_header(guard.page());
+            if (ph->page_level != PageLevel::INTERNAL) {
+                continue;
+            }
+            next.push_back(*reinterpret_cast<uint32_t*>(ph->reserved));
+            stored_bytes += ph->prefix_size;
+            for (uint16_t i = 0; i < ph->cell_count; i++) {
+                auto* e = reinterpret_cast<InternalEntry*>(guard.page().data + *slot_ptr(guard.page(), i));
+                next.push_back(e->child_page);
+                separators++;
+                separator_bytes += internal_entry_key(guard.page(), i).size();
+                stored_bytes += e->key_size;
+            }
+        }
+        height++;
+        level = std::move(next);
+    }
+    size_t key_size = make_key(0).size();
+    // Rows differ in the product number, so no separator needs the query.
+    assert(separators > 0 && separator_bytes < separators * (key_size - 10) && "separators not truncated");
+    assert(stored_bytes < separator_bytes / 2 && "separators not prefix-compressed");
+    std::cout << "[OK] " << separators << " separators average " << separator_bytes / separators << " of "
+              << key_size << " key bytes, " << stored_bytes << " bytes stored, height " << height << "\n";
+
+    std::vector<uint8_t> out;
+    for (uint32_t i = 0; i < rows; i++) {
+        assert(se.get_record(th, make_key(i), out) && "row lost");
+    }
+    std::vector<std::vector<uint8_t>> keys;
+    for (uint32_t i = 0; i < rows; i += 3) {
+        keys.push_back(make_key(i));
+    }
+    StorageEngine::BatchResult batch;
+    assert(se.get_batch(th, keys, batch) == keys.size() && "batch lookup missed rows");
+
+    struct ScanState {
+        std::vector<uint8_t> last;
+        size_t count = 0;
+        bool ordered = true;
+    } scan;
+    se.scan_table(th, [](const std::vector<uint8_t>& key, const std::vector<uint8_t>&, void* ctx) {
+        auto* state = static_cast<ScanState*>(ctx);
+        state->ordered = state->ordered && (state->count == 0 || state->last < key);
+        state->last = key;
+        state->count++;
+    }, &scan);
+    assert(scan.count == rows && scan.ordered && "scan out of order");
+
+    for (uint32_t i = 0; i < rows; i++) {
+        if (i % 4 != 0) {
+            assert(se.delete_record(th, make_key(i)) && "delete failed");
+        }
+    }
+    for (uint32_t i = 0; i < rows; i++) {
+        assert(se.get_record(th, make_key(i), out) == (i % 4 == 0) && "delete left the wrong rows");
+    }
+    std::cout << "[OK] Lookups, batch lookups, scans and deletes find every URL row\n";
+
+    se.close_table(th);
+    se.drop_table(table_name);
+
+    // Separators as long as a 300-byte shared prefix still fit several to
+    // an internal page, whether the rows are inserted or bulk loaded. One
+    // past max_separator_size fails the split with the leaf as it was.
+    const uint32_t page_bytes = PAGE_SIZE;
+    auto long_key = [](size_t prefix, uint32_t i) {
+        std::string key = std::string(prefix, 'p') + std::to_string(100000 + i);
+        return std::vector<uint8_t>(key.begin(), key.end());
+    };
+    const uint32_t long_rows = 300;
+    for (bool bulk : {false, true}) {
+        assert(se.create_table(table_name, page_bytes) && "create_table failed");
+        th = se.open_table(table_name);
+        assert(th != nullptr && "open_table failed");
+        if (bulk) {
+            struct Source {
+                std::vector<std::vector<uint8_t>> keys;
+                size_t next = 0;
+            } source;
+            for (uint32_t i = 0; i < long_rows; i++) {
+                source.keys.push_back(long_key(300, i));
+            }
+            assert(se.bulk_load(th, [](std::vector<uint8_t>& key, std::vector<uint8_t>& value, void* ctx) {
+                auto* source = static_cast<Source*>(ctx);
+                if (source->next == source->keys.size()) {
+                    return false;
+                }
+                key = source->keys[source->next++];
+                value.assign(8, 'b');
+                return true;
+            }, &source) && "bulk load of long keys failed");
+        } else {
+            for (uint32_t i = 0; i < long_rows; i++) {
+                uint32_t k = i * 7 % long_rows;
+                assert(se.insert_record(th, long_key(300, k), std::vector<uint8_t>(8, 'i')) && "long key insert failed");
+            }
+        }
+        for (uint32_t i = 0; i < long_rows; i++) {
+            assert(se.get_record(th, long_key(300, i), out) && "long key row lost");
+        }
+        se.close_table(th);
+        se.drop_table(table_name);
+    }
+    std::cout << "[OK] " << long_rows << " rows sharing a 300-byte prefix inserted and bulk loaded\n";
+
+    assert(se.create_table(table_name, page_bytes) && "create_table failed");
+    th = se.open_table(table_name);
+    assert(th != nullptr && "open_table failed");
+    const size_t too_long = max_separator_size(page_bytes) + 1;
+    uint32_t inserted = 0;
+    while (se.insert_record(th, long_key(too_long, inserted), std::vector<uint8_t>(8, 'x'))) {
+        inserted++;
+        assert(inserted < 10 && "split around an oversized separator went through");
+    }
+    for (uint32_t i = 0; i < inserted; i++) {
+        assert(se.get_record(th, long_key(too_long, i), out) && "failed split lost a row");
+    }
+    assert(se.insert_record(th, long_key(0, 1), std::vector<uint8_t>(8, 's')) &&
+           se.get_record(th, long_key(0, 1), out) && "table unusable after a failed split");
+    std::cout << "[OK] A " << too_long << "-byte separator fails the split after " << inserted << " rows\n";
+    se.close_table(th);
+    se.drop_table(table_name);
+    std::cout << "\n=== Separator Truncation Test PASSED ===\n";
+}
+
+static void test_concurrent_btree() {
+    std::cout << "\n=== Concurrent B+Tree Readers Test ===\n";
+
+    const std::string table_name = "test_concurrent_btree";
+    std::remove(("data/" + table_name + ".db").c_str());
+    StorageEngine se;
+    assert(se.create_table(table_name) && "create_table failed");
+    TableHandle* th = se.open_table(table_name);
+    assert(th != nullptr && "open_table failed");
+
+    auto make_key = [](uint32_t i) {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "key%07u", i);
+        return std::string(buf);
+    };
+    const std::string value(40, 'v');
+    const Value row_value(reinterpret_cast<const uint8_t*>(value.data()), static_cast<uint16_t>(value.size()));
+
+    // The even keys go in first and stay. The engine's own lookups wait
+    // for writers, so the readers call the tree directly while one writer
+    // splits leaves and internal pages around those keys, grows the root,
+    // and then merges the leaves again. Keys under another prefix make the
+    // internal pages they land on re-encode under a shorter one.
+    const uint32_t rows = 12000;
+    for (uint32_t i = 0; i < rows; i += 2) {
+        assert(btree_insert(*th, Key(make_key(i)), row_value) && "load failed");
+    }
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> lookups{0};
+    std::atomic<uint64_t> bad_scans{0};
+    auto other_key = [](uint32_t i) {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "k%07u", i);
+        return std::string(buf);
+    };
+    std::thread writer([&] {
+        for (uint32_t i = 1; i < rows; i += 2) {
+            btree_insert(*th, Key(make_key(i)), row_value);
+            btree_insert(*th, Key(other_key(i)), row_value);
+        }
+        for (uint32_t i = 1; i < rows; i += 2) {
+            btree_delete(*th, Key(make_key(i)));
+            btree_delete(*th, Key(other_key(i)));
+        }
+        done = true;
+    });
+    auto reader = [&](uint32_t seed) {
+        struct ScanState {
+            uint32_t even = 0;
+            std::string last;
+            bool ordered = true;
+        };
+        uint32_t i = seed;
+        while (!done) {
+            for (int n = 0; n < 200; n++) {
+                i = (i * 1103515245u + 12345u) % rows & ~1u;
+                Value out;
+                if (!btree_search(*th, Key(make_key(i)), out) || out.size() != value.size()) {
+                    misses++;
+                }
+                lookups++;
+            }
+            ScanState scan;
+            btree_range_scan(*th, Key(), Key(), [](const Key& key, const Value&, void* ctx) {
+                auto* state = static_cast<ScanState*>(ctx);
+                std::string k(reinterpret_cast<const char*>(key.data()), key.size());
+                state->ordered = state->ordered && state->last < k;
+                state->even += k.compare(0, 3, "key") == 0 && (k.back() - '0') % 2 == 0 ? 1 : 0;
+                state->last = k;
+            }, &scan);
+            if (scan.even != rows / 2 || !scan.ordered) {
+                bad_scans++;
+            }
+        }
+    };
+    std::thread first(reader, 1);
+    std::thread second(reader, 2);
+    writer.join();
+    first.join();
+    second.join();
+    assert(misses == 0 && "a reader missed a key during splits and merges");
+    assert(bad_scans == 0 && "a scan missed keys or went out of order");
+    for (uint32_t i = 0; i < rows; i++) {
+        Value out;
+        assert(btree_search(*th, Key(make_key(i)), out) == (i % 2 == 0) && "writer left the wrong rows");
+    }
+    std::cout << "[OK] " << lookups.load() << " lookups and every scan saw all rows while the tree split and merged\n";
+
+    se.close_table(th);
+    se.drop_table(table_name);
+    std::cout << "\n=== Concurrent B+Tree Readers Test PASSED ===\n";
+}
+
 int main() {
     try {
         test_basic_operations();
         test_multiple_records();
         test_scan_table();
         test_range_scan();
+        test_shared_buffer_pool();
+        test_disk_manager();
+        test_io_queue();
+        test_page_cleaner();
+        test_flush_coalescing();
+        test_lru_replacer();
+        test_replacer_policies();
+        test_page_guards();
+        test_concurrent_misses();
+        test_concurrent_pins();
+        test_read_ahead();
+        test_mmap_access_mode();
+        test_durability_modes();
+        test_page_sizes();
+        test_page_compression();
+        test_tablespace();
+        test_free_space_map();
+        test_leaf_locality();
+        test_compact_table();
+        test_bulk_load();
+        test_insert_batch();
+        test_get_batch();
+        test_update_record();
+        test_upsert_and_merge();
+        test_page_compaction();
+        test_separator_truncation();
+        test_concurrent_btree();
 
         std::cout << "\n\n=== ALL STORAGE ENGINE TESTS PASSED ===\n";
         return 0;